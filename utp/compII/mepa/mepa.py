@@ -258,6 +258,16 @@ class InstructionSet:
         absaddr = self.mem.get(D_SEGMENT + k) + reladdr
         self.mem.set(absaddr, value)
 
+    @extension
+    def i_armc(self): # extensao
+        "Atribuição que mantém o valor no topo da pilha"
+        reladdr = self.mem.pop()
+        k = self.mem.pop()
+        value = self.mem.pop()
+        absaddr = self.mem.get(D_SEGMENT + k) + reladdr
+        self.mem.set(absaddr, value)
+        self.mem.push(value)
+
     def i_armi(self):
         reladdr = self.mem.pop()
         k = self.mem.pop()
@@ -319,7 +329,7 @@ class InstructionSet:
         "Chamada de procedimento (salva PC, k, e salta para endereço)"
         k = self.mem.pop()
         addr = self.mem.pop()
-        self.mem.push(self.regs.pc + 1)
+        self.mem.push(self.regs.pc)
         self.mem.tag(self.regs.sp, "N")
         self.mem.push(self.regs.bp)
         self.mem.tag(self.regs.sp, "B")
@@ -421,13 +431,13 @@ class MEPA:
             if self.debug:
                 print "PC: 0x%x SP: 0x%x INSTR: %s ARGS: %s" % \
                       (self.regs.pc, self.regs.sp, instr.__name__, args)
-            prevpc = self.regs.pc
+            # the jumps set pc, the next instruction runs otherwise (a
+            # jump to the instruction itself included)
+            self.regs.pc += 1
             try:
                 instr()
             except ProgramFinished:
                 break
-            if prevpc == self.regs.pc:
-                self.regs.pc += 1
 
     def assemble_program(self, source):
         code = []
@@ -0,0 +1,115 @@
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "arena.h"
+
+struct arena *create_arena(size_t block_size)
+{
+	struct arena *arena;
+
+	arena = (struct arena*) malloc(sizeof(struct arena));
+	if (!arena)
+		return NULL;
+
+	arena->current = NULL;
+	arena->spare = NULL;
+	arena->block_size = block_size;
+
+	return arena;
+}
+
+void destroy_arena(struct arena *arena)
+{
+	struct arena_block *block, *prev;
+
+	for (block = arena->current; block; block = prev) {
+		prev = block->prev;
+		free(block);
+	}
+	free(arena->spare);
+	free(arena);
+}
+
+/* the offset in the block where an allocation would start */
+static size_t aligned_used(struct arena_block *block)
+{
+	uintptr_t addr = (uintptr_t) (block->data + block->used);
+
+	return block->used + (-addr & (ARENA_ALIGN - 1));
+}
+
+static struct arena_block *new_block(struct arena *arena, size_t size)
+{
+	struct arena_block *block;
+
+	/* room for the alignment of the first allocation */
+	size += ARENA_ALIGN;
+	if (size < arena->block_size)
+		size = arena->block_size;
+
+	if (arena->spare && arena->spare->size >= size) {
+		block = arena->spare;
+		arena->spare = NULL;
+	}
+	else {
+		block = (struct arena_block*) malloc(sizeof(struct arena_block)
+				+ size);
+		if (!block)
+			return NULL;
+		block->size = size;
+	}
+	block->used = 0;
+	block->prev = arena->current;
+	arena->current = block;
+
+	return block;
+}
+
+/** Returns size bytes aligned to ARENA_ALIGN, or NULL when there is no
+ * memory left */
+void *arena_alloc(struct arena *arena, size_t size)
+{
+	struct arena_block *block = arena->current;
+	size_t start;
+
+	if (block) {
+		start = aligned_used(block);
+		if (start <= block->size && block->size - start >= size) {
+			block->used = start + size;
+			return block->data + start;
+		}
+	}
+
+	block = new_block(arena, size);
+	if (!block)
+		return NULL;
+	start = aligned_used(block);
+	block->used = start + size;
+
+	return block->data + start;
+}
+
+struct arena_mark arena_mark(struct arena *arena)
+{
+	struct arena_mark mark;
+
+	mark.block = arena->current;
+	mark.used = arena->current ? arena->current->used : 0;
+
+	return mark;
+}
+
+/** Gives back everything allocated after the mark was taken */
+void arena_release(struct arena *arena, struct arena_mark mark)
+{
+	struct arena_block *block;
+
+	while (arena->current != mark.block) {
+		block = arena->current;
+		arena->current = block->prev;
+		free(arena->spare);
+		arena->spare = block;
+	}
+	if (mark.block)
+		mark.block->used = mark.used;
+}
@@ -0,0 +1,39 @@
+#ifndef inc_arena_h
+#define inc_arena_h
+
+#include <stddef.h>
+
+/* A bump allocator: the memory is taken from big blocks and it is only
+ * given back all at once, either by destroying the arena or by releasing
+ * everything allocated after a mark.
+ */
+
+#define ARENA_ALIGN		16
+#define ARENA_BLOCK_SIZE	65536
+
+struct arena_block {
+	struct arena_block *prev;
+	size_t size;
+	size_t used;
+	char data[];
+};
+
+struct arena {
+	struct arena_block *current;
+	struct arena_block *spare;	/* the last block released, kept to
+					   be reused */
+	size_t block_size;
+};
+
+struct arena_mark {
+	struct arena_block *block;
+	size_t used;
+};
+
+struct arena *create_arena(size_t block_size);
+void destroy_arena(struct arena *arena);
+void *arena_alloc(struct arena *arena, size_t size);
+struct arena_mark arena_mark(struct arena *arena);
+void arena_release(struct arena *arena, struct arena_mark mark);
+
+#endif /* inc_arena_h */
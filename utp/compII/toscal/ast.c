@@ -0,0 +1,449 @@
+/** ast.c
+ *
+ * Each walk_* function does what the state_* function of parser.c of the
+ * same production does with the semantic.c calls, with the values of the
+ * tokens taken from the nodes. Keep them in sync.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "ast.h"
+#include "tokenize.h"
+
+#define OK	1
+
+struct ast *create_ast(void)
+{
+	struct ast *ast;
+
+	ast = (struct ast*) malloc(sizeof(struct ast));
+	if (!ast)
+		return NULL;
+
+	ast->arena = create_arena(AST_ARENA_SIZE);
+	if (!ast->arena) {
+		free(ast);
+		return NULL;
+	}
+	ast->root = NULL;
+	ast->error_position = NULL;
+
+	return ast;
+}
+
+void destroy_ast(struct ast *ast)
+{
+	destroy_arena(ast->arena);
+	free(ast);
+}
+
+struct ast_node *ast_new_node(struct ast *ast, enum ast_kind kind)
+{
+	struct ast_node *node;
+
+	node = (struct ast_node*) arena_alloc(ast->arena,
+			sizeof(struct ast_node));
+	if (!node)
+		return NULL;
+
+	node->kind = kind;
+	node->flags = 0;
+	node->ident = 0;
+	node->value.integer = 0;
+	node->names = NULL;
+	node->child[0] = node->child[1] = node->child[2] = NULL;
+	node->next = NULL;
+
+	return node;
+}
+
+struct ast_walker {
+	struct ast *ast;
+	struct semantic_state *ss;
+	int check;
+};
+
+/* the same as SEMANTIC_HOOK() in parser.c, the error is at the position
+ * i of the node */
+#define WALK_HOOK(node, i, fcall) do { \
+	if (w->ss->debug_stream) \
+		fprintf(w->ss->debug_stream, "%s\n", #fcall); \
+	if (w->check && fcall == ERROR) { \
+		w->ast->error_position = &(node)->pos[i]; \
+		return ERROR; \
+	} } while(0)
+
+#define WALK(fcall) do { \
+	if (fcall == ERROR) \
+		return ERROR; \
+	} while (0)
+
+static int walk_expression(struct ast_walker *w, struct ast_node *node,
+		sem_ref_t *rval);
+static int walk_command(struct ast_walker *w, struct ast_node *node);
+static int walk_block(struct ast_walker *w, struct ast_node *node);
+
+static int walk_type(struct ast_walker *w, struct ast_node *node,
+		sem_ref_t *rval)
+{
+	WALK_HOOK(node, 0, sem_find_type(w->ss, node->ident, rval));
+	return OK;
+}
+
+static int walk_variables(struct ast_walker *w, struct ast_node *node)
+{
+	sem_ref_t rval;
+
+	WALK(walk_type(w, node->child[0], &rval));
+	WALK_HOOK(node, 0, sem_decl_var_list(w->ss, node->names, &rval));
+	return OK;
+}
+
+static int walk_arguments(struct ast_walker *w, struct ast_node *node,
+		sem_ref_t *var)
+{
+	struct ast_node *arg;
+	sem_ref_t rval, expritem, ref;
+	int ignoreref;
+
+	WALK_HOOK(node, 0, sem_begin_expr_list(w->ss, var, &expritem, &ref));
+
+	for (arg = node->child[0]; arg; arg = arg->next) {
+		ignoreref = 1;
+
+		if (arg->flags & AST_IDENT_FIRST) {
+			WALK_HOOK(arg, 0, sem_hold_var(w->ss, arg->ident,
+						&ref));
+			WALK_HOOK(arg, 0, sem_check_ref(w->ss, &expritem,
+						&ref, &rval, &ignoreref));
+		}
+
+		if (ignoreref)
+			WALK(walk_expression(w, arg->child[0], &rval));
+		else if (arg->child[0]->kind != AST_VARIABLE) {
+			/* the parser takes just the variable and fails on
+			 * what follows it */
+			semantic_set_error(w->ss, SEMANTIC_INVALID_BYREF_ARG,
+					intern_name(w->ss->idents,
+						arg->ident));
+			w->ast->error_position = &arg->pos[1];
+			return ERROR;
+		}
+
+		WALK_HOOK(arg, 1, sem_expr_list_item(w->ss, var, &expritem,
+					&rval, &ref));
+	}
+
+	WALK_HOOK(node, 1, sem_end_expr_list(w->ss, var, &expritem));
+
+	return OK;
+}
+
+static int walk_expression(struct ast_walker *w, struct ast_node *node,
+		sem_ref_t *rval)
+{
+	sem_ref_t var, left, right;
+
+	switch (node->kind) {
+	case AST_INTEGER:
+		WALK_HOOK(node, 0, sem_put_integer(w->ss, node->value.integer,
+					rval));
+		break;
+	case AST_REAL:
+		WALK_HOOK(node, 0, sem_put_real(w->ss, node->value.real,
+					rval));
+		break;
+	case AST_CHAR:
+		WALK_HOOK(node, 0, sem_put_char(w->ss, node->value.character,
+					rval));
+		break;
+	case AST_VARIABLE:
+		WALK_HOOK(node, 0, sem_hold_var(w->ss, node->ident, &var));
+		WALK_HOOK(node, 1, sem_get_var(w->ss, &var, rval));
+		break;
+	case AST_FUNCALL:
+		WALK_HOOK(node, 0, sem_hold_var(w->ss, node->ident, &var));
+		WALK_HOOK(node, 1, sem_funcall_prolog(w->ss, &var));
+		WALK(walk_arguments(w, node->child[0], &var));
+		WALK_HOOK(node, 2, sem_call_function(w->ss, &var, rval));
+		break;
+	case AST_NOT:
+		WALK(walk_expression(w, node->child[0], rval));
+		left = *rval;
+		WALK_HOOK(node, 0, sem_not_value(w->ss, &left, rval));
+		break;
+	case AST_INVERT:
+		WALK(walk_expression(w, node->child[0], rval));
+		WALK_HOOK(node, 0, sem_invert_value(w->ss, rval));
+		break;
+	case AST_BINARY:
+		WALK(walk_expression(w, node->child[0], &left));
+		if (node->value.op == TOK_KW_AND || node->value.op == TOK_KW_OR)
+			WALK_HOOK(node, 0, sem_boolcmp_operand(w->ss, &left));
+		WALK(walk_expression(w, node->child[1], &right));
+
+		switch (node->value.op) {
+		case TOK_ASTERISK:
+			WALK_HOOK(node, 1, sem_mul_values(w->ss, &left,
+						&right, rval));
+			break;
+		case TOK_KW_DIV:
+			WALK_HOOK(node, 1, sem_div_values(w->ss, &left,
+						&right, rval));
+			break;
+		case TOK_KW_MOD:
+			WALK_HOOK(node, 1, sem_mod_values(w->ss, &left,
+						&right, rval));
+			break;
+		case TOK_KW_AND:
+			WALK_HOOK(node, 1, sem_boolcmp_values(w->ss,
+						SEMANTIC_BOOL_AND, &left,
+						&right, rval));
+			break;
+		case TOK_PLUS:
+			WALK_HOOK(node, 1, sem_sum_values(w->ss, &left,
+						&right, rval));
+			break;
+		case TOK_MINUS:
+			WALK_HOOK(node, 1, sem_subt_values(w->ss, &left,
+						&right, rval));
+			break;
+		case TOK_KW_OR:
+			WALK_HOOK(node, 1, sem_boolcmp_values(w->ss,
+						SEMANTIC_BOOL_OR, &left,
+						&right, rval));
+			break;
+		case TOK_EQUAL:
+			WALK_HOOK(node, 1, sem_relcmp_values(w->ss,
+						SEMANTIC_CMP_EQUAL, &left,
+						&right, rval));
+			break;
+		case TOK_DIFFERENT:
+			WALK_HOOK(node, 1, sem_relcmp_values(w->ss,
+						SEMANTIC_CMP_DIFFERENT, &left,
+						&right, rval));
+			break;
+		case TOK_LESSTHAN:
+			WALK_HOOK(node, 1, sem_relcmp_values(w->ss,
+						SEMANTIC_CMP_LESSTHAN, &left,
+						&right, rval));
+			break;
+		case TOK_LESSEQTHAN:
+			WALK_HOOK(node, 1, sem_relcmp_values(w->ss,
+						SEMANTIC_CMP_LESSEQTHAN, &left,
+						&right, rval));
+			break;
+		case TOK_GREATERTHAN:
+			WALK_HOOK(node, 1, sem_relcmp_values(w->ss,
+						SEMANTIC_CMP_GREATERTHAN,
+						&left, &right, rval));
+			break;
+		case TOK_GREATEREQTHAN:
+			WALK_HOOK(node, 1, sem_relcmp_values(w->ss,
+						SEMANTIC_CMP_GREATEREQTHAN,
+						&left, &right, rval));
+			break;
+		default:
+			break;
+		}
+		break;
+	default:
+		break;
+	}
+
+	return OK;
+}
+
+static int walk_commands(struct ast_walker *w, struct ast_node *node)
+{
+	for (; node; node = node->next)
+		WALK(walk_command(w, node));
+	return OK;
+}
+
+static int walk_command(struct ast_walker *w, struct ast_node *node)
+{
+	struct ast_node *item;
+	sem_ref_t var, rval, holdpos;
+
+	switch (node->kind) {
+	case AST_LABELED:
+		WALK_HOOK(node, 0, sem_hold_var(w->ss, node->ident, &var));
+		WALK_HOOK(node, 1, sem_inst_label(w->ss, &var));
+		WALK(walk_command(w, node->child[0]));
+		break;
+	case AST_COMMAND_BLOCK:
+		WALK(walk_commands(w, node->child[0]));
+		break;
+	case AST_ASSIGNMENT:
+		WALK_HOOK(node, 0, sem_hold_var(w->ss, node->ident, &var));
+		WALK(walk_expression(w, node->child[0], &rval));
+		WALK_HOOK(node, 1, sem_var_assignment(w->ss, &var, &rval));
+		break;
+	case AST_CALL:
+		WALK_HOOK(node, 0, sem_hold_var(w->ss, node->ident, &var));
+		WALK_HOOK(node, 1, sem_funcall_prolog(w->ss, &var));
+		if (node->child[0])
+			WALK(walk_arguments(w, node->child[0], &var));
+		WALK_HOOK(node, 2, sem_call_function(w->ss, &var, &rval));
+		WALK_HOOK(node, 2, sem_funcall_cleanup(w->ss, &var, 1));
+		break;
+	case AST_CONDITIONAL:
+		WALK_HOOK(node, 0, sem_cond_prolog(w->ss, &holdpos));
+		WALK(walk_expression(w, node->child[0], &rval));
+		WALK_HOOK(node, 1, sem_cond_eval(w->ss, &rval, &holdpos));
+		WALK(walk_command(w, node->child[1]));
+		if (node->child[2]) {
+			WALK_HOOK(node, 2, sem_cond_else(w->ss, &holdpos));
+			WALK(walk_command(w, node->child[2]));
+		}
+		WALK_HOOK(node, 3, sem_cond_epilog(w->ss, &holdpos));
+		break;
+	case AST_WHILE:
+		WALK_HOOK(node, 0, sem_while_prolog(w->ss, &holdpos));
+		WALK(walk_expression(w, node->child[0], &rval));
+		WALK_HOOK(node, 1, sem_while_eval(w->ss, &rval, &holdpos));
+		WALK(walk_command(w, node->child[1]));
+		WALK_HOOK(node, 2, sem_while_epilog(w->ss, &holdpos));
+		break;
+	case AST_REPEAT:
+		WALK_HOOK(node, 0, sem_repeat_prolog(w->ss, &holdpos));
+		WALK(walk_commands(w, node->child[1]));
+		WALK(walk_expression(w, node->child[0], &rval));
+		WALK_HOOK(node, 1, sem_repeat_eval(w->ss, &rval, &holdpos));
+		break;
+	case AST_GOTO:
+		WALK_HOOK(node, 0, sem_hold_var(w->ss, node->ident, &var));
+		WALK_HOOK(node, 0, sem_goto_label(w->ss, &var));
+		break;
+	case AST_READ:
+		for (item = node->child[0]; item; item = item->next) {
+			WALK_HOOK(item, 0, sem_hold_var(w->ss, item->ident,
+						&var));
+			WALK_HOOK(item, 0, sem_read_var(w->ss, &var));
+		}
+		break;
+	case AST_WRITE:
+		for (item = node->child[0]; item; item = item->next) {
+			WALK(walk_expression(w, item->child[0], &rval));
+			WALK_HOOK(item, 0, sem_write_value(w->ss, &rval));
+		}
+		break;
+	default:
+		break;
+	}
+
+	return OK;
+}
+
+static int walk_const(struct ast_walker *w, struct ast_node *node)
+{
+	struct ast_node *value = node->child[0];
+
+	switch (value->kind) {
+	case AST_INTEGER:
+		WALK_HOOK(node, 0, sem_decl_const_int(w->ss, node->ident,
+					value->value.integer));
+		break;
+	case AST_REAL:
+		WALK_HOOK(node, 0, sem_decl_const_real(w->ss, node->ident,
+					value->value.real));
+		break;
+	case AST_CHAR:
+		WALK_HOOK(node, 0, sem_decl_const_char(w->ss, node->ident,
+					value->value.character));
+		break;
+	default:
+		break;
+	}
+
+	return OK;
+}
+
+static int walk_params(struct ast_walker *w, struct ast_node *node)
+{
+	if (node->flags & AST_BYREF)
+		WALK_HOOK(node, 0, sem_set_byref_param(w->ss));
+	WALK(walk_variables(w, node->child[0]));
+	WALK_HOOK(node, 1, sem_set_byval_param(w->ss));
+	return OK;
+}
+
+static int walk_procedure(struct ast_walker *w, struct ast_node *node)
+{
+	struct ast_node *params;
+	sem_ref_t var, type;
+
+	if (node->kind == AST_DECL_FUNCTION)
+		WALK_HOOK(node, 0, sem_decl_function(w->ss, node->ident,
+					&var));
+	else
+		WALK_HOOK(node, 0, sem_decl_procedure(w->ss, node->ident,
+					&var));
+
+	if (node->child[0]) {
+		WALK_HOOK(node, 1, sem_begin_params(w->ss, &var));
+		for (params = node->child[0]; params; params = params->next)
+			WALK(walk_params(w, params));
+		WALK_HOOK(node, 2, sem_finish_params(w->ss, &var));
+	}
+
+	if (node->child[1]) {
+		WALK(walk_type(w, node->child[1], &type));
+		WALK_HOOK(node->child[1], 1, sem_function_type(w->ss, &var,
+					&type));
+	}
+
+	WALK(walk_block(w, node->child[2]));
+	WALK_HOOK(node, 3, sem_finish_procedure(w->ss, &var));
+
+	return OK;
+}
+
+static int walk_block(struct ast_walker *w, struct ast_node *node)
+{
+	struct ast_node *decl;
+
+	for (decl = node->child[0]; decl; decl = decl->next)
+		switch (decl->kind) {
+		case AST_DECL_LABEL:
+			WALK_HOOK(decl, 0, sem_decl_label(w->ss,
+						decl->ident));
+			break;
+		case AST_DECL_CONST:
+			WALK(walk_const(w, decl));
+			break;
+		case AST_DECL_VARS:
+			WALK(walk_variables(w, decl));
+			break;
+		case AST_DECL_PROCEDURE:
+		case AST_DECL_FUNCTION:
+			WALK(walk_procedure(w, decl));
+			break;
+		default:
+			break;
+		}
+
+	WALK_HOOK(node, 0, sem_begin_code_block(w->ss));
+
+	return walk_command(w, node->child[1]);
+}
+
+/** Makes the calls to semantic.c for the whole program. When check is
+ * off, their errors are ignored (like with the -S of the parser). */
+int ast_walk(struct ast *ast, struct semantic_state *ss, int check)
+{
+	struct ast_walker walker, *w = &walker;
+	struct ast_node *node = ast->root;
+
+	w->ast = ast;
+	w->ss = ss;
+	w->check = check;
+	ast->error_position = NULL;
+
+	WALK_HOOK(node, 0, sem_init_program(ss, node->ident));
+	WALK(walk_block(w, node->child[0]));
+	WALK_HOOK(node, 1, sem_finish_program(ss));
+
+	return OK;
+}
@@ -0,0 +1,136 @@
+/** The syntax tree built by the parser with -A, instead of calling
+ * semantic.c as it reads the source: one node for each production of the
+ * grammar, allocated from an arena.
+ *
+ * ast_walk() then makes the calls to semantic.c the parser would have
+ * made, in the same order and with the same positions for the messages,
+ * so the generated code is the same. Whatever needs to see the whole
+ * program before the code is generated works on the tree in between.
+ */
+#ifndef inc_ast_h
+#define inc_ast_h
+
+#include <stdio.h>
+
+#include "input.h"
+#include "intern.h"
+#include "arena.h"
+#include "string_list.h"
+#include "semantic.h"
+
+#define AST_ARENA_SIZE	65536
+
+/* The children and positions of each kind, the positions are where the
+ * parser is when it calls the functions of semantic.c given */
+enum ast_kind {
+	/* ident, child[0] the block; pos[0] sem_init_program, pos[1]
+	 * sem_finish_program */
+	AST_PROGRAM,
+	/* child[0] the declarations, child[1] the command block; pos[0]
+	 * sem_begin_code_block */
+	AST_BLOCK,
+	/* ident; pos[0] sem_decl_label */
+	AST_DECL_LABEL,
+	/* ident, child[0] the value (AST_INTEGER, AST_REAL or AST_CHAR);
+	 * pos[0] sem_decl_const_* */
+	AST_DECL_CONST,
+	/* names, child[0] the type; pos[0] sem_decl_var_list */
+	AST_DECL_VARS,
+	/* ident; pos[0] sem_find_type, pos[1] sem_function_type */
+	AST_TYPE,
+	/* ident, child[0] the params, child[1] the type of a function,
+	 * child[2] the block; pos[0] sem_decl_*, pos[1] sem_begin_params,
+	 * pos[2] sem_finish_params, pos[3] sem_finish_procedure */
+	AST_DECL_PROCEDURE,
+	AST_DECL_FUNCTION,
+	/* flags AST_BYREF, child[0] the variables; pos[0]
+	 * sem_set_byref_param, pos[1] sem_set_byval_param */
+	AST_PARAMS,
+
+	/* child[0] the commands */
+	AST_COMMAND_BLOCK,
+	/* ident the label, child[0] the command; pos[0] sem_hold_var, pos[1]
+	 * sem_inst_label */
+	AST_LABELED,
+	/* ident, child[0] the value; pos[0] sem_hold_var, pos[1]
+	 * sem_var_assignment */
+	AST_ASSIGNMENT,
+	/* ident, child[0] the arguments (if any); pos[0] sem_hold_var,
+	 * pos[1] sem_funcall_prolog, pos[2] sem_call_function */
+	AST_CALL,
+	/* child[0] the condition, child[1] then, child[2] else (if any);
+	 * pos[0] sem_cond_prolog, pos[1] sem_cond_eval, pos[2]
+	 * sem_cond_else, pos[3] sem_cond_epilog */
+	AST_CONDITIONAL,
+	/* child[0] the condition, child[1] the command; pos[0]
+	 * sem_while_prolog, pos[1] sem_while_eval, pos[2] sem_while_epilog */
+	AST_WHILE,
+	/* child[0] the condition, child[1] the commands; pos[0]
+	 * sem_repeat_prolog, pos[1] sem_repeat_eval */
+	AST_REPEAT,
+	/* ident the label; pos[0] sem_goto_label */
+	AST_GOTO,
+	/* child[0] the variables */
+	AST_READ,
+	/* child[0] the values */
+	AST_WRITE,
+	/* child[0] the expression; pos[0] sem_write_value */
+	AST_VALUE,
+
+	/* pos[0] sem_begin_expr_list, pos[1] sem_end_expr_list, child[0]
+	 * the arguments */
+	AST_ARGUMENTS,
+	/* flags AST_IDENT_FIRST with its ident, child[0] the expression;
+	 * pos[0] sem_check_ref, pos[1] sem_expr_list_item */
+	AST_ARGUMENT,
+
+	/* value; pos[0] sem_put_* */
+	AST_INTEGER,
+	AST_REAL,
+	AST_CHAR,
+	/* ident; pos[0] sem_hold_var, pos[1] sem_get_var (sem_read_var) */
+	AST_VARIABLE,
+	/* ident, child[0] the arguments; pos[0] sem_hold_var, pos[1]
+	 * sem_funcall_prolog, pos[2] sem_call_function */
+	AST_FUNCALL,
+	/* value.op the token, child[0] and child[1] the operands; pos[0]
+	 * sem_boolcmp_operand, pos[1] the operation */
+	AST_BINARY,
+	/* child[0] the operand; pos[0] sem_not_value */
+	AST_NOT,
+	/* child[0] the operand; pos[0] sem_invert_value */
+	AST_INVERT
+};
+
+#define AST_BYREF	1	/* a "var" in the params */
+#define AST_IDENT_FIRST	2	/* the argument starts with an identifier */
+
+struct ast_node {
+	enum ast_kind kind;
+	int flags;
+	ident_t ident;
+	union {
+		int integer;
+		float real;
+		char character;
+		int op;		/* enum token_t */
+	} value;
+	struct string_list *names;
+	struct ast_node *child[3];
+	struct ast_node *next;	/* in the same list */
+	struct input_position pos[4];
+};
+
+struct ast {
+	struct arena *arena;
+	struct ast_node *root;
+	/* where ast_walk() stopped, for the message */
+	struct input_position *error_position;
+};
+
+struct ast *create_ast(void);
+void destroy_ast(struct ast *ast);
+struct ast_node *ast_new_node(struct ast *ast, enum ast_kind kind);
+int ast_walk(struct ast *ast, struct semantic_state *ss, int check);
+
+#endif /* inc_ast_h */
@@ -0,0 +1,75 @@
+/** The binary format of the MEPA programs, written by toscal -b and run
+ * by mepa/mepa without any parsing.
+ *
+ * A header followed by one fixed size record per instruction, all the
+ * fields are little endian 32 bit integers. The jumps (the L operands in
+ * mepa_opcodes[]) already hold the index of the target instruction, and
+ * the index right after the last one stops the program.
+ *
+ * With MEPA_BC_STACK in the flags, the use of the stack found by toscal
+ * follows the instructions: a struct mepa_bc_stack and then one struct
+ * mepa_bc_proc for each procedure, the main block first.
+ */
+#ifndef inc_bytecode_h
+#define inc_bytecode_h
+
+#include <stdint.h>
+
+/* the first byte is never in a text program */
+#define MEPA_BC_MAGIC		"\177MEP"
+#define MEPA_BC_MAGIC_SIZE	4
+
+/* the opcodes are the values of enum mepa_opcode: new ones only go at
+ * the end of the real instructions, anything else bumps the version */
+#define MEPA_BC_VERSION		1
+
+struct mepa_bc_header {
+	char magic[MEPA_BC_MAGIC_SIZE];
+	uint32_t version;
+	uint32_t count;		/* instructions after the header */
+	uint32_t flags;		/* MEPA_BC_* */
+};
+
+#define MEPA_BC_STACK		1	/* the stack section follows */
+#define MEPA_BC_FLAGS		MEPA_BC_STACK	/* all the known ones */
+
+/* a is the target of the jumps, the operands written after it in the text
+ * go in b and c */
+struct mepa_bc_inst {
+	uint32_t op;
+	int32_t a;
+	int32_t b;
+	int32_t c;
+};
+
+/* the words are counted from the bottom of the stack for the whole
+ * program, and from the first local (the base of the frame) for each
+ * procedure */
+struct mepa_bc_stack {
+	uint32_t words;		/* the most the program uses, 0 when it has
+				   recursion or a depth isn't known */
+	uint32_t count;		/* procedures after it */
+};
+
+struct mepa_bc_proc {
+	uint32_t entry;		/* its first instruction */
+	int32_t frame;		/* the locals */
+	int32_t depth;		/* the most words over them, -1 unknown */
+	int32_t params;		/* popped by RTPR, -1 for the main block */
+};
+
+static inline void mepa_bc_put32(unsigned char *p, uint32_t value)
+{
+	p[0] = value & 0xff;
+	p[1] = (value >> 8) & 0xff;
+	p[2] = (value >> 16) & 0xff;
+	p[3] = (value >> 24) & 0xff;
+}
+
+static inline uint32_t mepa_bc_get32(const unsigned char *p)
+{
+	return (uint32_t) p[0] | (uint32_t) p[1] << 8
+		| (uint32_t) p[2] << 16 | (uint32_t) p[3] << 24;
+}
+
+#endif /* inc_bytecode_h */
@@ -7,26 +7,53 @@
  */
 #include <stdlib.h>
 #include <stdio.h>
-#include <stdarg.h>
 #include <string.h>
 #include <errno.h>
 
 #include "codegen.h"
+#include "opcodes.h"
+#include "bytecode.h"
+#include "x86_64.h"
+#include "csource.h"
+#include "stackdepth.h"
+#include "shortcircuit.h"
+#include "tailcalls.h"
+#include "invariants.h"
+#include "cse.h"
 
 #define ERROR	0
 #define OK	1
 
 /* aligned with enum codegen_relcmp */
-static const char *relcmp_mnemonics[] = {
-	"CMIG", /* equal */
-	"CMDG", /* different */
-	"CMMA", /* greater than */
-	"CMAG",  /* greater or equal than */
-	"CMME", /* less than */
-	"CMEG" /* less or equal than */
+static const enum mepa_opcode relcmp_opcodes[] = {
+	MEPA_CMIG, /* equal */
+	MEPA_CMDG, /* different */
+	MEPA_CMMA, /* greater than */
+	MEPA_CMAG,  /* greater or equal than */
+	MEPA_CMME, /* less than */
+	MEPA_CMEG /* less or equal than */
 };
 
-const char *scope_names[] = { "global", "param", "local" };
+/* aligned with enum codegen_note */
+static const char *codegen_notes[] = {
+	"",
+	"\t\t; local var",
+	"\t\t; dealloc locals",
+	"\t; global var",
+	"\t; param var",
+	"\t; local var",
+	"\t; read global var",
+	"\t; read param var",
+	"\t; read local var",
+	"\t; read ref param var",
+	"\t\t; func call remainings",
+	"\t\t; repeat statement",
+	"\t\t; until statement",
+	"\t\t; local vars"
+};
+
+/* aligned with enum codegen_label_kind */
+static const char label_letters[] = { '_', 'L', 'R', 'U' };
 
 void codegen_dump_error(struct codegen_state *cs, FILE *stream)
 {
@@ -37,6 +64,9 @@ void codegen_dump_error(struct codegen_state *cs, FILE *stream)
 	case CODEGEN_WRITE_ERROR:
 		fprintf(stream, "write error: %s\n", strerror(errno));
 		break;
+	case CODEGEN_NO_MEMORY:
+		fputs("out of memory for the generated code\n", stream);
+		break;
 	}
 }
 
@@ -54,34 +84,507 @@ struct codegen_state *init_codegen_state(FILE *out)
 		return NULL;
 
 	cs->out = out;
+	cs->format = CODEGEN_FORMAT_TEXT;
 	cs->error = CODEGEN_NOERROR;
 	cs->next_global_addr = 0;
 	cs->next_local_addr = 0;
 	cs->next_label = 0;
 
+	cs->ninsts = 0;
+	cs->written = 0;
+	cs->procedures = 0;
+	cs->allocated = CODEGEN_INITIAL_INSTS;
+	cs->code = (struct codegen_inst*) malloc(cs->allocated
+			* sizeof(struct codegen_inst));
+	if (!cs->code)
+		goto error_code;
+
+	cs->labels_allocated = CODEGEN_INITIAL_LABELS;
+	cs->labels = (struct codegen_label*) malloc(cs->labels_allocated
+			* sizeof(struct codegen_label));
+	if (!cs->labels)
+		goto error_labels;
+	cs->labels[CODEGEN_START_LABEL].kind = CODEGEN_LABEL_START;
+	cs->labels[CODEGEN_START_LABEL].number = 0;
+	cs->labels[CODEGEN_START_LABEL].target = CODEGEN_NO_TARGET;
+	cs->nlabels = 1;
+
+	cs->short_circuit = 0;
+	cs->bools = NULL;
+	cs->nbools = 0;
+	cs->bools_allocated = 0;
+
+	cs->tail_calls = 0;
+	cs->tails = NULL;
+	cs->ntails = 0;
+	cs->tails_allocated = 0;
+
+	cs->inline_size = 0;
+	cs->temps_k = 0;
+	cs->temps_entry = 0;
+	cs->temps_at = 0;
+	cs->temps_base = 0;
+	cs->ntemps = 0;
+
+	cs->loop_invariants = 0;
+	cs->cse = 0;
+	cs->stack_notes = 0;
+
 	return cs;
+
+error_labels:
+	free(cs->code);
+error_code:
+	free(cs);
+	return NULL;
 }
 
 void destroy_codegen_state(struct codegen_state *cs)
 {
+	free(cs->tails);
+	free(cs->bools);
+	free(cs->labels);
+	free(cs->code);
 	free(cs);
 }
 
-int codegenf(struct codegen_state *cs, const char *format, ...)
+/** Appends one instruction to the code, nothing is kept when there is no
+ * output */
+int codegen_emit(struct codegen_state *cs, enum mepa_opcode op,
+		int a, int b, size_t label, enum codegen_note note)
 {
-	va_list ap;
+	struct codegen_inst *code, *inst;
 
-	va_start(ap, format);
-	
 	if (!cs->out)
 		return OK;
 
-	if (vfprintf(cs->out, format, ap) < 0) {
+	if (cs->ninsts == cs->allocated) {
+		code = (struct codegen_inst*) realloc(cs->code,
+				cs->allocated * 2 * sizeof(struct codegen_inst));
+		if (!code) {
+			codegen_set_error(cs, CODEGEN_NO_MEMORY);
+			return ERROR;
+		}
+		cs->code = code;
+		cs->allocated *= 2;
+	}
+
+	inst = &cs->code[cs->ninsts++];
+	inst->op = op;
+	inst->note = note;
+	inst->a = a;
+	inst->b = b;
+	inst->label = label;
+
+	return OK;
+}
+
+/** The position of the next instruction, to come back to with
+ * codegen_rewind() */
+size_t codegen_position(struct codegen_state *cs)
+{
+	return cs->ninsts;
+}
+
+/** Drops the instructions generated after the position (but not the ones
+ * already written) */
+void codegen_rewind(struct codegen_state *cs, size_t position)
+{
+	if (position >= cs->written && position < cs->ninsts)
+		cs->ninsts = position;
+}
+
+int codegen_new_label(struct codegen_state *cs,
+		enum codegen_label_kind kind, size_t *label)
+{
+	struct codegen_label *labels;
+
+	if (cs->nlabels == cs->labels_allocated) {
+		labels = (struct codegen_label*) realloc(cs->labels,
+				cs->labels_allocated * 2
+				* sizeof(struct codegen_label));
+		if (!labels) {
+			codegen_set_error(cs, CODEGEN_NO_MEMORY);
+			return ERROR;
+		}
+		cs->labels = labels;
+		cs->labels_allocated *= 2;
+	}
+
+	*label = cs->nlabels++;
+	cs->labels[*label].kind = kind;
+	cs->labels[*label].number = cs->next_label++;
+	cs->labels[*label].target = CODEGEN_NO_TARGET;
+
+	return OK;
+}
+
+/** Places the label before the next instruction */
+int codegen_place_label(struct codegen_state *cs, size_t label,
+		enum codegen_note note)
+{
+	if (cs->out)
+		cs->labels[label].target = cs->ninsts;
+	return codegen_emit(cs, MEPA_LABEL, 0, 0, label, note);
+}
+
+/*
+ * The text output: the instructions are formatted by hand into a buffer
+ * written in big chunks.
+ */
+
+struct text_writer {
+	FILE *out;
+	size_t len;
+	int failed;
+	char buf[CODEGEN_TEXT_BUFFER];
+};
+
+static void text_flush(struct text_writer *w)
+{
+	if (w->len && fwrite(w->buf, 1, w->len, w->out) != w->len)
+		w->failed = 1;
+	w->len = 0;
+}
+
+static inline void text_char(struct text_writer *w, char c)
+{
+	if (w->len == sizeof(w->buf))
+		text_flush(w);
+	w->buf[w->len++] = c;
+}
+
+static void text_str(struct text_writer *w, const char *str)
+{
+	while (*str)
+		text_char(w, *str++);
+}
+
+static void text_number(struct text_writer *w, long value)
+{
+	char digits[24];
+	unsigned long uvalue;
+	int n = 0;
+
+	if (value < 0) {
+		text_char(w, '-');
+		uvalue = -(unsigned long) value;
+	}
+	else
+		uvalue = value;
+	do {
+		digits[n++] = '0' + uvalue % 10;
+		uvalue /= 10;
+	} while (uvalue);
+	while (n)
+		text_char(w, digits[--n]);
+}
+
+/** The name of the label in the text, like R3 */
+void codegen_label_name(struct codegen_state *cs, size_t label, char *buf,
+		size_t size)
+{
+	struct codegen_label *l = &cs->labels[label];
+
+	if (l->kind == CODEGEN_LABEL_START)
+		snprintf(buf, size, "_start");
+	else
+		snprintf(buf, size, "%c%lu", label_letters[l->kind],
+				(unsigned long) l->number);
+}
+
+/** The instruction as a line of the MEPA text, without the label and the
+ * comments, for the backends writing it as a comment */
+void codegen_inst_text(struct codegen_state *cs, struct codegen_inst *inst,
+		char *buf, size_t size)
+{
+	const struct mepa_opcode_info *info = &mepa_opcodes[inst->op];
+	char label[CODEGEN_LABEL_SIZE];
+	int n;
+
+	n = snprintf(buf, size, "%s", info->mnemonic);
+	if (n < 0 || (size_t) n >= size)
+		return;
+	switch (info->operands) {
+	case MEPA_OPND_A:
+		snprintf(buf + n, size - n, " %d", inst->a);
+		break;
+	case MEPA_OPND_AB:
+		snprintf(buf + n, size - n, " %d, %d", inst->a, inst->b);
+		break;
+	case MEPA_OPND_L:
+		codegen_label_name(cs, inst->label, label, sizeof(label));
+		snprintf(buf + n, size - n, " %s", label);
+		break;
+	case MEPA_OPND_LA:
+		codegen_label_name(cs, inst->label, label, sizeof(label));
+		snprintf(buf + n, size - n, " %s, %d", label, inst->a);
+		break;
+	case MEPA_OPND_LAB:
+		codegen_label_name(cs, inst->label, label, sizeof(label));
+		snprintf(buf + n, size - n, " %s, %d, %d", label, inst->a,
+				inst->b);
+		break;
+	default:
+		break;
+	}
+}
+
+static void text_label(struct text_writer *w, struct codegen_state *cs,
+		size_t label)
+{
+	struct codegen_label *l = &cs->labels[label];
+
+	if (l->kind == CODEGEN_LABEL_START) {
+		text_str(w, "_start");
+		return;
+	}
+	text_char(w, label_letters[l->kind]);
+	text_number(w, l->number);
+}
+
+static void text_inst(struct text_writer *w, struct codegen_state *cs,
+		struct codegen_inst *inst)
+{
+	const struct mepa_opcode_info *info = &mepa_opcodes[inst->op];
+
+	switch (inst->op) {
+	case MEPA_LABEL:
+		text_label(w, cs, inst->label);
+		text_char(w, ':');
+		break;
+	case MEPA_PARAM_NOTE:
+		text_str(w, "\t\t; allocated param var at ");
+		text_number(w, inst->a);
+		break;
+	case MEPA_LABEL_NOTE:
+		text_str(w, "\t\t; allocated label ");
+		text_number(w, cs->labels[inst->label].number);
+		break;
+	default:
+		text_str(w, info->mnemonic);
+		switch (info->operands) {
+		case MEPA_OPND_A:
+		case MEPA_OPND_AB:
+			text_char(w, ' ');
+			text_number(w, inst->a);
+			if (info->operands == MEPA_OPND_AB) {
+				text_str(w, ", ");
+				text_number(w, inst->b);
+			}
+			break;
+		case MEPA_OPND_L:
+		case MEPA_OPND_LA:
+		case MEPA_OPND_LAB:
+			text_char(w, ' ');
+			text_label(w, cs, inst->label);
+			if (info->operands != MEPA_OPND_L) {
+				text_str(w, ", ");
+				text_number(w, inst->a);
+			}
+			if (info->operands == MEPA_OPND_LAB) {
+				text_str(w, ", ");
+				text_number(w, inst->b);
+			}
+			break;
+		default:
+			break;
+		}
+	}
+	text_str(w, codegen_notes[inst->note]);
+	text_char(w, '\n');
+}
+
+/* the comment with the use of the stack, before the first instruction of
+ * the procedure */
+static void text_stack_note(struct text_writer *w, struct stack_depth *sd,
+		struct stack_procedure *proc)
+{
+	text_str(w, "\t\t; stack: frame ");
+	text_number(w, proc->frame);
+	text_str(w, ", depth ");
+	if (proc->depth < 0)
+		text_str(w, "unknown");
+	else
+		text_number(w, proc->depth);
+	if (proc->params >= 0) {
+		text_str(w, ", params ");
+		text_number(w, proc->params);
+	}
+	/* the main block also tells the most of the whole program */
+	if (proc == sd->procs && sd->words) {
+		text_str(w, ", total ");
+		text_number(w, sd->words);
+	}
+	else if (proc == sd->procs)
+		text_str(w, ", total unbounded");
+	text_char(w, '\n');
+}
+
+/*
+ * The bytecode output, where the labels are replaced by the index of the
+ * instruction following them.
+ */
+
+static int bytecode_put(struct codegen_state *cs, uint32_t op, int32_t a,
+		int32_t b, int32_t c)
+{
+	unsigned char record[sizeof(struct mepa_bc_inst)];
+
+	mepa_bc_put32(record, op);
+	mepa_bc_put32(record + 4, (uint32_t) a);
+	mepa_bc_put32(record + 8, (uint32_t) b);
+	mepa_bc_put32(record + 12, (uint32_t) c);
+
+	return fwrite(record, sizeof(record), 1, cs->out) == 1;
+}
+
+/* the stack section, after the instructions */
+static int bytecode_stack(struct codegen_state *cs, struct stack_depth *sd,
+		size_t *index)
+{
+	unsigned char header[sizeof(struct mepa_bc_stack)];
+	unsigned char record[sizeof(struct mepa_bc_proc)];
+	struct stack_procedure *proc;
+	int ok;
+
+	mepa_bc_put32(header, sd->words);
+	mepa_bc_put32(header + 4, sd->nprocs);
+	ok = fwrite(header, sizeof(header), 1, cs->out) == 1;
+
+	for (proc = sd->procs; ok && proc < sd->procs + sd->nprocs; proc++) {
+		mepa_bc_put32(record, index[proc->entry]);
+		mepa_bc_put32(record + 4, (uint32_t) proc->frame);
+		mepa_bc_put32(record + 8, (uint32_t) proc->depth);
+		mepa_bc_put32(record + 12, (uint32_t) proc->params);
+		ok = fwrite(record, sizeof(record), 1, cs->out) == 1;
+	}
+
+	return ok;
+}
+
+/* the whole program at once, the jumps can go anywhere in it */
+static int bytecode_write(struct codegen_state *cs)
+{
+	unsigned char header[sizeof(struct mepa_bc_header)];
+	struct codegen_inst *inst;
+	struct stack_depth *sd;
+	size_t *index;
+	size_t i, count = 0, target;
+	int ok;
+
+	/* the instruction at each position of cs->code */
+	index = (size_t*) malloc((cs->ninsts + 1) * sizeof(size_t));
+	sd = create_stack_depth(cs);
+	if (!index || !sd) {
+		free(index);
+		destroy_stack_depth(sd);
+		codegen_set_error(cs, CODEGEN_NO_MEMORY);
+		return ERROR;
+	}
+	for (i = 0; i < cs->ninsts; i++) {
+		index[i] = count;
+		if (mepa_opcodes[cs->code[i].op].operands != MEPA_OPND_PSEUDO)
+			count++;
+	}
+	index[i] = count;
+
+	memcpy(header, MEPA_BC_MAGIC, MEPA_BC_MAGIC_SIZE);
+	mepa_bc_put32(header + 4, MEPA_BC_VERSION);
+	mepa_bc_put32(header + 8, count);
+	mepa_bc_put32(header + 12, MEPA_BC_STACK);
+	ok = fwrite(header, sizeof(header), 1, cs->out) == 1;
+
+	for (i = 0; ok && i < cs->ninsts; i++) {
+		inst = &cs->code[i];
+		switch (mepa_opcodes[inst->op].operands) {
+		case MEPA_OPND_PSEUDO:
+			break;
+		case MEPA_OPND_L:
+		case MEPA_OPND_LA:
+		case MEPA_OPND_LAB:
+			target = cs->labels[inst->label].target;
+			target = target == CODEGEN_NO_TARGET ? count
+				: index[target];
+			ok = bytecode_put(cs, inst->op, target, inst->a,
+					inst->b);
+			break;
+		default:
+			ok = bytecode_put(cs, inst->op, inst->a, inst->b, 0);
+		}
+	}
+	if (ok)
+		ok = bytecode_stack(cs, sd, index);
+	free(index);
+	destroy_stack_depth(sd);
+	if (!ok || fflush(cs->out) == EOF) {
 		codegen_set_error(cs, CODEGEN_WRITE_ERROR);
 		return ERROR;
 	}
+	cs->written = cs->ninsts;
 
-	if (fputc('\n', cs->out) == EOF) {
+	return OK;
+}
+
+/** Writes the MEPA assembly of the code generated since the last call, or
+ * the whole program in the other formats */
+int codegen_write(struct codegen_state *cs)
+{
+	struct text_writer *w;
+	struct stack_depth *sd = NULL;
+	struct stack_procedure *proc = NULL, *end = NULL;
+	size_t i;
+	int failed, note;
+
+	if (!cs->out)
+		return OK;
+	if (cs->format == CODEGEN_FORMAT_BYTECODE)
+		return bytecode_write(cs);
+	if (cs->format == CODEGEN_FORMAT_X86_64)
+		return x86_64_write(cs);
+	if (cs->format == CODEGEN_FORMAT_C)
+		return csource_write(cs);
+
+	w = (struct text_writer*) malloc(sizeof(struct text_writer));
+	if (cs->stack_notes && w) {
+		sd = create_stack_depth(cs);
+		if (!sd) {
+			free(w);
+			w = NULL;
+		}
+		else {
+			proc = sd->procs;
+			end = sd->procs + sd->nprocs;
+		}
+	}
+	if (!w) {
+		codegen_set_error(cs, CODEGEN_NO_MEMORY);
+		return ERROR;
+	}
+	w->out = cs->out;
+	w->len = 0;
+	w->failed = 0;
+
+	while (proc < end && proc->entry < cs->written)
+		proc++;
+	for (i = cs->written; i < cs->ninsts; i++) {
+		/* right after the label of a procedure, or before the INPP */
+		note = proc < end && proc->entry == i;
+		if (note && cs->code[i].op != MEPA_LABEL)
+			text_stack_note(w, sd, proc);
+		text_inst(w, cs, &cs->code[i]);
+		if (note && cs->code[i].op == MEPA_LABEL)
+			text_stack_note(w, sd, proc);
+		if (note)
+			proc++;
+	}
+	cs->written = cs->ninsts;
+	text_flush(w);
+
+	failed = w->failed;
+	free(w);
+	destroy_stack_depth(sd);
+	if (failed) {
 		codegen_set_error(cs, CODEGEN_WRITE_ERROR);
 		return ERROR;
 	}
@@ -89,42 +592,155 @@ int codegenf(struct codegen_state *cs, const char *format, ...)
 	return OK;
 }
 
+/* The code of each procedure is generated at once after the ones nested in
+ * it, so only the main block, which comes last, is out of place: it is
+ * moved to the start, right after INPP, and no jump is needed to get to it
+ * or to go around the procedures. */
+static int codegen_move_main_block(struct codegen_state *cs)
+{
+	struct codegen_inst *main_block;
+	size_t start = cs->labels[CODEGEN_START_LABEL].target;
+	size_t first = cs->procedures;
+	size_t count, i;
+
+	if (start == CODEGEN_NO_TARGET || first < cs->written)
+		return OK;
+	/* the comments of the labels declared by the program stay first */
+	while (first < start && cs->code[first].op == MEPA_LABEL_NOTE)
+		first++;
+	if (first == start)
+		return OK;
+
+	count = cs->ninsts - start;
+	main_block = (struct codegen_inst*) malloc(count
+			* sizeof(struct codegen_inst));
+	if (!main_block) {
+		codegen_set_error(cs, CODEGEN_NO_MEMORY);
+		return ERROR;
+	}
+	memcpy(main_block, &cs->code[start],
+			count * sizeof(struct codegen_inst));
+	memmove(&cs->code[first + count], &cs->code[first],
+			(start - first) * sizeof(struct codegen_inst));
+	memcpy(&cs->code[first], main_block,
+			count * sizeof(struct codegen_inst));
+	free(main_block);
+
+	for (i = first; i < cs->ninsts; i++)
+		if (cs->code[i].op == MEPA_LABEL)
+			cs->labels[cs->code[i].label].target = i;
+
+	return OK;
+}
+
+/* allocates the room of the inlined calls after the locals, the ENRT of
+ * the goto labels and the ENPR keep it */
+static int codegen_alloc_temps(struct codegen_state *cs)
+{
+	struct codegen_inst alloc;
+	size_t at = cs->temps_at, i;
+
+	if (!cs->ntemps || at < cs->written)
+		return OK;
+	if (!codegen_emit(cs, MEPA_AMEM, cs->ntemps, 0, 0,
+				CODEGEN_NOTE_LOCAL_ALLOC))
+		return ERROR;
+
+	alloc = cs->code[cs->ninsts - 1];
+	memmove(&cs->code[at + 1], &cs->code[at],
+			(cs->ninsts - at - 1) * sizeof(struct codegen_inst));
+	cs->code[at] = alloc;
+	for (i = 0; i < cs->nlabels; i++)
+		if (cs->labels[i].target != CODEGEN_NO_TARGET
+				&& cs->labels[i].target >= at)
+			cs->labels[i].target++;
+	for (i = 0; i < cs->ntails; i++)
+		if (cs->tails[i].at >= at)
+			cs->tails[i].at++;
+	for (i = at + 1; i < cs->ninsts; i++)
+		if (cs->code[i].op == MEPA_ENRT && cs->code[i].a == cs->temps_k)
+			cs->code[i].b += cs->ntemps;
+	cs->code[cs->temps_entry].b += cs->ntemps;
+
+	return OK;
+}
+
 int codegen_program_prolog(struct codegen_state *cs)
 {
-	return codegenf(cs, "INPP\nDSVS _start");
+	if (!codegen_emit_op(cs, MEPA_INPP))
+		return ERROR;
+	cs->procedures = cs->ninsts;
+
+	return OK;
 }
 
 int codegen_program_epilog(struct codegen_state *cs)
 {
-	return codegenf(cs, "PARA");
+	if (!codegen_common_values(cs) || !codegen_alloc_temps(cs)
+			|| !codegen_emit_op(cs, MEPA_PARA))
+		return ERROR;
+	return codegen_move_main_block(cs);
 }
 
 int codegen_begin_main_block(struct codegen_state *cs)
 {
-	return codegenf(cs, "_start:");
+	cs->temps_entry = cs->procedures - 1;	/* the INPP */
+	return codegen_place_label(cs, CODEGEN_START_LABEL, CODEGEN_NOTE_NONE);
+}
+
+/** The code of the statements of a procedure (or of the main block) of
+ * level k, with that many locals, starts here */
+int codegen_begin_code(struct codegen_state *cs, int k, size_t locals)
+{
+	if (cs->temps_entry < cs->ninsts)
+		cs->code[cs->temps_entry].b = locals;
+	cs->temps_k = k;
+	cs->temps_at = cs->ninsts;
+	cs->temps_base = locals;
+	cs->ntemps = 0;
+
+	return OK;
 }
 
 int codegen_procedure_prolog(struct codegen_state *cs,
 		struct codegen_object *obj, int k)
 {
-	return codegenf(cs, "L%lu:\n"
-			    "ENPR %d", obj->address, k);
+	if (!codegen_place_label(cs, obj->address, CODEGEN_NOTE_NONE))
+		return ERROR;
+	cs->temps_entry = cs->ninsts;
+	return codegen_emit(cs, MEPA_ENPR, k, 0, 0, CODEGEN_NOTE_NONE);
 }
 
 int codegen_procedure_epilog(struct codegen_state *cs,
 		int k, size_t params_offset, size_t locals_offset)
 {
+	int ret;
+
+	/* the room of the inlined calls is one more local */
+	ret = codegen_common_values(cs) && codegen_alloc_temps(cs);
+	locals_offset += cs->ntemps;
+	if (ret && cs->ntails)
+		ret = codegen_tail_calls(cs, k, params_offset, locals_offset);
+	/* the positions kept are gone */
+	cs->ntails = 0;
+	cs->nbools = 0;
+	cs->ntemps = 0;
+	if (!ret)
+		return ERROR;
+
 	/* TODO it should dealloc based on the variable size! */
 	if (locals_offset &&
-	    !codegenf(cs, "DMEM %lu\t\t; dealloc locals", locals_offset))
+	    !codegen_emit(cs, MEPA_DMEM, locals_offset, 0, 0,
+		    CODEGEN_NOTE_DEALLOC_LOCALS))
 		return ERROR;
 
-	return codegenf(cs, "RTPR %d, %lu", k, params_offset);
+	return codegen_emit(cs, MEPA_RTPR, k, params_offset, 0,
+			CODEGEN_NOTE_NONE);
 }
 
 int codegen_push_const(struct codegen_state *cs, int value)
 {
-	return codegenf(cs, "CRCT %d", value);
+	return codegen_emit(cs, MEPA_CRCT, value, 0, 0, CODEGEN_NOTE_NONE);
 }
 
 int codegen_push_const_int(struct codegen_state *cs, int value)
@@ -150,58 +766,61 @@ int codegen_sum_values(struct codegen_state *cs)
 	/* problem: no knoledge about the values that have been pushed to
 	 * the stack, with such interface it wouldn't be easy to port it to
 	 * the so-dreamed i386. */
-	return codegenf(cs, "SOMA");
+	return codegen_emit_op(cs, MEPA_SOMA);
 }
 
 int codegen_sub_values(struct codegen_state *cs)
 {
 	/* the same note as above */
-	return codegenf(cs, "SUBT");
+	return codegen_emit_op(cs, MEPA_SUBT);
 }
 
-int codegen_or_values(struct codegen_state *cs)
+/** right is the position where the code of the right operand starts */
+int codegen_or_values(struct codegen_state *cs, size_t right)
 {
-	return codegenf(cs, "DISJ");
+	return codegen_keep_bool(cs, MEPA_DISJ, right)
+		&& codegen_emit_op(cs, MEPA_DISJ);
 }
 
-int codegen_and_values(struct codegen_state *cs)
+int codegen_and_values(struct codegen_state *cs, size_t right)
 {
-	return codegenf(cs, "CONJ");
+	return codegen_keep_bool(cs, MEPA_CONJ, right)
+		&& codegen_emit_op(cs, MEPA_CONJ);
 }
 
 int codegen_mul_values(struct codegen_state *cs)
 {
-	return codegenf(cs, "MULT");
+	return codegen_emit_op(cs, MEPA_MULT);
 }
 
 int codegen_div_values(struct codegen_state *cs)
 {
-	return codegenf(cs, "DIVI");
+	return codegen_emit_op(cs, MEPA_DIVI);
 }
 
 int codegen_mod_values(struct codegen_state *cs)
 {
-	return codegenf(cs, "MODU");
+	return codegen_emit_op(cs, MEPA_MODU);
 }
 
 int codegen_relcmp_values(struct codegen_state *cs, enum codegen_relcmp op)
 {
-	return codegenf(cs, relcmp_mnemonics[op]);
+	return codegen_emit_op(cs, relcmp_opcodes[op]);
 }
 
 int codegen_alloc_address(struct codegen_state *cs,
 		struct codegen_object *obj)
 {
-	obj->address = cs->next_label++;
-	return OK;
+	return codegen_new_label(cs, CODEGEN_LABEL_PROC, &obj->address);
 }
 
 int codegen_alloc_object(struct codegen_state *cs,
 		struct codegen_object *codeobj,
 		enum codegen_objscope scope, int k, int ref)
 {
+	int error = OK;
+
 	codeobj->type = CODEGEN_OBJ_INT; /* FIXME */
-	int error;
 
 	codeobj->scope = scope;
 	codeobj->k = k;
@@ -223,18 +842,20 @@ int codegen_alloc_object(struct codegen_state *cs,
 int codegen_inst_object(struct codegen_state *cs,
 		struct codegen_object *obj)
 {
-	int error;
+	int error = OK;
 
 	/* FIXME use object size */
 
 	switch (obj->scope) {
 	case CODEGEN_SCOPE_GLOBAL:
 	case CODEGEN_SCOPE_LOCAL:
-		error = codegenf(cs, "AMEM 1\t\t; local var");
+		error = codegen_emit(cs, MEPA_AMEM, 1, 0, 0,
+				CODEGEN_NOTE_LOCAL_ALLOC);
 		break;
 	case CODEGEN_SCOPE_PARAM:
-		error = codegenf(cs, "\t\t; allocated param var at %d",
-				obj->index - CODEOBJ_ARGS_BP_OFFSET);
+		error = codegen_emit(cs, MEPA_PARAM_NOTE,
+				obj->index - CODEOBJ_ARGS_BP_OFFSET, 0, 0,
+				CODEGEN_NOTE_NONE);
 		break;
 	}
 
@@ -263,176 +884,196 @@ static int objk(struct codegen_object *obj)
 	return obj->k;
 }
 
+/* the instructions on variables have their k and address as operands */
+static int codegen_emit_var(struct codegen_state *cs, enum mepa_opcode op,
+		struct codegen_object *obj, enum codegen_note note)
+{
+	return codegen_emit(cs, op, objk(obj), objaddr(obj), 0, note);
+}
+
 int codegen_fetch_object(struct codegen_state *cs,
 		struct codegen_object *obj)
 {
-	int error;
-
-	error = codegenf(cs, "CRVL %d, %d\t; %s var",
-			objk(obj), objaddr(obj),
-			scope_names[obj->scope]);
-	return error;
+	return codegen_emit_var(cs, MEPA_CRVL, obj,
+			CODEGEN_NOTE_GLOBAL_VAR + obj->scope);
 }
 
 int codegen_store_object(struct codegen_state *cs,
 		struct codegen_object *obj)
 {
-	return codegenf(cs, "ARMZ %d, %d\t; %s var",
-			objk(obj), objaddr(obj),
-			scope_names[obj->scope]);
+	return codegen_emit_var(cs, MEPA_ARMZ, obj,
+			CODEGEN_NOTE_GLOBAL_VAR + obj->scope);
 }
 
 int codegen_fetch_ref(struct codegen_state *cs,
 		struct codegen_object *obj)
 {
-	return codegenf(cs, "CRVI %d, %d", objk(obj), objaddr(obj));
+	return codegen_emit_var(cs, MEPA_CRVI, obj, CODEGEN_NOTE_NONE);
 }
 
 int codegen_store_ref(struct codegen_state *cs,
 		struct codegen_object *obj)
 {
-	return codegenf(cs, "ARMI %d, %d", objk(obj), objaddr(obj));
+	return codegen_emit_var(cs, MEPA_ARMI, obj, CODEGEN_NOTE_NONE);
 }
 
 int codegen_put_ref(struct codegen_state *cs,
 		struct codegen_object *obj)
 {
-	return codegenf(cs, "CREN %d, %d", objk(obj), objaddr(obj));
+	return codegen_emit_var(cs, MEPA_CREN, obj, CODEGEN_NOTE_NONE);
 }
 
 int codegen_funcall_prolog(struct codegen_state *cs,
 		struct codegen_object *obj)
 {
 	/* TODO alloc the size needed by obj */
-	return codegenf(cs, "AMEM 1");
+	return codegen_emit(cs, MEPA_AMEM, 1, 0, 0, CODEGEN_NOTE_NONE);
 }
 
 int codegen_call_function(struct codegen_state *cs,
 		struct codegen_object *obj, int k)
 {
-	return codegenf(cs, "CHPR L%lu, %d", obj->address, k);
+	return codegen_emit(cs, MEPA_CHPR, k, 0, obj->address,
+			CODEGEN_NOTE_NONE);
 }
 
 int codegen_funcall_cleanup(struct codegen_state *cs,
 		struct codegen_object *obj)
 {
 	/* TODO shrink to the size needed by obj */
-	return codegenf(cs, "DMEM 1\t\t; func call remainings");
+	return codegen_emit(cs, MEPA_DMEM, 1, 0, 0, CODEGEN_NOTE_FUNC_CALL);
 }
 
 int codegen_cond_prolog(struct codegen_state *cs, codegen_cond_t *cond)
 {
-	cond->jump_label = cs->next_label++;
-	return OK;
+	return codegen_new_label(cs, CODEGEN_LABEL_JUMP, &cond->jump_label);
 }
 
 int codegen_cond_eval(struct codegen_state *cs, codegen_cond_t *cond)
 {
-	return codegenf(cs, "DSVF R%lu", cond->jump_label);
+	return codegen_jump_false(cs, cond->jump_label, CODEGEN_NOTE_NONE);
 }
 
 int codegen_cond_else(struct codegen_state *cs, codegen_cond_t *cond)
 {
-	int error;
 	size_t next;
 
-	next = cs->next_label++;
-	error = codegenf(cs, "DSVS R%lu\n"
-			     "R%lu:", next, cond->jump_label);
+	if (!codegen_new_label(cs, CODEGEN_LABEL_JUMP, &next))
+		return ERROR;
+	if (!codegen_emit(cs, MEPA_DSVS, 0, 0, next, CODEGEN_NOTE_NONE)
+			|| !codegen_place_label(cs, cond->jump_label,
+				CODEGEN_NOTE_NONE))
+		return ERROR;
 	cond->jump_label = next;
 
-	return error;
+	return OK;
 }
 
 int codegen_cond_epilog(struct codegen_state *cs, codegen_cond_t *cond)
 {
-	return codegenf(cs, "R%lu:", cond->jump_label);
+	return codegen_place_label(cs, cond->jump_label, CODEGEN_NOTE_NONE);
 }
 
 int codegen_invert_value(struct codegen_state *cs)
 {
-	return codegenf(cs, "INVR");
+	return codegen_emit_op(cs, MEPA_INVR);
 }
 
 int codegen_while_prolog(struct codegen_state *cs, codegen_while_t *while_)
 {
-	while_->loop_label = cs->next_label++;
-	while_->leave_label = cs->next_label++;
+	if (!codegen_new_label(cs, CODEGEN_LABEL_JUMP, &while_->loop_label)
+			|| !codegen_new_label(cs, CODEGEN_LABEL_JUMP,
+				&while_->leave_label))
+		return ERROR;
 
-	return codegenf(cs, "R%lu:", while_->loop_label);
+	return codegen_place_label(cs, while_->loop_label, CODEGEN_NOTE_NONE);
 }
 
 int codegen_while_eval(struct codegen_state *cs, codegen_while_t *while_)
 {
-	return codegenf(cs, "DSVF R%lu", while_->leave_label);
+	return codegen_jump_false(cs, while_->leave_label, CODEGEN_NOTE_NONE);
 }
 
 int codegen_while_epilog(struct codegen_state *cs, codegen_while_t *while_)
 {
-	return codegenf(cs, "DSVS R%lu\n"
-			    "R%lu:", while_->loop_label, while_->leave_label);
+	if (!codegen_emit(cs, MEPA_DSVS, 0, 0, while_->loop_label,
+				CODEGEN_NOTE_NONE)
+			|| !codegen_loop_invariants(cs, while_->loop_label))
+		return ERROR;
+	return codegen_place_label(cs, while_->leave_label, CODEGEN_NOTE_NONE);
 }
 
 int codegen_repeat_prolog(struct codegen_state *cs, codegen_repeat_t *repeat)
 {
-	repeat->jump_label = cs->next_label++;
+	if (!codegen_new_label(cs, CODEGEN_LABEL_JUMP, &repeat->jump_label))
+		return ERROR;
 
-	return codegenf(cs, "R%lu:\t\t; repeat statement", repeat->jump_label);
+	return codegen_place_label(cs, repeat->jump_label,
+			CODEGEN_NOTE_REPEAT);
 }
 
 int codegen_repeat_eval(struct codegen_state *cs, codegen_repeat_t *repeat)
 {
-	return codegenf(cs, "DSVF R%lu\t\t; until statement", repeat->jump_label);
+	if (!codegen_jump_false(cs, repeat->jump_label, CODEGEN_NOTE_UNTIL))
+		return ERROR;
+	return codegen_loop_invariants(cs, repeat->jump_label);
 }
 
 int codegen_read_object(struct codegen_state *cs, struct codegen_object *obj)
 {
-	return codegenf(cs, "LEIT\n"
-			    "ARMZ %d, %d\t; read %s var", 
-			    objk(obj), objaddr(obj),
-			    scope_names[obj->scope]);
+	if (!codegen_emit_op(cs, MEPA_LEIT))
+		return ERROR;
+	return codegen_emit_var(cs, MEPA_ARMZ, obj,
+			CODEGEN_NOTE_READ_GLOBAL_VAR + obj->scope);
 }
 
 int codegen_read_ref(struct codegen_state *cs, struct codegen_object *obj)
 {
-	return codegenf(cs, "LEIT\n"
-			    "ARMI %d, %d\t; read ref param var", 
-			    objk(obj), objaddr(obj));
+	if (!codegen_emit_op(cs, MEPA_LEIT))
+		return ERROR;
+	return codegen_emit_var(cs, MEPA_ARMI, obj, CODEGEN_NOTE_READ_REF);
 }
 
 int codegen_write_value(struct codegen_state *cs)
 {
-	return codegenf(cs, "IMPR");
+	return codegen_emit_op(cs, MEPA_IMPR);
 }
 
 int codegen_set_label(struct codegen_state *cs, struct codegen_object *obj)
 {
-	obj->address = cs->next_label++;
-	return codegenf(cs, "\t\t; allocated label %lu", obj->address);
+	if (!codegen_new_label(cs, CODEGEN_LABEL_USER, &obj->address))
+		return ERROR;
+	return codegen_emit(cs, MEPA_LABEL_NOTE, 0, 0, obj->address,
+			CODEGEN_NOTE_NONE);
 }
 
 int codegen_inst_label(struct codegen_state *cs, struct codegen_object *obj,
 		int k, size_t locals_offset)
 {
 	/* U is just a hint for "user-defined" */
-	return codegenf(cs, "U%lu:\n"
-			    "ENRT %d, %lu", obj->address, k, locals_offset);
+	if (!codegen_place_label(cs, obj->address, CODEGEN_NOTE_NONE))
+		return ERROR;
+	return codegen_emit(cs, MEPA_ENRT, k, locals_offset, 0,
+			CODEGEN_NOTE_NONE);
 }
 
 int codegen_goto_label(struct codegen_state *cs, struct codegen_object *obj)
 {
-	return codegenf(cs, "DSVS U%lu", obj->address);
+	return codegen_emit(cs, MEPA_DSVS, 0, 0, obj->address,
+			CODEGEN_NOTE_NONE);
 }
 
 int codegen_goto_far_label(struct codegen_state *cs,
 		struct codegen_object *obj, int srck, int dstk)
 {
-	return codegenf(cs, "DSVR U%lu, %d, %d", obj->address, dstk, srck);
+	return codegen_emit(cs, MEPA_DSVR, dstk, srck, obj->address,
+			CODEGEN_NOTE_NONE);
 }
 
 int codegen_not_value(struct codegen_state *cs)
 {
-	return codegenf(cs, "NEGA");
+	return codegen_keep_bool(cs, MEPA_NEGA, cs->ninsts)
+		&& codegen_emit_op(cs, MEPA_NEGA);
 }
 
 int codegen_reset_locals(struct codegen_state *cs)
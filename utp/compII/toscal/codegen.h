@@ -11,6 +11,8 @@
 
 #include <stdio.h>
 
+#include "opcodes.h"
+
 /* The space in the stack memory between function parameters and the word
  * pointed by the base pointer, it contains the information saved from the
  * caller function. */
@@ -18,7 +20,8 @@
 
 enum codegen_error {
 	CODEGEN_NOERROR,
-	CODEGEN_WRITE_ERROR
+	CODEGEN_WRITE_ERROR,
+	CODEGEN_NO_MEMORY
 };
 
 enum codegen_relcmp {
@@ -46,13 +49,134 @@ enum codegen_objscope {
 #define CODEGEN_REAL_SIZE	1
 #define CODEGEN_CHAR_SIZE	1
 
+#define CODEGEN_INITIAL_INSTS	1024
+#define CODEGEN_INITIAL_LABELS	64
+#define CODEGEN_INITIAL_BOOLS	16
+#define CODEGEN_INITIAL_TAILS	8
+#define CODEGEN_INLINE_SIZE	16	/* the default of -finline */
+#define CODEGEN_TEXT_BUFFER	65536
+#define CODEGEN_LABEL_SIZE	32	/* for codegen_label_name() */
+
+/* the comments written after the instructions, the ones of variables
+ * are in the order of enum codegen_objscope */
+enum codegen_note {
+	CODEGEN_NOTE_NONE,
+	CODEGEN_NOTE_LOCAL_ALLOC,
+	CODEGEN_NOTE_DEALLOC_LOCALS,
+	CODEGEN_NOTE_GLOBAL_VAR,
+	CODEGEN_NOTE_PARAM_VAR,
+	CODEGEN_NOTE_LOCAL_VAR,
+	CODEGEN_NOTE_READ_GLOBAL_VAR,
+	CODEGEN_NOTE_READ_PARAM_VAR,
+	CODEGEN_NOTE_READ_LOCAL_VAR,
+	CODEGEN_NOTE_READ_REF,
+	CODEGEN_NOTE_FUNC_CALL,
+	CODEGEN_NOTE_REPEAT,
+	CODEGEN_NOTE_UNTIL,
+	CODEGEN_NOTE_LOCAL_ALLOCS
+};
+
+/* One instruction of the generated code. The operands used by each
+ * opcode are in mepa_opcodes[], label is an index of cs->labels. The b
+ * of ENPR (and of INPP, for the main block) isn't written: it keeps the
+ * size of the locals, for stackdepth.c. */
+struct codegen_inst {
+	unsigned char op;	/* enum mepa_opcode */
+	unsigned char note;	/* enum codegen_note */
+	int a;
+	int b;
+	unsigned int label;
+};
+
+/* the letter used in the name of the label, _start has none */
+enum codegen_label_kind {
+	CODEGEN_LABEL_START,
+	CODEGEN_LABEL_PROC,	/* L */
+	CODEGEN_LABEL_JUMP,	/* R */
+	CODEGEN_LABEL_USER	/* U */
+};
+
+#define CODEGEN_START_LABEL	0	/* always the first one */
+#define CODEGEN_NO_TARGET	((size_t) -1)
+
+struct codegen_label {
+	enum codegen_label_kind kind;
+	size_t number;
+	size_t target;	/* index of its MEPA_LABEL in cs->code */
+};
+
+/* An and, or or not kept with -fshort-circuit: when a condition uses its
+ * value, the operands become jumps (see codegen_cond_eval()) */
+struct codegen_bool {
+	enum mepa_opcode op;	/* MEPA_CONJ, MEPA_DISJ or MEPA_NEGA */
+	size_t right;	/* where the code of the right operand starts */
+	size_t at;	/* the position of op */
+};
+
+/* A call of the procedure being generated to itself, made by the last
+ * statement: it becomes a jump to its start if nothing else follows it
+ * (see codegen_procedure_epilog()) */
+struct codegen_tail_call {
+	size_t at;	/* the position of the CHPR */
+	int result;	/* an ARMZ to the function result follows it */
+};
+
+/* what codegen_write() writes */
+enum codegen_format {
+	CODEGEN_FORMAT_TEXT,		/* the MEPA assembly */
+	CODEGEN_FORMAT_BYTECODE,	/* see bytecode.h */
+	CODEGEN_FORMAT_X86_64,		/* GNU assembly, see x86_64.h */
+	CODEGEN_FORMAT_C		/* see csource.h */
+};
+
 struct codegen_state {
 	enum codegen_error error;
 	FILE *out;
+	enum codegen_format format;
 	size_t next_global_addr;
 	int next_local_addr;
 	int next_param_addr;
 	size_t next_label;
+
+	struct codegen_inst *code;
+	size_t ninsts;
+	size_t allocated;
+	size_t written;	/* instructions already sent to out */
+	size_t procedures;	/* where the code of the procedures starts */
+
+	struct codegen_label *labels;
+	size_t nlabels;
+	size_t labels_allocated;
+
+	/* the ones since the last condition, only with short_circuit */
+	int short_circuit;
+	struct codegen_bool *bools;
+	size_t nbools;
+	size_t bools_allocated;
+
+	/* the ones in the current procedure, only with tail_calls */
+	int tail_calls;
+	struct codegen_tail_call *tails;
+	size_t ntails;
+	size_t tails_allocated;
+
+	/* the room of the calls replaced by the code of procedures of up to
+	 * inline_size instructions, after the locals of the current one */
+	int inline_size;
+	int temps_k;
+	size_t temps_entry;	/* the ENPR (or INPP) of the procedure */
+	size_t temps_at;	/* where it is allocated */
+	size_t temps_base;	/* its first address */
+	size_t ntemps;
+
+	/* the values computed before the loops, in the same room */
+	int loop_invariants;
+	/* the values computed again in a block, in the same room */
+	int cse;
+
+	/* the use of the stack of each procedure goes in the text, as
+	 * comments (the bytecode always has it) */
+	int stack_notes;
 };
 
 typedef struct  {
@@ -70,16 +194,36 @@ struct codegen_object {
 	int k;
 	int index;
 	int ref;
-	size_t address; /* for labels */
+	size_t address; /* the label of procedures and goto targets */
 };
 
 void codegen_dump_error(struct codegen_state *cs, FILE *stream);
+void codegen_set_error(struct codegen_state *cs, enum codegen_error error);
 struct codegen_state *init_codegen_state(FILE *out);
 void destroy_codegen_state(struct codegen_state *cs);
+int codegen_write(struct codegen_state *cs);
+size_t codegen_position(struct codegen_state *cs);
+void codegen_label_name(struct codegen_state *cs, size_t label, char *buf,
+		size_t size);
+void codegen_inst_text(struct codegen_state *cs, struct codegen_inst *inst,
+		char *buf, size_t size);
+void codegen_rewind(struct codegen_state *cs, size_t position);
+
+/* for the passes in their own files, like shortcircuit.c */
+int codegen_emit(struct codegen_state *cs, enum mepa_opcode op,
+		int a, int b, size_t label, enum codegen_note note);
+int codegen_new_label(struct codegen_state *cs,
+		enum codegen_label_kind kind, size_t *label);
+int codegen_place_label(struct codegen_state *cs, size_t label,
+		enum codegen_note note);
+
+#define codegen_emit_op(cs, op) \
+	codegen_emit(cs, op, 0, 0, 0, CODEGEN_NOTE_NONE)
 
 int codegen_program_prolog(struct codegen_state *cs);
 int codegen_program_epilog(struct codegen_state *cs);
 int codegen_begin_main_block(struct codegen_state *cs);
+int codegen_begin_code(struct codegen_state *cs, int k, size_t locals);
 
 int codegen_push_address(struct codegen_state *cs, size_t address);
 int codegen_push_const_int(struct codegen_state *cs, int value);
@@ -103,8 +247,8 @@ int codegen_output(struct codegen_state *cs);
 
 int codegen_sum_values(struct codegen_state *cs);
 int codegen_sub_values(struct codegen_state *cs);
-int codegen_or_values(struct codegen_state *cs);
-int codegen_and_values(struct codegen_state *cs);
+int codegen_or_values(struct codegen_state *cs, size_t right);
+int codegen_and_values(struct codegen_state *cs, size_t right);
 int codegen_mul_values(struct codegen_state *cs);
 int codegen_div_values(struct codegen_state *cs);
 int codegen_mod_values(struct codegen_state *cs);
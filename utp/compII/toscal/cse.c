@@ -0,0 +1,409 @@
+/** cse.c
+ *
+ * In each block of straight code (ended by labels, jumps and calls) the
+ * values are numbered as they are pushed, the same number for the same
+ * instruction on the same numbers. A value computed again in the block is
+ * loaded from a room after the one of the inlined calls, where its first
+ * computation is stored. The loads of a variable get a new number after a
+ * store that may change it.
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "cse.h"
+#include "opcodes.h"
+
+#define ERROR	0
+#define OK	1
+
+#define CSE_MAX_KEYS	256
+#define CSE_NONE	((size_t) -1)
+
+/* the number of the value of op with a and b, or of op on left and
+ * right */
+struct cse_key {
+	enum mepa_opcode op;
+	int a;
+	int b;
+	int left;
+	int right;
+	int number;
+	size_t first;	/* the first value found with the number */
+};
+
+/* a value on the stack, number 0 when its code can't be repeated */
+struct cse_value {
+	int number;
+	size_t start;
+};
+
+/* a value computed by [start, end) of at least three instructions */
+struct cse_found {
+	size_t start;
+	size_t end;
+	size_t first;	/* the first one with its number, maybe itself */
+	int load;	/* replaced by a load of temp */
+	int store;	/* stored in temp after its code */
+	int temp;
+};
+
+struct cse_state {
+	struct codegen_state *cs;
+	struct cse_key keys[CSE_MAX_KEYS];
+	size_t nkeys;
+	int next_number;
+	struct cse_value *stack;
+	size_t depth;
+	struct cse_found *found;
+	size_t nfound;
+	size_t found_allocated;
+	size_t block;	/* the first found in the current block */
+	int ntemps;	/* the most used by a block */
+	int loads;
+};
+
+/* the same value for both orders of the operands */
+static int cse_commutative(enum mepa_opcode op)
+{
+	switch (op) {
+	case MEPA_SOMA:
+	case MEPA_MULT:
+	case MEPA_CONJ:
+	case MEPA_DISJ:
+	case MEPA_CMIG:
+	case MEPA_CMDG:
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+/* the key of the value, a new one if it was not seen in the block (or
+ * there is no room for it) */
+static struct cse_key *cse_lookup(struct cse_state *cse,
+		enum mepa_opcode op, int a, int b, int left, int right)
+{
+	struct cse_key *key;
+	int swap;
+
+	if (cse_commutative(op) && left > right) {
+		swap = left;
+		left = right;
+		right = swap;
+	}
+	for (key = cse->keys; key < cse->keys + cse->nkeys; key++)
+		if (key->op == op && key->a == a && key->b == b
+				&& key->left == left && key->right == right)
+			return key;
+	if (cse->nkeys == CSE_MAX_KEYS)
+		return NULL;
+
+	key = &cse->keys[cse->nkeys++];
+	key->op = op;
+	key->a = a;
+	key->b = b;
+	key->left = left;
+	key->right = right;
+	key->number = cse->next_number++;
+	key->first = CSE_NONE;
+	return key;
+}
+
+/* the variables that may have changed get new numbers: the one stored,
+ * the ones loaded through a reference or all of them */
+static void cse_kill(struct cse_state *cse, enum mepa_opcode op, int a,
+		int b)
+{
+	struct cse_key *key;
+	size_t kept = 0;
+
+	for (key = cse->keys; key < cse->keys + cse->nkeys; key++)
+		if (key->op == MEPA_CRVI
+				|| (key->op == MEPA_CRVL && (op == MEPA_ARMI
+					|| (key->a == a && key->b == b))))
+			continue;
+		else
+			cse->keys[kept++] = *key;
+	cse->nkeys = kept;
+}
+
+static void cse_push(struct cse_state *cse, int number, size_t start)
+{
+	cse->stack[cse->depth].number = number;
+	cse->stack[cse->depth].start = start;
+	cse->depth++;
+}
+
+/* the values below the block are not known */
+static struct cse_value cse_pop(struct cse_state *cse)
+{
+	struct cse_value none = { 0, 0 };
+
+	if (!cse->depth)
+		return none;
+	return cse->stack[--cse->depth];
+}
+
+/* the value of op on the values is pushed, its code is [start, end) */
+static int cse_compute(struct cse_state *cse, enum mepa_opcode op,
+		int left, int right, size_t start, size_t end)
+{
+	struct cse_found *found;
+	struct cse_key *key;
+
+	if (!left || (!right && op != MEPA_INVR && op != MEPA_NEGA)) {
+		cse_push(cse, 0, start);
+		return OK;
+	}
+	key = cse_lookup(cse, op, 0, 0, left, right);
+	cse_push(cse, key ? key->number : cse->next_number++, start);
+	if (!key || end - start < 3)
+		return OK;
+
+	if (cse->nfound == cse->found_allocated) {
+		found = (struct cse_found*) realloc(cse->found,
+				(cse->found_allocated * 2 + 16)
+				* sizeof(struct cse_found));
+		if (!found) {
+			codegen_set_error(cse->cs, CODEGEN_NO_MEMORY);
+			return ERROR;
+		}
+		cse->found = found;
+		cse->found_allocated = cse->found_allocated * 2 + 16;
+	}
+	found = &cse->found[cse->nfound];
+	if (key->first == CSE_NONE)
+		key->first = cse->nfound;
+	found->start = start;
+	found->end = end;
+	found->first = key->first;
+	found->load = 0;
+	found->store = 0;
+	found->temp = 0;
+	cse->nfound++;
+
+	return OK;
+}
+
+/* The block ends: the values found again, but the ones inside others
+ * found again, are loaded. They were found after the values inside
+ * them, so backwards each one comes before the ones inside it. */
+static void cse_end_block(struct cse_state *cse)
+{
+	struct cse_found *f, *first, *last = NULL;
+	int ntemps = 0;
+	size_t i;
+
+	for (i = cse->nfound; i > cse->block; i--) {
+		f = &cse->found[i - 1];
+		if (f->first == i - 1 || (last && f->start >= last->start
+					&& f->end <= last->end))
+			continue;
+		first = &cse->found[f->first];
+		if (!first->store) {
+			first->store = 1;
+			first->temp = ntemps++;
+		}
+		f->load = 1;
+		f->temp = first->temp;
+		last = f;
+		cse->loads++;
+	}
+	if (ntemps > cse->ntemps)
+		cse->ntemps = ntemps;
+
+	cse->block = cse->nfound;
+	cse->nkeys = 0;
+	cse->depth = 0;
+}
+
+/* numbers the values of [start, end) */
+static int cse_values(struct cse_state *cse, size_t start, size_t end)
+{
+	struct codegen_inst *inst;
+	struct cse_value left, right;
+	struct cse_key *key;
+	size_t i, n;
+	int ret = OK;
+
+	for (i = start; ret && i < end; i++) {
+		inst = &cse->cs->code[i];
+		switch (inst->op) {
+		case MEPA_CRCT:
+		case MEPA_CRVL:
+		case MEPA_CRVI:
+			key = cse_lookup(cse, inst->op, inst->a,
+					inst->op == MEPA_CRCT ? 0 : inst->b,
+					0, 0);
+			cse_push(cse, key ? key->number
+					: cse->next_number++, i);
+			break;
+		case MEPA_CREN:
+		case MEPA_LEIT:
+			cse_push(cse, 0, i);
+			break;
+		case MEPA_AMEM:
+			for (n = 0; n < (size_t) inst->a; n++)
+				cse_push(cse, 0, i);
+			break;
+		case MEPA_INVR:
+		case MEPA_NEGA:
+			right = cse_pop(cse);
+			ret = cse_compute(cse, inst->op, right.number, 0,
+					right.start, i + 1);
+			break;
+		case MEPA_SOMA:
+		case MEPA_SUBT:
+		case MEPA_MULT:
+		case MEPA_DIVI:
+		case MEPA_MODU:
+		case MEPA_CONJ:
+		case MEPA_DISJ:
+		case MEPA_CMME:
+		case MEPA_CMMA:
+		case MEPA_CMIG:
+		case MEPA_CMDG:
+		case MEPA_CMEG:
+		case MEPA_CMAG:
+			right = cse_pop(cse);
+			left = cse_pop(cse);
+			ret = cse_compute(cse, inst->op, left.number,
+					right.number, left.start, i + 1);
+			break;
+		case MEPA_ARMC:
+			right = cse_pop(cse);
+			cse_push(cse, 0, right.start);
+			cse_kill(cse, inst->op, inst->a, inst->b);
+			break;
+		case MEPA_ARMZ:
+		case MEPA_ARMI:
+			cse_pop(cse);
+			cse_kill(cse, inst->op, inst->a, inst->b);
+			break;
+		case MEPA_IMPR:
+			cse_pop(cse);
+			break;
+		case MEPA_DMEM:
+			for (n = 0; n < (size_t) inst->a; n++)
+				cse_pop(cse);
+			break;
+		default:
+			/* the labels, jumps, calls and notes */
+			cse_end_block(cse);
+			break;
+		}
+	}
+	cse_end_block(cse);
+
+	return ret;
+}
+
+/* The code of the procedure is generated again with the loads and the
+ * stores, like in codegen_tail_calls() */
+static int cse_replace(struct cse_state *cse, size_t start)
+{
+	struct codegen_state *cs = cse->cs;
+	struct codegen_object temp;
+	struct codegen_inst *saved, *inst;
+	struct cse_found **loads, **stores, *f;
+	struct codegen_tail_call *tail = cs->tails;
+	size_t count, i;
+	int ret = OK;
+
+	count = cs->ninsts - start;
+	saved = (struct codegen_inst*) malloc(count
+			* sizeof(struct codegen_inst));
+	/* the found values by where their code starts and ends */
+	loads = (struct cse_found**) calloc(2 * (count + 1),
+			sizeof(struct cse_found*));
+	if (!saved || !loads) {
+		free(saved);
+		free(loads);
+		codegen_set_error(cs, CODEGEN_NO_MEMORY);
+		return ERROR;
+	}
+	stores = loads + count + 1;
+	for (f = cse->found; f < cse->found + cse->nfound; f++) {
+		if (f->load)
+			loads[f->start - start] = f;
+		if (f->store)
+			stores[f->end - start] = f;
+	}
+	memcpy(saved, &cs->code[start], count * sizeof(struct codegen_inst));
+	cs->ninsts = start;
+
+	temp.type = CODEGEN_OBJ_INT;
+	temp.scope = CODEGEN_SCOPE_LOCAL;
+	temp.k = cs->temps_k;
+	temp.ref = 0;
+	temp.address = 0;
+	for (i = 0; ret && i <= count; i++) {
+		if (stores[i]) {
+			temp.index = cs->temps_base + cs->ntemps
+				+ stores[i]->temp;
+			ret = codegen_store_object(cs, &temp)
+				&& codegen_fetch_object(cs, &temp);
+		}
+		if (!ret || i == count)
+			break;
+
+		inst = &saved[i];
+		if (loads[i]) {
+			temp.index = cs->temps_base + cs->ntemps
+				+ loads[i]->temp;
+			ret = codegen_fetch_object(cs, &temp);
+			i = loads[i]->end - start - 1;
+			continue;
+		}
+		while (tail < cs->tails + cs->ntails && tail->at < start + i)
+			tail++;
+		if (tail < cs->tails + cs->ntails && tail->at == start + i)
+			tail->at = cs->ninsts;
+		if (inst->op == MEPA_LABEL)
+			ret = codegen_place_label(cs, inst->label, inst->note);
+		else
+			ret = codegen_emit(cs, inst->op, inst->a, inst->b,
+					inst->label, inst->note);
+	}
+	free(saved);
+	free(loads);
+
+	return ret;
+}
+
+/** The common values of the code of the current procedure, before the
+ * room is allocated */
+int codegen_common_values(struct codegen_state *cs)
+{
+	struct cse_state cse;
+	size_t start = cs->temps_at, size, i;
+	int ret;
+
+	if (!cs->cse || !cs->out || start < cs->written
+			|| start >= cs->ninsts)
+		return OK;
+	memset(&cse, 0, sizeof(cse));
+	cse.cs = cs;
+	cse.next_number = 1;
+
+	/* each instruction pushes one value at most, but AMEM */
+	size = cs->ninsts - start;
+	for (i = start; i < cs->ninsts; i++)
+		if (cs->code[i].op == MEPA_AMEM)
+			size += cs->code[i].a;
+	cse.stack = (struct cse_value*) malloc(size
+			* sizeof(struct cse_value));
+	if (!cse.stack) {
+		codegen_set_error(cs, CODEGEN_NO_MEMORY);
+		return ERROR;
+	}
+	ret = cse_values(&cse, start, cs->ninsts);
+	if (ret && cse.loads) {
+		ret = cse_replace(&cse, start);
+		cs->ntemps += cse.ntemps;
+	}
+	free(cse.stack);
+	free(cse.found);
+
+	return ret;
+}
@@ -0,0 +1,11 @@
+/** The common values, with -fcse: a value computed again in a block of
+ * straight code is loaded instead (see codegen_procedure_epilog()).
+ */
+#ifndef inc_cse_h
+#define inc_cse_h
+
+#include "codegen.h"
+
+int codegen_common_values(struct codegen_state *cs);
+
+#endif /* inc_cse_h */
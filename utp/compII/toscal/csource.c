@@ -0,0 +1,608 @@
+/** csource.c
+ *
+ * The whole program becomes main(), with each MEPA instruction as a few C
+ * statements:
+ *
+ * - The memory is the array m[], s is SP and the display is the array d[],
+ *   so the variables of nested procedures are reached through d[k] just
+ *   like in the VMs. The frames have the same layout, CHPR saves the same
+ *   three words.
+ * - The words the expressions push and pop are kept in the locals t0, t1...
+ *   (tN is the N-th word above s) and only stored in m[] before a label,
+ *   a jump or a call, so inside a statement the C compiler sees plain
+ *   variables. After a label they're loaded back from m[] when needed.
+ * - DSVS, DSVF and the DSxx extensions are goto, CHPR is a goto after
+ *   saving a number for the return, and RTPR goes back through a switch
+ *   on that number, among the CHPRs of its procedure (the one of the last
+ *   L label, as codegen.c generates each procedure in one piece).
+ *
+ * Like in mepa/vm.c the words are longs, the arithmetic wraps around and
+ * the memory starts filled with 999999. The stack has a fixed size
+ * (-DMEPA_STACK_SIZE=words when compiling the output), checked by AMEM
+ * and CHPR.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include "csource.h"
+#include "opcodes.h"
+
+#define ERROR	0
+#define OK	1
+
+/* the room left for the expressions and the words of CHPR */
+#define EXTRA_ROOM	3
+
+#define ADDRESS_SIZE	32
+
+static const char prelude[] =
+	"/* written by toscal -m c */\n"
+	"#include <stdio.h>\n"
+	"#include <stdlib.h>\n"
+	"#include <errno.h>\n"
+	"\n"
+	"#ifndef MEPA_STACK_SIZE\n"
+	"#define MEPA_STACK_SIZE 1048576\n"
+	"#endif\n"
+	"\n"
+	"/* what the memory has before being written */\n"
+	"#define MEPA_UNSET 999999\n"
+	"\n"
+	"#define ADD(a, b) ((long) ((unsigned long) (a) + (unsigned long) (b)))\n"
+	"#define SUB(a, b) ((long) ((unsigned long) (a) - (unsigned long) (b)))\n"
+	"#define MUL(a, b) ((long) ((unsigned long) (a) * (unsigned long) (b)))\n"
+	"#define NEG(a) ((long) -(unsigned long) (a))\n"
+	"/* the python \"and\" and \"or\", which give one of the operands */\n"
+	"#define CONJ(a, b) ((b) ? (a) : (b))\n"
+	"#define DISJ(a, b) ((b) ? (b) : (a))\n"
+	"\n"
+	"static long m[MEPA_STACK_SIZE];\n"
+	"\n"
+	"static inline void mepa_fail(const char *message)\n"
+	"{\n"
+	"\tfflush(stdout);\n"
+	"\tfprintf(stderr, \"%s\\n\", message);\n"
+	"\texit(1);\n"
+	"}\n"
+	"\n"
+	"static inline long mepa_read(void)\n"
+	"{\n"
+	"\tchar line[128];\n"
+	"\tchar *end;\n"
+	"\tlong value;\n"
+	"\n"
+	"\tif (!fgets(line, sizeof(line), stdin))\n"
+	"\t\tmepa_fail(\"the input is not an integer\");\n"
+	"\terrno = 0;\n"
+	"\tvalue = strtol(line, &end, 10);\n"
+	"\tif (errno || end == line)\n"
+	"\t\tmepa_fail(\"the input is not an integer\");\n"
+	"\twhile (*end == ' ' || *end == '\\t' || *end == '\\r' "
+		"|| *end == '\\n')\n"
+	"\t\tend++;\n"
+	"\tif (*end)\n"
+	"\t\tmepa_fail(\"the input is not an integer\");\n"
+	"\n"
+	"\treturn value;\n"
+	"}\n"
+	"\n"
+	"/* a // b and a % b of python, b is never 0 */\n"
+	"static inline long mepa_div(long a, long b)\n"
+	"{\n"
+	"\tlong q;\n"
+	"\n"
+	"\tif (b == -1)\n"
+	"\t\treturn NEG(a);\n"
+	"\tq = a / b;\n"
+	"\tif (a % b != 0 && (a < 0) != (b < 0))\n"
+	"\t\tq--;\n"
+	"\treturn q;\n"
+	"}\n"
+	"\n"
+	"static inline long mepa_mod(long a, long b)\n"
+	"{\n"
+	"\tlong r;\n"
+	"\n"
+	"\tif (b == -1)\n"
+	"\t\treturn 0;\n"
+	"\tr = a % b;\n"
+	"\tif (r != 0 && (r < 0) != (b < 0))\n"
+	"\t\tr += b;\n"
+	"\treturn r;\n"
+	"}\n"
+	"\n"
+	"static inline void mepa_assert(long a, long b)\n"
+	"{\n"
+	"\tif (a != b) {\n"
+	"\t\tfflush(stdout);\n"
+	"\t\tfprintf(stderr, \"assertion failed: %ld != %ld\\n\", a, b);\n"
+	"\t\texit(1);\n"
+	"\t}\n"
+	"}\n"
+	"\n"
+	"int main(void)\n"
+	"{\n";
+
+/* the binary operations that can't fail */
+struct binary_op {
+	enum mepa_opcode op;
+	const char *format;	/* of the operands a and b, in this order */
+};
+
+static const struct binary_op binary_ops[] = {
+	{ MEPA_SOMA, "ADD(t%d, t%d)" },
+	{ MEPA_SUBT, "SUB(t%d, t%d)" },
+	{ MEPA_MULT, "MUL(t%d, t%d)" },
+	{ MEPA_CONJ, "CONJ(t%d, t%d)" },
+	{ MEPA_DISJ, "DISJ(t%d, t%d)" },
+	{ MEPA_CMIG, "t%d == t%d" },
+	{ MEPA_CMDG, "t%d != t%d" },
+	{ MEPA_CMMA, "t%d > t%d" },
+	{ MEPA_CMAG, "t%d >= t%d" },
+	{ MEPA_CMME, "t%d < t%d" },
+	{ MEPA_CMEG, "t%d <= t%d" },
+	{ MEPA__COUNT, NULL }
+};
+
+struct c_writer {
+	FILE *out;	/* NULL while only counting */
+	struct codegen_state *cs;
+	unsigned char *used;	/* the labels written */
+	unsigned char *jumped;	/* the labels the code written jumps to */
+	int depth;	/* the words in t0...tN above s */
+	int max_depth;
+	int temps;	/* max_depth of the whole code */
+	long levels;
+	unsigned int returns;	/* of the CHPRs so far */
+	size_t *callees;	/* the label called by each of them */
+	size_t proc;	/* the label of the procedure being written */
+	unsigned char *returning;	/* the procedures with a RTPR written */
+	int procedures;	/* some RTPR needs r */
+	int unreachable;	/* after a jump, until a label */
+};
+
+static void put(struct c_writer *w, const char *format, ...)
+{
+	va_list ap;
+
+	if (!w->out)
+		return;
+	va_start(ap, format);
+	vfprintf(w->out, format, ap);
+	va_end(ap);
+}
+
+static void label_name(struct c_writer *w, size_t label, char *buf)
+{
+	if (w->cs->labels[label].target == CODEGEN_NO_TARGET) {
+		snprintf(buf, CODEGEN_LABEL_SIZE, "mepa_end");
+		return;
+	}
+	memcpy(buf, "mepa_", 5);
+	codegen_label_name(w->cs, label, buf + 5, CODEGEN_LABEL_SIZE - 5);
+}
+
+/* the label of a jump, which then needs to be written */
+static void jump_label(struct c_writer *w, size_t label, char *buf)
+{
+	w->jumped[label] = 1;
+	label_name(w, label, buf);
+}
+
+/* the address of the word n of level k, as d[k] + n */
+static const char *address(char *buf, int k, int n)
+{
+	if (n > 0)
+		snprintf(buf, ADDRESS_SIZE, "d[%d] + %d", k, n);
+	else if (n < 0)
+		snprintf(buf, ADDRESS_SIZE, "d[%d] - %ld", k, -(long) n);
+	else
+		snprintf(buf, ADDRESS_SIZE, "d[%d]", k);
+	return buf;
+}
+
+/* a new word on top, returns its t */
+static int push(struct c_writer *w)
+{
+	if (++w->depth > w->max_depth)
+		w->max_depth = w->depth;
+	return w->depth - 1;
+}
+
+/* makes sure the top count words are in locals, bringing them from m[] */
+static void need(struct c_writer *w, int count)
+{
+	int missing = count - w->depth;
+	int i;
+
+	if (missing <= 0)
+		return;
+	for (i = w->depth - 1; i >= 0; i--)
+		put(w, "\tt%d = t%d;\n", i + missing, i);
+	for (i = 0; i < missing; i++)
+		if (i == missing - 1)
+			put(w, "\tt%d = m[s];\n", i);
+		else
+			put(w, "\tt%d = m[s - %d];\n", i, missing - 1 - i);
+	put(w, "\ts -= %d;\n", missing);
+	w->depth = count;
+	if (w->depth > w->max_depth)
+		w->max_depth = w->depth;
+}
+
+/* stores the locals in m[], before s is used */
+static void flush(struct c_writer *w)
+{
+	int i;
+
+	if (!w->depth)
+		return;
+	for (i = 0; i < w->depth; i++)
+		put(w, "\tm[s + %d] = t%d;\n", i + 1, i);
+	put(w, "\ts += %d;\n", w->depth);
+	w->depth = 0;
+}
+
+/* fails unless m[] has count more words, and the room for the
+ * expressions */
+static void check_room(struct c_writer *w, long count)
+{
+	put(w, "\tif (s >= MEPA_STACK_SIZE - %ld)\n"
+			"\t\tmepa_fail(\"stack overflow\");\n",
+			count + w->temps + EXTRA_ROOM);
+}
+
+static void comment(struct c_writer *w, struct codegen_inst *inst)
+{
+	char text[64];
+
+	if (!w->out)
+		return;
+	codegen_inst_text(w->cs, inst, text, sizeof(text));
+	put(w, "\t/* %s */\n", text);
+}
+
+static const char *binary_format(enum mepa_opcode op)
+{
+	const struct binary_op *bin;
+
+	for (bin = binary_ops; bin->format; bin++)
+		if (bin->op == op)
+			break;
+	return bin->format;
+}
+
+static int binary(struct c_writer *w, struct codegen_inst *inst)
+{
+	const char *format = binary_format(inst->op);
+	int a;
+
+	if (!format)
+		return 0;
+
+	need(w, 2);
+	a = w->depth - 2;
+	put(w, "\tt%d = ", a);
+	put(w, format, a, a + 1);
+	put(w, ";\n");
+	w->depth--;
+
+	return 1;
+}
+
+static void write_inst(struct c_writer *w, struct codegen_inst *inst)
+{
+	char label[CODEGEN_LABEL_SIZE];
+	char addr[ADDRESS_SIZE];
+	int t;
+
+	if (inst->op == MEPA_LABEL) {
+		if (w->cs->labels[inst->label].kind == CODEGEN_LABEL_PROC)
+			w->proc = inst->label;
+		if (!w->used[inst->label])
+			return;
+		flush(w);
+		w->unreachable = 0;
+		label_name(w, inst->label, label);
+		put(w, "%s: ;\n", label);
+		return;
+	}
+	if (mepa_opcodes[inst->op].operands == MEPA_OPND_PSEUDO
+			|| w->unreachable)
+		return;
+
+	comment(w, inst);
+	if (binary(w, inst))
+		return;
+
+	switch (inst->op) {
+	case MEPA_INPP:
+		put(w, "\td[0] = 0;\n");
+		break;
+	case MEPA_PARA:
+		put(w, "\tgoto mepa_end;\n");
+		w->unreachable = 1;
+		break;
+	case MEPA_AMEM:
+		/* like in the VMs, the operand was pushed and then popped */
+		flush(w);
+		check_room(w, inst->a);
+		put(w, "\tm[s + 1] = %d;\n\ts += %d;\n", inst->a, inst->a);
+		break;
+	case MEPA_DMEM:
+		flush(w);
+		put(w, "\ts -= %d;\n", inst->a);
+		break;
+	case MEPA_CRCT:
+		put(w, "\tt%d = %d;\n", push(w), inst->a);
+		break;
+	case MEPA_CRVL:
+		put(w, "\tt%d = m[%s];\n", push(w),
+				address(addr, inst->a, inst->b));
+		break;
+	case MEPA_ARMZ:
+	case MEPA_ARMC:
+		need(w, 1);
+		put(w, "\tm[%s] = t%d;\n", address(addr, inst->a, inst->b),
+				w->depth - 1);
+		if (inst->op == MEPA_ARMZ)
+			w->depth--;
+		break;
+	case MEPA_CRVI:
+		put(w, "\tt%d = m[m[%s]];\n", push(w),
+				address(addr, inst->a, inst->b));
+		break;
+	case MEPA_ARMI:
+		need(w, 1);
+		put(w, "\tm[m[%s]] = t%d;\n", address(addr, inst->a, inst->b),
+				--w->depth);
+		break;
+	case MEPA_CREN:
+		put(w, "\tt%d = %s;\n", push(w),
+				address(addr, inst->a, inst->b));
+		break;
+	case MEPA_DIVI:
+	case MEPA_MODU:
+		need(w, 2);
+		t = w->depth - 2;
+		put(w, "\tif (t%d == 0)\n\t\tmepa_fail(\"division by zero\");\n"
+				"\tt%d = mepa_%s(t%d, t%d);\n", t + 1, t,
+				inst->op == MEPA_DIVI ? "div" : "mod", t, t + 1);
+		w->depth--;
+		break;
+	case MEPA_INVR:
+		need(w, 1);
+		t = w->depth - 1;
+		put(w, "\tt%d = NEG(t%d);\n", t, t);
+		break;
+	case MEPA_NEGA:
+		need(w, 1);
+		t = w->depth - 1;
+		put(w, "\tt%d = !t%d;\n", t, t);
+		break;
+	case MEPA_DSVS:
+		flush(w);
+		jump_label(w, inst->label, label);
+		put(w, "\tgoto %s;\n", label);
+		w->unreachable = 1;
+		break;
+	case MEPA_DSVF:
+		/* the condition stays in its local */
+		need(w, 1);
+		t = --w->depth;
+		flush(w);
+		jump_label(w, inst->label, label);
+		put(w, "\tif (!t%d)\n\t\tgoto %s;\n", t, label);
+		break;
+	case MEPA_DSIG:
+	case MEPA_DSDG:
+	case MEPA_DSMA:
+	case MEPA_DSAG:
+	case MEPA_DSME:
+	case MEPA_DSEG:
+		/* the condition of the CMxx with the same operands */
+		need(w, 2);
+		w->depth -= 2;
+		t = w->depth;
+		flush(w);
+		jump_label(w, inst->label, label);
+		put(w, "\tif (");
+		put(w, binary_format(MEPA_CMIG + (inst->op - MEPA_DSIG)),
+				t, t + 1);
+		put(w, ")\n\t\tgoto %s;\n", label);
+		break;
+	case MEPA_DSVR:
+		/* BP of the level of the label, SP is set by its ENRT */
+		flush(w);
+		jump_label(w, inst->label, label);
+		put(w, "\tbp = d[%d];\n\tgoto %s;\n", inst->a, label);
+		w->unreachable = 1;
+		break;
+	case MEPA_CHPR:
+		flush(w);
+		check_room(w, 0);
+		jump_label(w, inst->label, label);
+		put(w, "\tm[s + 1] = %u;\n\tm[s + 2] = bp;\n\tm[s + 3] = %d;\n"
+				"\ts += 3;\n\tgoto %s;\nmepa_return%u: ;\n",
+				w->returns, inst->a, label, w->returns);
+		w->callees[w->returns++] = inst->label;
+		break;
+	case MEPA_ENPR:
+		flush(w);
+		put(w, "\tbp = s + 1;\n\td[%d] = bp;\n", inst->a);
+		break;
+	case MEPA_RTPR:
+		/* D[k of the caller] = BP of the caller */
+		flush(w);
+		w->procedures = 1;
+		w->returning[w->proc] = 1;
+		label_name(w, w->proc, label);
+		put(w, "\tbp = m[s - 1];\n\td[m[s]] = bp;\n\tr = m[s - 2];\n"
+				"\ts -= %d;\n\tgoto %s_return;\n",
+				3 + inst->b, label);
+		w->unreachable = 1;
+		break;
+	case MEPA_ENRT:
+		flush(w);
+		put(w, "\ts = %s;\n", address(addr, inst->a, inst->b - 1));
+		break;
+	case MEPA_LEIT:
+		put(w, "\tt%d = mepa_read();\n", push(w));
+		break;
+	case MEPA_IMPR:
+		need(w, 1);
+		put(w, "\tprintf(\"%%ld\\n\", t%d);\n", --w->depth);
+		break;
+	case MEPA_NADA:
+		break;
+	case MEPA_ASSERT:
+		need(w, 2);
+		w->depth -= 2;
+		put(w, "\tmepa_assert(t%d, t%d);\n", w->depth + 1, w->depth);
+		break;
+	default:
+		break;
+	}
+}
+
+static void write_code(struct c_writer *w)
+{
+	size_t i;
+
+	w->depth = 0;
+	w->max_depth = 0;
+	w->returns = 0;
+	w->procedures = 0;
+	w->unreachable = 0;
+	w->proc = CODEGEN_START_LABEL;
+	memset(w->jumped, 0, w->cs->nlabels);
+	memset(w->returning, 0, w->cs->nlabels);
+	for (i = 0; i < w->cs->ninsts; i++)
+		write_inst(w, &w->cs->code[i]);
+	flush(w);
+}
+
+/* the labels some instruction jumps to, and the largest k */
+static void scan_code(struct c_writer *w)
+{
+	struct codegen_inst *inst;
+	long k;
+	size_t i;
+
+	w->levels = 1;
+	for (i = 0; i < w->cs->ninsts; i++) {
+		inst = &w->cs->code[i];
+		switch (mepa_opcodes[inst->op].operands) {
+		case MEPA_OPND_L:
+		case MEPA_OPND_LA:
+		case MEPA_OPND_LAB:
+			w->used[inst->label] = 1;
+			break;
+		default:
+			break;
+		}
+		switch (inst->op) {
+		case MEPA_CRVL: case MEPA_ARMZ: case MEPA_ARMC:
+		case MEPA_CRVI: case MEPA_ARMI: case MEPA_CREN:
+		case MEPA_ENPR: case MEPA_RTPR: case MEPA_ENRT:
+		case MEPA_CHPR:
+			k = inst->a;
+			break;
+		case MEPA_DSVR:
+			k = inst->a > inst->b ? inst->a : inst->b;
+			break;
+		default:
+			continue;
+		}
+		if (k >= w->levels)
+			w->levels = k + 1;
+	}
+}
+
+/* the switch of the RTPRs of a procedure, on the CHPRs calling it */
+static void write_returns(struct c_writer *w, size_t proc)
+{
+	char label[CODEGEN_LABEL_SIZE];
+	unsigned int i;
+
+	label_name(w, proc, label);
+	put(w, "%s_return:\n\tswitch (r) {\n", label);
+	for (i = 0; i < w->returns; i++)
+		if (w->callees[i] == proc)
+			put(w, "\tcase %u: goto mepa_return%u;\n", i, i);
+	put(w, "\t}\n\tmepa_fail(\"invalid return address\");\n");
+}
+
+static void write_main(struct c_writer *w)
+{
+	size_t i;
+	int t;
+
+	put(w, "\tlong d[%ld];\n\tlong s = -1, bp = 0", w->levels);
+	if (w->procedures)
+		put(w, ", r");
+	for (t = 0; t < w->temps; t++)
+		put(w, ", t%d", t);
+	put(w, ";\n\tlong i;\n\n"
+			"\tfor (i = 0; i < MEPA_STACK_SIZE; i++)\n"
+			"\t\tm[i] = MEPA_UNSET;\n"
+			"\tfor (i = 0; i < %ld; i++)\n"
+			"\t\td[i] = MEPA_UNSET;\n"
+			"\t(void) bp;\n\n", w->levels);
+
+	write_code(w);
+	put(w, "\tgoto mepa_end;\n\n");
+
+	for (i = 0; i < w->cs->nlabels; i++)
+		if (w->returning[i])
+			write_returns(w, i);
+	put(w, "mepa_end:\n\tfflush(stdout);\n\treturn ferror(stdout) != 0;\n"
+			"}\n");
+}
+
+/** Writes the whole program as C */
+int csource_write(struct codegen_state *cs)
+{
+	struct c_writer w;
+	int changed;
+
+	memset(&w, 0, sizeof(w));
+	w.cs = cs;
+	w.used = (unsigned char*) calloc(cs->nlabels + 1, 3);
+	w.callees = (size_t*) malloc((cs->ninsts + 1) * sizeof(size_t));
+	if (!w.used || !w.callees) {
+		free(w.used);
+		free(w.callees);
+		codegen_set_error(cs, CODEGEN_NO_MEMORY);
+		return ERROR;
+	}
+	w.jumped = w.used + cs->nlabels + 1;
+	w.returning = w.jumped + cs->nlabels + 1;
+	scan_code(&w);
+
+	/* without writing, until only the labels reached are left (the
+	 * procedures never called may call others) and the number of
+	 * locals is known */
+	do {
+		write_code(&w);
+		changed = memcmp(w.used, w.jumped, cs->nlabels) != 0;
+		memcpy(w.used, w.jumped, cs->nlabels);
+	} while (changed);
+	w.temps = w.max_depth;
+
+	w.out = cs->out;
+	fputs(prelude, w.out);
+	write_main(&w);
+	free(w.used);
+	free(w.callees);
+
+	if (fflush(w.out) == EOF || ferror(w.out)) {
+		codegen_set_error(cs, CODEGEN_WRITE_ERROR);
+		return ERROR;
+	}
+	cs->written = cs->ninsts;
+
+	return OK;
+}
@@ -0,0 +1,14 @@
+/** The C backend writes the code generated by codegen.c as a standalone
+ * C program, left for the C compiler to optimize.
+ *
+ * The program needs nothing but the C library: main() runs it with the
+ * input and the output of mepa.py.
+ */
+#ifndef inc_csource_h
+#define inc_csource_h
+
+#include "codegen.h"
+
+int csource_write(struct codegen_state *cs);
+
+#endif /* inc_csource_h */
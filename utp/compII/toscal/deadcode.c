@@ -0,0 +1,134 @@
+/** deadcode.c
+ *
+ * The dead code is found on the whole program: what is not reached from
+ * its start, following the jumps and the calls, is taken out.
+ */
+#include <stdlib.h>
+
+#include "deadcode.h"
+#include "opcodes.h"
+
+/* how the instructions are reached */
+#define DEAD		0
+#define REACHED		1
+#define CONST_JUMP	2	/* a DSVF after a CRCT */
+
+/* the instructions with a label operand */
+static int has_label(enum mepa_opcode op)
+{
+	switch (mepa_opcodes[op].operands) {
+	case MEPA_OPND_L:
+	case MEPA_OPND_LA:
+	case MEPA_OPND_LAB:
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+static void reach(unsigned char *reached, size_t *work, size_t *nwork,
+		size_t pos)
+{
+	if (reached[pos] != DEAD)
+		return;
+	reached[pos] = REACHED;
+	work[(*nwork)++] = pos;
+}
+
+/* Marks the instructions reached from the start of the program: the
+ * procedures never called, the code after the jumps and the branches of
+ * the conditions that are constants are not. */
+static void find_reached(struct codegen_state *cs, unsigned char *reached,
+		size_t *work)
+{
+	struct codegen_inst *inst;
+	size_t nwork = 0, i, target;
+	int next, jump;
+
+	reach(reached, work, &nwork, 0);
+	while (nwork) {
+		i = work[--nwork];
+		inst = &cs->code[i];
+		next = 1;
+		jump = has_label(inst->op) && inst->op != MEPA_LABEL;
+
+		switch (inst->op) {
+		case MEPA_DSVS:
+		case MEPA_DSVR:
+		case MEPA_RTPR:
+		case MEPA_PARA:
+			next = 0;
+			break;
+		case MEPA_DSVF:
+			/* only a fall through gets to a DSVF, the CRCT just
+			 * before it is the value tested */
+			if (i == 0 || cs->code[i - 1].op != MEPA_CRCT)
+				break;
+			reached[i] = CONST_JUMP;
+			if (cs->code[i - 1].a)
+				jump = 0;
+			else
+				next = 0;
+			break;
+		default:
+			break;
+		}
+
+		if (next && i + 1 < cs->ninsts)
+			reach(reached, work, &nwork, i + 1);
+		if (!jump)
+			continue;
+		target = cs->labels[inst->label].target;
+		if (target != CODEGEN_NO_TARGET && target < cs->ninsts)
+			reach(reached, work, &nwork, target);
+	}
+}
+
+/** Takes out the code never reached, returns how many instructions */
+size_t codegen_remove_dead_code(struct codegen_state *cs)
+{
+	unsigned char *reached;
+	size_t *work;
+	size_t i, n = 0, removed = 0;
+
+	/* the jumps of the code already written are not known */
+	if (cs->written || !cs->ninsts)
+		return 0;
+	reached = (unsigned char*) calloc(cs->ninsts, 1);
+	work = (size_t*) malloc(cs->ninsts * sizeof(size_t));
+	if (!reached || !work) {
+		/* without memory the code stays as it is */
+		free(reached);
+		free(work);
+		return 0;
+	}
+	find_reached(cs, reached, work);
+
+	for (i = 0; i < cs->ninsts; i++) {
+		if (reached[i] == DEAD) {
+			if (cs->code[i].op == MEPA_LABEL)
+				cs->labels[cs->code[i].label].target =
+					CODEGEN_NO_TARGET;
+			else if (mepa_opcodes[cs->code[i].op].operands
+					!= MEPA_OPND_PSEUDO)
+				removed++;
+			continue;
+		}
+		if (reached[i] == CONST_JUMP) {
+			/* the CRCT goes, the DSVF is always or never taken */
+			n--;
+			removed++;
+			if (cs->code[i - 1].a) {
+				removed++;
+				continue;
+			}
+			cs->code[i].op = MEPA_DSVS;
+		}
+		cs->code[n++] = cs->code[i];
+	}
+	cs->ninsts = n;
+	free(reached);
+	free(work);
+
+	return removed;
+}
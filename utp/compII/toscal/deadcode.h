@@ -0,0 +1,13 @@
+/** The dead code, with -fdead-code: the code never reached is taken out
+ * before the other rewrites of peephole_optimize().
+ */
+#ifndef inc_deadcode_h
+#define inc_deadcode_h
+
+#include <stddef.h>
+
+#include "codegen.h"
+
+size_t codegen_remove_dead_code(struct codegen_state *cs);
+
+#endif /* inc_deadcode_h */
@@ -1,37 +1,72 @@
 #ifndef inc_hash_h
 #define inc_hash_h
 
+#include <stddef.h>
+
+/* An open addressing hash table in the style of the "Swiss tables": each
+ * slot has a control byte, either HASH_EMPTY, HASH_DELETED or the 7 upper
+ * bits of the hash of its key, and the slots are probed in groups of
+ * HASH_GROUP control bytes compared at once (with SSE2 when available).
+ *
+ * The keys are copied to a storage owned by the table, they stay at the
+ * same address until the table is freed, even if they are popped.
+ *
+ * When the table gets too full, a new array is allocated and the entries
+ * are moved to it a few groups at a time by the following operations, so
+ * no single put pays for the whole rehash.
+ */
+
+#define HASH_GROUP		16
+#define HASH_EMPTY		0x80
+#define HASH_DELETED		0xfe
+/* groups moved from the old array by each operation while resizing */
+#define HASH_MIGRATE_GROUPS	2
+#define HASH_KEY_CHUNK_MIN	256
+#define HASH_KEY_CHUNK_MAX	65536
+
 struct hash_entry {
-#ifdef DEBUG
-	char *key;
-#endif
+	const char *key;	/* '\0'-terminated copy of the key */
 	size_t key_len;
 	unsigned int hash;
 	void *data;
-	struct hash_entry *next;
+};
+
+struct hash_key_chunk {
+	struct hash_key_chunk *next;
+	size_t used;
+	size_t size;
+	char data[];
 };
 
 struct hash_table {
-    size_t count; /* the number of real valid entries */
-	size_t size; /* the number of entries allocated */
-	struct hash_entry **entries;
+	size_t count; /* the number of real valid entries */
+	size_t size; /* the number of slots allocated, a power of 2 */
+	size_t used; /* slots not HASH_EMPTY, including HASH_DELETED */
+	unsigned char *ctrl;
+	struct hash_entry *entries;
+
+	/* the array being drained while resizing, old_ctrl is NULL
+	 * otherwise */
+	size_t old_size;
+	size_t old_pos; /* the first slot not moved yet */
+	unsigned char *old_ctrl;
+	struct hash_entry *old_entries;
+
+	struct hash_key_chunk *keys;
 };
 
 /* opaque iterator state */
 typedef struct hash_iter_t_ {
-    size_t i;
-    struct hash_entry *current;
-    struct hash_entry *next;
-}hash_iter_t;
+	size_t i;
+} hash_iter_t;
 
 struct hash_table *hash_init(size_t);
-void *hash_put(struct hash_table *, const char *, size_t, void *,
-		unsigned int);
+struct hash_entry *hash_put(struct hash_table *, const char *, size_t,
+		void *, unsigned int);
 void *hash_get(struct hash_table *, const char *, size_t, unsigned int);
 void *hash_pop(struct hash_table *table, const char *key,
 		size_t key_len, unsigned int force_hash);
 void hash_free(struct hash_table *);
-void hash_free_entry(struct hash_entry *entry);
 unsigned int get_hash(const char *, size_t);
 
 hash_iter_t hash_iter_first(struct hash_table *, void **);
@@ -0,0 +1,216 @@
+/** inline.c
+ *
+ * A call of a small procedure whose code is complete is replaced by a copy
+ * of that code. The frame of the copy (the params, the result and the
+ * locals) is room in the frame of the caller, after its locals; it is
+ * shared by all the calls replaced in the caller, as none of them is used
+ * after its code ends.
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "inline.h"
+#include "opcodes.h"
+
+#define ERROR	0
+#define OK	1
+
+/* the instructions with the k and the address of a variable */
+static int codegen_var_op(enum mepa_opcode op)
+{
+	switch (op) {
+	case MEPA_CRVL:
+	case MEPA_ARMZ:
+	case MEPA_CRVI:
+	case MEPA_ARMI:
+	case MEPA_CREN:
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+/* the AMEM and DMEM of the locals, left out of the copies */
+static int codegen_locals_op(struct codegen_inst *inst)
+{
+	return (inst->op == MEPA_AMEM && inst->note == CODEGEN_NOTE_LOCAL_ALLOC)
+		|| (inst->op == MEPA_DMEM
+				&& inst->note == CODEGEN_NOTE_DEALLOC_LOCALS);
+}
+
+/* The code of the procedure of label between its ENPR and RTPR, in
+ * [*first, *end), when it can be copied: it is small, it calls neither
+ * itself nor the procedures inside it (they need its frame) and has no
+ * goto labels (ENRT cuts the stack at its locals). */
+static int codegen_inline_code(struct codegen_state *cs, size_t label,
+		int *k, size_t *first, size_t *end)
+{
+	struct codegen_inst *inst;
+	size_t proc, target, i;
+	int size = 0;
+
+	proc = cs->labels[label].target;
+	if (proc == CODEGEN_NO_TARGET || proc + 1 >= cs->ninsts
+			|| cs->code[proc + 1].op != MEPA_ENPR)
+		return 0;
+	*k = cs->code[proc + 1].a;
+
+	for (i = proc + 2; i < cs->ninsts; i++) {
+		inst = &cs->code[i];
+		switch (inst->op) {
+		case MEPA_RTPR:
+			*first = proc + 2;
+			*end = i;
+			return 1;
+		case MEPA_ENPR:
+		case MEPA_ENRT:
+		case MEPA_DSVR:
+			return 0;
+		case MEPA_CHPR:
+			if (inst->label == label)
+				return 0;
+			target = cs->labels[inst->label].target;
+			if (target != CODEGEN_NO_TARGET
+					&& target + 1 < cs->ninsts
+					&& cs->code[target + 1].op == MEPA_ENPR
+					&& cs->code[target + 1].a > *k)
+				return 0;
+			break;
+		default:
+			break;
+		}
+		if (mepa_opcodes[inst->op].operands != MEPA_OPND_PSEUDO
+				&& !codegen_locals_op(inst)
+				&& ++size > cs->inline_size)
+			return 0;
+	}
+
+	return 0;
+}
+
+/* takes out the instruction at pos, before the code of a call */
+static void codegen_remove(struct codegen_state *cs, size_t pos)
+{
+	size_t i, kept = 0;
+
+	memmove(&cs->code[pos], &cs->code[pos + 1],
+			(cs->ninsts - pos - 1) * sizeof(struct codegen_inst));
+	cs->ninsts--;
+	for (i = 0; i < cs->nlabels; i++)
+		if (cs->labels[i].target != CODEGEN_NO_TARGET
+				&& cs->labels[i].target > pos)
+			cs->labels[i].target--;
+	for (i = 0; i < cs->ntails; i++)
+		if (cs->tails[i].at > pos)
+			cs->tails[i].at--;
+	/* the and/or/not in the arguments are no value of a condition */
+	for (i = 0; i < cs->nbools; i++)
+		if (cs->bools[i].at < pos)
+			cs->bools[kept++] = cs->bools[i];
+	cs->nbools = kept;
+}
+
+/* the address in the room of a call of the variable at address of the
+ * procedure called */
+static int codegen_inline_address(size_t base, int params, int result,
+		int address)
+{
+	if (address >= 0)
+		return base + params + result + address;
+	/* the params go from -(params + 3) to -4, the result is below */
+	if (address < -(params + CODEOBJ_ARGS_BP_OFFSET))
+		return base + params;
+	return base + address + params + CODEOBJ_ARGS_BP_OFFSET;
+}
+
+/** The call just generated is replaced by the code of the procedure
+ * called, when inline_size allows it; result is the position of the AMEM
+ * of the value of a function, CODEGEN_NO_TARGET for a procedure */
+int codegen_inline_call(struct codegen_state *cs, size_t result)
+{
+	struct codegen_inst call, inst;
+	size_t first, end, base, size, nmap = 0, i, j, *map = NULL;
+	int k, c, params, locals = 0, function = result != CODEGEN_NO_TARGET;
+	int ret = OK;
+
+	if (!cs->inline_size || !cs->out || cs->ninsts <= cs->written)
+		return OK;
+	call = cs->code[cs->ninsts - 1];
+	if (call.op != MEPA_CHPR
+			|| !codegen_inline_code(cs, call.label, &k, &first, &end))
+		return OK;
+	if (function && (result < cs->written || result >= cs->ninsts
+				|| cs->code[result].op != MEPA_AMEM))
+		return OK;
+
+	params = cs->code[end].b;
+	if (codegen_locals_op(&cs->code[end - 1]))
+		locals = cs->code[end - 1].a;
+	c = call.a;
+	base = cs->temps_base;
+	size = params + function + locals;
+
+	/* the labels of the copy, in pairs with the ones of the code */
+	for (i = first; i < end; i++)
+		if (cs->code[i].op == MEPA_LABEL)
+			nmap++;
+	if (nmap) {
+		map = (size_t*) malloc(2 * nmap * sizeof(size_t));
+		if (!map) {
+			codegen_set_error(cs, CODEGEN_NO_MEMORY);
+			return ERROR;
+		}
+	}
+	for (i = first, j = 0; ret && i < end; i++)
+		if (cs->code[i].op == MEPA_LABEL) {
+			map[j++] = cs->code[i].label;
+			ret = codegen_new_label(cs,
+					cs->labels[cs->code[i].label].kind,
+					&map[j++]);
+		}
+
+	/* the CHPR and the AMEM of the value go, the arguments are taken
+	 * from the stack, the last one at the top */
+	cs->ninsts--;
+	if (function)
+		codegen_remove(cs, result);
+	for (i = params; ret && i > 0; i--)
+		ret = codegen_emit(cs, MEPA_ARMZ, c, base + i - 1, 0,
+				CODEGEN_NOTE_NONE);
+
+	for (i = first; ret && i < end; i++) {
+		inst = cs->code[i];
+		if (inst.op == MEPA_PARAM_NOTE || inst.op == MEPA_LABEL_NOTE
+				|| codegen_locals_op(&inst))
+			continue;
+		if (codegen_var_op(inst.op) && inst.a == k) {
+			inst.a = c;
+			inst.b = codegen_inline_address(base, params,
+					function, inst.b);
+			inst.note = CODEGEN_NOTE_NONE;
+		}
+		else if (inst.op == MEPA_CHPR)
+			inst.a = c;
+		else if (mepa_opcodes[inst.op].operands == MEPA_OPND_L
+				|| inst.op == MEPA_LABEL)
+			for (j = 0; j < 2 * nmap; j += 2)
+				if (map[j] == inst.label) {
+					inst.label = map[j + 1];
+					break;
+				}
+		if (inst.op == MEPA_LABEL)
+			ret = codegen_place_label(cs, inst.label, inst.note);
+		else
+			ret = codegen_emit(cs, inst.op, inst.a, inst.b,
+					inst.label, inst.note);
+	}
+	free(map);
+
+	if (ret && function)
+		ret = codegen_emit(cs, MEPA_CRVL, c, base + params, 0,
+				CODEGEN_NOTE_NONE);
+	if (size > cs->ntemps)
+		cs->ntemps = size;
+
+	return ret;
+}
@@ -0,0 +1,13 @@
+/** The inlining, with -finline: the calls of small procedures become a
+ * copy of their code, allocated by codegen_alloc_temps().
+ */
+#ifndef inc_inline_h
+#define inc_inline_h
+
+#include <stddef.h>
+
+#include "codegen.h"
+
+int codegen_inline_call(struct codegen_state *cs, size_t result);
+
+#endif /* inc_inline_h */
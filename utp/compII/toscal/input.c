@@ -19,66 +19,124 @@
  *                      888                           
  *                     o888o                          
 */
+#include <errno.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
 #include "input.h"
+#include "scan.h"
+
+/* used for empty sources, so that the cursor always points somewhere */
+static const char empty_source[1] = "";
 
-int input_next(struct input_state *is)
+static int input_map(struct input_state *is)
 {
-	int ch;
+#ifndef _WIN32
+	struct stat st;
+	void *addr;
+	off_t offset;
+	int fd;
 
-	is->last = is->current;
-	is->first = 0;
-	
-	ch = fgetc(is->stream);
-	if (ch == EOF) {
-		if (feof(is->stream))
-			ch = -INPUT_EOF;
-		else
-			return -INPUT_ERROR;
-	}
+	fd = fileno(is->stream);
+	if (fd == -1 || fstat(fd, &st) == -1 || !S_ISREG(st.st_mode)
+			|| st.st_size == 0)
+		return 0;
 
-	is->current = ch;
+	addr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (addr == MAP_FAILED)
+		return 0; /* let the slow path try it */
+#ifdef MADV_SEQUENTIAL
+	madvise(addr, st.st_size, MADV_SEQUENTIAL);
+#endif
 
-	if (ch == '\n') {
-		is->lineno++;
-		is->last_linepos = is->linepos;
-		is->linepos = 0;
-	}
-	else
-		is->linepos++;
+	/* someone may have already read part of the stream */
+	offset = ftello(is->stream);
+	if (offset < 0 || offset > st.st_size)
+		offset = 0;
+
+	is->buf = (const char*) addr;
+	is->size = st.st_size;
+	is->begin = is->buf + offset;
+	is->end = is->buf + is->size;
+	is->mapped = 1;
 
-	return ch;
+	return 1;
+#else
+	return 0;
+#endif
 }
 
-int input_step_back(struct input_state *is)
+static int input_slurp(struct input_state *is)
 {
-	if (ungetc(is->current, is->stream) == EOF)
-		return 0;
-	if (is->current == '\n') {
-		is->lineno--;
-		is->linepos = 0;
+	char *buf = NULL, *newbuf;
+	size_t size = 0, allocated = 0, readed;
+
+	while (1) {
+		if (allocated - size < INPUT_READ_CHUNK) {
+			allocated = allocated ? allocated * 2 : INPUT_READ_CHUNK;
+			newbuf = (char*) realloc(buf, allocated);
+			if (!newbuf)
+				goto error;
+			buf = newbuf;
+		}
+		readed = fread(buf + size, 1, allocated - size, is->stream);
+		size += readed;
+		if (readed == 0) {
+			if (ferror(is->stream))
+				goto error;
+			break;
+		}
+	}
+
+	if (size == 0) {
+		free(buf);
+		is->buf = empty_source;
 	}
 	else
-		is->linepos--;
-	
+		is->buf = buf;
+	is->size = size;
+	is->begin = is->buf;
+	is->end = is->buf + size;
+	is->mapped = 0;
+
 	return 1;
+error:
+	free(buf);
+	return 0;
 }
 
-void input_dump_position(struct input_state *is, FILE *stream)
+void input_get_position(struct input_state *is,
+		struct input_position *position)
 {
-	size_t pos;
-	size_t line;
-
 	/* when stepping back from first char of line, the line number
 	 * should be ok */
 	if (is->linepos == 0) {
-		pos = is->last_linepos;
-		line = is->lineno - 1;
+		position->pos = is->last_linepos;
+		position->line = is->lineno - 1;
 	}
 	else {
-		pos = is->linepos;
-		line = is->lineno;
+		position->pos = is->linepos;
+		position->line = is->lineno;
 	}
-	fprintf(stream, "line %u position %u", line, pos);
+}
+
+void input_dump_saved_position(struct input_position *position,
+		FILE *stream)
+{
+	fprintf(stream, "line %u position %u", position->line, position->pos);
+}
+
+void input_dump_position(struct input_state *is, FILE *stream)
+{
+	struct input_position position;
+
+	input_get_position(is, &position);
+	input_dump_saved_position(&position, stream);
 }
 
 struct input_state *init_input_state(FILE *stream)
@@ -89,6 +147,21 @@ struct input_state *init_input_state(FILE *stream)
 	if (!is)
 		return NULL;
 	is->stream = stream;
+	init_scan();
+
+	if (!input_map(is) && !input_slurp(is)) {
+		free(is);
+		return NULL;
+	}
+	input_rewind(is);
+
+	return is;
+}
+
+/* goes back to the first char of the source, as if it was just opened */
+void input_rewind(struct input_state *is)
+{
+	is->cur = is->begin;
 	is->lineno = 1;
 	is->linepos = 0;
 	is->last_linepos = 1; /* 1 in the case of the first char of the
@@ -96,12 +169,44 @@ struct input_state *init_input_state(FILE *stream)
 	is->first = 1;
 	is->current = 0;
 	is->last = 0;
+}
 
-	return is;
+/* Consumes every char until "to" (exclusive), leaving the line and
+ * position as if they were read one by one with input_next() */
+void input_skip(struct input_state *is, const char *to)
+{
+	const char *nl, *prev;
+
+	for (nl = to - 1; nl >= is->cur && *nl != '\n'; nl--)
+		;
+	if (nl < is->cur) {
+		input_skip_line(is, to);
+		return;
+	}
+
+	/* last_linepos is the position before the last newline */
+	for (prev = nl - 1; prev >= is->cur && *prev != '\n'; prev--)
+		;
+	if (prev < is->cur)
+		is->last_linepos = is->linepos + (nl - is->cur);
+	else
+		is->last_linepos = nl - prev - 1;
+	is->lineno += scan.newlines(is->cur, to);
+	is->linepos = to - nl - 1;
+
+	is->last = to - is->cur > 1 ? (unsigned char) to[-2] : is->current;
+	is->current = (unsigned char) to[-1];
+	is->first = 0;
+	is->cur = to;
 }
 
 void close_input_state(struct input_state *is)
 {
+#ifndef _WIN32
+	if (is->mapped)
+		munmap((void*) is->buf, is->size);
+#endif
+	if (!is->mapped && is->buf != empty_source)
+		free((void*) is->buf);
 	free(is);
 }
-
@@ -8,8 +8,19 @@
 #define INPUT_EOF	0
 #define INPUT_ERROR	1
 
+#define INPUT_READ_CHUNK	65536
+
+/* The whole source is kept in contiguous memory: regular files are
+ * mmap()ed and anything else (pipes, stdin) is slurped into a growable
+ * buffer. The tokenizer then just walks a cursor over it. */
 struct input_state {
 	FILE *stream;
+	const char *buf;
+	const char *begin;	/* the first char of the source */
+	const char *cur;	/* the next char to be read */
+	const char *end;
+	size_t size;
+	int mapped;		/* whether buf must be munmap()ed or free()d */
 	size_t lineno;
 	size_t linepos;
 	size_t last_linepos; /* holds the position in the last line, should
@@ -19,10 +30,80 @@ struct input_state {
 	int last;
 };
 
-int input_next(struct input_state *is);
+/* a place in the source, as input_dump_position() writes it */
+struct input_position {
+	unsigned int line;
+	unsigned int pos;
+};
+
 struct input_state *init_input_state(FILE *stream);
 void close_input_state(struct input_state *is);
-int input_step_back(struct input_state *is);
+void input_rewind(struct input_state *is);
+void input_skip(struct input_state *is, const char *to);
 void input_dump_position(struct input_state*, FILE *stream);
+void input_get_position(struct input_state *is,
+		struct input_position *position);
+void input_dump_saved_position(struct input_position *position,
+		FILE *stream);
+
+/* These two are called once or twice for every char of the source, keep
+ * them inline */
+static inline int input_next(struct input_state *is)
+{
+	int ch;
+
+	is->last = is->current;
+	is->first = 0;
+
+	/* the cursor is allowed to go past the end so that stepping back
+	 * from EOF works as it does for any other char */
+	if (is->cur < is->end)
+		ch = (unsigned char) *is->cur;
+	else
+		ch = -INPUT_EOF;
+	is->cur++;
+
+	is->current = ch;
+
+	if (ch == '\n') {
+		is->lineno++;
+		is->last_linepos = is->linepos;
+		is->linepos = 0;
+	}
+	else
+		is->linepos++;
+
+	return ch;
+}
+
+static inline int input_step_back(struct input_state *is)
+{
+	if (is->cur == is->begin)
+		return 0;
+	is->cur--;
+	if (is->current == '\n') {
+		is->lineno--;
+		is->linepos = 0;
+	}
+	else
+		is->linepos--;
+
+	return 1;
+}
+
+/* Consumes every char until "to" (exclusive) as input_next() would, when
+ * it is known that there are no newlines in the way */
+static inline void input_skip_line(struct input_state *is, const char *to)
+{
+	size_t n = to - is->cur;
+
+	if (!n)
+		return;
+	is->last = n > 1 ? (unsigned char) to[-2] : is->current;
+	is->current = (unsigned char) to[-1];
+	is->first = 0;
+	is->linepos += n;
+	is->cur = to;
+}
 
 #endif
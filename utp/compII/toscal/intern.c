@@ -0,0 +1,84 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "intern.h"
+#include "hash.h"
+
+struct intern_pool *init_intern_pool()
+{
+	struct intern_pool *pool;
+
+	pool = (struct intern_pool*) malloc(sizeof(struct intern_pool));
+	if (!pool)
+		return NULL;
+
+	pool->allocated = INTERN_INITIAL_IDENTS;
+	pool->entries = (struct intern_entry*) malloc(pool->allocated
+			* sizeof(struct intern_entry));
+	if (!pool->entries)
+		goto error_entries;
+	/* the id 0 is never used */
+	pool->entries[0].name = "";
+	pool->entries[0].size = 0;
+	pool->entries[0].hash = 0;
+	pool->count = 1;
+
+	pool->index = hash_init(INTERN_INITIAL_IDENTS);
+	if (!pool->index)
+		goto error_index;
+
+	return pool;
+
+error_index:
+	free(pool->entries);
+error_entries:
+	free(pool);
+	return NULL;
+}
+
+void destroy_intern_pool(struct intern_pool *pool)
+{
+	hash_free(pool->index);
+	free(pool->entries);
+	free(pool);
+}
+
+/** Returns the id of the name, adding it to the pool if it wasn't seen
+ * before. Returns 0 when there is no memory left.
+ */
+ident_t intern_string(struct intern_pool *pool, const char *name,
+		size_t size)
+{
+	unsigned int hash;
+	ident_t id;
+	struct intern_entry *entry, *entries;
+	struct hash_entry *stored;
+
+	hash = get_hash(name, size);
+	id = (ident_t) (size_t) hash_get(pool->index, name, size, hash);
+	if (id)
+		return id;
+
+	if (pool->count == pool->allocated) {
+		entries = (struct intern_entry*) realloc(pool->entries,
+				pool->allocated * 2 * sizeof(struct intern_entry));
+		if (!entries)
+			return 0;
+		pool->entries = entries;
+		pool->allocated *= 2;
+	}
+
+	id = pool->count;
+	stored = hash_put(pool->index, name, size, (void*) (size_t) id, hash);
+	if (!stored)
+		return 0;
+
+	/* the index keeps its copy of the name until it is freed */
+	entry = &pool->entries[id];
+	entry->name = stored->key;
+	entry->size = size;
+	entry->hash = hash;
+	pool->count++;
+
+	return id;
+}
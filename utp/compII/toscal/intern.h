@@ -0,0 +1,41 @@
+#ifndef inc_intern_h
+#define inc_intern_h
+
+#include <stddef.h>
+
+#include "hash.h"
+
+/* The identifiers of the source are stored only once in the intern pool,
+ * the rest of the compiler refers to them by their ident_t.
+ *
+ * The ids are dense and start at 1, 0 means "no identifier". Two names are
+ * equal if and only if their ids are equal.
+ */
+typedef unsigned int ident_t;
+
+#define INTERN_INITIAL_IDENTS	256
+
+struct intern_entry {
+	const char *name;	/* the key stored by the index */
+	size_t size;
+	unsigned int hash;	/* get_hash() of the name */
+};
+
+struct intern_pool {
+	struct intern_entry *entries;	/* indexed by ident_t */
+	size_t count;			/* including the unused entry 0 */
+	size_t allocated;
+
+	struct hash_table *index;	/* name -> ident_t */
+};
+
+struct intern_pool *init_intern_pool();
+void destroy_intern_pool(struct intern_pool *pool);
+ident_t intern_string(struct intern_pool *pool, const char *name,
+		size_t size);
+
+#define intern_name(pool, id)	((pool)->entries[id].name)
+#define intern_size(pool, id)	((pool)->entries[id].size)
+#define intern_hash(pool, id)	((pool)->entries[id].hash)
+
+#endif /* inc_intern_h */
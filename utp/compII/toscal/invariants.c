@@ -0,0 +1,438 @@
+/** invariants.c
+ *
+ * A value computed in a loop only from variables the loop doesn't change
+ * is computed once before it, kept in one more room after the locals
+ * (like the inlined calls) and loaded in the loop. The code of an
+ * expression is postfix, so following the loop with a stack of the values
+ * finds where each one starts.
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "invariants.h"
+#include "opcodes.h"
+
+#define ERROR	0
+#define OK	1
+
+/* a value on the stack while the code of the loop is followed */
+struct loop_value {
+	int invariant;
+	int loads;	/* of variables in its code */
+	size_t start;	/* where its code starts */
+};
+
+/* a value moved out of the loop, the code in [start, end) */
+struct loop_invariant {
+	size_t start;
+	size_t end;
+	int shared;	/* the same code came before */
+	struct codegen_object temp;
+};
+
+struct loop_state {
+	struct codegen_state *cs;
+	size_t start;
+	size_t end;
+	int calls;	/* CHPR or ARMI, only the locals not passed by
+			 * reference are safe */
+	int deeper;	/* calls of the procedures inside this one, nothing
+			 * is safe */
+	int stores;	/* ARMZ of what a reference may point to */
+	struct loop_value *stack;
+	size_t depth;
+	struct loop_invariant *found;
+	size_t nfound;
+};
+
+/* the address of the local b is passed somewhere in this procedure */
+static int loop_escaped(struct loop_state *ls, int b)
+{
+	struct codegen_state *cs = ls->cs;
+	size_t i;
+
+	for (i = cs->temps_at; i < ls->end; i++)
+		if (cs->code[i].op == MEPA_CREN && cs->code[i].a == cs->temps_k
+				&& cs->code[i].b == b)
+			return 1;
+	return 0;
+}
+
+/* the loop stores to the variable */
+static int loop_stored(struct loop_state *ls, int a, int b)
+{
+	struct codegen_inst *inst;
+	size_t i;
+
+	for (i = ls->start; i < ls->end; i++) {
+		inst = &ls->cs->code[i];
+		if ((inst->op == MEPA_ARMZ || inst->op == MEPA_ARMC)
+				&& inst->a == a && inst->b == b)
+			return 1;
+	}
+	return 0;
+}
+
+/* the CRVL or CRVI loads the same value in every iteration */
+static int loop_invariant_load(struct loop_state *ls,
+		struct codegen_inst *inst)
+{
+	if (ls->deeper)
+		return 0;
+	if (inst->op == MEPA_CRVI && (ls->calls || ls->stores))
+		return 0;
+	if (inst->a == ls->cs->temps_k) {
+		if (ls->calls && loop_escaped(ls, inst->b))
+			return 0;
+	}
+	else if (ls->calls)
+		return 0;
+	return !loop_stored(ls, inst->a, inst->b);
+}
+
+/* The first pass: what the calls and the stores may change. Returns 0 for
+ * the loops that can be entered from outside (the goto labels). */
+static int loop_scan(struct loop_state *ls)
+{
+	struct codegen_state *cs = ls->cs;
+	struct codegen_inst *inst;
+	size_t target;
+
+	for (inst = &cs->code[ls->start]; inst < &cs->code[ls->end]; inst++)
+		switch (inst->op) {
+		case MEPA_ENRT:
+			return 0;
+		case MEPA_LABEL:
+			if (cs->labels[inst->label].kind == CODEGEN_LABEL_USER)
+				return 0;
+			break;
+		case MEPA_ARMI:
+			ls->calls = 1;
+			break;
+		case MEPA_CHPR:
+			ls->calls = 1;
+			target = cs->labels[inst->label].target;
+			if (target == CODEGEN_NO_TARGET
+					|| target + 1 >= cs->ninsts
+					|| cs->code[target + 1].op != MEPA_ENPR
+					|| cs->code[target + 1].a
+						> cs->temps_k)
+				ls->deeper = 1;
+			break;
+		case MEPA_ARMZ:
+		case MEPA_ARMC:
+			if (inst->a != cs->temps_k
+					|| loop_escaped(ls, inst->b))
+				ls->stores = 1;
+			break;
+		default:
+			break;
+		}
+
+	return 1;
+}
+
+/* the value is moved out when it loads something and computes something
+ * with it, its code ends at end */
+static int loop_keep(struct loop_state *ls, struct loop_value *value,
+		size_t end)
+{
+	struct loop_invariant *found;
+
+	if (!value->invariant || !value->loads || end - value->start < 2)
+		return OK;
+
+	found = (struct loop_invariant*) realloc(ls->found,
+			(ls->nfound + 1) * sizeof(struct loop_invariant));
+	if (!found) {
+		codegen_set_error(ls->cs, CODEGEN_NO_MEMORY);
+		return ERROR;
+	}
+	ls->found = found;
+	found[ls->nfound].start = value->start;
+	found[ls->nfound].end = end;
+	ls->nfound++;
+
+	return OK;
+}
+
+static void loop_push(struct loop_state *ls, int invariant, int loads,
+		size_t start)
+{
+	ls->stack[ls->depth].invariant = invariant;
+	ls->stack[ls->depth].loads = loads;
+	ls->stack[ls->depth].start = start;
+	ls->depth++;
+}
+
+/* the values below the loop are not known */
+static struct loop_value loop_pop(struct loop_state *ls)
+{
+	struct loop_value none = { 0, 0, 0 };
+
+	if (!ls->depth)
+		return none;
+	return ls->stack[--ls->depth];
+}
+
+/* the values on the stack are used by something that stays in the loop */
+static int loop_keep_all(struct loop_state *ls, size_t end)
+{
+	int ret = OK;
+
+	while (ret && ls->depth) {
+		ls->depth--;
+		ret = loop_keep(ls, &ls->stack[ls->depth], end);
+		end = ls->stack[ls->depth].start;
+	}
+
+	return ret;
+}
+
+/* the divisions that never fail */
+static int loop_safe_division(struct loop_state *ls, size_t pos,
+		struct loop_value *divisor)
+{
+	struct codegen_inst *inst = &ls->cs->code[pos - 1];
+
+	return divisor->start == pos - 1 && inst->op == MEPA_CRCT
+		&& inst->a != 0 && inst->a != -1;
+}
+
+/* The second pass: the values of the loop, finding the largest invariant
+ * ones */
+static int loop_values(struct loop_state *ls)
+{
+	struct codegen_inst *inst;
+	struct loop_value left, right;
+	size_t i, n;
+	int ret = OK;
+
+	for (i = ls->start; ret && i < ls->end; i++) {
+		inst = &ls->cs->code[i];
+		switch (inst->op) {
+		case MEPA_CRCT:
+			loop_push(ls, 1, 0, i);
+			break;
+		case MEPA_CRVL:
+		case MEPA_CRVI:
+			loop_push(ls, loop_invariant_load(ls, inst), 1, i);
+			break;
+		case MEPA_CREN:
+		case MEPA_LEIT:
+			loop_push(ls, 0, 0, i);
+			break;
+		case MEPA_AMEM:
+			for (n = 0; n < (size_t) inst->a; n++)
+				loop_push(ls, 0, 0, i);
+			break;
+		case MEPA_INVR:
+		case MEPA_NEGA:
+			right = loop_pop(ls);
+			loop_push(ls, right.invariant, right.loads,
+					right.start);
+			break;
+		case MEPA_ARMC:
+			right = loop_pop(ls);
+			ret = loop_keep(ls, &right, i);
+			loop_push(ls, 0, 0, right.start);
+			break;
+		case MEPA_SOMA:
+		case MEPA_SUBT:
+		case MEPA_MULT:
+		case MEPA_DIVI:
+		case MEPA_MODU:
+		case MEPA_CONJ:
+		case MEPA_DISJ:
+		case MEPA_CMME:
+		case MEPA_CMMA:
+		case MEPA_CMIG:
+		case MEPA_CMDG:
+		case MEPA_CMEG:
+		case MEPA_CMAG:
+			right = loop_pop(ls);
+			left = loop_pop(ls);
+			if ((inst->op == MEPA_DIVI || inst->op == MEPA_MODU)
+					&& !loop_safe_division(ls, i, &right))
+				right.invariant = 0;
+			if (left.invariant && right.invariant) {
+				loop_push(ls, 1, left.loads + right.loads,
+						left.start);
+				break;
+			}
+			ret = loop_keep(ls, &left, right.start)
+				&& loop_keep(ls, &right, i);
+			loop_push(ls, 0, 0, left.start);
+			break;
+		case MEPA_ARMZ:
+		case MEPA_ARMI:
+		case MEPA_IMPR:
+		case MEPA_DSVF:
+			right = loop_pop(ls);
+			ret = loop_keep(ls, &right, i);
+			break;
+		case MEPA_DMEM:
+			for (n = 0; ret && n < (size_t) inst->a; n++) {
+				right = loop_pop(ls);
+				ret = loop_keep(ls, &right, i);
+			}
+			break;
+		case MEPA_LABEL:
+			/* the values reach it from other places */
+			for (n = 0; n < ls->depth; n++)
+				ls->stack[n].invariant = 0;
+			break;
+		default:
+			if (mepa_opcodes[inst->op].operands == MEPA_OPND_PSEUDO
+					|| inst->op == MEPA_DSVS
+					|| inst->op == MEPA_NADA)
+				break;
+			/* the calls and the fused compares and jumps */
+			ret = loop_keep_all(ls, i);
+			break;
+		}
+	}
+
+	return ret;
+}
+
+/* the code of both values is the same */
+static int loop_same_code(struct codegen_state *cs, struct loop_invariant *x,
+		struct loop_invariant *y)
+{
+	size_t i;
+
+	if (x->end - x->start != y->end - y->start)
+		return 0;
+	for (i = 0; i < x->end - x->start; i++)
+		if (cs->code[x->start + i].op != cs->code[y->start + i].op
+				|| cs->code[x->start + i].a
+					!= cs->code[y->start + i].a
+				|| cs->code[x->start + i].b
+					!= cs->code[y->start + i].b)
+			return 0;
+	return 1;
+}
+
+/* The values found, in the order of their code, get their room; the same
+ * code shares it. Then the loop is moved out and generated again after
+ * the code of the values, like in codegen_tail_calls(). */
+static int loop_move_out(struct loop_state *ls)
+{
+	struct codegen_state *cs = ls->cs;
+	struct loop_invariant *found = ls->found, *f, swap;
+	struct codegen_inst *saved, *inst;
+	size_t count, i, j;
+	int ret = OK;
+
+	for (i = 1; i < ls->nfound; i++)
+		for (j = i; j > 0 && found[j - 1].start > found[j].start; j--) {
+			swap = found[j];
+			found[j] = found[j - 1];
+			found[j - 1] = swap;
+		}
+	for (i = 0; i < ls->nfound; i++) {
+		for (j = 0; j < i; j++)
+			if (loop_same_code(cs, &found[j], &found[i]))
+				break;
+		found[i].shared = j < i;
+		if (found[i].shared) {
+			found[i].temp = found[j].temp;
+			continue;
+		}
+		found[i].temp.type = CODEGEN_OBJ_INT;
+		found[i].temp.scope = CODEGEN_SCOPE_LOCAL;
+		found[i].temp.k = cs->temps_k;
+		found[i].temp.index = cs->temps_base + cs->ntemps++;
+		found[i].temp.ref = 0;
+		found[i].temp.address = 0;
+	}
+
+	count = ls->end - ls->start;
+	saved = (struct codegen_inst*) malloc(count
+			* sizeof(struct codegen_inst));
+	if (!saved) {
+		codegen_set_error(cs, CODEGEN_NO_MEMORY);
+		return ERROR;
+	}
+	memcpy(saved, &cs->code[ls->start],
+			count * sizeof(struct codegen_inst));
+	cs->ninsts = ls->start;
+
+	for (f = found; ret && f < found + ls->nfound; f++) {
+		if (f->shared)
+			continue;
+		for (i = f->start; ret && i < f->end; i++) {
+			inst = &saved[i - ls->start];
+			ret = codegen_emit(cs, inst->op, inst->a, inst->b,
+					inst->label, inst->note);
+		}
+		ret = ret && codegen_store_object(cs, &f->temp);
+	}
+
+	f = found;
+	for (i = ls->start; ret && i < ls->end; i++) {
+		inst = &saved[i - ls->start];
+		if (f < found + ls->nfound && f->start == i) {
+			ret = codegen_fetch_object(cs, &f->temp);
+			i = f->end - 1;
+			f++;
+		}
+		else if (inst->op == MEPA_LABEL)
+			ret = codegen_place_label(cs, inst->label, inst->note);
+		else
+			ret = codegen_emit(cs, inst->op, inst->a, inst->b,
+					inst->label, inst->note);
+	}
+	free(saved);
+
+	return ret;
+}
+
+/** The loop starts at the label, its code ends here */
+int codegen_loop_invariants(struct codegen_state *cs, size_t label)
+{
+	struct loop_state ls;
+	size_t size, i, kept;
+	int ret = OK;
+
+	if (!cs->loop_invariants || !cs->out)
+		return OK;
+	memset(&ls, 0, sizeof(ls));
+	ls.cs = cs;
+	ls.start = cs->labels[label].target;
+	ls.end = cs->ninsts;
+	if (ls.start == CODEGEN_NO_TARGET || ls.start < cs->written
+			|| ls.start < cs->temps_at || !loop_scan(&ls)
+			|| ls.deeper)
+		return OK;
+
+	/* each instruction pushes one value at most, but AMEM */
+	size = ls.end - ls.start;
+	for (i = ls.start; i < ls.end; i++)
+		if (cs->code[i].op == MEPA_AMEM)
+			size += cs->code[i].a;
+	ls.stack = (struct loop_value*) malloc(size
+			* sizeof(struct loop_value));
+	if (!ls.stack) {
+		codegen_set_error(cs, CODEGEN_NO_MEMORY);
+		return ERROR;
+	}
+	ret = loop_values(&ls);
+	if (ret && ls.nfound) {
+		ret = loop_move_out(&ls);
+		/* the positions kept in the loop are gone */
+		for (i = kept = 0; i < cs->ntails; i++)
+			if (cs->tails[i].at < ls.start)
+				cs->tails[kept++] = cs->tails[i];
+		cs->ntails = kept;
+		for (i = kept = 0; i < cs->nbools; i++)
+			if (cs->bools[i].at < ls.start)
+				cs->bools[kept++] = cs->bools[i];
+		cs->nbools = kept;
+	}
+	free(ls.stack);
+	free(ls.found);
+
+	return ret;
+}
@@ -0,0 +1,14 @@
+/** The loop invariants, with -floop-invariants: the values a loop computes
+ * again in every iteration are computed before it (see
+ * codegen_while_epilog() and codegen_repeat_eval()).
+ */
+#ifndef inc_invariants_h
+#define inc_invariants_h
+
+#include <stddef.h>
+
+#include "codegen.h"
+
+int codegen_loop_invariants(struct codegen_state *cs, size_t label);
+
+#endif /* inc_invariants_h */
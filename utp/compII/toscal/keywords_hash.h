@@ -0,0 +1,23 @@
+/* Generated by mkkeywords.py from the keywords[] table of tokenize.h,
+ * don't edit it by hand. */
+#ifndef inc_keywords_hash_h
+#define inc_keywords_hash_h
+
+#define KEYWORD_MIN_LEN	2
+#define KEYWORD_MAX_LEN	9
+#define KEYWORD_HASH_SIZE	32
+
+#define KEYWORD_HASH(first, second, last, len) \
+	((((unsigned char) (first)) * 11 \
+	  + ((unsigned char) (second)) * 4 \
+	  + ((unsigned char) (last)) * 6 + (len)) & (KEYWORD_HASH_SIZE - 1))
+
+/* index + 1 into keywords[], 0 for empty slots */
+static const unsigned char keyword_slots[KEYWORD_HASH_SIZE] = {
+	14, 11, 0, 3, 15, 2, 23, 18,
+	22, 13, 4, 0, 17, 1, 0, 0,
+	0, 7, 20, 0, 12, 9, 21, 8,
+	16, 0, 10, 5, 0, 0, 6, 19,
+};
+
+#endif /* inc_keywords_hash_h */
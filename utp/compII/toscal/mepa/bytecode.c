@@ -0,0 +1,249 @@
+/** bytecode.c
+ *
+ * Loads the programs written by toscal -b (see bytecode.h). The file is
+ * mmap()ed when it can be, and each record only has its fields copied to
+ * the instruction, the jumps are already resolved.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "vm.h"
+#include "bytecode.h"
+
+#define ERROR	0
+#define OK	1
+
+#define READ_CHUNK	65536
+
+struct image {
+	const unsigned char *data;
+	size_t size;
+	void *base;		/* what was mapped or allocated */
+	size_t base_size;
+	int mapped;
+};
+
+static int map_image(struct image *img, FILE *source)
+{
+#ifndef _WIN32
+	struct stat st;
+	void *addr;
+	off_t offset;
+	int fd;
+
+	fd = fileno(source);
+	if (fd == -1 || fstat(fd, &st) == -1 || !S_ISREG(st.st_mode)
+			|| st.st_size == 0)
+		return 0;
+
+	/* someone may have already read part of it (and ungetc()) */
+	offset = ftello(source);
+	if (offset < 0 || offset > st.st_size)
+		return 0;
+
+	addr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (addr == MAP_FAILED)
+		return 0; /* let the slow path try it */
+
+	img->base = addr;
+	img->base_size = st.st_size;
+	img->data = (const unsigned char*) addr + offset;
+	img->size = st.st_size - offset;
+	img->mapped = 1;
+
+	return 1;
+#else
+	return 0;
+#endif
+}
+
+static int read_image(struct image *img, FILE *source)
+{
+	unsigned char *buf = NULL, *newbuf;
+	size_t size = 0, allocated = 0, readed;
+
+	while (1) {
+		if (allocated - size < READ_CHUNK) {
+			allocated = allocated ? allocated * 2 : READ_CHUNK;
+			newbuf = (unsigned char*) realloc(buf, allocated);
+			if (!newbuf)
+				goto error;
+			buf = newbuf;
+		}
+		readed = fread(buf + size, 1, allocated - size, source);
+		size += readed;
+		if (readed == 0) {
+			if (ferror(source))
+				goto error;
+			break;
+		}
+	}
+
+	img->base = buf;
+	img->base_size = allocated;
+	img->data = buf;
+	img->size = size;
+	img->mapped = 0;
+
+	return 1;
+error:
+	free(buf);
+	return 0;
+}
+
+static void close_image(struct image *img)
+{
+#ifndef _WIN32
+	if (img->mapped) {
+		munmap(img->base, img->base_size);
+		return;
+	}
+#endif
+	free(img->base);
+}
+
+static int bad_bytecode(const char *name, const char *message,
+		unsigned long what)
+{
+	fprintf(stderr, "%s: invalid bytecode: %s %lu\n", name, message, what);
+	return ERROR;
+}
+
+/* the stack section, in the size left after the instructions */
+static int decode_stack(struct vm_program *prog, const unsigned char *data,
+		size_t size, const char *name)
+{
+	struct vm_procedure *proc;
+	uint32_t count, i;
+
+	if (size < sizeof(struct mepa_bc_stack))
+		return bad_bytecode(name, "wrong size for the stack section",
+				(unsigned long) size);
+	count = mepa_bc_get32(data + 4);
+	if ((size - sizeof(struct mepa_bc_stack))
+			/ sizeof(struct mepa_bc_proc) != count
+			|| (size - sizeof(struct mepa_bc_stack))
+			% sizeof(struct mepa_bc_proc))
+		return bad_bytecode(name, "wrong size for procedures", count);
+
+	prog->stack_words = mepa_bc_get32(data);
+	prog->procs = (struct vm_procedure*) malloc((count ? count : 1)
+			* sizeof(struct vm_procedure));
+	if (!prog->procs) {
+		fprintf(stderr, "%s: out of memory\n", name);
+		return ERROR;
+	}
+	data += sizeof(struct mepa_bc_stack);
+	for (i = 0; i < count; i++, data += sizeof(struct mepa_bc_proc)) {
+		proc = &prog->procs[i];
+		proc->entry = mepa_bc_get32(data);
+		proc->frame = (int32_t) mepa_bc_get32(data + 4);
+		proc->depth = (int32_t) mepa_bc_get32(data + 8);
+		proc->params = (int32_t) mepa_bc_get32(data + 12);
+		/* in the order of the code */
+		if (proc->entry >= prog->count
+				|| (i && proc->entry <= proc[-1].entry))
+			return bad_bytecode(name, "invalid entry for procedure",
+					i);
+	}
+	prog->nprocs = count;
+
+	return OK;
+}
+
+static int decode(struct vm_program *prog, const struct image *img,
+		const char *name)
+{
+	const unsigned char *record;
+	struct vm_inst *inst;
+	uint32_t version, count, flags, op, i;
+	enum mepa_operands operands;
+	size_t size;
+
+	if (img->size < sizeof(struct mepa_bc_header)
+			|| memcmp(img->data, MEPA_BC_MAGIC,
+				MEPA_BC_MAGIC_SIZE) != 0) {
+		fprintf(stderr, "%s: not a MEPA bytecode file\n", name);
+		return ERROR;
+	}
+	version = mepa_bc_get32(img->data + 4);
+	if (version != MEPA_BC_VERSION)
+		return bad_bytecode(name, "unsupported version", version);
+	count = mepa_bc_get32(img->data + 8);
+	flags = mepa_bc_get32(img->data + 12);
+	if (flags & ~MEPA_BC_FLAGS)
+		return bad_bytecode(name, "unknown flags", flags);
+	/* the instructions, then what is left for the stack section */
+	size = img->size - sizeof(struct mepa_bc_header);
+	if (size / sizeof(struct mepa_bc_inst) < count
+			|| (!(flags & MEPA_BC_STACK)
+				&& size != (size_t) count
+				* sizeof(struct mepa_bc_inst)))
+		return bad_bytecode(name, "wrong size for instructions",
+				count);
+	size -= (size_t) count * sizeof(struct mepa_bc_inst);
+
+	record = img->data + sizeof(struct mepa_bc_header);
+	for (i = 0; i < count; i++, record += sizeof(struct mepa_bc_inst)) {
+		op = mepa_bc_get32(record);
+		if (op >= MEPA__COUNT || mepa_opcodes[op].operands
+				== MEPA_OPND_PSEUDO)
+			return bad_bytecode(name, "unknown opcode at", i);
+
+		vm_warn_extension(prog, op, mepa_opcodes[op].mnemonic);
+		inst = vm_program_add(prog, op);
+		if (!inst) {
+			fprintf(stderr, "%s: out of memory\n", name);
+			return ERROR;
+		}
+		inst->a = (int32_t) mepa_bc_get32(record + 4);
+		inst->b = (int32_t) mepa_bc_get32(record + 8);
+		inst->c = (int32_t) mepa_bc_get32(record + 12);
+
+		operands = mepa_opcodes[op].operands;
+		if ((operands == MEPA_OPND_L || operands == MEPA_OPND_LA
+					|| operands == MEPA_OPND_LAB)
+				&& (inst->a < 0 || inst->a > (long) count))
+			return bad_bytecode(name, "invalid jump at", i);
+		if (!vm_valid_levels(inst))
+			return bad_bytecode(name, "invalid lexical level at", i);
+	}
+
+	if ((flags & MEPA_BC_STACK) && !decode_stack(prog, record, size,
+				name))
+		return ERROR;
+
+	if (!vm_program_end(prog)) {
+		fprintf(stderr, "%s: out of memory\n", name);
+		return ERROR;
+	}
+
+	return OK;
+}
+
+/** Loads the program in the bytecode format from source, reporting the
+ * errors with its name.
+ *
+ * prog must be initialized and empty.
+ */
+int vm_load_bytecode(struct vm_program *prog, FILE *source, const char *name)
+{
+	struct image img;
+	int ret;
+
+	if (!map_image(&img, source) && !read_image(&img, source)) {
+		fprintf(stderr, "%s: %s\n", name, strerror(errno));
+		return ERROR;
+	}
+	ret = decode(prog, &img, name);
+	close_image(&img);
+
+	return ret;
+}
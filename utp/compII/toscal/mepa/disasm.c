@@ -0,0 +1,95 @@
+/** disasm.c
+ *
+ * Writes a loaded program back in the text format, with a label "L<n>"
+ * before each instruction n that is the target of a jump, and the use of
+ * the stack of the bytecode as comments, like toscal -s writes them.
+ */
+#include <stdlib.h>
+
+#include "vm.h"
+
+#define ERROR	0
+#define OK	1
+
+/* before the first instruction of the procedure */
+static void write_stack(struct vm_program *prog, struct vm_procedure *proc,
+		FILE *out)
+{
+	fprintf(out, "\t\t; stack: frame %ld, depth ", proc->frame);
+	if (proc->depth < 0)
+		fputs("unknown", out);
+	else
+		fprintf(out, "%ld", proc->depth);
+	if (proc->params >= 0)
+		fprintf(out, ", params %ld", proc->params);
+	/* the main block also tells the most of the whole program */
+	if (proc == prog->procs && prog->stack_words)
+		fprintf(out, ", total %lu",
+				(unsigned long) prog->stack_words);
+	else if (proc == prog->procs)
+		fputs(", total unbounded", out);
+	fputc('\n', out);
+}
+
+static int is_jump(enum mepa_operands operands)
+{
+	return operands == MEPA_OPND_L || operands == MEPA_OPND_LA
+		|| operands == MEPA_OPND_LAB;
+}
+
+/** Writes prog as MEPA assembly to out */
+int vm_write_text(struct vm_program *prog, FILE *out)
+{
+	const struct mepa_opcode_info *info;
+	struct vm_inst *inst;
+	struct vm_procedure *proc;
+	unsigned char *targets;
+	size_t i;
+
+	/* the end of the program can be a target too */
+	targets = (unsigned char*) calloc(prog->count + 1, 1);
+	if (!targets)
+		return ERROR;
+	for (i = 0; i < prog->count; i++)
+		if (is_jump(mepa_opcodes[prog->code[i].op].operands))
+			targets[prog->code[i].a] = 1;
+
+	proc = prog->procs;
+	for (i = 0; i <= prog->count; i++) {
+		if (targets[i])
+			fprintf(out, "L%lu:\n", (unsigned long) i);
+		if (i == prog->count)
+			break;
+		/* the loaders keep them in the order of the code */
+		if (proc < prog->procs + prog->nprocs && proc->entry == i)
+			write_stack(prog, proc++, out);
+
+		inst = &prog->code[i];
+		info = &mepa_opcodes[inst->op];
+		fputs(info->mnemonic, out);
+		switch (info->operands) {
+		case MEPA_OPND_A:
+			fprintf(out, " %ld", inst->a);
+			break;
+		case MEPA_OPND_AB:
+			fprintf(out, " %ld, %ld", inst->a, inst->b);
+			break;
+		case MEPA_OPND_L:
+			fprintf(out, " L%ld", inst->a);
+			break;
+		case MEPA_OPND_LA:
+			fprintf(out, " L%ld, %ld", inst->a, inst->b);
+			break;
+		case MEPA_OPND_LAB:
+			fprintf(out, " L%ld, %ld, %ld", inst->a, inst->b,
+					inst->c);
+			break;
+		default:
+			break;
+		}
+		fputc('\n', out);
+	}
+	free(targets);
+
+	return !ferror(out);
+}
@@ -0,0 +1,101 @@
+#include <stdio.h>
+#include <string.h>
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#endif
+
+#include "vm.h"
+#include "bytecode.h"
+
+/* either toscal -b output or the text */
+static int load(struct vm_program *prog, FILE *source, const char *path)
+{
+	int c;
+
+	c = getc(source);
+	if (c != EOF)
+		ungetc(c, source);
+	if (c == (unsigned char) MEPA_BC_MAGIC[0])
+		return vm_load_bytecode(prog, source, path);
+	return vm_load_text(prog, source, path);
+}
+
+static int run_file(const char *path, int disassemble)
+{
+	struct vm_program prog;
+	struct vm_state vm;
+	FILE *source;
+	int ok = 0;
+
+	if (strcmp(path, "-") == 0) {
+		source = stdin;
+#ifdef _WIN32
+		_setmode(_fileno(stdin), _O_BINARY);
+#endif
+	}
+	else {
+		source = fopen(path, "rb");
+		if (!source) {
+			perror(path);
+			return 0;
+		}
+	}
+
+	if (!init_vm_program(&prog)) {
+		perror("allocating the program");
+		goto failed;
+	}
+	/* the warnings aren't part of the program */
+	if (disassemble)
+		prog.warnings = stderr;
+	if (!load(&prog, source, path))
+		goto loaded;
+
+	if (disassemble) {
+		ok = vm_write_text(&prog, stdout);
+		if (!ok)
+			perror("writing the program");
+		goto loaded;
+	}
+
+	memset(&vm, 0, sizeof(vm));
+	vm.in = stdin;
+	vm.out = stdout;
+	ok = vm_run(&vm, &prog);
+	if (!ok) {
+		fprintf(stderr, "%s: ", path);
+		vm_dump_error(&vm, &prog, stderr);
+	}
+
+loaded:
+	destroy_vm_program(&prog);
+failed:
+	if (source != stdin)
+		fclose(source);
+
+	return ok;
+}
+
+int main(int argc, char *argv[])
+{
+	int i = 1;
+	int disassemble = 0;
+
+	if (argc > 1 && strcmp(argv[1], "-d") == 0) {
+		disassemble = 1;
+		i++;
+	}
+	if (i == argc) {
+		fprintf(stderr, "usage: %s [-d] <file>... (- for stdin)\n"
+				"  -d  writes the programs as text instead of "
+				"running them\n", argv[0]);
+		return 2;
+	}
+
+	for (; i < argc; i++)
+		if (!run_file(argv[i], disassemble))
+			return 1;
+
+	return 0;
+}
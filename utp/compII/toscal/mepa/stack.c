@@ -0,0 +1,242 @@
+/** stack.c
+ *
+ * Finds the instructions that push without looking at the size of the
+ * stack. Each procedure, the code from the start of the program or from
+ * where a CHPR goes, is walked following its jumps with the words pushed
+ * since it was entered before each instruction, like toscal does (see
+ * stackdepth.c); the most of them is its room. When the stack has that
+ * room over the top it had at the entry, no instruction of the procedure
+ * can get past its end, as the paths to each instruction agree on the
+ * words pushed.
+ *
+ * So vm_run() looks at the size only where the code gets into a procedure
+ * other than by its own code: CHPR makes room for the procedure it calls,
+ * and RTPR, DSVR and ENRT (which sets the top) for the instruction they
+ * go to, with the room left at it. A procedure is left out, with -1 in
+ * all its instructions, when its paths don't agree, when another one
+ * shares its code or when other code falls or jumps into it, and also
+ * when its room is above VM_MAX_ROOM.
+ */
+#include <stdlib.h>
+
+#include "vm.h"
+
+#define ERROR	0
+#define OK	1
+
+#define NONE	((size_t) -1)
+
+struct walk {
+	struct vm_program *prog;
+	size_t *owner;		/* the entry of the procedure of each one */
+	long *depth;		/* the words pushed before it */
+	long *most;		/* of each entry */
+	long *params;		/* of each entry, -2 until found */
+	unsigned char *bad;	/* the entries left out */
+	size_t *work;
+	size_t nwork;
+};
+
+/* the instructions coming next to inst with no look at the size (the
+ * return of a CHPR and what follows ENRT are looked at), NONE when there
+ * is none */
+static void next_of(struct vm_program *prog, size_t i, size_t *next,
+		size_t *jump)
+{
+	struct vm_inst *inst = &prog->code[i];
+
+	*next = i + 1;
+	*jump = NONE;
+	switch (inst->op) {
+	case MEPA_PARA: case MEPA_RTPR: case MEPA_DSVR: case MEPA_CHPR:
+	case MEPA_ENRT:
+		*next = NONE;
+		break;
+	case MEPA_DSVS:
+		*next = NONE;
+		*jump = inst->a;
+		break;
+	case MEPA_DSVF:
+	case MEPA_DSIG: case MEPA_DSDG: case MEPA_DSMA:
+	case MEPA_DSAG: case MEPA_DSME: case MEPA_DSEG:
+		*jump = inst->a;
+		break;
+	default:
+		break;
+	}
+	/* the PARA after the end pushes nothing */
+	if (*next >= prog->count)
+		*next = NONE;
+	if (*jump >= prog->count)
+		*jump = NONE;
+}
+
+/* the params taken out by the RTPR of the procedure at entry, -1 when it
+ * has none before the next procedure */
+static long params_of(struct walk *w, size_t entry)
+{
+	struct vm_program *prog = w->prog;
+	size_t i;
+
+	if (entry >= prog->count)
+		return -1;
+	if (w->params[entry] != -2)
+		return w->params[entry];
+	w->params[entry] = -1;
+	for (i = entry; i < prog->count; i++) {
+		if (i > entry && w->owner[i] == i)
+			break;
+		if (prog->code[i].op == MEPA_RTPR) {
+			w->params[entry] = prog->code[i].b;
+			break;
+		}
+	}
+
+	return w->params[entry];
+}
+
+static void visit(struct walk *w, size_t entry, size_t i, long depth)
+{
+	if (i == NONE)
+		return;
+	if (w->owner[i] == NONE) {
+		w->owner[i] = entry;
+		w->depth[i] = depth;
+		w->work[w->nwork++] = i;
+	}
+	else if (w->owner[i] != entry) {
+		w->bad[entry] = 1;
+		w->bad[w->owner[i]] = 1;
+	}
+	else if (w->depth[i] != depth)
+		w->bad[entry] = 1;
+}
+
+static void walk_procedure(struct walk *w, size_t entry)
+{
+	struct vm_program *prog = w->prog;
+	struct vm_inst *inst;
+	size_t i, next, jump;
+	long depth, after, most = 0;
+
+	w->nwork = 0;
+	w->work[w->nwork++] = entry;
+	w->depth[entry] = 0;
+	while (w->nwork) {
+		i = w->work[--w->nwork];
+		inst = &prog->code[i];
+		depth = w->depth[i];
+		after = depth + mepa_opcodes[inst->op].stack;
+		next_of(prog, i, &next, &jump);
+
+		switch (inst->op) {
+		case MEPA_AMEM:
+			/* the operand goes over the top */
+			after = depth + inst->a;
+			if (depth + 1 > most)
+				most = depth + 1;
+			break;
+		case MEPA_DMEM:
+			after = depth - inst->a;
+			break;
+		case MEPA_CHPR:
+			/* it comes back with the params taken out */
+			after = params_of(w, inst->a);
+			if (after >= 0 && i + 1 < prog->count) {
+				after = depth - after;
+				next = i + 1;
+			}
+			else
+				after = depth;
+			break;
+		case MEPA_ENRT:
+			after = inst->b;
+			if (i + 1 < prog->count)
+				next = i + 1;
+			break;
+		default:
+			break;
+		}
+		if (depth > most)
+			most = depth;
+		if (after > most)
+			most = after;
+
+		visit(w, entry, next, after);
+		visit(w, entry, jump, after);
+	}
+	w->most[entry] = most;
+	/* making that much room at the call could fail a program that
+	 * never gets to the instruction needing it */
+	if (most > VM_MAX_ROOM)
+		w->bad[entry] = 1;
+}
+
+/** Fills prog->room, 0 without memory */
+int vm_find_room(struct vm_program *prog)
+{
+	struct walk w;
+	size_t n = prog->count, i, next, jump, owner;
+	int ok = ERROR;
+
+	prog->room = (long*) malloc((n + 1) * sizeof(long));
+	w.prog = prog;
+	w.owner = (size_t*) malloc((n + 1) * sizeof(size_t));
+	w.depth = (long*) malloc((n + 1) * sizeof(long));
+	w.most = (long*) malloc((n + 1) * sizeof(long));
+	w.params = (long*) malloc((n + 1) * sizeof(long));
+	w.bad = (unsigned char*) calloc(n + 1, 1);
+	w.work = (size_t*) malloc((n + 1) * sizeof(size_t));
+	if (!prog->room || !w.owner || !w.depth || !w.most || !w.params
+			|| !w.bad || !w.work)
+		goto done;
+
+	/* the entries own themselves first, so the walks stop at them */
+	for (i = 0; i <= n; i++) {
+		w.owner[i] = NONE;
+		w.params[i] = -2;
+		prog->room[i] = -1;
+	}
+	if (n)
+		w.owner[0] = 0;
+	for (i = 0; i < n; i++)
+		if (prog->code[i].op == MEPA_CHPR
+				&& (size_t) prog->code[i].a < n)
+			w.owner[prog->code[i].a] = prog->code[i].a;
+	for (i = 0; i < n; i++)
+		if (w.owner[i] == i)
+			walk_procedure(&w, i);
+
+	/* the code out of the procedures can only get into one by
+	 * instructions looking at the size */
+	for (i = 0; i < n; i++) {
+		owner = w.owner[i];
+		if (owner != NONE && !w.bad[owner])
+			continue;
+		next_of(prog, i, &next, &jump);
+		if (next != NONE && w.owner[next] != NONE)
+			w.bad[w.owner[next]] = 1;
+		if (jump != NONE && w.owner[jump] != NONE)
+			w.bad[w.owner[jump]] = 1;
+	}
+
+	/* ENRT makes room for what follows once it sets the top, so a DSVR
+	 * going to it needs none */
+	for (i = 0; i < n; i++) {
+		owner = w.owner[i];
+		if (owner != NONE && !w.bad[owner])
+			prog->room[i] = prog->code[i].op == MEPA_ENRT ? 0
+				: w.most[owner] - w.depth[i];
+	}
+	ok = OK;
+
+done:
+	free(w.owner);
+	free(w.depth);
+	free(w.most);
+	free(w.params);
+	free(w.bad);
+	free(w.work);
+
+	return ok;
+}
@@ -0,0 +1,345 @@
+/** text.c
+ *
+ * Loads the MEPA assembly read by mepa.py: one instruction per line, with
+ * its arguments separated by commas, "label:" before an instruction (or
+ * alone in its line) and comments starting with ';'.
+ *
+ * mepa.py pushes every argument to the stack before running the
+ * instruction, which pops the ones it takes, so any extra arguments at the
+ * left stay in the stack as if loaded by CRCT: "cmdg 0" is "crct 0; cmdg".
+ * Those become real CRCTs here, so the jump targets written as numbers
+ * (the position of the instruction in the source) are translated.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <errno.h>
+
+#include "vm.h"
+#include "hash.h"
+
+#define ERROR	0
+#define OK	1
+
+#define MAX_LINE	1024
+#define MAX_ARGS	16
+
+/* a label used before being found */
+struct fixup {
+	size_t inst;
+	unsigned int line;
+	char *name;
+};
+
+struct loader {
+	const char *name;
+	unsigned int line;
+	struct vm_program *prog;
+	struct hash_table *labels;	/* source position + 1 */
+	size_t *positions;	/* source position => instruction */
+	size_t npositions;
+	size_t allocated;
+	struct fixup *fixups;
+	size_t nfixups;
+};
+
+static int load_error(struct loader *ld, const char *message,
+		const char *what)
+{
+	fprintf(stderr, "%s:%u: %s%s%s\n", ld->name, ld->line, message,
+			what ? ": " : "", what ? what : "");
+	return ERROR;
+}
+
+static char *trim(char *s)
+{
+	char *end;
+
+	while (isspace((unsigned char) *s))
+		s++;
+	end = s + strlen(s);
+	while (end > s && isspace((unsigned char) end[-1]))
+		end--;
+	*end = '\0';
+
+	return s;
+}
+
+static int find_opcode(const char *mnemonic)
+{
+	int op;
+
+	for (op = 0; op < MEPA__COUNT; op++)
+		if (mepa_opcodes[op].mnemonic
+				&& strcasecmp(mepa_opcodes[op].mnemonic,
+					mnemonic) == 0)
+			return op;
+	return -1;
+}
+
+static int count_operands(enum mepa_operands operands)
+{
+	switch (operands) {
+	case MEPA_OPND_A:
+	case MEPA_OPND_L:
+		return 1;
+	case MEPA_OPND_AB:
+	case MEPA_OPND_LA:
+		return 2;
+	case MEPA_OPND_LAB:
+		return 3;
+	default:
+		return 0;
+	}
+}
+
+static int is_jump(enum mepa_operands operands)
+{
+	return operands == MEPA_OPND_L || operands == MEPA_OPND_LA
+		|| operands == MEPA_OPND_LAB;
+}
+
+static int parse_number(const char *arg, long *value)
+{
+	char *end;
+
+	errno = 0;
+	*value = strtol(arg, &end, 10);
+	return !errno && end != arg && *end == '\0';
+}
+
+static int add_position(struct loader *ld)
+{
+	size_t *positions;
+
+	if (ld->npositions == ld->allocated) {
+		positions = (size_t*) realloc(ld->positions,
+				ld->allocated * 2 * sizeof(size_t));
+		if (!positions)
+			return ERROR;
+		ld->positions = positions;
+		ld->allocated *= 2;
+	}
+	ld->positions[ld->npositions++] = ld->prog->count;
+
+	return OK;
+}
+
+static int add_fixup(struct loader *ld, const char *name)
+{
+	struct fixup *fixups;
+
+	fixups = (struct fixup*) realloc(ld->fixups,
+			(ld->nfixups + 1) * sizeof(struct fixup));
+	if (!fixups)
+		return ERROR;
+	ld->fixups = fixups;
+	fixups[ld->nfixups].inst = ld->prog->count - 1;
+	fixups[ld->nfixups].line = ld->line;
+	fixups[ld->nfixups].name = strdup(name);
+	if (!fixups[ld->nfixups].name)
+		return ERROR;
+	ld->nfixups++;
+
+	return OK;
+}
+
+static int parse_instruction(struct loader *ld, char *text)
+{
+	char *args[MAX_ARGS];
+	char *mnemonic, *rest, *label = NULL;
+	struct vm_inst *inst;
+	long values[3] = { 0, 0, 0 };
+	long value;
+	int op, nargs = 0, noperands, i;
+
+	mnemonic = text;
+	for (rest = text; *rest && !isspace((unsigned char) *rest); rest++)
+		;
+	if (*rest) {
+		*rest++ = '\0';
+		for (;;) {
+			if (nargs == MAX_ARGS)
+				return load_error(ld, "too many arguments",
+						NULL);
+			args[nargs++] = rest;
+			rest = strchr(rest, ',');
+			if (!rest)
+				break;
+			*rest++ = '\0';
+		}
+		for (i = 0; i < nargs; i++)
+			args[i] = trim(args[i]);
+	}
+
+	op = find_opcode(mnemonic);
+	if (op < 0)
+		return load_error(ld, "unknown instruction", mnemonic);
+	vm_warn_extension(ld->prog, op, mnemonic);
+
+	noperands = count_operands(mepa_opcodes[op].operands);
+	if (nargs < noperands)
+		return load_error(ld, "missing arguments", mnemonic);
+
+	if (!add_position(ld))
+		return load_error(ld, "out of memory", NULL);
+
+	/* the extra ones only stay in the stack */
+	for (i = 0; i < nargs - noperands; i++) {
+		if (!parse_number(args[i], &value))
+			return load_error(ld, "invalid argument", args[i]);
+		inst = vm_program_add(ld->prog, MEPA_CRCT);
+		if (!inst)
+			return load_error(ld, "out of memory", NULL);
+		inst->line = ld->line;
+		inst->a = value;
+	}
+	for (i = 0; i < noperands; i++) {
+		if (parse_number(args[nargs - noperands + i], &values[i]))
+			continue;
+		if (i != 0 || !is_jump(mepa_opcodes[op].operands))
+			return load_error(ld, "invalid argument",
+					args[nargs - noperands + i]);
+		label = args[nargs - noperands];
+	}
+
+	inst = vm_program_add(ld->prog, op);
+	if (!inst)
+		return load_error(ld, "out of memory", NULL);
+	inst->line = ld->line;
+	inst->a = values[0];
+	inst->b = values[1];
+	inst->c = values[2];
+	if (!vm_valid_levels(inst))
+		return load_error(ld, "invalid lexical level", mnemonic);
+
+	if (label && !add_fixup(ld, label))
+		return load_error(ld, "out of memory", NULL);
+
+	return OK;
+}
+
+static int parse_line(struct loader *ld, char *line)
+{
+	char *comment, *colon, *label;
+	size_t len;
+
+	comment = strchr(line, ';');
+	if (comment)
+		*comment = '\0';
+	line = trim(line);
+
+	colon = strchr(line, ':');
+	if (colon) {
+		*colon = '\0';
+		label = trim(line);
+		line = trim(colon + 1);
+		len = strlen(label);
+		/* the last one with the name wins, as in mepa.py */
+		if (len && !hash_put(ld->labels, label, len,
+					(void*) (ld->npositions + 1), 0))
+			return load_error(ld, "out of memory", NULL);
+	}
+
+	if (!*line)
+		return OK;
+	return parse_instruction(ld, line);
+}
+
+/* the source position of a jump to the instruction in the program */
+static int resolve_jumps(struct loader *ld)
+{
+	struct vm_program *prog = ld->prog;
+	struct vm_inst *inst;
+	struct fixup *fixup;
+	size_t i, pos;
+
+	for (i = 0; i < ld->nfixups; i++) {
+		fixup = &ld->fixups[i];
+		pos = (size_t) hash_get(ld->labels, fixup->name,
+				strlen(fixup->name), 0);
+		if (!pos) {
+			ld->line = fixup->line;
+			return load_error(ld, "undefined label", fixup->name);
+		}
+		prog->code[fixup->inst].a = pos - 1;
+	}
+
+	for (i = 0; i < prog->count; i++) {
+		inst = &prog->code[i];
+		if (!is_jump(mepa_opcodes[inst->op].operands))
+			continue;
+		if (inst->a < 0) {
+			ld->line = inst->line;
+			return load_error(ld, "invalid jump target", NULL);
+		}
+		/* beyond the end it stops, as mepa.py does */
+		if ((size_t) inst->a >= ld->npositions)
+			inst->a = prog->count;
+		else
+			inst->a = ld->positions[inst->a];
+	}
+
+	return OK;
+}
+
+/** Loads the program in the text format from source, reporting the errors
+ * with its name.
+ *
+ * prog must be initialized and empty.
+ */
+int vm_load_text(struct vm_program *prog, FILE *source, const char *name)
+{
+	struct loader ld;
+	char line[MAX_LINE];
+	size_t len, i;
+	int ret = ERROR;
+
+	memset(&ld, 0, sizeof(ld));
+	ld.name = name;
+	ld.prog = prog;
+	ld.labels = hash_init(64);
+	ld.allocated = 256;
+	ld.positions = (size_t*) malloc(ld.allocated * sizeof(size_t));
+	if (!ld.labels || !ld.positions) {
+		load_error(&ld, "out of memory", NULL);
+		goto error;
+	}
+
+	while (fgets(line, sizeof(line), source)) {
+		ld.line++;
+		len = strlen(line);
+		if (len == sizeof(line) - 1 && line[len - 1] != '\n') {
+			load_error(&ld, "line too long", NULL);
+			goto error;
+		}
+		if (!parse_line(&ld, line))
+			goto error;
+	}
+	if (ferror(source)) {
+		load_error(&ld, "read error", strerror(errno));
+		goto error;
+	}
+
+	if (!resolve_jumps(&ld))
+		goto error;
+
+	/* where the jumps beyond the end go */
+	if (!vm_program_end(prog)) {
+		load_error(&ld, "out of memory", NULL);
+		goto error;
+	}
+
+	ret = OK;
+
+error:
+	for (i = 0; i < ld.nfixups; i++)
+		free(ld.fixups[i].name);
+	free(ld.fixups);
+	free(ld.positions);
+	if (ld.labels)
+		hash_free(ld.labels);
+
+	return ret;
+}
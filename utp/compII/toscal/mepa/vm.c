@@ -0,0 +1,671 @@
+/** vm.c
+ *
+ * The instructions do what their i_* methods in mepa.py do, but the
+ * operands aren't pushed to the stack before each one: they are read from
+ * the instruction. Only AMEM keeps its operand in the first word
+ * allocated, as mepa.py does, since programs reading variables not
+ * initialized would see it.
+ *
+ * The values are longs, where mepa.py has python integers, so only
+ * results that don't fit in 64 bits differ (they wrap around here).
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "vm.h"
+
+#define ERROR	0
+#define OK	1
+
+int init_vm_program(struct vm_program *prog)
+{
+	prog->count = 0;
+	prog->allocated = 256;
+	prog->levels = 1;
+	prog->procs = NULL;
+	prog->nprocs = 0;
+	prog->stack_words = 0;
+	prog->room = NULL;
+	prog->warnings = stdout;
+	memset(prog->warned, 0, sizeof(prog->warned));
+	prog->code = (struct vm_inst*) malloc(prog->allocated
+			* sizeof(struct vm_inst));
+
+	return prog->code != NULL;
+}
+
+void destroy_vm_program(struct vm_program *prog)
+{
+	free(prog->code);
+	free(prog->procs);
+	free(prog->room);
+}
+
+struct vm_inst *vm_program_add(struct vm_program *prog, int op)
+{
+	struct vm_inst *code, *inst;
+
+	if (prog->count == prog->allocated) {
+		code = (struct vm_inst*) realloc(prog->code,
+				prog->allocated * 2 * sizeof(struct vm_inst));
+		if (!code)
+			return NULL;
+		prog->code = code;
+		prog->allocated *= 2;
+	}
+
+	inst = &prog->code[prog->count++];
+	inst->handler = NULL;
+	inst->op = op;
+	inst->line = 0;
+	inst->a = 0;
+	inst->b = 0;
+	inst->c = 0;
+
+	return inst;
+}
+
+/* the lexical levels an instruction refers to */
+static long inst_level(struct vm_inst *inst)
+{
+	switch (inst->op) {
+	case MEPA_CRVL: case MEPA_ARMZ: case MEPA_ARMC: case MEPA_CRVI:
+	case MEPA_ARMI: case MEPA_CREN: case MEPA_ENPR: case MEPA_RTPR:
+	case MEPA_ENRT:
+		return inst->a;
+	case MEPA_CHPR:
+		return inst->b;
+	case MEPA_DSVR:
+		return inst->b > inst->c ? inst->b : inst->c;
+	default:
+		return -1;
+	}
+}
+
+#define VALID_LEVEL(k)	((k) >= 0 && (k) < VM_MAX_LEVELS)
+
+/** Whether the lexical levels inst refers to fit in the display, checked
+ * by the loaders before vm_program_end(). */
+int vm_valid_levels(struct vm_inst *inst)
+{
+	switch (inst->op) {
+	case MEPA_CRVL: case MEPA_ARMZ: case MEPA_ARMC: case MEPA_CRVI:
+	case MEPA_ARMI: case MEPA_CREN: case MEPA_ENPR: case MEPA_RTPR:
+	case MEPA_ENRT:
+		return VALID_LEVEL(inst->a);
+	case MEPA_CHPR:
+		return VALID_LEVEL(inst->b);
+	case MEPA_DSVR:
+		return VALID_LEVEL(inst->b) && VALID_LEVEL(inst->c);
+	default:
+		return 1;
+	}
+}
+
+/** Appends the PARA after the last instruction, which doesn't count in
+ * prog->count: jumping to the end of the program stops it. The display
+ * gets room for all the levels used, and the instructions the room they
+ * may push in (see stack.c). */
+int vm_program_end(struct vm_program *prog)
+{
+	size_t i;
+	long k;
+
+	for (i = 0; i < prog->count; i++) {
+		k = inst_level(&prog->code[i]);
+		if (k >= prog->levels)
+			prog->levels = k + 1;
+	}
+
+	if (!vm_program_add(prog, MEPA_PARA))
+		return ERROR;
+	prog->count--;
+	if (prog->count)
+		prog->code[prog->count].line =
+			prog->code[prog->count - 1].line;
+
+	return vm_find_room(prog);
+}
+
+/** Warns once about each instruction that isn't in the MEPA
+ * specification, with the mnemonic found in the source */
+void vm_warn_extension(struct vm_program *prog, int op,
+		const char *mnemonic)
+{
+	if (!mepa_opcodes[op].extension || prog->warned[op])
+		return;
+	prog->warned[op] = 1;
+	if (prog->warnings)
+		fprintf(prog->warnings, "aviso: instrucao nao faz parte da "
+				"especificacao da MEPA: %s\n", mnemonic);
+}
+
+void vm_dump_error(struct vm_state *vm, struct vm_program *prog,
+		FILE *stream)
+{
+	/* the bytecode has no lines */
+	if (vm->failed && vm->failed->line)
+		fprintf(stream, "line %u: %s: ", vm->failed->line,
+				mepa_opcodes[vm->failed->op].mnemonic);
+	else if (vm->failed)
+		fprintf(stream, "instruction %lu: %s: ",
+				(unsigned long) (vm->failed - prog->code),
+				mepa_opcodes[vm->failed->op].mnemonic);
+
+	switch (vm->error) {
+	case VM_NOERROR:
+		fputs("WTF? no pending error!\n", stream);
+		break;
+	case VM_NO_MEMORY:
+		fputs("out of memory\n", stream);
+		break;
+	case VM_DIVISION_BY_ZERO:
+		fputs("division by zero\n", stream);
+		break;
+	case VM_EMPTY_STACK:
+		fputs("empty stack\n", stream);
+		break;
+	case VM_STACK_OVERFLOW:
+		fputs("stack overflow\n", stream);
+		break;
+	case VM_BAD_ADDRESS:
+		fprintf(stream, "invalid address %ld\n", vm->error_args[0]);
+		break;
+	case VM_BAD_LEVEL:
+		fprintf(stream, "invalid lexical level %ld\n",
+				vm->error_args[0]);
+		break;
+	case VM_BAD_JUMP:
+		fprintf(stream, "invalid return address %ld\n",
+				vm->error_args[0]);
+		break;
+	case VM_BAD_INPUT:
+		fputs("the input is not an integer\n", stream);
+		break;
+	case VM_ASSERT_FAILED:
+		fprintf(stream, "assertion failed: %ld != %ld\n",
+				vm->error_args[0], vm->error_args[1]);
+		break;
+	}
+}
+
+/* grows the stack so that index fits in it, the new words are VM_UNSET */
+static int grow_stack(struct vm_state *vm, size_t index)
+{
+	size_t size = vm->stack_size;
+	size_t i;
+	long *stack;
+
+	if (index >= VM_MAX_STACK) {
+		vm->error = VM_STACK_OVERFLOW;
+		return ERROR;
+	}
+	while (size <= index)
+		size *= 2;
+	if (size > VM_MAX_STACK)
+		size = VM_MAX_STACK;
+
+	stack = (long*) realloc(vm->stack, size * sizeof(long));
+	if (!stack) {
+		vm->error = VM_NO_MEMORY;
+		return ERROR;
+	}
+	for (i = vm->stack_size; i < size; i++)
+		stack[i] = VM_UNSET;
+	vm->stack = stack;
+	vm->stack_size = size;
+
+	return OK;
+}
+
+/* like int(sys.stdin.readline()) */
+static int read_integer(FILE *in, long *value)
+{
+	char line[128];
+	char *end;
+
+	if (!fgets(line, sizeof(line), in))
+		return ERROR;
+	errno = 0;
+	*value = strtol(line, &end, 10);
+	if (errno || end == line)
+		return ERROR;
+	while (*end == ' ' || *end == '\t' || *end == '\r' || *end == '\n')
+		end++;
+
+	return *end == '\0';
+}
+
+/* the floor division of python, a // b */
+static inline long floor_div(long a, long b)
+{
+	long q;
+
+	if (b == -1)
+		return (long) -(unsigned long) a;
+	q = a / b;
+	if (a % b != 0 && (a < 0) != (b < 0))
+		q--;
+	return q;
+}
+
+/* the modulo of python, with the sign of b */
+static inline long floor_mod(long a, long b)
+{
+	long r;
+
+	if (b == -1)
+		return 0;
+	r = a % b;
+	if (r != 0 && (r < 0) != (b < 0))
+		r += b;
+	return r;
+}
+
+/* with gcc each instruction jumps straight to the next one's code, other
+ * compilers get a switch (or -DVM_SWITCH_DISPATCH) */
+#if defined(__GNUC__) && !defined(VM_SWITCH_DISPATCH)
+#define VM_THREADED
+#endif
+
+/*
+ * The registers live in local variables, sp is the index of the top of
+ * the stack (-1 when it is empty) and ip the instruction running.
+ */
+
+#ifdef VM_THREADED
+#define DISPATCH()	goto *ip->handler
+#define OP(name)	op_##name
+#else
+#define DISPATCH()	goto dispatch
+#define OP(name)	case MEPA_##name
+#endif
+
+#define NEXT()		do { ip++; DISPATCH(); } while (0)
+#define JUMP(target)	do { ip = code + (target); DISPATCH(); } while (0)
+
+#define FAIL(err)	do { vm->error = err; goto failed; } while (0)
+
+/* at least n values in the stack */
+#define NEED(n)		do { if (sp < (n) - 1) FAIL(VM_EMPTY_STACK); } while (0)
+
+/* room for the index top in the stack */
+#define ROOM(top)	do { \
+	if ((size_t) (top) >= size) { \
+		if (!grow_stack(vm, (top))) \
+			goto failed; \
+		stack = vm->stack; \
+		size = vm->stack_size; \
+	} } while (0)
+
+/* room for what the procedure may still push from the instruction at
+ * target, when it was found (see stack.c) */
+#define ENTER(target)	do { \
+	long room_ = rooms[target]; \
+	if (room_ > 0) \
+		ROOM(sp + room_); \
+	} while (0)
+
+#define PUSH(value)	do { \
+	long value_ = (value); \
+	ROOM(sp + 1); \
+	stack[++sp] = value_; } while (0)
+
+/* where the room was made by ENTER() */
+#define PUSH_FAST(value) do { \
+	long value_ = (value); \
+	stack[++sp] = value_; } while (0)
+
+/* sets sp, the stack can't end below its bottom */
+#define SET_SP(value)	do { \
+	long sp_ = (value); \
+	if (sp_ < -1) \
+		FAIL(VM_EMPTY_STACK); \
+	if (sp_ >= 0) \
+		ROOM(sp_); \
+	sp = sp_; } while (0)
+
+#define SET_SP_FAST(value) do { \
+	long sp_ = (value); \
+	if (sp_ < -1) \
+		FAIL(VM_EMPTY_STACK); \
+	sp = sp_; } while (0)
+
+#define CHECK_ADDRESS(addr) do { \
+	if ((addr) < 0) { \
+		vm->error_args[0] = (addr); \
+		FAIL(VM_BAD_ADDRESS); \
+	} } while (0)
+
+/* the memory never written is VM_UNSET */
+#define LOAD(addr, dst)	do { \
+	long addr_ = (addr); \
+	CHECK_ADDRESS(addr_); \
+	(dst) = (size_t) addr_ < size ? stack[addr_] : VM_UNSET; \
+	} while (0)
+
+#define STORE(addr, value) do { \
+	long addr_ = (addr), value_ = (value); \
+	CHECK_ADDRESS(addr_); \
+	ROOM(addr_); \
+	stack[addr_] = value_; } while (0)
+
+#define JUMP_IF(expr)	do { \
+	long a, b; \
+	NEED(2); \
+	b = stack[sp]; \
+	a = stack[sp - 1]; \
+	sp -= 2; \
+	if (expr) \
+		JUMP(ip->a); \
+	NEXT(); } while (0)
+
+#define BINARY(expr)	do { \
+	long a, b; \
+	NEED(2); \
+	b = stack[sp--]; \
+	a = stack[sp]; \
+	stack[sp] = (expr); \
+	NEXT(); } while (0)
+
+/* wraps around instead of overflowing */
+#define WRAP(a, op, b)	((long) ((unsigned long) (a) op (unsigned long) (b)))
+
+/** Runs the program from its first instruction until PARA */
+int vm_run(struct vm_state *vm, struct vm_program *prog)
+{
+#ifdef VM_THREADED
+	static const void *handlers[MEPA__COUNT] = {
+		[MEPA_INPP] = &&op_INPP, [MEPA_PARA] = &&op_PARA,
+		[MEPA_AMEM] = &&op_AMEM, [MEPA_DMEM] = &&op_DMEM,
+		[MEPA_CRCT] = &&op_CRCT, [MEPA_CRVL] = &&op_CRVL,
+		[MEPA_ARMZ] = &&op_ARMZ, [MEPA_CRVI] = &&op_CRVI,
+		[MEPA_ARMI] = &&op_ARMI, [MEPA_CREN] = &&op_CREN,
+		[MEPA_SOMA] = &&op_SOMA, [MEPA_SUBT] = &&op_SUBT,
+		[MEPA_MULT] = &&op_MULT, [MEPA_DIVI] = &&op_DIVI,
+		[MEPA_MODU] = &&op_MODU, [MEPA_INVR] = &&op_INVR,
+		[MEPA_CONJ] = &&op_CONJ, [MEPA_DISJ] = &&op_DISJ,
+		[MEPA_NEGA] = &&op_NEGA, [MEPA_CMIG] = &&op_CMIG,
+		[MEPA_CMDG] = &&op_CMDG, [MEPA_CMMA] = &&op_CMMA,
+		[MEPA_CMAG] = &&op_CMAG, [MEPA_CMME] = &&op_CMME,
+		[MEPA_CMEG] = &&op_CMEG, [MEPA_DSVS] = &&op_DSVS,
+		[MEPA_DSVF] = &&op_DSVF, [MEPA_DSVR] = &&op_DSVR,
+		[MEPA_CHPR] = &&op_CHPR, [MEPA_ENPR] = &&op_ENPR,
+		[MEPA_RTPR] = &&op_RTPR, [MEPA_ENRT] = &&op_ENRT,
+		[MEPA_LEIT] = &&op_LEIT, [MEPA_IMPR] = &&op_IMPR,
+		[MEPA_ARMC] = &&op_ARMC, [MEPA_NADA] = &&op_NADA,
+		[MEPA_ASSERT] = &&op_ASSERT, [MEPA_DSIG] = &&op_DSIG,
+		[MEPA_DSDG] = &&op_DSDG, [MEPA_DSMA] = &&op_DSMA,
+		[MEPA_DSAG] = &&op_DSAG, [MEPA_DSME] = &&op_DSME,
+		[MEPA_DSEG] = &&op_DSEG,
+	};
+	/* the ones that don't look at the size, for the instructions with
+	 * their room found */
+	static const void *fast_handlers[MEPA__COUNT] = {
+		[MEPA_AMEM] = &&op_AMEM_FAST, [MEPA_DMEM] = &&op_DMEM_FAST,
+		[MEPA_CRCT] = &&op_CRCT_FAST, [MEPA_CRVL] = &&op_CRVL_FAST,
+		[MEPA_CRVI] = &&op_CRVI_FAST, [MEPA_CREN] = &&op_CREN_FAST,
+		[MEPA_LEIT] = &&op_LEIT_FAST,
+	};
+#endif
+	struct vm_inst *code = prog->code;
+	const long *rooms = prog->room;
+	struct vm_inst *ip;
+	long *stack, *display;
+	size_t size, i;
+	long sp = -1, bp = 0;
+	long value;
+
+	vm->error = VM_NOERROR;
+	vm->failed = NULL;
+	vm->stack = NULL;
+	vm->display = NULL;
+
+	/* toscal knows how much the programs without recursion use */
+	vm->stack_size = VM_INITIAL_STACK;
+	if (prog->stack_words && prog->stack_words <= VM_MAX_STACK)
+		vm->stack_size = prog->stack_words;
+	vm->stack = (long*) malloc(vm->stack_size * sizeof(long));
+	vm->levels = prog->levels;
+	vm->display = (long*) malloc(vm->levels * sizeof(long));
+	if (!vm->stack || !vm->display) {
+		vm->error = VM_NO_MEMORY;
+		goto cleanup;
+	}
+	for (i = 0; i < vm->stack_size; i++)
+		vm->stack[i] = VM_UNSET;
+	for (i = 0; i < (size_t) vm->levels; i++)
+		vm->display[i] = VM_UNSET;
+
+	stack = vm->stack;
+	size = vm->stack_size;
+	display = vm->display;
+
+#ifdef VM_THREADED
+	for (i = 0; i <= prog->count; i++)
+		if (rooms[i] >= 0 && fast_handlers[code[i].op])
+			code[i].handler = fast_handlers[code[i].op];
+		else
+			code[i].handler = handlers[code[i].op];
+#endif
+
+	ip = code;
+	ENTER(0);
+	DISPATCH();
+
+#ifndef VM_THREADED
+dispatch:
+	switch (ip->op) {
+#endif
+
+	OP(INPP):
+		display[0] = 0;
+		NEXT();
+	OP(PARA):
+		goto done;
+	OP(AMEM):
+		/* the operand was pushed and then popped */
+		ROOM(sp + 1);
+		stack[sp + 1] = ip->a;
+		SET_SP(sp + ip->a);
+		NEXT();
+	OP(DMEM):
+		SET_SP(sp - ip->a);
+		NEXT();
+	OP(CRCT):
+		PUSH(ip->a);
+		NEXT();
+	OP(CRVL):
+		LOAD(display[ip->a] + ip->b, value);
+		PUSH(value);
+		NEXT();
+	OP(ARMZ):
+		NEED(1);
+		STORE(display[ip->a] + ip->b, stack[sp]);
+		sp--;
+		NEXT();
+	OP(ARMC):
+		NEED(1);
+		STORE(display[ip->a] + ip->b, stack[sp]);
+		NEXT();
+	OP(CRVI):
+		LOAD(display[ip->a] + ip->b, value);
+		LOAD(value, value);
+		PUSH(value);
+		NEXT();
+	OP(ARMI):
+		NEED(1);
+		LOAD(display[ip->a] + ip->b, value);
+		STORE(value, stack[sp]);
+		sp--;
+		NEXT();
+	OP(CREN):
+		PUSH(display[ip->a] + ip->b);
+		NEXT();
+	OP(SOMA):
+		BINARY(WRAP(a, +, b));
+	OP(SUBT):
+		BINARY(WRAP(a, -, b));
+	OP(MULT):
+		BINARY(WRAP(a, *, b));
+	OP(DIVI):
+		NEED(2);
+		if (stack[sp] == 0)
+			FAIL(VM_DIVISION_BY_ZERO);
+		BINARY(floor_div(a, b));
+	OP(MODU):
+		NEED(2);
+		if (stack[sp] == 0)
+			FAIL(VM_DIVISION_BY_ZERO);
+		BINARY(floor_mod(a, b));
+	OP(INVR):
+		NEED(1);
+		stack[sp] = (long) -(unsigned long) stack[sp];
+		NEXT();
+	/* the python "and" and "or", which give one of the operands */
+	OP(CONJ):
+		BINARY(b ? a : b);
+	OP(DISJ):
+		BINARY(b ? b : a);
+	OP(NEGA):
+		NEED(1);
+		stack[sp] = !stack[sp];
+		NEXT();
+	OP(CMIG):
+		BINARY(a == b);
+	OP(CMDG):
+		BINARY(a != b);
+	OP(CMMA):
+		BINARY(a > b);
+	OP(CMAG):
+		BINARY(a >= b);
+	OP(CMME):
+		BINARY(a < b);
+	OP(CMEG):
+		BINARY(a <= b);
+	OP(DSVS):
+		JUMP(ip->a);
+	OP(DSVF):
+		NEED(1);
+		if (!stack[sp--])
+			JUMP(ip->a);
+		NEXT();
+	/* CMxx and DSVF in one dispatch */
+	OP(DSIG):
+		JUMP_IF(a == b);
+	OP(DSDG):
+		JUMP_IF(a != b);
+	OP(DSMA):
+		JUMP_IF(a > b);
+	OP(DSAG):
+		JUMP_IF(a >= b);
+	OP(DSME):
+		JUMP_IF(a < b);
+	OP(DSEG):
+		JUMP_IF(a <= b);
+	OP(DSVR):
+		ENTER(ip->a);
+		bp = display[ip->b];
+		JUMP(ip->a);
+	OP(CHPR):
+		ROOM(sp + 3);
+		stack[++sp] = ip - code + 1;
+		stack[++sp] = bp;
+		stack[++sp] = ip->b;
+		ENTER(ip->a);
+		JUMP(ip->a);
+	OP(ENPR):
+		bp = sp + 1;
+		display[ip->a] = bp;
+		NEXT();
+	OP(RTPR):
+		NEED(3);
+		value = stack[sp];	/* the k of the caller */
+		if (value < 0 || value >= vm->levels) {
+			vm->error_args[0] = value;
+			FAIL(VM_BAD_LEVEL);
+		}
+		bp = stack[sp - 1];
+		display[value] = bp;
+		value = stack[sp - 2];	/* the return address */
+		if (value < 0 || (size_t) value > prog->count) {
+			vm->error_args[0] = value;
+			FAIL(VM_BAD_JUMP);
+		}
+		SET_SP(sp - 3 - ip->b);
+		ENTER(value);
+		JUMP(value);
+	OP(ENRT):
+		SET_SP(display[ip->a] + ip->b - 1);
+		ENTER(ip - code + 1);
+		NEXT();
+	OP(LEIT):
+		if (!read_integer(vm->in, &value))
+			FAIL(VM_BAD_INPUT);
+		PUSH(value);
+		NEXT();
+	OP(IMPR):
+		NEED(1);
+		fprintf(vm->out, "%ld\n", stack[sp--]);
+		NEXT();
+	OP(NADA):
+		NEXT();
+	OP(ASSERT):
+		NEED(2);
+		if (stack[sp] != stack[sp - 1]) {
+			vm->error_args[0] = stack[sp];
+			vm->error_args[1] = stack[sp - 1];
+			FAIL(VM_ASSERT_FAILED);
+		}
+		sp -= 2;
+		NEXT();
+
+#ifndef VM_THREADED
+	default:
+		/* the pseudo-instructions never get here */
+		goto done;
+	}
+#else
+	/* the same as above, in a procedure with its room made */
+op_AMEM_FAST:
+	stack[sp + 1] = ip->a;
+	SET_SP_FAST(sp + ip->a);
+	NEXT();
+op_DMEM_FAST:
+	SET_SP_FAST(sp - ip->a);
+	NEXT();
+op_CRCT_FAST:
+	PUSH_FAST(ip->a);
+	NEXT();
+op_CRVL_FAST:
+	LOAD(display[ip->a] + ip->b, value);
+	PUSH_FAST(value);
+	NEXT();
+op_CRVI_FAST:
+	LOAD(display[ip->a] + ip->b, value);
+	LOAD(value, value);
+	PUSH_FAST(value);
+	NEXT();
+op_CREN_FAST:
+	PUSH_FAST(display[ip->a] + ip->b);
+	NEXT();
+op_LEIT_FAST:
+	if (!read_integer(vm->in, &value))
+		FAIL(VM_BAD_INPUT);
+	PUSH_FAST(value);
+	NEXT();
+#endif
+
+failed:
+	vm->failed = ip;
+done:
+cleanup:
+	free(vm->stack);
+	free(vm->display);
+	vm->stack = NULL;
+	vm->display = NULL;
+	fflush(vm->out);
+
+	return vm->error == VM_NOERROR;
+}
@@ -0,0 +1,113 @@
+/** A native MEPA virtual machine, running the same programs as mepa.py
+ * with the same results.
+ *
+ * The program is decoded once into an array of instructions with their
+ * operands (labels resolved to instruction indexes), which is then run
+ * with direct threading: each instruction holds the address of the code
+ * that runs it.
+ */
+#ifndef inc_vm_h
+#define inc_vm_h
+
+#include <stdio.h>
+#include <stddef.h>
+
+#include "opcodes.h"
+
+/* the value of the memory never written, as in mepa.py */
+#define VM_UNSET		999999
+#define VM_INITIAL_STACK	1024
+/* in words, mepa.py only has 118 */
+#define VM_MAX_STACK		((size_t) 1 << 26)
+/* the most a procedure pushes to be run without looking at the size */
+#define VM_MAX_ROOM		4096
+/* the lexical levels of the programs, the size of the display */
+#define VM_MAX_LEVELS		1024
+
+struct vm_inst {
+	const void *handler;	/* filled by vm_run() */
+	unsigned short op;	/* enum mepa_opcode */
+	unsigned int line;	/* in the source, for the errors */
+	long a;
+	long b;
+	long c;
+};
+
+/* the use of the stack of a procedure found by toscal, as in bytecode.h */
+struct vm_procedure {
+	size_t entry;
+	long frame;
+	long depth;
+	long params;
+};
+
+struct vm_program {
+	struct vm_inst *code;	/* plus the PARA of vm_program_end() */
+	size_t count;
+	size_t allocated;
+	long levels;		/* size of the display (the D registers) */
+	/* from the bytecode, none in the text */
+	struct vm_procedure *procs;	/* the main block first */
+	size_t nprocs;
+	size_t stack_words;	/* the room of the whole program, 0 unknown */
+	/* the words each instruction may still push before its procedure
+	 * ends, -1 where it must look (see stack.c) */
+	long *room;
+	/* where the loaders warn about the extensions, like mepa.py does,
+	 * NULL for nowhere */
+	FILE *warnings;
+	unsigned char warned[MEPA__COUNT];
+};
+
+enum vm_error {
+	VM_NOERROR,
+	VM_NO_MEMORY,
+	VM_DIVISION_BY_ZERO,
+	VM_EMPTY_STACK,
+	VM_STACK_OVERFLOW,
+	VM_BAD_ADDRESS,
+	VM_BAD_LEVEL,
+	VM_BAD_JUMP,
+	VM_BAD_INPUT,
+	VM_ASSERT_FAILED
+};
+
+struct vm_state {
+	enum vm_error error;
+	struct vm_inst *failed;	/* the instruction that failed */
+	long error_args[2];
+
+	long *stack;
+	size_t stack_size;
+	long *display;
+	long levels;
+
+	FILE *in;
+	FILE *out;
+};
+
+/* text.c */
+int vm_load_text(struct vm_program *prog, FILE *source, const char *name);
+
+/* bytecode.c */
+int vm_load_bytecode(struct vm_program *prog, FILE *source, const char *name);
+
+/* stack.c */
+int vm_find_room(struct vm_program *prog);
+
+/* disasm.c */
+int vm_write_text(struct vm_program *prog, FILE *out);
+
+/* vm.c */
+int init_vm_program(struct vm_program *prog);
+void destroy_vm_program(struct vm_program *prog);
+struct vm_inst *vm_program_add(struct vm_program *prog, int op);
+int vm_valid_levels(struct vm_inst *inst);
+int vm_program_end(struct vm_program *prog);
+void vm_warn_extension(struct vm_program *prog, int op,
+		const char *mnemonic);
+int vm_run(struct vm_state *vm, struct vm_program *prog);
+void vm_dump_error(struct vm_state *vm, struct vm_program *prog,
+		FILE *stream);
+
+#endif /* inc_vm_h */
@@ -0,0 +1,74 @@
+#!/usr/bin/env python
+#
+# Generates keywords_hash.h, a perfect hash table for the keywords listed
+# in the keywords[] table of tokenize.h.
+#
+# The hash only looks at the first two chars, the last char and the length
+# of the identifier ("while" and "write" only differ in the second one), so
+# the tokenizer can tell keywords from identifiers with a table lookup and
+# at most one string comparison.
+#
+# Run "make update-keywords" after changing the keywords[] table.
+#
+import re
+import sys
+
+HEADER = "tokenize.h"
+OUTPUT = "keywords_hash.h"
+
+def read_keywords(path):
+    keywords = []
+    for line in open(path):
+        found = re.match(r'\s*KEYWORD\("(\w+)",', line)
+        if found:
+            keywords.append(found.group(1))
+    return keywords
+
+def find_hash(keywords):
+    size = 16
+    while size <= 256:
+        for a in range(1, 32):
+            for b in range(1, 32):
+                for c in range(1, 32):
+                    slots = {}
+                    for i, kw in enumerate(keywords):
+                        h = (ord(kw[0]) * a + ord(kw[1]) * b
+                                + ord(kw[-1]) * c + len(kw)) % size
+                        if h in slots:
+                            break
+                        slots[h] = i
+                    else:
+                        return size, (a, b, c), slots
+        size *= 2
+    raise Exception("no perfect hash found, change the hash function")
+
+def main():
+    keywords = read_keywords(HEADER)
+    size, factors, slots = find_hash(keywords)
+    minlen = min(len(kw) for kw in keywords)
+    maxlen = max(len(kw) for kw in keywords)
+    out = open(OUTPUT, "w")
+    out.write("/* Generated by mkkeywords.py from the keywords[] table of "
+              "tokenize.h,\n * don't edit it by hand. */\n")
+    out.write("#ifndef inc_keywords_hash_h\n#define inc_keywords_hash_h\n\n")
+    out.write("#define KEYWORD_MIN_LEN\t%d\n" % minlen)
+    out.write("#define KEYWORD_MAX_LEN\t%d\n" % maxlen)
+    out.write("#define KEYWORD_HASH_SIZE\t%d\n\n" % size)
+    out.write("#define KEYWORD_HASH(first, second, last, len) \\\n"
+              "\t((((unsigned char) (first)) * %d \\\n"
+              "\t  + ((unsigned char) (second)) * %d \\\n"
+              "\t  + ((unsigned char) (last)) * %d + (len)) "
+              "& (KEYWORD_HASH_SIZE - 1))\n\n" % factors)
+    out.write("/* index + 1 into keywords[], 0 for empty slots */\n")
+    out.write("static const unsigned char keyword_slots[KEYWORD_HASH_SIZE] = {")
+    for i in range(size):
+        if i % 8 == 0:
+            out.write("\n\t")
+        else:
+            out.write(" ")
+        out.write("%d," % (slots.get(i, -1) + 1))
+    out.write("\n};\n\n#endif /* inc_keywords_hash_h */\n")
+    out.close()
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,53 @@
+#include <stddef.h>
+
+#include "opcodes.h"
+
+const struct mepa_opcode_info mepa_opcodes[MEPA__COUNT] = {
+	[MEPA_INPP] = { "INPP", MEPA_OPND_NONE, 0, 0 },
+	[MEPA_PARA] = { "PARA", MEPA_OPND_NONE, 0, 0 },
+	[MEPA_AMEM] = { "AMEM", MEPA_OPND_A, 0, 0 },
+	[MEPA_DMEM] = { "DMEM", MEPA_OPND_A, 0, 0 },
+	[MEPA_CRCT] = { "CRCT", MEPA_OPND_A, 0, 1 },
+	[MEPA_CRVL] = { "CRVL", MEPA_OPND_AB, 0, 1 },
+	[MEPA_ARMZ] = { "ARMZ", MEPA_OPND_AB, 0, -1 },
+	[MEPA_CRVI] = { "CRVI", MEPA_OPND_AB, 0, 1 },
+	[MEPA_ARMI] = { "ARMI", MEPA_OPND_AB, 0, -1 },
+	[MEPA_CREN] = { "CREN", MEPA_OPND_AB, 0, 1 },
+	[MEPA_SOMA] = { "SOMA", MEPA_OPND_NONE, 0, -1 },
+	[MEPA_SUBT] = { "SUBT", MEPA_OPND_NONE, 0, -1 },
+	[MEPA_MULT] = { "MULT", MEPA_OPND_NONE, 0, -1 },
+	[MEPA_DIVI] = { "DIVI", MEPA_OPND_NONE, 0, -1 },
+	[MEPA_MODU] = { "MODU", MEPA_OPND_NONE, 1, -1 },
+	[MEPA_INVR] = { "INVR", MEPA_OPND_NONE, 0, 0 },
+	[MEPA_CONJ] = { "CONJ", MEPA_OPND_NONE, 0, -1 },
+	[MEPA_DISJ] = { "DISJ", MEPA_OPND_NONE, 0, -1 },
+	[MEPA_NEGA] = { "NEGA", MEPA_OPND_NONE, 0, 0 },
+	[MEPA_CMIG] = { "CMIG", MEPA_OPND_NONE, 0, -1 },
+	[MEPA_CMDG] = { "CMDG", MEPA_OPND_NONE, 0, -1 },
+	[MEPA_CMMA] = { "CMMA", MEPA_OPND_NONE, 0, -1 },
+	[MEPA_CMAG] = { "CMAG", MEPA_OPND_NONE, 0, -1 },
+	[MEPA_CMME] = { "CMME", MEPA_OPND_NONE, 0, -1 },
+	[MEPA_CMEG] = { "CMEG", MEPA_OPND_NONE, 0, -1 },
+	[MEPA_DSVS] = { "DSVS", MEPA_OPND_L, 0, 0 },
+	[MEPA_DSVF] = { "DSVF", MEPA_OPND_L, 0, -1 },
+	[MEPA_DSVR] = { "DSVR", MEPA_OPND_LAB, 0, 0 },
+	[MEPA_CHPR] = { "CHPR", MEPA_OPND_LA, 0, 0 },
+	[MEPA_ENPR] = { "ENPR", MEPA_OPND_A, 0, 0 },
+	[MEPA_RTPR] = { "RTPR", MEPA_OPND_AB, 0, 0 },
+	[MEPA_ENRT] = { "ENRT", MEPA_OPND_AB, 0, 0 },
+	[MEPA_LEIT] = { "LEIT", MEPA_OPND_NONE, 0, 1 },
+	[MEPA_IMPR] = { "IMPR", MEPA_OPND_NONE, 0, -1 },
+	[MEPA_ARMC] = { "ARMC", MEPA_OPND_AB, 1, 0 },
+	[MEPA_NADA] = { "NADA", MEPA_OPND_NONE, 0, 0 },
+	[MEPA_ASSERT] = { "ASSERT", MEPA_OPND_NONE, 0, -2 },
+	[MEPA_DSIG] = { "DSIG", MEPA_OPND_L, 1, -2 },
+	[MEPA_DSDG] = { "DSDG", MEPA_OPND_L, 1, -2 },
+	[MEPA_DSMA] = { "DSMA", MEPA_OPND_L, 1, -2 },
+	[MEPA_DSAG] = { "DSAG", MEPA_OPND_L, 1, -2 },
+	[MEPA_DSME] = { "DSME", MEPA_OPND_L, 1, -2 },
+	[MEPA_DSEG] = { "DSEG", MEPA_OPND_L, 1, -2 },
+
+	[MEPA_LABEL] = { NULL, MEPA_OPND_PSEUDO },
+	[MEPA_PARAM_NOTE] = { NULL, MEPA_OPND_PSEUDO },
+	[MEPA_LABEL_NOTE] = { NULL, MEPA_OPND_PSEUDO },
+};
@@ -0,0 +1,88 @@
+#ifndef inc_opcodes_h
+#define inc_opcodes_h
+
+/* The instructions of the MEPA VM, plus a few pseudo-instructions used by
+ * the codegen to place labels and comments in the code.
+ *
+ * Keep it aligned with mepa_opcodes[] in opcodes.c.
+ */
+enum mepa_opcode {
+	MEPA_INPP,
+	MEPA_PARA,
+	MEPA_AMEM,
+	MEPA_DMEM,
+	MEPA_CRCT,
+	MEPA_CRVL,
+	MEPA_ARMZ,
+	MEPA_CRVI,
+	MEPA_ARMI,
+	MEPA_CREN,
+	MEPA_SOMA,
+	MEPA_SUBT,
+	MEPA_MULT,
+	MEPA_DIVI,
+	MEPA_MODU,
+	MEPA_INVR,
+	MEPA_CONJ,
+	MEPA_DISJ,
+	MEPA_NEGA,
+	MEPA_CMIG,
+	MEPA_CMDG,
+	MEPA_CMMA,
+	MEPA_CMAG,
+	MEPA_CMME,
+	MEPA_CMEG,
+	MEPA_DSVS,
+	MEPA_DSVF,
+	MEPA_DSVR,
+	MEPA_CHPR,
+	MEPA_ENPR,
+	MEPA_RTPR,
+	MEPA_ENRT,
+	MEPA_LEIT,
+	MEPA_IMPR,
+	MEPA_ARMC,		/* extension: ARMZ keeping the value */
+	MEPA_NADA,		/* no-op, only in hand written code */
+	MEPA_ASSERT,		/* fails unless the top two are equal, for
+				   the tests of the VMs */
+	/* extensions: pop b and a, jump if a op b, aligned with MEPA_CM* */
+	MEPA_DSIG,		/* jump if equal */
+	MEPA_DSDG,		/* jump if different */
+	MEPA_DSMA,		/* jump if greater than */
+	MEPA_DSAG,		/* jump if greater or equal than */
+	MEPA_DSME,		/* jump if less than */
+	MEPA_DSEG,		/* jump if less or equal than */
+
+	/* pseudo-instructions */
+	MEPA_LABEL,		/* the label is placed here */
+	MEPA_PARAM_NOTE,	/* comment telling where a param is */
+	MEPA_LABEL_NOTE,	/* comment telling a label was declared */
+
+	MEPA__COUNT
+};
+
+/* which operands are written, a is always the first int and b the
+ * second one */
+enum mepa_operands {
+	MEPA_OPND_NONE,
+	MEPA_OPND_A,		/* OP a */
+	MEPA_OPND_AB,		/* OP a, b */
+	MEPA_OPND_L,		/* OP label */
+	MEPA_OPND_LA,		/* OP label, a */
+	MEPA_OPND_LAB,		/* OP label, a, b */
+	MEPA_OPND_PSEUDO	/* written in its own way */
+};
+
+struct mepa_opcode_info {
+	const char *mnemonic;
+	enum mepa_operands operands;
+	int extension;	/* not in the MEPA specification */
+	/* the words it leaves on the stack (negative when it takes them),
+	 * 0 for AMEM, DMEM, CHPR, RTPR and ENRT, which depend on the
+	 * operands or on the procedure called */
+	int stack;
+};
+
+extern const struct mepa_opcode_info mepa_opcodes[MEPA__COUNT];
+
+#endif /* inc_opcodes_h */
@@ -1,16 +1,15 @@
-#include <stdlib.h>
-
 #include "parameters.h"
 #include "symbols.h"
 
-struct parameters *create_parameters()
+struct parameters *create_parameters(struct arena *arena)
 {
 	struct parameters *p;
 
-	p = (struct parameters*) malloc(sizeof(struct parameters));
+	p = (struct parameters*) arena_alloc(arena, sizeof(struct parameters));
 	if (!p)
 		return NULL;
 
+	p->arena = arena;
 	p->count = 0;
 	p->first = NULL;
 	p->last = NULL;
@@ -23,7 +22,8 @@ struct parameter *parameters_add(struct parameters *p,
 {
 	struct parameter *new;
 
-	new = (struct parameter*) malloc(sizeof(struct parameter));
+	new = (struct parameter*) arena_alloc(p->arena,
+			sizeof(struct parameter));
 	if (!new)
 		return NULL;
 
@@ -62,16 +62,3 @@ struct symbol *parameters_next_symbol(struct parameters *p,
 
 	return symbol;
 }
-
-void destroy_parameters(struct parameters *p)
-{
-	struct parameter *current, *next;
-
-	current = p->first;
-	while (current) {
-		next = current->next;
-		free(current);
-		current = next;
-	}
-	free(p);
-}
@@ -2,6 +2,7 @@
 #define inc_parameters_h
 
 #include "symbols.h"
+#include "arena.h"
 
 struct parameter {
 	struct symbol *symbol;
@@ -10,15 +11,16 @@ struct parameter {
 
 typedef struct parameter* parameters_iter_t;
 
+/* the list and its nodes live as long as the arena */
 struct parameters {
 	size_t count;	
 	struct parameter *first;
 	struct parameter *last;
+	struct arena *arena;
 };
 
-struct parameters *create_parameters();
+struct parameters *create_parameters(struct arena *arena);
 struct parameter *parameters_add(struct parameters *p, struct symbol *symbol);
-void destroy_parameters(struct parameters *p);
 void parameters_begin_iter(struct parameters *p, parameters_iter_t *iter);
 struct symbol *parameters_next_symbol(struct parameters *p,
 		parameters_iter_t *iter);
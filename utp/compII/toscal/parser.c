@@ -19,6 +19,7 @@
 #include "parser.h"
 #include "symbols.h"
 #include "string_list.h"
+#include "ast.h"
 
 #define NEXT_TOKEN	do { \
 	if (!fetch_next_token(ps->input, &ps->current)) { \
@@ -78,6 +79,52 @@
 		return ERROR; \
 	} } while(0)
 
+/* With -A (ps->ast) the states build the syntax tree instead: the calls
+ * to semantic.c are left for ast_walk(), the node keeps the position where
+ * each one would have been made. Every state leaves the node it built in
+ * ps->node. */
+#define AST_NODE(n, kind) do { \
+	if (ps->ast) { \
+		n = ast_new_node(ps->ast, kind); \
+		if (!n) { \
+			parser_error(ps, PARSER_SYSTEM_ERROR, NULL); \
+			return ERROR; \
+		} \
+	} } while(0)
+
+#define SEMANTIC_HOOK_AT(n, i, fcall) do { \
+	if (ps->ast) \
+		input_get_position(ps->input, &(n)->pos[i]); \
+	else \
+		SEMANTIC_HOOK(fcall); \
+	} while(0)
+
+/* the node left by the last state is the child i of n */
+#define AST_CHILD(n, i) do { \
+	if (ps->ast) \
+		(n)->child[i] = ps->node; \
+	} while(0)
+
+/* adds the node (or list of nodes) to the list ending at *tail */
+#define AST_ADD(tail, n) do { \
+	if (ps->ast) { \
+		*(tail) = n; \
+		while (*(tail)) \
+			tail = &(*(tail))->next; \
+	} } while(0)
+
+#define AST_APPEND(tail)	AST_ADD(tail, ps->node)
+#define AST_RETURN(n)	(ps->node = (n))
+
+/* Labels are integers, which are not interned by the tokenizer */
+#define INTERN_LABEL do { \
+	ps->current.ident = intern_string(ps->current.idents, \
+			ps->current.repr, ps->current.pending); \
+	if (!ps->current.ident) { \
+		parser_error(ps, PARSER_SYSTEM_ERROR, NULL); \
+		return ERROR; \
+	} } while(0)
+
 #define NEGVAL(x, val) (x ? -val : val)
 
 #define ERROR	0
@@ -117,7 +164,11 @@ void parser_dump_error(struct parser_state *ps, FILE *stream)
 		break;
 
 	case PARSER_SEMANTIC_ERROR:
-		input_dump_position(ps->input, stream);
+		if (ps->ast && ps->ast->error_position)
+			input_dump_saved_position(ps->ast->error_position,
+					stream);
+		else
+			input_dump_position(ps->input, stream);
 		fprintf(stream, ": semantic error: ");
 		semantic_dump_error(ps->semantic, stream);
 		break;
@@ -138,15 +189,33 @@ struct parser_state *init_parser_state(struct input_state *input,
 	if (!ps)
 		return NULL;
 
+	ps->scratch = create_arena(PARSER_SCRATCH_SIZE);
+	if (!ps->scratch) {
+		free(ps);
+		return NULL;
+	}
+
 	ps->input = input;
 	ps->semantic = semantic;
+	/* the identifiers are interned by the tokenizer */
+	ps->current.idents = semantic->idents;
 	ps->debug_stream = NULL;
 	ps->dump_tokens = 0;
 	ps->semantic_check = 1;
+	ps->ast = NULL;
+	ps->node = NULL;
 
 	return ps;
 }
 
+void destroy_parser_state(struct parser_state *ps)
+{
+	if (ps->ast)
+		destroy_ast(ps->ast);
+	destroy_arena(ps->scratch);
+	free(ps);
+}
+
 /**
  * Sets the error information in the parser_state structure.
  *
@@ -176,6 +245,15 @@ int parser_check(struct parser_state *ps)
 
 	EXPECT_STATE(state_S);
 	EXPECT_TOKEN(TOK_EOF); /* shall we? */
+
+	/* the whole program is read, now it is checked */
+	if (ps->ast) {
+		ps->ast->root = ps->node;
+		if (!ast_walk(ps->ast, ps->semantic, ps->semantic_check)) {
+			parser_error(ps, PARSER_SEMANTIC_ERROR, NULL);
+			return ERROR;
+		}
+	}
 	return OK;
 }
 
@@ -199,19 +277,30 @@ int state_VariableArrayIndexing(struct parser_state *ps)
 
 int state_Type(struct parser_state *ps, sem_ref_t *rval)
 {
+	struct ast_node *node = NULL;
+
 	EXPECT_TOKEN(TOK_IDENTIFIER);
-	SEMANTIC_HOOK(sem_find_type(ps->semantic, ps->current.repr,
-				ps->current.pending, rval));
+	AST_NODE(node, AST_TYPE);
+	if (node)
+		node->ident = ps->current.ident;
+	SEMANTIC_HOOK_AT(node, 0, sem_find_type(ps->semantic,
+				ps->current.ident, rval));
 	NEXT_TOKEN;
+	AST_RETURN(node);
 	return OK;
 }
 
 int state_VariablesList(struct parser_state *ps)
 {
 	struct string_list *names;
+	struct arena_mark mark;
+	struct ast_node *node = NULL;
 	sem_ref_t rval;
 
-	names = create_string_list();
+	/* the names are dropped once declared (after an error they stay
+	 * until the parser state is destroyed), the tree keeps them */
+	mark = arena_mark(ps->scratch);
+	names = create_string_list(ps->ast ? ps->ast->arena : ps->scratch);
 	if (!names) {
 		parser_error(ps, PARSER_SYSTEM_ERROR, NULL);
 		return ERROR;
@@ -221,9 +310,8 @@ int state_VariablesList(struct parser_state *ps)
 	while (1) {
 		/* EXPECT_STATE(state_DeclOneVariable); */
 		EXPECT_TOKEN(TOK_IDENTIFIER);
-		if (!string_list_add(names, ps->current.repr, ps->current.pending)) {
+		if (!string_list_add(names, ps->current.ident)) {
 			parser_error(ps, PARSER_SYSTEM_ERROR, NULL);
-			destroy_string_list(names);
 			return ERROR;
 		}
 		NEXT_TOKEN;
@@ -237,19 +325,28 @@ int state_VariablesList(struct parser_state *ps)
 	NEXT_TOKEN;
 
 	EXPECT_STATE_VALUE(state_Type, &rval);
-	SEMANTIC_HOOK(sem_decl_var_list(ps->semantic, names, &rval));
+	AST_NODE(node, AST_DECL_VARS);
+	AST_CHILD(node, 0);
+	if (node)
+		node->names = names;
+	SEMANTIC_HOOK_AT(node, 0, sem_decl_var_list(ps->semantic, names,
+				&rval));
 
-	destroy_string_list(names);
+	arena_release(ps->scratch, mark);
 
+	AST_RETURN(node);
 	return OK;
 }
 
 int state_DeclVar(struct parser_state *ps)
 {
+	struct ast_node *list = NULL, **tail = &list;
+
 	/* DeclVars -> var ListaVariaveis { ; ListaVariaveis } ; */
 	EXPECT_TOKEN(TOK_KW_VAR);
 	NEXT_TOKEN;
 	EXPECT_STATE(state_VariablesList);
+	AST_APPEND(tail);
 	EXPECT_TOKEN(TOK_SEMICOLON);
 
 	while (1) {
@@ -262,9 +359,11 @@ int state_DeclVar(struct parser_state *ps)
 			break;
 
 		EXPECT_STATE(state_VariablesList);
+		AST_APPEND(tail);
 		EXPECT_TOKEN(TOK_SEMICOLON);
 	}
 
+	AST_RETURN(list);
 	return OK;
 }
 
@@ -273,34 +372,46 @@ int state_ExpressionList(struct parser_state *ps, sem_ref_t *var);
 
 int state_FatorI(struct parser_state *ps, sem_ref_t *rval)
 {
+	struct ast_node *node = NULL;
 	sem_ref_t var;
 
 	EXPECT_TOKEN(TOK_IDENTIFIER);
-	SEMANTIC_HOOK(sem_hold_var(ps->semantic, ps->current.repr,
-	              ps->current.pending, &var));
+	AST_NODE(node, AST_VARIABLE);
+	if (node)
+		node->ident = ps->current.ident;
+	SEMANTIC_HOOK_AT(node, 0, sem_hold_var(ps->semantic,
+				ps->current.ident, &var));
 	NEXT_TOKEN;
 
 	/* repeated code, keep in sync with Variable */
 	if (ps->current.type == TOK_LPARENTHESIS) {
 		/* a function call */
-		SEMANTIC_HOOK(sem_funcall_prolog(ps->semantic, &var));
+		if (node)
+			node->kind = AST_FUNCALL;
+		SEMANTIC_HOOK_AT(node, 1, sem_funcall_prolog(ps->semantic,
+					&var));
 		NEXT_TOKEN;
 		EXPECT_STATE_VALUE(state_ExpressionList, &var);
+		AST_CHILD(node, 0);
 		EXPECT_TOKEN(TOK_RPARENTHESIS);
-		SEMANTIC_HOOK(sem_call_function(ps->semantic, &var, rval));
+		SEMANTIC_HOOK_AT(node, 2, sem_call_function(ps->semantic,
+					&var, rval));
 		NEXT_TOKEN;
 	}
 	else  {
 		if (ps->current.type == TOK_OPENINGBRACKET)
 			/* TODO array support, changes var */
 			EXPECT_STATE(state_VariableArrayIndexing);
-		SEMANTIC_HOOK(sem_get_var(ps->semantic, &var, rval));
+		SEMANTIC_HOOK_AT(node, 1, sem_get_var(ps->semantic, &var,
+					rval));
 	}
+	AST_RETURN(node);
 	return OK;
 }
 
 int state_Fator(struct parser_state *ps, sem_ref_t *rval)
 {
+	struct ast_node *node = NULL;
 	sem_ref_t left;
 
 	int neg = 0;
@@ -326,22 +437,36 @@ int state_Fator(struct parser_state *ps, sem_ref_t *rval)
 	if (ps->current.type == TOK_IDENTIFIER)
 		EXPECT_STATE_VALUE(state_FatorI, rval);
 	else if (ps->current.type == TOK_INTEGER) {
-		SEMANTIC_HOOK(sem_put_integer(ps->semantic,
+		AST_NODE(node, AST_INTEGER);
+		if (node)
+			node->value.integer =
+				NEGVAL(neg, ps->current.token.integer);
+		SEMANTIC_HOOK_AT(node, 0, sem_put_integer(ps->semantic,
 					NEGVAL(neg, ps->current.token.integer),
 					rval));
 		NEXT_TOKEN;
+		AST_RETURN(node);
 	}
 	else if (ps->current.type == TOK_REAL) {
-		SEMANTIC_HOOK(sem_put_real(ps->semantic,
+		AST_NODE(node, AST_REAL);
+		if (node)
+			node->value.real = NEGVAL(neg, ps->current.token.real);
+		SEMANTIC_HOOK_AT(node, 0, sem_put_real(ps->semantic,
 					NEGVAL(neg, ps->current.token.real),
 					rval));
 		NEXT_TOKEN;
+		AST_RETURN(node);
 	}
 	else if (ps->current.type == TOK_CHAR) {
-		SEMANTIC_HOOK(sem_put_char(ps->semantic,
+		AST_NODE(node, AST_CHAR);
+		if (node)
+			node->value.character =
+				NEGVAL(neg, ps->current.repr[0]);
+		SEMANTIC_HOOK_AT(node, 0, sem_put_char(ps->semantic,
 					NEGVAL(neg, ps->current.repr[0]),
 					rval));
 		NEXT_TOKEN;
+		AST_RETURN(node);
 	}
 	else if (ps->current.type == TOK_LPARENTHESIS) {
 		NEXT_TOKEN;
@@ -350,10 +475,14 @@ int state_Fator(struct parser_state *ps, sem_ref_t *rval)
 		NEXT_TOKEN;
 	}
 	else if (ps->current.type == TOK_KW_NOT) {
+		AST_NODE(node, AST_NOT);
 		NEXT_TOKEN;
 		EXPECT_STATE_VALUE(state_Fator, rval);
+		AST_CHILD(node, 0);
 		left = *rval;
-		SEMANTIC_HOOK(sem_not_value(ps->semantic, &left, rval));
+		SEMANTIC_HOOK_AT(node, 0, sem_not_value(ps->semantic, &left,
+					rval));
+		AST_RETURN(node);
 	}
 	else {
 		parser_error(ps, PARSER_UNEXPECTED_TOKEN, "fator tokens");
@@ -366,6 +495,7 @@ int state_Fator(struct parser_state *ps, sem_ref_t *rval)
 int state_Term(struct parser_state *ps, sem_ref_t *rval)
 {
 	enum token_t operator;
+	struct ast_node *node = NULL;
 	sem_ref_t left, right;
 
 	EXPECT_STATE_VALUE(state_Fator, &left);
@@ -376,29 +506,43 @@ int state_Term(struct parser_state *ps, sem_ref_t *rval)
 			|| ps->current.type == TOK_KW_AND
 			|| ps->current.type == TOK_KW_MOD) {
 		operator = ps->current.type;
+		AST_NODE(node, AST_BINARY);
+		if (node) {
+			node->value.op = operator;
+			node->child[0] = ps->node;
+		}
 		NEXT_TOKEN;
+		if (operator == TOK_KW_AND)
+			SEMANTIC_HOOK_AT(node, 0,
+					sem_boolcmp_operand(ps->semantic,
+						&left));
 		EXPECT_STATE_VALUE(state_Fator, &right);
+		AST_CHILD(node, 1);
 
 		switch (operator) {
 		case TOK_ASTERISK:
-			SEMANTIC_HOOK(sem_mul_values(ps->semantic, &left,
-						&right, rval));
+			SEMANTIC_HOOK_AT(node, 1, sem_mul_values(ps->semantic,
+						&left, &right, rval));
 			break;
 		case TOK_KW_DIV:
-			SEMANTIC_HOOK(sem_div_values(ps->semantic, &left,
-						&right, rval));
+			SEMANTIC_HOOK_AT(node, 1, sem_div_values(ps->semantic,
+						&left, &right, rval));
 			break;
 		case TOK_KW_MOD:
-			SEMANTIC_HOOK(sem_mod_values(ps->semantic, &left,
-						&right, rval));
+			SEMANTIC_HOOK_AT(node, 1, sem_mod_values(ps->semantic,
+						&left, &right, rval));
 			break;
 		case TOK_KW_AND:
-			SEMANTIC_HOOK(sem_boolcmp_values(ps->semantic,
+			SEMANTIC_HOOK_AT(node, 1,
+					sem_boolcmp_values(ps->semantic,
 						SEMANTIC_BOOL_AND, &left,
 						&right, rval));
 			break;
 		default: break;
 		}
+		/* the next operation is done on the result of this one */
+		left = *rval;
+		AST_RETURN(node);
 	}
 
 	return OK;
@@ -407,6 +551,7 @@ int state_Term(struct parser_state *ps, sem_ref_t *rval)
 int state_SimpleExpression(struct parser_state *ps, sem_ref_t *rval)
 {
 	enum token_t oper;
+	struct ast_node *node = NULL;
 	sem_ref_t left, right;
 	int invert = 0;
 
@@ -439,33 +584,51 @@ int state_SimpleExpression(struct parser_state *ps, sem_ref_t *rval)
 	}
 
 	EXPECT_STATE_VALUE(state_Term, &left);
+	if (invert) {
+		AST_NODE(node, AST_INVERT);
+		AST_CHILD(node, 0);
+		SEMANTIC_HOOK_AT(node, 0, sem_invert_value(ps->semantic,
+					&left));
+		AST_RETURN(node);
+	}
 	*rval = left;
 
-	if (invert)
-		SEMANTIC_HOOK(sem_invert_value(ps->semantic, &left));
-
 	while (ps->current.type == TOK_PLUS
 			|| ps->current.type == TOK_MINUS
 			|| ps->current.type == TOK_KW_OR) {
 		oper = ps->current.type;
+		AST_NODE(node, AST_BINARY);
+		if (node) {
+			node->value.op = oper;
+			node->child[0] = ps->node;
+		}
 		NEXT_TOKEN;
+		if (oper == TOK_KW_OR)
+			SEMANTIC_HOOK_AT(node, 0,
+					sem_boolcmp_operand(ps->semantic,
+						&left));
 		EXPECT_STATE_VALUE(state_Term, &right);
+		AST_CHILD(node, 1);
 		switch (oper) {
 		case TOK_PLUS:
-			SEMANTIC_HOOK(sem_sum_values(ps->semantic, &left,
-						&right, rval));
+			SEMANTIC_HOOK_AT(node, 1, sem_sum_values(ps->semantic,
+						&left, &right, rval));
 			break;
 		case TOK_MINUS:
-			SEMANTIC_HOOK(sem_subt_values(ps->semantic, &left,
-						&right, rval));
+			SEMANTIC_HOOK_AT(node, 1, sem_subt_values(ps->semantic,
+						&left, &right, rval));
 			break;
 		case TOK_KW_OR:
-			SEMANTIC_HOOK(sem_boolcmp_values(ps->semantic,
+			SEMANTIC_HOOK_AT(node, 1,
+					sem_boolcmp_values(ps->semantic,
 						SEMANTIC_BOOL_OR, &left,
 						&right, rval));
 			break;
 		default: break;
 		}
+		/* the next operation is done on the result of this one */
+		left = *rval;
+		AST_RETURN(node);
 	}
 
 	return OK;
@@ -475,6 +638,7 @@ int state_Expression(struct parser_state *ps, sem_ref_t *rval)
 {                          
 	enum token_t operator;
 	enum semantic_cmp_operators semop;
+	struct ast_node *node = NULL;
 	sem_ref_t left, right;
 
 	/* Expressao -> ExpressaoSimples [ OpRelacao ExpressaoSimples ] */
@@ -483,8 +647,14 @@ int state_Expression(struct parser_state *ps, sem_ref_t *rval)
 
 	if (IS_RELATIONALOP(ps->current.type)) {
 		operator = ps->current.type;
+		AST_NODE(node, AST_BINARY);
+		if (node) {
+			node->value.op = operator;
+			node->child[0] = ps->node;
+		}
 		NEXT_TOKEN;
 		EXPECT_STATE_VALUE(state_SimpleExpression, &right);
+		AST_CHILD(node, 1);
 
 		switch (operator) {
 		/* keep in sync with IS_RELATIONALOP */
@@ -510,9 +680,9 @@ int state_Expression(struct parser_state *ps, sem_ref_t *rval)
 			break;
 		}
 
-		SEMANTIC_HOOK(sem_relcmp_values(ps->semantic,
-					semop, &left,
-					&right, rval));
+		SEMANTIC_HOOK_AT(node, 1, sem_relcmp_values(ps->semantic,
+					semop, &left, &right, rval));
+		AST_RETURN(node);
 	}
 	
 	return OK;
@@ -522,82 +692,111 @@ int state_Command(struct parser_state *ps);
 
 int state_ConditionalCom(struct parser_state *ps)
 {
+	struct ast_node *node = NULL;
 	sem_ref_t rval;
 	sem_ref_t holdpos;
 
 	EXPECT_TOKEN(TOK_KW_IF);
-	SEMANTIC_HOOK(sem_cond_prolog(ps->semantic,  &holdpos));
+	AST_NODE(node, AST_CONDITIONAL);
+	SEMANTIC_HOOK_AT(node, 0, sem_cond_prolog(ps->semantic,  &holdpos));
 	NEXT_TOKEN;
 	EXPECT_STATE_VALUE(state_Expression, &rval);
-	SEMANTIC_HOOK(sem_cond_eval(ps->semantic, &rval, &holdpos));
+	AST_CHILD(node, 0);
+	SEMANTIC_HOOK_AT(node, 1, sem_cond_eval(ps->semantic, &rval,
+				&holdpos));
 	/* TODO evaluate the value */
 	EXPECT_TOKEN(TOK_KW_THEN);
 	NEXT_TOKEN;
 	EXPECT_STATE(state_Command);
+	AST_CHILD(node, 1);
 	if(ps->current.type == TOK_KW_ELSE) {
-		SEMANTIC_HOOK(sem_cond_else(ps->semantic, &holdpos));
+		SEMANTIC_HOOK_AT(node, 2, sem_cond_else(ps->semantic,
+					&holdpos));
 		NEXT_TOKEN;
 		EXPECT_STATE(state_Command);
+		AST_CHILD(node, 2);
 	}
-	SEMANTIC_HOOK(sem_cond_epilog(ps->semantic, &holdpos));
+	SEMANTIC_HOOK_AT(node, 3, sem_cond_epilog(ps->semantic, &holdpos));
+	AST_RETURN(node);
 	return OK;
 }
 
 int state_RepeatCom(struct parser_state *ps)
 {
+	struct ast_node *node = NULL, *list = NULL, **tail = &list;
 	sem_ref_t rval;
 	sem_ref_t holdpos;
 
 	if (ps->current.type == TOK_KW_WHILE) {
-		SEMANTIC_HOOK(sem_while_prolog(ps->semantic, &holdpos));
+		AST_NODE(node, AST_WHILE);
+		SEMANTIC_HOOK_AT(node, 0, sem_while_prolog(ps->semantic,
+					&holdpos));
 		NEXT_TOKEN;
 		EXPECT_STATE_VALUE(state_Expression, &rval);
-		SEMANTIC_HOOK(sem_while_eval(ps->semantic, &rval, &holdpos));
+		AST_CHILD(node, 0);
+		SEMANTIC_HOOK_AT(node, 1, sem_while_eval(ps->semantic, &rval,
+					&holdpos));
 		EXPECT_TOKEN(TOK_KW_DO);
 		NEXT_TOKEN;
 		EXPECT_STATE(state_Command);
-		SEMANTIC_HOOK(sem_while_epilog(ps->semantic, &holdpos));
+		AST_CHILD(node, 1);
+		SEMANTIC_HOOK_AT(node, 2, sem_while_epilog(ps->semantic,
+					&holdpos));
 	}
 	else if (ps->current.type == TOK_KW_REPEAT) {
-		SEMANTIC_HOOK(sem_repeat_prolog(ps->semantic, &holdpos));
+		AST_NODE(node, AST_REPEAT);
+		SEMANTIC_HOOK_AT(node, 0, sem_repeat_prolog(ps->semantic,
+					&holdpos));
 		NEXT_TOKEN;
 
 		/* The repeat block is exceptional: it doesn't require more
 		 * than one "command" to be grouped using begin and end
 		 * keywords. */
 		EXPECT_STATE(state_Command);
+		AST_APPEND(tail);
 		while (ps->current.type != TOK_KW_UNTIL) {
 			EXPECT_TOKEN(TOK_SEMICOLON);
 			NEXT_TOKEN;
 			if (ps->current.type == TOK_KW_UNTIL)
 				break;
 			EXPECT_STATE(state_Command);
+			AST_APPEND(tail);
 		}
 
 		EXPECT_TOKEN(TOK_KW_UNTIL);
 		NEXT_TOKEN;
 		EXPECT_STATE_VALUE(state_Expression, &rval);
-		SEMANTIC_HOOK(sem_repeat_eval(ps->semantic, &rval,
+		AST_CHILD(node, 0);
+		if (node)
+			node->child[1] = list;
+		SEMANTIC_HOOK_AT(node, 1, sem_repeat_eval(ps->semantic, &rval,
 					&holdpos));
 	}
 	else {
 		parser_error(ps, PARSER_UNEXPECTED_TOKEN, MANY_TOKENS);
 		return ERROR;
 	}
+	AST_RETURN(node);
 	return OK;
 }
 
 int state_BranchingCommand(struct parser_state *ps)
 {
+	struct ast_node *node = NULL;
 	sem_ref_t var;
 
 	EXPECT_TOKEN(TOK_KW_GOTO);
 	NEXT_TOKEN;
 	EXPECT_TOKEN(TOK_INTEGER);
-	SEMANTIC_HOOK(sem_hold_var(ps->semantic, ps->current.repr,
-				ps->current.pending, &var));
-	SEMANTIC_HOOK(sem_goto_label(ps->semantic, &var));
+	INTERN_LABEL;
+	AST_NODE(node, AST_GOTO);
+	if (node)
+		node->ident = ps->current.ident;
+	SEMANTIC_HOOK_AT(node, 0, sem_hold_var(ps->semantic,
+				ps->current.ident, &var));
+	SEMANTIC_HOOK_AT(node, 0, sem_goto_label(ps->semantic, &var));
 	NEXT_TOKEN;
+	AST_RETURN(node);
 	return OK;
 }
 
@@ -610,14 +809,15 @@ int state_Const(struct parser_state *ps)
 
 int state_DefineConst(struct parser_state *ps)
 {   
-	size_t size;
-	char name[BUFSIZ];
+	ident_t name;
+	struct ast_node *node = NULL, *value = NULL;
 	int neg = 0;
 
 	EXPECT_TOKEN(TOK_IDENTIFIER);
-
-	strncpy(name, ps->current.repr, BUFSIZ-1);
-	size = ps->current.pending;
+	name = ps->current.ident;
+	AST_NODE(node, AST_DECL_CONST);
+	if (node)
+		node->ident = name;
 
 	NEXT_TOKEN;
 	EXPECT_TOKEN(TOK_EQUAL);
@@ -630,31 +830,50 @@ int state_DefineConst(struct parser_state *ps)
 
 	switch (ps->current.type) {
 	case TOK_INTEGER:
-		SEMANTIC_HOOK(sem_decl_const_int(ps->semantic, name, size,
+		AST_NODE(value, AST_INTEGER);
+		if (value)
+			value->value.integer =
+				NEGVAL(neg, ps->current.token.integer);
+		SEMANTIC_HOOK_AT(node, 0, sem_decl_const_int(ps->semantic,
+					name,
 					NEGVAL(neg, ps->current.token.integer)));
 		break;
 	case TOK_REAL:
-		SEMANTIC_HOOK(sem_decl_const_real(ps->semantic, name, size,
+		AST_NODE(value, AST_REAL);
+		if (value)
+			value->value.real = NEGVAL(neg, ps->current.token.real);
+		SEMANTIC_HOOK_AT(node, 0, sem_decl_const_real(ps->semantic,
+					name,
 					NEGVAL(neg, ps->current.token.real)));
 		break;
 	case TOK_CHAR:
-		SEMANTIC_HOOK(sem_decl_const_char(ps->semantic, name, size,
-					NEGVAL(neg, ps->current.repr[0])));
+		AST_NODE(value, AST_CHAR);
+		if (value)
+			value->value.character =
+				NEGVAL(neg, ps->current.repr[0]);
+		SEMANTIC_HOOK_AT(node, 0, sem_decl_const_char(ps->semantic,
+					name, NEGVAL(neg, ps->current.repr[0])));
 		break;
 	default:
 		parser_error(ps, PARSER_UNEXPECTED_TOKEN, MANY_TOKENS);
 		return ERROR;
 	}
+	if (node)
+		node->child[0] = value;
 
 	NEXT_TOKEN;
+	AST_RETURN(node);
 	return OK;
 }
 
 int state_DeclConst(struct parser_state *ps)
 {
+	struct ast_node *list = NULL, **tail = &list;
+
 	EXPECT_TOKEN(TOK_KW_CONST);
 	NEXT_TOKEN;
 	EXPECT_STATE(state_DefineConst);
+	AST_APPEND(tail);
 	EXPECT_TOKEN(TOK_SEMICOLON);
 
 	while (1) {
@@ -665,40 +884,58 @@ int state_DeclConst(struct parser_state *ps)
 			break;
 
 		EXPECT_STATE(state_DefineConst);
+		AST_APPEND(tail);
 		EXPECT_TOKEN(TOK_SEMICOLON);
 	}
 
+	AST_RETURN(list);
 	return OK;
 }
 
 int state_DeclLabels(struct parser_state *ps)
 {
+	struct ast_node *node = NULL, *list = NULL, **tail = &list;
+
 	EXPECT_TOKEN(TOK_KW_LABEL);
 	NEXT_TOKEN;
 	EXPECT_TOKEN(TOK_INTEGER);
-	SEMANTIC_HOOK(sem_decl_label(ps->semantic,
-				ps->current.repr, ps->current.pending));
+	INTERN_LABEL;
+	AST_NODE(node, AST_DECL_LABEL);
+	if (node)
+		node->ident = ps->current.ident;
+	SEMANTIC_HOOK_AT(node, 0, sem_decl_label(ps->semantic,
+				ps->current.ident));
+	AST_ADD(tail, node);
 	NEXT_TOKEN;
 	while (ps->current.type == TOK_COMMA) {
 		EXPECT_TOKEN(TOK_COMMA);
 		NEXT_TOKEN;
 		EXPECT_TOKEN(TOK_INTEGER);
-		SEMANTIC_HOOK(sem_decl_label(ps->semantic,
-					ps->current.repr, ps->current.pending));
+		INTERN_LABEL;
+		AST_NODE(node, AST_DECL_LABEL);
+		if (node)
+			node->ident = ps->current.ident;
+		SEMANTIC_HOOK_AT(node, 0, sem_decl_label(ps->semantic,
+					ps->current.ident));
+		AST_ADD(tail, node);
 		NEXT_TOKEN;
 	}
 	EXPECT_TOKEN(TOK_SEMICOLON);
 	NEXT_TOKEN;
+	AST_RETURN(list);
 	return OK;
 }
 
 int state_ExpressionList(struct parser_state *ps, sem_ref_t *var)
 {
+	struct ast_node *node = NULL, *arg = NULL, *list = NULL, **tail = &list;
 	sem_ref_t rval, expritem, ref;
 	int ignoreref;
 	int loop = 0;
 
-	SEMANTIC_HOOK(sem_begin_expr_list(ps->semantic, var, &expritem, &ref));
+	AST_NODE(node, AST_ARGUMENTS);
+	SEMANTIC_HOOK_AT(node, 0, sem_begin_expr_list(ps->semantic, var,
+				&expritem, &ref));
 
 	do {
 		if (loop)
@@ -707,32 +944,45 @@ int state_ExpressionList(struct parser_state *ps, sem_ref_t *var)
 			loop = 1;
 
 		ignoreref = 1;
+		AST_NODE(arg, AST_ARGUMENT);
 
 		if (ps->current.type == TOK_IDENTIFIER) {
 			/* More crap: give a hint to the semantic checker
 			 * that this parameter can be passed as reference
 			 * to the called function. */
-			SEMANTIC_HOOK(sem_hold_var(ps->semantic,
-						ps->current.repr,
-						ps->current.pending,
+			if (arg) {
+				arg->flags |= AST_IDENT_FIRST;
+				arg->ident = ps->current.ident;
+			}
+			SEMANTIC_HOOK_AT(arg, 0, sem_hold_var(ps->semantic,
+						ps->current.ident,
 						&ref));
-			SEMANTIC_HOOK(sem_check_ref(ps->semantic,
+			SEMANTIC_HOOK_AT(arg, 0, sem_check_ref(ps->semantic,
 						&expritem, &ref,
 						&rval, &ignoreref));
 		}
 
-		if (ignoreref)
+		/* the tree always has the expression, ast_walk() does
+		 * the check */
+		if (ignoreref) {
 			EXPECT_STATE_VALUE(state_Expression, &rval);
+			AST_CHILD(arg, 0);
+		}
 		else
 			NEXT_TOKEN;
 
-		SEMANTIC_HOOK(sem_expr_list_item(ps->semantic, var,
+		SEMANTIC_HOOK_AT(arg, 1, sem_expr_list_item(ps->semantic, var,
 					&expritem, &rval, &ref));
+		AST_ADD(tail, arg);
 
 	} while (ps->current.type == TOK_COMMA);
 
-	SEMANTIC_HOOK(sem_end_expr_list(ps->semantic, var, &expritem));
+	if (node)
+		node->child[0] = list;
+	SEMANTIC_HOOK_AT(node, 1, sem_end_expr_list(ps->semantic, var,
+				&expritem));
 
+	AST_RETURN(node);
 	return OK;
 }
 
@@ -746,17 +996,20 @@ int state_AssignmentAfterIdentifier(struct parser_state *ps)
  */
 int state_Command_ProcedureCallOrAssignment(struct parser_state *ps)
 {
+	struct ast_node *node = NULL;
 	sem_ref_t var, rval;
 	/* FIXME split these functions and pass the identifier token as an
 	 * argument. 
 	 *
-	 * We will be in trouble when we start working on the syntax tree,
-	 * because Assignment will have to know the identifier being
-	 * handled.
+	 * The syntax tree has one node for both, which becomes AST_CALL when
+	 * no assignment follows the identifier.
 	 */
 	EXPECT_TOKEN(TOK_IDENTIFIER);
-	SEMANTIC_HOOK(sem_hold_var(ps->semantic, ps->current.repr,
-				ps->current.pending, &var));
+	AST_NODE(node, AST_ASSIGNMENT);
+	if (node)
+		node->ident = ps->current.ident;
+	SEMANTIC_HOOK_AT(node, 0, sem_hold_var(ps->semantic,
+				ps->current.ident, &var));
 	NEXT_TOKEN;
 
 	if (ps->current.type == TOK_OPENINGBRACKET
@@ -774,41 +1027,55 @@ int state_Command_ProcedureCallOrAssignment(struct parser_state *ps)
 		EXPECT_TOKEN(TOK_ASSIGNMENT);
 		NEXT_TOKEN;
 		EXPECT_STATE_VALUE(state_Expression, &rval);
-		SEMANTIC_HOOK(sem_var_assignment(ps->semantic, &var,
-					&rval));
+		AST_CHILD(node, 0);
+		SEMANTIC_HOOK_AT(node, 1, sem_var_assignment(ps->semantic,
+					&var, &rval));
 	}
 	else {
 		/* a procedure or function call */
+		if (node)
+			node->kind = AST_CALL;
 
-		SEMANTIC_HOOK(sem_funcall_prolog(ps->semantic, &var));
+		SEMANTIC_HOOK_AT(node, 1, sem_funcall_prolog(ps->semantic,
+					&var));
 
 		if (ps->current.type == TOK_LPARENTHESIS) {
 			NEXT_TOKEN;
 			EXPECT_STATE_VALUE(state_ExpressionList, &var);
+			AST_CHILD(node, 0);
 			EXPECT_TOKEN(TOK_RPARENTHESIS);
 			NEXT_TOKEN;
 		}
 
 		/* a procedure or function call without parameters */
-		SEMANTIC_HOOK(sem_call_function(ps->semantic, &var,
-					&rval));
+		SEMANTIC_HOOK_AT(node, 2, sem_call_function(ps->semantic,
+					&var, &rval));
 
-		SEMANTIC_HOOK(sem_funcall_cleanup(ps->semantic, &var, 1));
+		SEMANTIC_HOOK_AT(node, 2, sem_funcall_cleanup(ps->semantic,
+					&var, 1));
 	}
 
+	AST_RETURN(node);
 	return OK;
 }
 
 int state_Parameters(struct parser_state *ps)
 {
+	struct ast_node *node = NULL;
+
+	AST_NODE(node, AST_PARAMS);
 	if (ps->current.type == TOK_KW_VAR) {
 		EXPECT_TOKEN(TOK_KW_VAR); /* just to see it in the dump */
-		SEMANTIC_HOOK(sem_set_byref_param(ps->semantic));
+		if (node)
+			node->flags |= AST_BYREF;
+		SEMANTIC_HOOK_AT(node, 0, sem_set_byref_param(ps->semantic));
 		NEXT_TOKEN;
 	}
 
 	EXPECT_STATE(state_VariablesList);
-	SEMANTIC_HOOK(sem_set_byval_param(ps->semantic));
+	AST_CHILD(node, 0);
+	SEMANTIC_HOOK_AT(node, 1, sem_set_byval_param(ps->semantic));
+	AST_RETURN(node);
 	return OK;
 }
 
@@ -816,104 +1083,137 @@ int state_Block(struct parser_state*);
 
 int state_DeclProcedure(struct parser_state *ps)
 { 
+	struct ast_node *node = NULL, *list = NULL, **tail = &list;
 	sem_ref_t var;
 
 	EXPECT_TOKEN(TOK_KW_PROCEDURE);
 	NEXT_TOKEN;
 	EXPECT_TOKEN(TOK_IDENTIFIER);
-	SEMANTIC_HOOK(sem_decl_procedure(ps->semantic, ps->current.repr,
-				ps->current.pending, &var));
+	AST_NODE(node, AST_DECL_PROCEDURE);
+	if (node)
+		node->ident = ps->current.ident;
+	SEMANTIC_HOOK_AT(node, 0, sem_decl_procedure(ps->semantic,
+				ps->current.ident, &var));
 	NEXT_TOKEN;
 
 	if (ps->current.type == TOK_LPARENTHESIS) {
 		/* shouldn't we have a separated state for it */
 		EXPECT_TOKEN(TOK_LPARENTHESIS);
 		NEXT_TOKEN;
-		SEMANTIC_HOOK(sem_begin_params(ps->semantic, &var));
+		SEMANTIC_HOOK_AT(node, 1, sem_begin_params(ps->semantic,
+					&var));
 		EXPECT_STATE(state_Parameters);
+		AST_APPEND(tail);
 		while (ps->current.type != TOK_RPARENTHESIS) {
 			EXPECT_TOKEN(TOK_SEMICOLON);
 			NEXT_TOKEN;
 			EXPECT_STATE(state_Parameters);
+			AST_APPEND(tail);
 		}
 		EXPECT_TOKEN(TOK_RPARENTHESIS);
 		NEXT_TOKEN;
 
-		SEMANTIC_HOOK(sem_finish_params(ps->semantic, &var));
+		if (node)
+			node->child[0] = list;
+		SEMANTIC_HOOK_AT(node, 2, sem_finish_params(ps->semantic,
+					&var));
 	}
 
 	EXPECT_TOKEN(TOK_SEMICOLON);
 	NEXT_TOKEN;
 	EXPECT_STATE(state_Block);
+	AST_CHILD(node, 2);
 
-	SEMANTIC_HOOK(sem_finish_procedure(ps->semantic, &var));
+	SEMANTIC_HOOK_AT(node, 3, sem_finish_procedure(ps->semantic, &var));
 
+	AST_RETURN(node);
 	return OK;
 }
 
 int state_DeclFunction(struct parser_state *ps)
 {
+	struct ast_node *node = NULL, *list = NULL, **tail = &list;
 	sem_ref_t var, type;
 
 	/* TODO merge the repeated code between procedure and function */
 	EXPECT_TOKEN(TOK_KW_FUNCTION);
 	NEXT_TOKEN;
 	EXPECT_TOKEN(TOK_IDENTIFIER);
-	SEMANTIC_HOOK(sem_decl_function(ps->semantic, ps->current.repr,
-				ps->current.pending, &var));
+	AST_NODE(node, AST_DECL_FUNCTION);
+	if (node)
+		node->ident = ps->current.ident;
+	SEMANTIC_HOOK_AT(node, 0, sem_decl_function(ps->semantic,
+				ps->current.ident, &var));
 	NEXT_TOKEN;
 
 	if (ps->current.type == TOK_LPARENTHESIS) {
 		/* shouldn't we have a separated state for it */
 		EXPECT_TOKEN(TOK_LPARENTHESIS);
 		NEXT_TOKEN;
-		SEMANTIC_HOOK(sem_begin_params(ps->semantic, &var));
+		SEMANTIC_HOOK_AT(node, 1, sem_begin_params(ps->semantic,
+					&var));
 		EXPECT_STATE(state_Parameters);
+		AST_APPEND(tail);
 		while (ps->current.type != TOK_RPARENTHESIS) {
 			EXPECT_TOKEN(TOK_SEMICOLON);
 			NEXT_TOKEN;
 			EXPECT_STATE(state_Parameters);
+			AST_APPEND(tail);
 		}
 		EXPECT_TOKEN(TOK_RPARENTHESIS);
 		NEXT_TOKEN;
 
-		SEMANTIC_HOOK(sem_finish_params(ps->semantic, &var));
+		if (node)
+			node->child[0] = list;
+		SEMANTIC_HOOK_AT(node, 2, sem_finish_params(ps->semantic,
+					&var));
 	}
 
 	EXPECT_TOKEN(TOK_COLON);
 	NEXT_TOKEN;
 	EXPECT_STATE_VALUE(state_Type, &type);
+	AST_CHILD(node, 1);
 
-	SEMANTIC_HOOK(sem_function_type(ps->semantic, &var, &type));
+	SEMANTIC_HOOK_AT(ps->node, 1, sem_function_type(ps->semantic, &var,
+				&type));
 
 	EXPECT_TOKEN(TOK_SEMICOLON);
 	NEXT_TOKEN;
 	EXPECT_STATE(state_Block);
+	AST_CHILD(node, 2);
 
-	SEMANTIC_HOOK(sem_finish_procedure(ps->semantic, &var));
+	SEMANTIC_HOOK_AT(node, 3, sem_finish_procedure(ps->semantic, &var));
 
+	AST_RETURN(node);
 	return OK;
 }
 
 int state_DeclSub(struct parser_state *ps)
 {
+	struct ast_node *list = NULL, **tail = &list;
+
 	while (ps->current.type == TOK_KW_PROCEDURE 
 			|| ps->current.type == TOK_KW_FUNCTION) {
 		if (ps->current.type == TOK_KW_PROCEDURE)
 			EXPECT_STATE(state_DeclProcedure);
 		else
 			EXPECT_STATE(state_DeclFunction);
+		AST_APPEND(tail);
 		EXPECT_TOKEN(TOK_SEMICOLON);
 		NEXT_TOKEN;
 	}
+	AST_RETURN(list);
 	return OK;
 }
 
 int state_ReadCommand(struct parser_state *ps)
 {
+	struct ast_node *node = NULL, *item = NULL, *list = NULL;
+	struct ast_node **tail = &list;
 	sem_ref_t var;
 
 	EXPECT_TOKEN(TOK_KW_READ);
+	AST_NODE(node, AST_READ);
 	NEXT_TOKEN;
 	EXPECT_TOKEN(TOK_LPARENTHESIS);
 	NEXT_TOKEN;
@@ -925,9 +1225,13 @@ int state_ReadCommand(struct parser_state *ps)
 			return ERROR;
 		}
 
-		SEMANTIC_HOOK(sem_hold_var(ps->semantic, ps->current.repr,
-					ps->current.pending, &var));
-		SEMANTIC_HOOK(sem_read_var(ps->semantic, &var));
+		AST_NODE(item, AST_VARIABLE);
+		if (item)
+			item->ident = ps->current.ident;
+		SEMANTIC_HOOK_AT(item, 0, sem_hold_var(ps->semantic,
+					ps->current.ident, &var));
+		SEMANTIC_HOOK_AT(item, 0, sem_read_var(ps->semantic, &var));
+		AST_ADD(tail, item);
 
 		NEXT_TOKEN;
 		if (ps->current.type == TOK_RPARENTHESIS)
@@ -937,16 +1241,22 @@ int state_ReadCommand(struct parser_state *ps)
 		NEXT_TOKEN;
 	}
 	EXPECT_TOKEN(TOK_RPARENTHESIS);
+	if (node)
+		node->child[0] = list;
 	
 	NEXT_TOKEN;
+	AST_RETURN(node);
 	return OK;
 }
 
 int state_WriteCommand(struct parser_state *ps)
 {
+	struct ast_node *node = NULL, *item = NULL, *list = NULL;
+	struct ast_node **tail = &list;
 	sem_ref_t rval;
 
 	EXPECT_TOKEN(TOK_KW_WRITE);
+	AST_NODE(node, AST_WRITE);
 	NEXT_TOKEN;
 	EXPECT_TOKEN(TOK_LPARENTHESIS);
 	NEXT_TOKEN;
@@ -954,7 +1264,10 @@ int state_WriteCommand(struct parser_state *ps)
 	while (ps->current.type != TOK_RPARENTHESIS) {
 
 		EXPECT_STATE_VALUE(state_Expression, &rval);
-		SEMANTIC_HOOK(sem_write_value(ps->semantic, &rval));
+		AST_NODE(item, AST_VALUE);
+		AST_CHILD(item, 0);
+		SEMANTIC_HOOK_AT(item, 0, sem_write_value(ps->semantic, &rval));
+		AST_ADD(tail, item);
 
 		if (ps->current.type == TOK_RPARENTHESIS)
 			break;
@@ -963,8 +1276,11 @@ int state_WriteCommand(struct parser_state *ps)
 		NEXT_TOKEN;
 	}
 	EXPECT_TOKEN(TOK_RPARENTHESIS);
+	if (node)
+		node->child[0] = list;
 	
 	NEXT_TOKEN;
+	AST_RETURN(node);
 	return OK;
 }
 
@@ -972,16 +1288,21 @@ int state_CommandBlock(struct parser_state*);
 
 int state_Command(struct parser_state *ps)
 {
+	struct ast_node *label = NULL;
 	sem_ref_t var;
 
 	/* Comando -> [Label:] Atribuicao | ComandoComposto */
 	if (ps->current.type == TOK_INTEGER) {
 		/* Label "instantiation" */
-		SEMANTIC_HOOK(sem_hold_var(ps->semantic, ps->current.repr,
-					ps->current.pending, &var));
+		INTERN_LABEL;
+		AST_NODE(label, AST_LABELED);
+		if (label)
+			label->ident = ps->current.ident;
+		SEMANTIC_HOOK_AT(label, 0, sem_hold_var(ps->semantic,
+					ps->current.ident, &var));
 		NEXT_TOKEN;
 		EXPECT_TOKEN(TOK_COLON);
-		SEMANTIC_HOOK(sem_inst_label(ps->semantic, &var));
+		SEMANTIC_HOOK_AT(label, 1, sem_inst_label(ps->semantic, &var));
 		NEXT_TOKEN;
 	}
 
@@ -1005,16 +1326,24 @@ int state_Command(struct parser_state *ps)
 				"begin or an assignment");
 		return ERROR;
 	}
+	if (label) {
+		label->child[0] = ps->node;
+		AST_RETURN(label);
+	}
 	return OK;
 }
 
 int state_CommandBlock(struct parser_state *ps)
 {
+	struct ast_node *node = NULL, *list = NULL, **tail = &list;
+
 	/* ComComposto -> begin Comando { ; Comando } end */
 	EXPECT_TOKEN(TOK_KW_BEGIN);
+	AST_NODE(node, AST_COMMAND_BLOCK);
 
 	NEXT_TOKEN;
 	EXPECT_STATE(state_Command);
+	AST_APPEND(tail);
 
 	while (ps->current.type != TOK_KW_END) {
 		EXPECT_TOKEN(TOK_SEMICOLON);
@@ -1032,30 +1361,49 @@ int state_CommandBlock(struct parser_state *ps)
 			break;
 
 		EXPECT_STATE(state_Command);
+		AST_APPEND(tail);
 	}
 
 	EXPECT_TOKEN(TOK_KW_END);
+	if (node)
+		node->child[0] = list;
 
 	NEXT_TOKEN;
+	AST_RETURN(node);
 	return OK;
 }
 
 int state_Block(struct parser_state *ps)
 {
-	if (ps->current.type == TOK_KW_LABEL)
+	struct ast_node *node = NULL, *list = NULL, **tail = &list;
+
+	if (ps->current.type == TOK_KW_LABEL) {
 		EXPECT_STATE(state_DeclLabels);
-	if (ps->current.type == TOK_KW_CONST)
+		AST_APPEND(tail);
+	}
+	if (ps->current.type == TOK_KW_CONST) {
 		EXPECT_STATE(state_DeclConst);
-	if (ps->current.type == TOK_KW_VAR)
+		AST_APPEND(tail);
+	}
+	if (ps->current.type == TOK_KW_VAR) {
 		EXPECT_STATE(state_DeclVar);
+		AST_APPEND(tail);
+	}
 	if (ps->current.type == TOK_KW_PROCEDURE
-			|| ps->current.type == TOK_KW_FUNCTION)
+			|| ps->current.type == TOK_KW_FUNCTION) {
 		EXPECT_STATE(state_DeclSub);
+		AST_APPEND(tail);
+	}
 
-	SEMANTIC_HOOK(sem_begin_code_block(ps->semantic));
+	AST_NODE(node, AST_BLOCK);
+	if (node)
+		node->child[0] = list;
+	SEMANTIC_HOOK_AT(node, 0, sem_begin_code_block(ps->semantic));
 
 	EXPECT_STATE(state_CommandBlock);
+	AST_CHILD(node, 1);
 
+	AST_RETURN(node);
 	return OK;
 }
 
@@ -1071,12 +1419,17 @@ int state_Block(struct parser_state *ps)
  */
 int state_S(struct parser_state *ps)
 {
+	struct ast_node *node = NULL;
+
 	EXPECT_TOKEN(TOK_KW_PROGRAM);
 	NEXT_TOKEN;
 	EXPECT_TOKEN(TOK_IDENTIFIER);
 
-	SEMANTIC_HOOK(sem_init_program(ps->semantic, ps->current.repr,
-				ps->current.pending));
+	AST_NODE(node, AST_PROGRAM);
+	if (node)
+		node->ident = ps->current.ident;
+	SEMANTIC_HOOK_AT(node, 0, sem_init_program(ps->semantic,
+				ps->current.ident));
 
 	NEXT_TOKEN;
 
@@ -1099,10 +1452,12 @@ int state_S(struct parser_state *ps)
 
 	NEXT_TOKEN;
 	EXPECT_STATE(state_Block);
+	AST_CHILD(node, 0);
 	EXPECT_TOKEN(TOK_DOT);
 
-	SEMANTIC_HOOK(sem_finish_program(ps->semantic));
+	SEMANTIC_HOOK_AT(node, 1, sem_finish_program(ps->semantic));
 
 	NEXT_TOKEN;
+	AST_RETURN(node);
 	return OK;
 }
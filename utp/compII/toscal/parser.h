@@ -4,6 +4,8 @@
 #include "input.h"
 #include "tokenize.h"
 #include "semantic.h"
+#include "arena.h"
+#include "ast.h"
 
 enum error_type {
 	PARSER_SUCCESS,
@@ -26,10 +28,17 @@ struct parser_state {
 	int dump_tokens;
 	int semantic_check;
 	struct semantic_state *semantic;
+	struct arena *scratch;	/* for the lists built while parsing a
+				   declaration */
+	struct ast *ast;	/* with -A, the tree built instead */
+	struct ast_node *node;	/* the node built by the last state */
 };
 
+#define PARSER_SCRATCH_SIZE	4096
+
 struct parser_state *init_parser_state(struct input_state *input,
 		struct semantic_state *semantic);
+void destroy_parser_state(struct parser_state *ps);
 void parser_dump_error(struct parser_state *ps, FILE *stream);
 int parser_check(struct parser_state *ps);
 
@@ -0,0 +1,263 @@
+/** peephole.c
+ *
+ * The code is rewritten in place: every instruction is appended again to
+ * the (shorter) optimized code and then the rewrites are tried at its
+ * end, so that the result of one can feed the next one, like in
+ * CRCT 1; CRCT 2; SOMA; CRCT 3; MULT => CRCT 9.
+ *
+ * Labels are jump targets, so nothing is combined across them. The dead
+ * code is taken out before (see deadcode.c).
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#include "peephole.h"
+#include "deadcode.h"
+#include "opcodes.h"
+
+const struct peephole_pass_info peephole_passes[] = {
+	{ "merge-mem", PEEPHOLE_MERGE_MEM },
+	{ "jump-next", PEEPHOLE_JUMP_NEXT },
+	{ "fold-const", PEEPHOLE_FOLD_CONST },
+	{ "double-invr", PEEPHOLE_DOUBLE_INVR },
+	{ "store-load", PEEPHOLE_STORE_LOAD },
+	{ "compare-jump", PEEPHOLE_COMPARE_JUMP },
+	{ "dead-code", PEEPHOLE_DEAD_CODE },
+	{ NULL, 0 }
+};
+
+/** Returns the pass with the given name, or 0 when there is none */
+unsigned int peephole_find_pass(const char *name)
+{
+	const struct peephole_pass_info *info;
+
+	for (info = peephole_passes; info->name; info++)
+		if (strcmp(info->name, name) == 0)
+			return info->pass;
+	return 0;
+}
+
+struct peephole {
+	struct codegen_inst *code;
+	size_t start;	/* nothing before it is touched */
+	size_t n;	/* end of the optimized code */
+	unsigned int passes;
+};
+
+static int is_pseudo(enum mepa_opcode op)
+{
+	return mepa_opcodes[op].operands == MEPA_OPND_PSEUDO;
+}
+
+/* the last instruction but back */
+static struct codegen_inst *last(struct peephole *p, size_t back)
+{
+	if (p->n - p->start <= back)
+		return NULL;
+	return &p->code[p->n - 1 - back];
+}
+
+static int is_compare(struct codegen_inst *inst)
+{
+	return inst->op >= MEPA_CMIG && inst->op <= MEPA_CMEG;
+}
+
+/* the comparison giving the opposite result, both aligned with MEPA_CM* */
+static enum mepa_opcode negated_compare(enum mepa_opcode op)
+{
+	static const enum mepa_opcode negated[] = {
+		MEPA_CMDG, MEPA_CMIG, MEPA_CMEG, MEPA_CMME, MEPA_CMAG, MEPA_CMMA
+	};
+
+	return negated[op - MEPA_CMIG];
+}
+
+static int is_const(struct codegen_inst *inst)
+{
+	return inst && inst->op == MEPA_CRCT;
+}
+
+/* Computes a op b the way mepa.py does it, but only when the result fits
+ * in an int and doesn't depend on how the VM rounds divisions */
+static int fold_binary(enum mepa_opcode op, long long a, long long b,
+		int *result)
+{
+	long long value;
+
+	switch (op) {
+	case MEPA_SOMA: value = a + b; break;
+	case MEPA_SUBT: value = a - b; break;
+	case MEPA_MULT: value = a * b; break;
+	case MEPA_DIVI:
+	case MEPA_MODU:
+		if (a < 0 || b <= 0)
+			return 0;
+		value = op == MEPA_DIVI ? a / b : a % b;
+		break;
+	/* the python and/or of the operands, b is the top of the stack */
+	case MEPA_CONJ: value = b ? a : b; break;
+	case MEPA_DISJ: value = b ? b : a; break;
+	case MEPA_CMIG: value = a == b; break;
+	case MEPA_CMDG: value = a != b; break;
+	case MEPA_CMMA: value = a > b; break;
+	case MEPA_CMAG: value = a >= b; break;
+	case MEPA_CMME: value = a < b; break;
+	case MEPA_CMEG: value = a <= b; break;
+	default:
+		return 0;
+	}
+	if (value < INT_MIN || value > INT_MAX)
+		return 0;
+	*result = (int) value;
+
+	return 1;
+}
+
+static enum codegen_note merged_note(enum codegen_note first,
+		enum codegen_note second)
+{
+	if (first == CODEGEN_NOTE_LOCAL_ALLOC
+			|| first == CODEGEN_NOTE_LOCAL_ALLOCS)
+		return second == CODEGEN_NOTE_LOCAL_ALLOC ?
+			CODEGEN_NOTE_LOCAL_ALLOCS : CODEGEN_NOTE_NONE;
+	return first == second ? first : CODEGEN_NOTE_NONE;
+}
+
+/* Tries one rewrite at the end of the optimized code, returns how many
+ * instructions it took out */
+static size_t rewrite_tail(struct peephole *p)
+{
+	struct codegen_inst *top = last(p, 0);
+	struct codegen_inst *prev = last(p, 1);
+	struct codegen_inst *first = last(p, 2);
+	int value;
+
+	if (!prev)
+		return 0;
+
+	if ((p->passes & PEEPHOLE_MERGE_MEM)
+			&& (top->op == MEPA_AMEM || top->op == MEPA_DMEM)
+			&& prev->op == top->op
+			&& (long long) prev->a + top->a <= INT_MAX) {
+		prev->a += top->a;
+		prev->note = merged_note(prev->note, top->note);
+		p->n--;
+		return 1;
+	}
+
+	if ((p->passes & PEEPHOLE_DOUBLE_INVR) && top->op == MEPA_INVR
+			&& prev->op == MEPA_INVR) {
+		p->n -= 2;
+		return 2;
+	}
+
+	if ((p->passes & PEEPHOLE_STORE_LOAD) && top->op == MEPA_CRVL
+			&& prev->op == MEPA_ARMZ && prev->a == top->a
+			&& prev->b == top->b) {
+		prev->op = MEPA_ARMC;
+		p->n--;
+		return 1;
+	}
+
+	/* the NEGA of the short circuit and the DSVF of the conditions, the
+	 * jump is taken when the comparison is false */
+	if ((p->passes & PEEPHOLE_COMPARE_JUMP) && is_compare(prev)
+			&& top->op == MEPA_NEGA) {
+		prev->op = negated_compare(prev->op);
+		p->n--;
+		return 1;
+	}
+	if ((p->passes & PEEPHOLE_COMPARE_JUMP) && is_compare(prev)
+			&& top->op == MEPA_DSVF) {
+		prev->op = MEPA_DSIG + (negated_compare(prev->op) - MEPA_CMIG);
+		prev->label = top->label;
+		prev->note = top->note;
+		p->n--;
+		return 1;
+	}
+
+	if (!(p->passes & PEEPHOLE_FOLD_CONST) || !is_const(prev))
+		return 0;
+
+	if (top->op == MEPA_INVR && prev->a != INT_MIN) {
+		prev->a = -prev->a;
+		p->n--;
+		return 1;
+	}
+	if (top->op == MEPA_NEGA) {
+		prev->a = !prev->a;
+		p->n--;
+		return 1;
+	}
+	if (is_const(first) && fold_binary(top->op, first->a, prev->a,
+				&value)) {
+		first->a = value;
+		p->n -= 2;
+		return 2;
+	}
+
+	return 0;
+}
+
+/* A jump to one of the labels at the end of the optimized code (maybe
+ * with some comments among them) just falls through them. */
+static size_t remove_jump_next(struct peephole *p)
+{
+	size_t i, j;
+	size_t removed = 0;
+
+retry:
+	for (i = p->n; i > p->start && is_pseudo(p->code[i - 1].op); i--)
+		;
+	if (i == p->start || p->code[i - 1].op != MEPA_DSVS)
+		return removed;
+	for (j = i; j < p->n; j++)
+		if (p->code[j].op == MEPA_LABEL
+				&& p->code[j].label == p->code[i - 1].label) {
+			memmove(&p->code[i - 1], &p->code[i],
+					(p->n - i) * sizeof(struct codegen_inst));
+			p->n--;
+			removed++;
+			goto retry;
+		}
+
+	return removed;
+}
+
+/** Optimizes the code not written yet, returns how many instructions were
+ * removed */
+size_t peephole_optimize(struct codegen_state *cs, unsigned int passes)
+{
+	struct peephole p;
+	size_t i, removed = 0, count;
+
+	if (passes & PEEPHOLE_DEAD_CODE)
+		removed += codegen_remove_dead_code(cs);
+
+	p.code = cs->code;
+	p.start = cs->written;
+	p.n = cs->written;
+	p.passes = passes;
+
+	for (i = cs->written; i < cs->ninsts; i++) {
+		p.code[p.n++] = cs->code[i];
+		if (p.code[p.n - 1].op == MEPA_LABEL) {
+			if (passes & PEEPHOLE_JUMP_NEXT)
+				removed += remove_jump_next(&p);
+			continue;
+		}
+		if (is_pseudo(p.code[p.n - 1].op))
+			continue;
+		while ((count = rewrite_tail(&p)))
+			removed += count;
+	}
+	cs->ninsts = p.n;
+
+	/* the labels moved with the code */
+	for (i = cs->written; i < cs->ninsts; i++)
+		if (cs->code[i].op == MEPA_LABEL)
+			cs->labels[cs->code[i].label].target = i;
+
+	return removed;
+}
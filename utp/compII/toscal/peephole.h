@@ -0,0 +1,34 @@
+/** The peephole optimizer looks at a few instructions at a time in the
+ * generated code and replaces them by fewer ones doing the same.
+ */
+#ifndef inc_peephole_h
+#define inc_peephole_h
+
+#include <stddef.h>
+
+#include "codegen.h"
+
+/* each rewrite can be turned on and off by its name */
+enum peephole_pass {
+	PEEPHOLE_MERGE_MEM = 1 << 0,	/* AMEM a; AMEM b => AMEM a+b */
+	PEEPHOLE_JUMP_NEXT = 1 << 1,	/* DSVS to the label that follows */
+	PEEPHOLE_FOLD_CONST = 1 << 2,	/* CRCT a; CRCT b; SOMA => CRCT a+b */
+	PEEPHOLE_DOUBLE_INVR = 1 << 3,	/* INVR; INVR => nothing */
+	PEEPHOLE_STORE_LOAD = 1 << 4,	/* ARMZ k,n; CRVL k,n => ARMC k,n */
+	PEEPHOLE_COMPARE_JUMP = 1 << 5,	/* CMME; DSVF l => DSAG l */
+	PEEPHOLE_DEAD_CODE = 1 << 6	/* code never reached */
+};
+
+#define PEEPHOLE_ALL	((1 << 7) - 1)
+
+struct peephole_pass_info {
+	const char *name;
+	enum peephole_pass pass;
+};
+
+extern const struct peephole_pass_info peephole_passes[];
+
+unsigned int peephole_find_pass(const char *name);
+size_t peephole_optimize(struct codegen_state *cs, unsigned int passes);
+
+#endif /* inc_peephole_h */
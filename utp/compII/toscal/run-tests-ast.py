@@ -0,0 +1,64 @@
+#!/usr/bin/python
+# 
+# The same programs of the other tests, with the syntax tree (-A): the
+# output shall not change. tests/ast has the cases where it does.
+import os
+import glob
+import sys
+import subprocess
+
+TESTS = [
+        ("tests/semantic/success", ["-C"], True),
+        ("tests/codegen-mepa/success", ["-W"], True),
+        ("tests/codegen-optimize/success", ["-W", "-O"], True),
+        ("tests/codegen-short-circuit/success", ["-W", "-fshort-circuit"],
+            True),
+        ("tests/codegen-inline/success", ["-W", "-finline"], True),
+        ("tests/ast/fail", ["-C"], False),
+]
+
+if os.name == "win32":
+    TESTER = "toscal.exe"
+else:
+    TESTER = "./toscal"
+
+def check(test, flags, should_succeed):
+    outputpath = test + "-output"
+    oldoutput = open(outputpath).read()
+    testinput = open(test)
+    proc = subprocess.Popen([TESTER, "-A"] + flags, stdin=testinput,
+            stderr=subprocess.PIPE,
+            stdout=subprocess.PIPE)
+    err = proc.wait()
+    output = proc.stderr.read() + proc.stdout.read() # crap!
+    testinput.close()
+    failed = False
+    if (should_succeed and err != 0) or (not should_succeed and err == 0):
+        print "FAILED",
+        failed = True
+    if output != oldoutput:
+        print "DIFFER",
+        failed = True
+    if not failed:
+        print "GOOD",
+    print test
+    return not failed
+
+def run(testsdir, flags, should_succeed=True):
+    tests = os.path.join(testsdir, "*.pas")
+    errors = 0
+    for path in glob.glob(tests):
+        if not check(path, flags, should_succeed):
+            errors += 1
+    return errors
+
+def main():
+    errors = 0
+    for testsdir, flags, should_succeed in TESTS:
+        errors += run(testsdir, flags, should_succeed)
+    print "errors:", errors
+    if errors != 0:
+        sys.exit(1)
+
+if __name__ == "__main__":
+    main()
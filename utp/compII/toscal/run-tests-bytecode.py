@@ -0,0 +1,61 @@
+#!/usr/bin/python
+# 
+#
+import os
+import glob
+import sys
+import subprocess
+
+SUCCESSDIR = "tests/bytecode/success"
+
+if os.name == "win32":
+    COMPILER = "toscal.exe"
+    DISASSEMBLER = "mepa.exe"
+else:
+    COMPILER = "./toscal"
+    DISASSEMBLER = "./mepa/mepa"
+
+def check(test, should_succeed):
+    outputpath = test + "-output"
+    oldoutput = open(outputpath).read()
+    testinput = open(test)
+    compiler = subprocess.Popen([COMPILER, "-W", "-b"], stdin=testinput,
+            stderr=subprocess.PIPE,
+            stdout=subprocess.PIPE)
+    proc = subprocess.Popen([DISASSEMBLER, "-d", "-"],
+            stdin=compiler.stdout,
+            stderr=subprocess.PIPE,
+            stdout=subprocess.PIPE)
+    compiler.stdout.close()
+    output = proc.stdout.read()
+    err = proc.wait() or compiler.wait()
+    output = compiler.stderr.read() + proc.stderr.read() + output # crap!
+    testinput.close()
+    failed = False
+    if (should_succeed and err != 0) or (not should_succeed and err == 0):
+        print "FAILED",
+        failed = True
+    if output != oldoutput:
+        print "DIFFER",
+        failed = True
+    if not failed:
+        print "GOOD",
+    print test
+    return not failed
+
+def run(testsdir, should_succeed=True):
+    tests = os.path.join(testsdir, "*.pas")
+    errors = 0
+    for path in glob.glob(tests):
+        if not check(path, should_succeed):
+            errors += 1
+    return errors
+
+def main():
+    errors = run(SUCCESSDIR, True)
+    print "errors:", errors
+    if errors != 0:
+        sys.exit(1)
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,83 @@
+#!/usr/bin/python
+# Compiles the programs of tests/codegen-mepa with toscal -m c and the C
+# compiler, and checks they print the same as the MEPA machine.
+#
+import os
+import glob
+import sys
+import shutil
+import subprocess
+import tempfile
+
+SUCCESSDIR = "tests/codegen-mepa/success"
+
+# the same for the programs that read something
+INPUT = "".join("%d\n" % n for n in range(1, 21))
+
+if os.name == "win32":
+    COMPILER = "toscal.exe"
+    MACHINE = "mepa.exe"
+else:
+    COMPILER = "./toscal"
+    MACHINE = "./mepa/mepa"
+CC = os.environ.get("CC", "cc")
+
+def execute(args, input=""):
+    proc = subprocess.Popen(args, stdin=subprocess.PIPE,
+            stderr=subprocess.PIPE,
+            stdout=subprocess.PIPE)
+    output, errors = proc.communicate(input)
+    return proc.returncode, output, errors
+
+def compile(test, path, args):
+    err, output, errors = execute([COMPILER, "-W"] + args,
+            open(test).read())
+    open(path, "w").write(output)
+    return err == 0
+
+def check(test, tmpdir):
+    mepapath = os.path.join(tmpdir, "test.mepa")
+    cpath = os.path.join(tmpdir, "test.c")
+    program = os.path.join(tmpdir, "test")
+    failed = False
+    if (not compile(test, mepapath, []) or not compile(test, cpath,
+                ["-m", "c"]) or execute([CC, "-O2", "-o", program,
+                    cpath])[0] != 0):
+        print "FAILED", test
+        return False
+    mepaerr, expected, errors = execute([MACHINE, mepapath], INPUT)
+    err, output, errors = execute([program], INPUT)
+    # the machine also warns about the extensions of the MEPA
+    expected = "".join(line for line in expected.splitlines(True)
+            if not line.startswith("aviso:"))
+    if (err == 0) != (mepaerr == 0):
+        print "FAILED",
+        failed = True
+    if output != expected:
+        print "DIFFER",
+        failed = True
+    if not failed:
+        print "GOOD",
+    print test
+    return not failed
+
+def run(testsdir):
+    tests = os.path.join(testsdir, "*.pas")
+    errors = 0
+    tmpdir = tempfile.mkdtemp()
+    try:
+        for path in glob.glob(tests):
+            if not check(path, tmpdir):
+                errors += 1
+    finally:
+        shutil.rmtree(tmpdir)
+    return errors
+
+def main():
+    errors = run(SUCCESSDIR)
+    print "errors:", errors
+    if errors != 0:
+        sys.exit(1)
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,115 @@
+#!/usr/bin/python
+# Checks the code of tests/codegen-inline with toscal -finline, and runs the programs
+# of both it and tests/codegen-mepa on the MEPA machine to check they print
+# the same with -finline as without it.
+#
+import os
+import glob
+import sys
+import shutil
+import subprocess
+import tempfile
+
+SUCCESSDIR = "tests/codegen-inline/success"
+RUNDIRS = [SUCCESSDIR, "tests/codegen-mepa/success"]
+
+# the same for the programs that read something
+INPUT = "".join("%d\n" % n for n in range(1, 21))
+
+if os.name == "win32":
+    TESTER = "toscal.exe"
+    MACHINE = "mepa.exe"
+else:
+    TESTER = "./toscal"
+    MACHINE = "./mepa/mepa"
+
+def check(test, should_succeed):
+    outputpath = test + "-output"
+    oldoutput = open(outputpath).read()
+    testinput = open(test)
+    proc = subprocess.Popen([TESTER, "-W", "-finline"], stdin=testinput,
+            stderr=subprocess.PIPE,
+            stdout=subprocess.PIPE)
+    err = proc.wait()
+    output = proc.stderr.read() + proc.stdout.read() # crap!
+    testinput.close()
+    failed = False
+    if (should_succeed and err != 0) or (not should_succeed and err == 0):
+        print "FAILED",
+        failed = True
+    if output != oldoutput:
+        print "DIFFER",
+        failed = True
+    if not failed:
+        print "GOOD",
+    print test
+    return not failed
+
+def execute(args, input=""):
+    proc = subprocess.Popen(args, stdin=subprocess.PIPE,
+            stderr=subprocess.PIPE,
+            stdout=subprocess.PIPE)
+    output, errors = proc.communicate(input)
+    return proc.returncode, output, errors
+
+def compile(test, path, args):
+    err, output, errors = execute([TESTER, "-W"] + args,
+            open(test).read())
+    open(path, "w").write(output)
+    return err == 0
+
+def check_run(test, tmpdir):
+    plainpath = os.path.join(tmpdir, "plain.mepa")
+    path = os.path.join(tmpdir, "inline.mepa")
+    failed = False
+    if not compile(test, plainpath, []) or not compile(test, path,
+            ["-finline"]):
+        print "FAILED", test
+        return False
+    expectederr, expected, errors = execute([MACHINE, plainpath], INPUT)
+    err, output, errors = execute([MACHINE, path], INPUT)
+    # the machine also warns about the extensions of the MEPA
+    expected = "".join(line for line in expected.splitlines(True)
+            if not line.startswith("aviso:"))
+    output = "".join(line for line in output.splitlines(True)
+            if not line.startswith("aviso:"))
+    if (err == 0) != (expectederr == 0):
+        print "FAILED",
+        failed = True
+    if output != expected:
+        print "DIFFER",
+        failed = True
+    if not failed:
+        print "GOOD",
+    print test
+    return not failed
+
+def run(testsdir, should_succeed=True):
+    tests = os.path.join(testsdir, "*.pas")
+    errors = 0
+    for path in glob.glob(tests):
+        if not check(path, should_succeed):
+            errors += 1
+    return errors
+
+def run_programs(testsdirs):
+    errors = 0
+    tmpdir = tempfile.mkdtemp()
+    try:
+        for testsdir in testsdirs:
+            for path in glob.glob(os.path.join(testsdir, "*.pas")):
+                if not check_run(path, tmpdir):
+                    errors += 1
+    finally:
+        shutil.rmtree(tmpdir)
+    return errors
+
+def main():
+    errors = run(SUCCESSDIR, True)
+    errors += run_programs(RUNDIRS)
+    print "errors:", errors
+    if errors != 0:
+        sys.exit(1)
+
+if __name__ == "__main__":
+    main()
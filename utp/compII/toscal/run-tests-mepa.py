@@ -0,0 +1,58 @@
+#!/usr/bin/python
+# 
+#
+import os
+import glob
+import sys
+import subprocess
+
+SUCCESSDIR = "tests/mepa/success"
+FAILDIR = "tests/mepa/fail"
+
+if os.name == "win32":
+    TESTER = "mepa.exe"
+else:
+    TESTER = "./mepa/mepa"
+
+def check(test, should_succeed):
+    outputpath = test + "-output"
+    oldoutput = open(outputpath).read()
+    inputpath = test + "-input"
+    if not os.path.exists(inputpath):
+        inputpath = os.devnull
+    testinput = open(inputpath)
+    proc = subprocess.Popen([TESTER, test], stdin=testinput,
+            stderr=subprocess.PIPE,
+            stdout=subprocess.PIPE)
+    err = proc.wait()
+    output = proc.stderr.read() + proc.stdout.read() # crap!
+    testinput.close()
+    failed = False
+    if (should_succeed and err != 0) or (not should_succeed and err == 0):
+        print "FAILED",
+        failed = True
+    if output != oldoutput:
+        print "DIFFER",
+        failed = True
+    if not failed:
+        print "GOOD",
+    print test
+    return not failed
+
+def run(testsdir, should_succeed=True):
+    tests = os.path.join(testsdir, "*.mepa")
+    errors = 0
+    for path in glob.glob(tests):
+        if not check(path, should_succeed):
+            errors += 1
+    return errors
+
+def main():
+    errors = run(SUCCESSDIR, True)
+    errors += run(FAILDIR, False)
+    print "errors:", errors
+    if errors != 0:
+        sys.exit(1)
+
+if __name__ == "__main__":
+    main()
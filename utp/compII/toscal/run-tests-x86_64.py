@@ -0,0 +1,120 @@
+#!/usr/bin/python
+# Checks the assembly of tests/x86_64 with toscal -m x86_64, and assembles
+# the programs of tests/codegen-mepa to check they print the same as the
+# MEPA machine.
+#
+import os
+import glob
+import sys
+import shutil
+import platform
+import subprocess
+import tempfile
+
+SUCCESSDIR = "tests/x86_64/success"
+RUNDIR = "tests/codegen-mepa/success"
+RUNTIME = "runtime/runtime.c"
+
+# the same for the programs that read something
+INPUT = "".join("%d\n" % n for n in range(1, 21))
+
+if os.name == "win32":
+    TESTER = "toscal.exe"
+    MACHINE = "mepa.exe"
+else:
+    TESTER = "./toscal"
+    MACHINE = "./mepa/mepa"
+CC = os.environ.get("CC", "cc")
+
+def check(test, should_succeed):
+    outputpath = test + "-output"
+    oldoutput = open(outputpath).read()
+    testinput = open(test)
+    proc = subprocess.Popen([TESTER, "-W", "-m", "x86_64"], stdin=testinput,
+            stderr=subprocess.PIPE,
+            stdout=subprocess.PIPE)
+    err = proc.wait()
+    output = proc.stderr.read() + proc.stdout.read() # crap!
+    testinput.close()
+    failed = False
+    if (should_succeed and err != 0) or (not should_succeed and err == 0):
+        print "FAILED",
+        failed = True
+    if output != oldoutput:
+        print "DIFFER",
+        failed = True
+    if not failed:
+        print "GOOD",
+    print test
+    return not failed
+
+def execute(args, input=""):
+    proc = subprocess.Popen(args, stdin=subprocess.PIPE,
+            stderr=subprocess.PIPE,
+            stdout=subprocess.PIPE)
+    output, errors = proc.communicate(input)
+    return proc.returncode, output, errors
+
+def compile(test, path, args):
+    err, output, errors = execute([TESTER, "-W"] + args,
+            open(test).read())
+    open(path, "w").write(output)
+    return err == 0
+
+def check_run(test, tmpdir):
+    mepapath = os.path.join(tmpdir, "test.mepa")
+    asmpath = os.path.join(tmpdir, "test.s")
+    program = os.path.join(tmpdir, "test")
+    failed = False
+    if (not compile(test, mepapath, []) or not compile(test, asmpath,
+                ["-m", "x86_64"]) or execute([CC, "-o", program,
+                    asmpath, RUNTIME])[0] != 0):
+        print "FAILED", test
+        return False
+    mepaerr, expected, errors = execute([MACHINE, mepapath], INPUT)
+    err, output, errors = execute([program], INPUT)
+    # the machine also warns about the extensions of the MEPA
+    expected = "".join(line for line in expected.splitlines(True)
+            if not line.startswith("aviso:"))
+    if (err == 0) != (mepaerr == 0):
+        print "FAILED",
+        failed = True
+    if output != expected:
+        print "DIFFER",
+        failed = True
+    if not failed:
+        print "GOOD",
+    print test
+    return not failed
+
+def run(testsdir, should_succeed=True):
+    tests = os.path.join(testsdir, "*.pas")
+    errors = 0
+    for path in glob.glob(tests):
+        if not check(path, should_succeed):
+            errors += 1
+    return errors
+
+def run_programs(testsdir):
+    tests = os.path.join(testsdir, "*.pas")
+    errors = 0
+    tmpdir = tempfile.mkdtemp()
+    try:
+        for path in glob.glob(tests):
+            if not check_run(path, tmpdir):
+                errors += 1
+    finally:
+        shutil.rmtree(tmpdir)
+    return errors
+
+def main():
+    errors = run(SUCCESSDIR, True)
+    # the assembly only runs on the machine it was written for
+    if platform.machine() in ("x86_64", "AMD64"):
+        errors += run_programs(RUNDIR)
+    print "errors:", errors
+    if errors != 0:
+        sys.exit(1)
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,64 @@
+/** runtime.c
+ *
+ * What the programs compiled by toscal -m x86_64 call, the input and the
+ * output work like in mepa.py: one integer per line.
+ *
+ *   $ toscal -m x86_64 < program.pas > program.s
+ *   $ cc -o program program.s runtime/runtime.c
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+
+void mepa_main(void);
+
+void mepa_fail(const char *message)
+{
+	fflush(stdout);
+	fprintf(stderr, "%s\n", message);
+	exit(1);
+}
+
+/* LEIT, like int(sys.stdin.readline()) */
+long mepa_read(void)
+{
+	char line[128];
+	char *end;
+	long value;
+
+	if (!fgets(line, sizeof(line), stdin))
+		mepa_fail("the input is not an integer");
+	errno = 0;
+	value = strtol(line, &end, 10);
+	if (errno || end == line)
+		mepa_fail("the input is not an integer");
+	while (*end == ' ' || *end == '\t' || *end == '\r' || *end == '\n')
+		end++;
+	if (*end)
+		mepa_fail("the input is not an integer");
+
+	return value;
+}
+
+/* IMPR */
+void mepa_write(long value)
+{
+	printf("%ld\n", value);
+}
+
+/* ASSERT, top and the one below it */
+void mepa_assert(long first, long second)
+{
+	if (first != second) {
+		fflush(stdout);
+		fprintf(stderr, "assertion failed: %ld != %ld\n", first,
+				second);
+		exit(1);
+	}
+}
+
+int main(void)
+{
+	mepa_main();
+	return 0;
+}
@@ -0,0 +1,284 @@
+#include <string.h>
+
+#include "scan.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__clang__) \
+		|| __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define SCAN_X86
+#include <immintrin.h>
+#endif
+
+/*
+ * The plain C versions, also used for the tails shorter than a vector
+ */
+
+static inline int is_space(unsigned char c)
+{
+	return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+static inline int is_ident(unsigned char c)
+{
+	unsigned char lower = c | 0x20;
+
+	return (lower >= 'a' && lower <= 'z') || (c >= '0' && c <= '9')
+		|| c == '_';
+}
+
+static const char *scalar_space(const char *p, const char *end)
+{
+	while (p < end && is_space(*p))
+		p++;
+	return p;
+}
+
+static const char *scalar_ident(const char *p, const char *end)
+{
+	while (p < end && is_ident(*p))
+		p++;
+	return p;
+}
+
+static const char *scalar_digits(const char *p, const char *end)
+{
+	while (p < end && *p >= '0' && *p <= '9')
+		p++;
+	return p;
+}
+
+static const char *scalar_comment(const char *p, const char *end)
+{
+	while (p < end && *p != '*' && *p != '\0')
+		p++;
+	return p;
+}
+
+static size_t scalar_newlines(const char *p, const char *end)
+{
+	size_t n = 0;
+
+	while (p < end)
+		n += *p++ == '\n';
+	return n;
+}
+
+#ifdef SCAN_X86
+
+/*
+ * The vector versions: each classify function sets to 0xff the bytes of
+ * the vector that belong to the run, and the first byte not set ends it.
+ * The signed compares are fine because none of the classes have bytes
+ * above 127.
+ */
+
+#define SCAN_SSE2 __attribute__((target("sse2")))
+#define SCAN_AVX2 __attribute__((target("avx2")))
+
+static inline SCAN_SSE2 __m128i sse2_range(__m128i c, char lo, char hi)
+{
+	return _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8(lo - 1)),
+			_mm_cmpgt_epi8(_mm_set1_epi8(hi + 1), c));
+}
+
+static inline SCAN_SSE2 __m128i sse2_space(__m128i c)
+{
+	return _mm_or_si128(_mm_cmpeq_epi8(c, _mm_set1_epi8(' ')),
+			sse2_range(c, '\t', '\r'));
+}
+
+static inline SCAN_SSE2 __m128i sse2_ident(__m128i c)
+{
+	__m128i lower = _mm_or_si128(c, _mm_set1_epi8(0x20));
+
+	return _mm_or_si128(_mm_or_si128(sse2_range(lower, 'a', 'z'),
+				sse2_range(c, '0', '9')),
+			_mm_cmpeq_epi8(c, _mm_set1_epi8('_')));
+}
+
+static inline SCAN_SSE2 __m128i sse2_digits(__m128i c)
+{
+	return sse2_range(c, '0', '9');
+}
+
+static inline SCAN_SSE2 __m128i sse2_comment(__m128i c)
+{
+	return _mm_andnot_si128(_mm_or_si128(
+				_mm_cmpeq_epi8(c, _mm_set1_epi8('*')),
+				_mm_cmpeq_epi8(c, _mm_setzero_si128())),
+			_mm_set1_epi8(-1));
+}
+
+static inline SCAN_AVX2 __m256i avx2_range(__m256i c, char lo, char hi)
+{
+	return _mm256_and_si256(_mm256_cmpgt_epi8(c, _mm256_set1_epi8(lo - 1)),
+			_mm256_cmpgt_epi8(_mm256_set1_epi8(hi + 1), c));
+}
+
+static inline SCAN_AVX2 __m256i avx2_space(__m256i c)
+{
+	return _mm256_or_si256(_mm256_cmpeq_epi8(c, _mm256_set1_epi8(' ')),
+			avx2_range(c, '\t', '\r'));
+}
+
+static inline SCAN_AVX2 __m256i avx2_ident(__m256i c)
+{
+	__m256i lower = _mm256_or_si256(c, _mm256_set1_epi8(0x20));
+
+	return _mm256_or_si256(_mm256_or_si256(avx2_range(lower, 'a', 'z'),
+				avx2_range(c, '0', '9')),
+			_mm256_cmpeq_epi8(c, _mm256_set1_epi8('_')));
+}
+
+static inline SCAN_AVX2 __m256i avx2_digits(__m256i c)
+{
+	return avx2_range(c, '0', '9');
+}
+
+static inline SCAN_AVX2 __m256i avx2_comment(__m256i c)
+{
+	return _mm256_andnot_si256(_mm256_or_si256(
+				_mm256_cmpeq_epi8(c, _mm256_set1_epi8('*')),
+				_mm256_cmpeq_epi8(c, _mm256_setzero_si256())),
+			_mm256_set1_epi8(-1));
+}
+
+/* the loops are the same for every class, only the classify function
+ * and the vector width change */
+#define SSE2_RUN(class) \
+static SCAN_SSE2 const char *sse2_run_##class(const char *p, \
+		const char *end) \
+{ \
+	unsigned int mask; \
+\
+	while (end - p >= 16) { \
+		mask = ~_mm_movemask_epi8(sse2_##class( \
+				_mm_loadu_si128((const __m128i*) p))) & 0xffff; \
+		if (mask) \
+			return p + __builtin_ctz(mask); \
+		p += 16; \
+	} \
+	return scalar_##class(p, end); \
+}
+
+#define AVX2_RUN(class) \
+static SCAN_AVX2 const char *avx2_run_##class(const char *p, \
+		const char *end) \
+{ \
+	unsigned int mask; \
+\
+	while (end - p >= 32) { \
+		mask = ~(unsigned int) _mm256_movemask_epi8(avx2_##class( \
+				_mm256_loadu_si256((const __m256i*) p))); \
+		if (mask) \
+			return p + __builtin_ctz(mask); \
+		p += 32; \
+	} \
+	return scalar_##class(p, end); \
+}
+
+SSE2_RUN(space)
+SSE2_RUN(ident)
+SSE2_RUN(digits)
+SSE2_RUN(comment)
+
+AVX2_RUN(comment)
+
+static SCAN_SSE2 size_t sse2_newlines(const char *p, const char *end)
+{
+	const __m128i nl = _mm_set1_epi8('\n');
+	size_t n = 0;
+
+	while (end - p >= 16) {
+		n += __builtin_popcount(_mm_movemask_epi8(_mm_cmpeq_epi8(
+				_mm_loadu_si128((const __m128i*) p), nl)));
+		p += 16;
+	}
+	return n + scalar_newlines(p, end);
+}
+
+static SCAN_AVX2 size_t avx2_newlines(const char *p, const char *end)
+{
+	const __m256i nl = _mm256_set1_epi8('\n');
+	size_t n = 0;
+
+	while (end - p >= 32) {
+		n += __builtin_popcount(_mm256_movemask_epi8(_mm256_cmpeq_epi8(
+				_mm256_loadu_si256((const __m256i*) p), nl)));
+		p += 32;
+	}
+	return n + scalar_newlines(p, end);
+}
+
+#endif /* SCAN_X86 */
+
+static const struct scan_ops scan_impls[] = {
+	{ "scalar", scalar_space, scalar_ident, scalar_digits,
+		scalar_comment, scalar_newlines },
+#ifdef SCAN_X86
+	{ "sse2", sse2_run_space, sse2_run_ident, sse2_run_digits,
+		sse2_run_comment, sse2_newlines },
+	/* blanks, identifiers and numbers are usually shorter than 32
+	 * chars, the wider vectors only pay off for the comments */
+	{ "avx2", sse2_run_space, sse2_run_ident, sse2_run_digits,
+		avx2_run_comment, avx2_newlines },
+#endif
+};
+
+#define NR_SCAN_IMPLS (sizeof(scan_impls) / sizeof(scan_impls[0]))
+
+struct scan_ops scan = { "scalar", scalar_space, scalar_ident,
+	scalar_digits, scalar_comment, scalar_newlines };
+
+static int scan_supported(const struct scan_ops *ops)
+{
+#ifdef SCAN_X86
+	__builtin_cpu_init();
+	if (strcmp(ops->name, "sse2") == 0)
+		return __builtin_cpu_supports("sse2");
+	if (strcmp(ops->name, "avx2") == 0)
+		return __builtin_cpu_supports("avx2");
+#endif
+	return 1;
+}
+
+/* returns the name of the i-th implementation usable in this CPU, or
+ * NULL when there are no more */
+const char *scan_available(size_t i)
+{
+	size_t j;
+
+	for (j = 0; j < NR_SCAN_IMPLS; j++)
+		if (scan_supported(&scan_impls[j]) && i-- == 0)
+			return scan_impls[j].name;
+	return NULL;
+}
+
+int scan_select(const char *name)
+{
+	size_t i;
+
+	for (i = 0; i < NR_SCAN_IMPLS; i++)
+		if (strcmp(scan_impls[i].name, name) == 0
+				&& scan_supported(&scan_impls[i])) {
+			scan = scan_impls[i];
+			return 1;
+		}
+	return 0;
+}
+
+/* picks the last (best) implementation supported by the CPU */
+void init_scan(void)
+{
+	static int initialized = 0;
+	size_t i;
+
+	if (initialized)
+		return;
+	initialized = 1;
+
+	for (i = NR_SCAN_IMPLS; i > 0; i--)
+		if (scan_supported(&scan_impls[i - 1])) {
+			scan = scan_impls[i - 1];
+			break;
+		}
+}
@@ -0,0 +1,31 @@
+#ifndef inc_scan_h
+#define inc_scan_h
+
+#include <stddef.h>
+
+/* Helpers used by the tokenizer to go over runs of chars that don't
+ * change its state. Each one returns the first char in [p, end) that
+ * doesn't belong to the run (or end).
+ *
+ * There are SSE2 and AVX2 versions on x86, the best one supported by the
+ * CPU is picked by init_scan(), otherwise the plain C ones are used.
+ */
+
+typedef const char *(*scan_run_t)(const char *p, const char *end);
+
+struct scan_ops {
+	const char *name;
+	scan_run_t space;	/* ' ', '\t', '\n', '\v', '\f' and '\r' */
+	scan_run_t ident;	/* letters, digits and '_' */
+	scan_run_t digits;
+	scan_run_t comment;	/* anything but '*' and '\0' */
+	size_t (*newlines)(const char *p, const char *end);
+};
+
+extern struct scan_ops scan;
+
+void init_scan(void);
+int scan_select(const char *name);
+const char *scan_available(size_t i);
+
+#endif /* inc_scan_h */
@@ -15,6 +15,7 @@
 #include <string.h>
 #include <errno.h>
 #include <assert.h>
+#include <limits.h>
 
 #include "semantic.h"
 #include "string_list.h"
@@ -22,6 +23,8 @@
 #include "type.h"
 #include "parameters.h"
 #include "codegen.h"
+#include "tailcalls.h"
+#include "inline.h"
 
 #define ERROR	0
 #define OK	1	
@@ -85,6 +88,15 @@ void semantic_dump_error(struct semantic_state *ss, FILE *stream)
 				ss->error_arg);
 		break;
 
+	case SEMANTIC_DIVISION_BY_ZERO:
+		fprintf(stream, "division by zero in %s\n", ss->error_arg);
+		break;
+
+	case SEMANTIC_CONST_OVERFLOW:
+		fprintf(stream, "integer overflow in constant expression: %s\n",
+				ss->error_arg);
+		break;
+
 	case SEMANTIC_CODEGEN_ERROR:
 		fputs("code generator error: ", stream);
 		codegen_dump_error(ss->codegen, stream);
@@ -92,7 +104,8 @@ void semantic_dump_error(struct semantic_state *ss, FILE *stream)
 	}
 }
 
-struct semantic_state *init_semantic_state(struct codegen_state *codegen)
+struct semantic_state *init_semantic_state(struct codegen_state *codegen,
+		struct intern_pool *idents, struct arena *arena)
 {
 	struct semantic_state *ss;
 
@@ -100,13 +113,15 @@ struct semantic_state *init_semantic_state(struct codegen_state *codegen)
 	if (!ss)
 		return NULL;
 
-	ss->symbols = init_symbol_table();
-	if (!ss) {
+	ss->symbols = init_symbol_table(idents, arena);
+	if (!ss->symbols) {
 		free(ss);
 		return NULL;
 	}
 
 	ss->codegen = codegen;
+	ss->idents = idents;
+	ss->arena = arena;
 	ss->scope = SCOPE_LOCAL;
 	ss->error = SEMANTIC_SUCCESS;
 	ss->error_arg[0] = '\0';
@@ -115,6 +130,7 @@ struct semantic_state *init_semantic_state(struct codegen_state *codegen)
 	ss->ntypes = NUM_SCALAR_TYPES;
 	ss->main_proc = NULL;
 	ss->proc = NULL;
+	ss->self_call = 0;
 	ss->warning_stream = NULL;
 	ss->debug_stream = NULL;
 
@@ -131,8 +147,10 @@ void semantic_set_error(struct semantic_state *ss,
 		enum semantic_error error, const char *error_arg)
 {
 	ss->error = error;
-	if (error_arg)
-		strncpy(ss->error_arg, error_arg, SEMANTIC_MAX_ERROR_ARG);
+	if (error_arg) {
+		strncpy(ss->error_arg, error_arg, SEMANTIC_MAX_ERROR_ARG - 1);
+		ss->error_arg[SEMANTIC_MAX_ERROR_ARG - 1] = '\0';
+	}
 }
 
 void sem_warning(struct semantic_state *ss, enum semantic_warnings type,
@@ -192,8 +210,7 @@ int sem_alloc_codeobj(struct semantic_state *ss, struct symbol *sym)
 int sem_decl_sym_list(struct semantic_state *ss, struct string_list *names,
 		struct type *type, enum symbol_types symtype)
 {
-	char *name;
-	size_t size;
+	ident_t name;
 	struct symbol *sym;
 	string_list_iter_t iter;
 
@@ -202,13 +219,14 @@ int sem_decl_sym_list(struct semantic_state *ss, struct string_list *names,
 		 * passed by reference */
 		symtype = SYMTYPE_REF;
 
-	string_list_foreach(names, iter, name, size) {
-		sym = symbol_table_get(ss->symbols, name, size);
+	string_list_foreach(names, iter, name) {
+		sym = symbol_table_get(ss->symbols, name);
 		if (sym) {
-			semantic_set_error(ss, SEMANTIC_ALREADY_DEFINED, name);
+			semantic_set_error(ss, SEMANTIC_ALREADY_DEFINED,
+				intern_name(ss->idents, name));
 			return ERROR;
 		}
-		sym = add_symbol(ss->symbols, name, size, symtype,
+		sym = add_symbol(ss->symbols, name, symtype,
 				ss->scope, type, type->reference,
 				ss->proc);
 		if (!sem_alloc_codeobj(ss, sym))
@@ -242,20 +260,21 @@ int sem_decl_var_list(struct semantic_state *ss, struct string_list *names,
 }
 
 static struct symbol *sem_decl_const(struct semantic_state *ss,
-		const char *name, size_t size, struct object value)
+		ident_t name, struct object value)
 {
 	struct symbol *sym;
 	struct type *type;
 
-	sym = symbol_table_get(ss->symbols, name, size);
+	sym = symbol_table_get(ss->symbols, name);
 	if (sym) {
-		semantic_set_error(ss, SEMANTIC_ALREADY_DEFINED, name);
+		semantic_set_error(ss, SEMANTIC_ALREADY_DEFINED,
+				intern_name(ss->idents, name));
 		return NULL;
 	}
 
 	type = &ss->types[value.type];
 
-	sym = add_symbol(ss->symbols, name, size, SYMTYPE_CONST,
+	sym = add_symbol(ss->symbols, name, SYMTYPE_CONST,
 			ss->scope, type, value, ss->proc);
 	if (!sym) {
 		semantic_set_error(ss, SEMANTIC_SYSTEM_ERROR, NULL);
@@ -265,56 +284,55 @@ static struct symbol *sem_decl_const(struct semantic_state *ss,
 	return sym;
 }
 
-int sem_decl_const_int(struct semantic_state *ss, const char *name,
-		size_t size, int value)
+int sem_decl_const_int(struct semantic_state *ss, ident_t name, int value)
 {
 	struct object objvalue;
 
 	objvalue.type = TYPE_INTEGER;
 	objvalue.scalar.integer = value;
 
-	if (!sem_decl_const(ss, name, size, objvalue))
+	if (!sem_decl_const(ss, name, objvalue))
 		return ERROR;
 
 	return OK;
 }
 
-int sem_decl_const_char(struct semantic_state *ss, const char *name,
-		size_t size, char value)
+int sem_decl_const_char(struct semantic_state *ss, ident_t name, char value)
 {
 	struct object objvalue;
 
 	objvalue.type = TYPE_CHAR;
 	objvalue.scalar.ch = value;
 
-	if (!sem_decl_const(ss, name, size, objvalue))
+	if (!sem_decl_const(ss, name, objvalue))
 		return ERROR;
 
 	return OK;
 }
 
-int sem_decl_const_real(struct semantic_state *ss, const char *name,
-		size_t size, float value)
+int sem_decl_const_real(struct semantic_state *ss, ident_t name, float value)
 {
 	struct object objvalue;
 
 	objvalue.type = TYPE_REAL;
 	objvalue.scalar.ch = value;
 
-	if (!sem_decl_const(ss, name, size, objvalue))
+	if (!sem_decl_const(ss, name, objvalue))
 		return ERROR;
 
 	return OK;
 }
 
-int sem_find_type(struct semantic_state *ss, const char *name,
-		size_t size, sem_ref_t *rval)
+int sem_find_type(struct semantic_state *ss, ident_t name, sem_ref_t *rval)
 {
 	struct type *found;
 
-	found = parse_scalar_type_name(ss->types, ss->ntypes, name, size);
+	found = parse_scalar_type_name(ss->types, ss->ntypes,
+			intern_name(ss->idents, name),
+			intern_size(ss->idents, name));
 	if (found->reference.type == TYPE_INVALID) {
-		semantic_set_error(ss, SEMANTIC_INVALID_TYPE, name);
+		semantic_set_error(ss, SEMANTIC_INVALID_TYPE,
+				intern_name(ss->idents, name));
 		return ERROR;
 	}
 	rval->type = found;
@@ -322,14 +340,15 @@ int sem_find_type(struct semantic_state *ss, const char *name,
 	return OK;
 }
 
-int sem_hold_var(struct semantic_state *ss, const char *name, size_t size,
+int sem_hold_var(struct semantic_state *ss, ident_t name,
 		sem_ref_t *hold)
 {
 	struct symbol *sym;
 
-	sym = symbol_table_get(ss->symbols, name, size);
+	sym = symbol_table_get(ss->symbols, name);
 	if (!sym) {
-		semantic_set_error(ss, SEMANTIC_UNDEFINED_SYMBOL, name);
+		semantic_set_error(ss, SEMANTIC_UNDEFINED_SYMBOL,
+				intern_name(ss->idents, name));
 		return ERROR;
 	}
 	sym->referenced = 1;
@@ -348,6 +367,8 @@ int sem_funcall_prolog(struct semantic_state *ss, sem_ref_t *var)
 				var->symbol->name);
 		return ERROR;
 	}
+	/* where the room of the value is, for codegen_inline_call() */
+	var->at = codegen_position(ss->codegen);
 	if (!codegen_funcall_prolog(ss->codegen,
 				&var->symbol->codeobj)) {
 		semantic_set_error(ss, SEMANTIC_CODEGEN_ERROR, NULL);
@@ -378,6 +399,7 @@ int sem_call_function(struct semantic_state *ss, sem_ref_t *var,
 	/* _prolog and _cleanup functions will take care of the remaining
 	 * differences between functions and procedures. */
 	holdret->type = var->symbol->type;
+	holdret->known = 0;
 
 	if (!codegen_call_function(ss->codegen, &var->symbol->codeobj,
 				ss->proc->lexscope)) {
@@ -385,6 +407,26 @@ int sem_call_function(struct semantic_state *ss, sem_ref_t *var,
 		return ERROR;
 	}
 
+	/* a procedure calling itself may do it as its last statement, a
+	 * function when its value is assigned (see sem_var_assignment()) */
+	if (var->symbol == ss->proc) {
+		ss->self_call = codegen_position(ss->codegen);
+		if (var->symbol->symtype == SYMTYPE_PROCEDURE
+				&& !codegen_tail_call(ss->codegen, 0)) {
+			semantic_set_error(ss, SEMANTIC_CODEGEN_ERROR, NULL);
+			return ERROR;
+		}
+	}
+	else {
+		ss->self_call = 0;
+		if (!codegen_inline_call(ss->codegen,
+					var->symbol->symtype == SYMTYPE_FUNCTION
+					? var->at : CODEGEN_NO_TARGET)) {
+			semantic_set_error(ss, SEMANTIC_CODEGEN_ERROR, NULL);
+			return ERROR;
+		}
+	}
+
 	return OK;
 }
 
@@ -426,6 +468,14 @@ int sem_var_assignment(struct semantic_state *ss, sem_ref_t *var,
 
 	var->symbol->initialized = 1;
 
+	/* f := f(...), the value is the call */
+	if (var->symbol == ss->proc
+			&& ss->self_call == codegen_position(ss->codegen)
+			&& !codegen_tail_call(ss->codegen, 1)) {
+		semantic_set_error(ss, SEMANTIC_CODEGEN_ERROR, NULL);
+		return ERROR;
+	}
+
 	if (var->symbol->symtype == SYMTYPE_REF) {
 		if (!codegen_store_ref(ss->codegen, &var->symbol->codeobj)) {
 			semantic_set_error(ss, SEMANTIC_CODEGEN_ERROR, NULL);
@@ -440,12 +490,16 @@ int sem_var_assignment(struct semantic_state *ss, sem_ref_t *var,
 	return OK;
 }
 
-static int sem_get_const(struct semantic_state *ss, struct symbol *symbol)
+static int sem_get_const(struct semantic_state *ss, struct symbol *symbol,
+		sem_ref_t *rval)
 {
-	int error;
+	int error = OK;
 
+	rval->at = codegen_position(ss->codegen);
 	switch (symbol->type->reference.type) {
 	case TYPE_INTEGER:
+		rval->known = 1;
+		rval->value = symbol->value.scalar.integer;
 		error = codegen_push_const_int(ss->codegen,
 				symbol->value.scalar.integer);
 		break;
@@ -454,6 +508,8 @@ static int sem_get_const(struct semantic_state *ss, struct symbol *symbol)
 				symbol->value.scalar.real);
 		break;
 	case TYPE_CHAR:
+		rval->known = 1;
+		rval->value = symbol->value.scalar.ch;
 		error = codegen_push_const_char(ss->codegen,
 				symbol->value.scalar.ch);
 		break;
@@ -482,12 +538,14 @@ static int sem_get_ref(struct semantic_state *ss, struct symbol *symbol)
 int sem_get_var(struct semantic_state *ss, sem_ref_t *var, 
 		sem_ref_t *rval)
 {
-	int error;
+	int error = OK;
 	char msg[BUFSIZ];
 	struct symbol *symbol;
+	size_t at;
 
 	symbol = var->symbol;
 	rval->type = symbol->type;
+	rval->known = 0;
 
 	/* covers the case a function without parameters is referred in a
 	 * expression */
@@ -499,15 +557,22 @@ int sem_get_var(struct semantic_state *ss, sem_ref_t *var,
 					msg);
 			return ERROR;
 		}
+		at = codegen_position(ss->codegen);
 		error = codegen_funcall_prolog(ss->codegen,
 				&var->symbol->codeobj);
 		if (error)
 			error = codegen_call_function(ss->codegen,
 					&var->symbol->codeobj,
 					ss->proc->lexscope);
+		if (symbol == ss->proc)
+			ss->self_call = codegen_position(ss->codegen);
+		else if (error) {
+			ss->self_call = 0;
+			error = codegen_inline_call(ss->codegen, at);
+		}
 	}
 	else if (symbol->symtype == SYMTYPE_CONST) {
-		if (!sem_get_const(ss, symbol))
+		if (!sem_get_const(ss, symbol, rval))
 			return ERROR;
 	}
 	else if (symbol->symtype == SYMTYPE_REF) {
@@ -540,6 +605,9 @@ int sem_put_char(struct semantic_state *ss, char value,
 		sem_ref_t *rval)
 { 
 	rval->type = &ss->types[TYPE_CHAR];
+	rval->known = 1;
+	rval->value = value;
+	rval->at = codegen_position(ss->codegen);
 
 	if (!codegen_push_const_char(ss->codegen, value)) {
 		semantic_set_error(ss, SEMANTIC_CODEGEN_ERROR, NULL);
@@ -553,6 +621,9 @@ int sem_put_integer(struct semantic_state *ss, int value,
 		sem_ref_t *rval)
 { 
 	rval->type = &ss->types[TYPE_INTEGER];
+	rval->known = 1;
+	rval->value = value;
+	rval->at = codegen_position(ss->codegen);
 
 	if (!codegen_push_const_int(ss->codegen, value)) {
 		semantic_set_error(ss, SEMANTIC_CODEGEN_ERROR, NULL);
@@ -565,7 +636,9 @@ int sem_put_integer(struct semantic_state *ss, int value,
 int sem_put_real(struct semantic_state *ss, float value,
 		sem_ref_t *rval)
 { 
+	/* the VM has no reals, so they are left to it */
 	rval->type = &ss->types[TYPE_REAL];
+	rval->known = 0;
 
 	if (!codegen_push_const_real(ss->codegen, value)) {
 		semantic_set_error(ss, SEMANTIC_CODEGEN_ERROR, NULL);
@@ -609,12 +682,79 @@ int sem_value_type(struct semantic_state *ss, sem_ref_t *left,
 	return OK;
 }
 
+/*
+ * Expressions made only of literals and constants are evaluated here, the
+ * CRCTs of the operands are replaced by a single one with the result.
+ * The results are the same ones the MEPA would compute.
+ */
+
+#define KNOWN(left, right)	((left)->known && (right)->known)
+
+static int sem_push_known(struct semantic_state *ss, int value,
+		sem_ref_t *rval)
+{
+	rval->known = 1;
+	rval->value = value;
+	rval->at = codegen_position(ss->codegen);
+
+	if (!codegen_push_const_int(ss->codegen, value)) {
+		semantic_set_error(ss, SEMANTIC_CODEGEN_ERROR, NULL);
+		return ERROR;
+	}
+
+	return OK;
+}
+
+static int sem_fold(struct semantic_state *ss, sem_ref_t *left,
+		sem_ref_t *right, const char *operator, long long value,
+		sem_ref_t *rval)
+{
+	char msg[BUFSIZ];
+
+	if (value < INT_MIN || value > INT_MAX) {
+		sprintf(msg, "%d %s %d", left->value, operator, right->value);
+		semantic_set_error(ss, SEMANTIC_CONST_OVERFLOW, msg);
+		return ERROR;
+	}
+
+	/* the operands are the last two CRCTs */
+	codegen_rewind(ss->codegen, left->at);
+
+	return sem_push_known(ss, (int) value, rval);
+}
+
+/* the MEPA rounds the quotient down, like python does */
+static long long floor_div(long long a, long long b)
+{
+	long long q = a / b;
+
+	if (a % b != 0 && (a < 0) != (b < 0))
+		q--;
+	return q;
+}
+
+static int check_divisor(struct semantic_state *ss, sem_ref_t *right,
+		const char *operator)
+{
+	if (right->known && right->value == 0) {
+		semantic_set_error(ss, SEMANTIC_DIVISION_BY_ZERO, operator);
+		return ERROR;
+	}
+
+	return OK;
+}
+
 int sem_sum_values(struct semantic_state *ss, sem_ref_t *left,
 		sem_ref_t *right, sem_ref_t *rval)
 {
 	if (sem_value_type(ss, left, right, rval) == ERROR)
 		return ERROR;
 
+	if (KNOWN(left, right))
+		return sem_fold(ss, left, right, "+",
+				(long long) left->value + right->value, rval);
+	rval->known = 0;
+
 	if (!codegen_sum_values(ss->codegen)) {
 		semantic_set_error(ss, SEMANTIC_CODEGEN_ERROR, NULL);
 		return ERROR;
@@ -629,6 +769,11 @@ int sem_subt_values(struct semantic_state *ss, sem_ref_t *left,
 	if (sem_value_type(ss, left, right, rval) == ERROR)
 		return ERROR;
 
+	if (KNOWN(left, right))
+		return sem_fold(ss, left, right, "-",
+				(long long) left->value - right->value, rval);
+	rval->known = 0;
+
 	if (!codegen_sub_values(ss->codegen)) {
 		semantic_set_error(ss, SEMANTIC_CODEGEN_ERROR, NULL);
 		return ERROR;
@@ -643,6 +788,11 @@ int sem_mul_values(struct semantic_state *ss, sem_ref_t *left,
 	if (sem_value_type(ss, left, right, rval) == ERROR)
 		return ERROR;
 
+	if (KNOWN(left, right))
+		return sem_fold(ss, left, right, "*",
+				(long long) left->value * right->value, rval);
+	rval->known = 0;
+
 	if (!codegen_mul_values(ss->codegen)) {
 		semantic_set_error(ss, SEMANTIC_CODEGEN_ERROR, NULL);
 		return ERROR;
@@ -657,6 +807,13 @@ int sem_div_values(struct semantic_state *ss, sem_ref_t *left,
 	if (sem_value_type(ss, left, right, rval) == ERROR)
 		return ERROR;
 
+	if (!check_divisor(ss, right, "div"))
+		return ERROR;
+	if (KNOWN(left, right))
+		return sem_fold(ss, left, right, "div",
+				floor_div(left->value, right->value), rval);
+	rval->known = 0;
+
 	if (!codegen_div_values(ss->codegen)) {
 		semantic_set_error(ss, SEMANTIC_CODEGEN_ERROR, NULL);
 		return ERROR;
@@ -672,6 +829,14 @@ int sem_mod_values(struct semantic_state *ss, sem_ref_t *left,
 	if (sem_value_type(ss, left, right, rval) == ERROR)
 		return ERROR;
 
+	if (!check_divisor(ss, right, "mod"))
+		return ERROR;
+	if (KNOWN(left, right))
+		return sem_fold(ss, left, right, "mod", left->value
+				- floor_div(left->value, right->value)
+				* right->value, rval);
+	rval->known = 0;
+
 	if (!codegen_mod_values(ss->codegen)) {
 		semantic_set_error(ss, SEMANTIC_CODEGEN_ERROR, NULL);
 		return ERROR;
@@ -690,6 +855,25 @@ static const enum codegen_relcmp relcmp_codegen[] = {
 	CODEGEN_RELCMP_LESSEQTHAN
 };
 
+static int relcmp(enum semantic_cmp_operators operator, int left, int right)
+{
+	switch (operator) {
+	case SEMANTIC_CMP_EQUAL:
+		return left == right;
+	case SEMANTIC_CMP_DIFFERENT:
+		return left != right;
+	case SEMANTIC_CMP_GREATERTHAN:
+		return left > right;
+	case SEMANTIC_CMP_GREATEREQTHAN:
+		return left >= right;
+	case SEMANTIC_CMP_LESSTHAN:
+		return left < right;
+	case SEMANTIC_CMP_LESSEQTHAN:
+		return left <= right;
+	}
+	return 0;
+}
+
 int sem_relcmp_values(struct semantic_state *ss,
 		enum semantic_cmp_operators operator,
 		sem_ref_t *left, sem_ref_t *right,
@@ -699,6 +883,12 @@ int sem_relcmp_values(struct semantic_state *ss,
 	 * result in integer values */
 	rval->type = &ss->types[TYPE_INTEGER];
 
+	if (KNOWN(left, right))
+		return sem_fold(ss, left, right, "cmp",
+				relcmp(operator, left->value, right->value),
+				rval);
+	rval->known = 0;
+
 	if (!codegen_relcmp_values(ss->codegen, relcmp_codegen[operator])) {
 		semantic_set_error(ss, SEMANTIC_CODEGEN_ERROR, NULL);
 		return ERROR;
@@ -707,19 +897,35 @@ int sem_relcmp_values(struct semantic_state *ss,
 	return OK;
 }
 
+/** Called between the operands of and/or, before the right one */
+int sem_boolcmp_operand(struct semantic_state *ss, sem_ref_t *left)
+{
+	left->end = codegen_position(ss->codegen);
+	return OK;
+}
+
 int sem_boolcmp_values(struct semantic_state *ss,
 		enum semantic_bool_operators operator,
 		sem_ref_t *left, sem_ref_t *right,
 		sem_ref_t *rval)
 {
-	enum codegen_error error;
+	enum codegen_error error = OK;
 
 	rval->type = &ss->types[TYPE_INTEGER];
 
+	/* the MEPA gives one of the operands, not 0 or 1 */
+	if (KNOWN(left, right) && operator == SEMANTIC_BOOL_OR)
+		return sem_fold(ss, left, right, "or", right->value ?
+				right->value : left->value, rval);
+	if (KNOWN(left, right) && operator == SEMANTIC_BOOL_AND)
+		return sem_fold(ss, left, right, "and", right->value ?
+				left->value : right->value, rval);
+	rval->known = 0;
+
 	if (operator == SEMANTIC_BOOL_OR)
-		error = codegen_or_values(ss->codegen);
+		error = codegen_or_values(ss->codegen, left->end);
 	else if (operator == SEMANTIC_BOOL_AND)
-		error = codegen_and_values(ss->codegen);
+		error = codegen_and_values(ss->codegen, left->end);
 
 	if (!error) {
 		semantic_set_error(ss, SEMANTIC_CODEGEN_ERROR, NULL);
@@ -734,6 +940,12 @@ int sem_not_value(struct semantic_state *ss, sem_ref_t *left,
 {
 	rval->type = &ss->types[TYPE_INTEGER];
 
+	if (left->known) {
+		codegen_rewind(ss->codegen, left->at);
+		return sem_push_known(ss, !left->value, rval);
+	}
+	rval->known = 0;
+
 	if (!codegen_not_value(ss->codegen)) {
 		semantic_set_error(ss, SEMANTIC_CODEGEN_ERROR, NULL);
 		return ERROR;
@@ -743,18 +955,19 @@ int sem_not_value(struct semantic_state *ss, sem_ref_t *left,
 }
 
 int sem_decl_procedure(struct semantic_state *ss,
-		const char *name, size_t size,
+		ident_t name,
 		sem_ref_t *var)
 {
 	struct symbol *sym;
 
-	sym = symbol_table_get(ss->symbols, name, size);
+	sym = symbol_table_get(ss->symbols, name);
 	if (sym) {
-		semantic_set_error(ss, SEMANTIC_ALREADY_DEFINED, name);
+		semantic_set_error(ss, SEMANTIC_ALREADY_DEFINED,
+				intern_name(ss->idents, name));
 		return ERROR;
 	}
 
-	sym = add_symbol(ss->symbols, name, size, SYMTYPE_PROCEDURE,
+	sym = add_symbol(ss->symbols, name, SYMTYPE_PROCEDURE,
 			ss->scope, &ss->types[TYPE_VOID],
 			ss->types[TYPE_VOID].reference,
 			ss->proc);
@@ -778,22 +991,26 @@ int sem_decl_procedure(struct semantic_state *ss,
 	sym->lexscope = ss->proc->lexscope + 1;
 	ss->proc = sym;
 
-	sym->parameters = create_parameters();
+	sym->parameters = create_parameters(ss->arena);
 	if (!sym->parameters) {
 		semantic_set_error(ss, SEMANTIC_SYSTEM_ERROR, NULL);
-		destroy_symbol(sym);
 		return ERROR;
 	}
 	var->symbol = sym;
 
+	if (!open_scope(ss->symbols, sym->lexscope)) {
+		semantic_set_error(ss, SEMANTIC_SYSTEM_ERROR, NULL);
+		return ERROR;
+	}
+
 	return OK;
 }
 
 int sem_decl_function(struct semantic_state *ss,
-		const char *name, size_t size,
+		ident_t name,
 		sem_ref_t *var)
 {
-	if (sem_decl_procedure(ss, name, size, var) == ERROR)
+	if (sem_decl_procedure(ss, name, var) == ERROR)
 		return ERROR;
 
 	var->symbol->symtype = SYMTYPE_FUNCTION;
@@ -1010,8 +1227,7 @@ int sem_finish_procedure(struct semantic_state *ss,
 	 * removed from the symbol table but they will not be destroyed
 	 * because they will be used to check the parameters when calling
 	 * the function. */
-	deref_params(ss->symbols, ss->proc->lexscope);
-	purge_locals(ss->symbols, ss->proc->lexscope);
+	close_scope(ss->symbols, ss->proc->lexscope);
 
 	ss->proc = ss->proc->parent;
 
@@ -1019,26 +1235,25 @@ int sem_finish_procedure(struct semantic_state *ss,
 }
 
 static struct symbol *alloc_main_procedure(struct semantic_state *ss, 
-		const char *name, size_t size)
+		ident_t name)
 {
 	struct symbol *sym;
 
-	sym = add_symbol(ss->symbols, name, size, SYMTYPE_PROCEDURE,
+	sym = add_symbol(ss->symbols, name, SYMTYPE_PROCEDURE,
 			SCOPE_LOCAL, &ss->types[TYPE_VOID],
 			ss->types[TYPE_VOID].reference, NULL);
 	sym->codeobj.scope = CODEGEN_SCOPE_LOCAL;
 	return sym;
 }
 
-int sem_init_program(struct semantic_state *ss, const char *name,
-		size_t size)
+int sem_init_program(struct semantic_state *ss, ident_t name)
 {
 	if (!codegen_program_prolog(ss->codegen)) {
 		semantic_set_error(ss, SEMANTIC_CODEGEN_ERROR, NULL);
 		return ERROR;
 	}
 
-	ss->main_proc = alloc_main_procedure(ss, name, size);
+	ss->main_proc = alloc_main_procedure(ss, name);
 	if (!ss->main_proc) {
 		semantic_set_error(ss, SEMANTIC_SYSTEM_ERROR, NULL);
 		return ERROR;
@@ -1076,7 +1291,7 @@ static int sem_begin_procedure_code(struct semantic_state *ss)
 			return ERROR;
 		}
 
-	for_each_symbol(ss->symbols, iter, sym)
+	for_each_scope_symbol(ss->symbols, ss->proc->lexscope, iter, sym)
 		if (sym->lexscope == ss->proc->lexscope
 				&& sym->symtype == SYMTYPE_VAR)
 			if (!codegen_inst_object(ss->codegen, &sym->codeobj)) {
@@ -1084,6 +1299,12 @@ static int sem_begin_procedure_code(struct semantic_state *ss)
 				return ERROR;
 			}
 
+	if (!codegen_begin_code(ss->codegen, ss->proc->lexscope,
+				ss->proc->locals)) {
+		semantic_set_error(ss, SEMANTIC_CODEGEN_ERROR, NULL);
+		return ERROR;
+	}
+
 	return OK;
 }
 
@@ -1150,12 +1371,23 @@ int sem_cond_epilog(struct semantic_state *ss, sem_ref_t *holdpos)
 int sem_invert_value(struct semantic_state *ss, sem_ref_t *rval)
 {
 	enum object_types type;
+	char msg[BUFSIZ];
 
 	type = rval->type->reference.type;
 	if (type != TYPE_INTEGER && type != TYPE_REAL)
 		sem_warning(ss, SEMANTIC_STRANGE_NEGATIVE,
 				rval->type->name);
-			
+
+	if (rval->known) {
+		if (rval->value == INT_MIN) {
+			sprintf(msg, "-(%d)", rval->value);
+			semantic_set_error(ss, SEMANTIC_CONST_OVERFLOW, msg);
+			return ERROR;
+		}
+		codegen_rewind(ss->codegen, rval->at);
+		return sem_push_known(ss, -rval->value, rval);
+	}
+
 	if (!codegen_invert_value(ss->codegen)) {
 		semantic_set_error(ss, SEMANTIC_CODEGEN_ERROR, NULL);
 		return ERROR;
@@ -1268,20 +1500,20 @@ int sem_write_value(struct semantic_state *ss, sem_ref_t *rval)
 	return OK;
 }
 
-int sem_decl_label(struct semantic_state *ss, const char *name,
-		size_t size)
+int sem_decl_label(struct semantic_state *ss, ident_t name)
 {
 	struct symbol *sym;
 	struct type *type;
 
-	sym = symbol_table_get(ss->symbols, name, size);
+	sym = symbol_table_get(ss->symbols, name);
 	if (sym) {
-		semantic_set_error(ss, SEMANTIC_ALREADY_DEFINED, name);
+		semantic_set_error(ss, SEMANTIC_ALREADY_DEFINED,
+				intern_name(ss->idents, name));
 		return ERROR;
 	}
 
 	type = &ss->types[TYPE_VOID];
-	sym = add_symbol(ss->symbols, name, size, SYMTYPE_LABEL, ss->scope,
+	sym = add_symbol(ss->symbols, name, SYMTYPE_LABEL, ss->scope,
 			type, type->reference, ss->proc);
 	if (!sym) {
 		semantic_set_error(ss, SEMANTIC_SYSTEM_ERROR, NULL);
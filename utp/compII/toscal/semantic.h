@@ -8,6 +8,8 @@
 #include "parameters.h"
 #include "type.h"
 #include "codegen.h"
+#include "intern.h"
+#include "arena.h"
 
 #define SEMANTIC_MAX_ERROR_ARG	BUFSIZ
 
@@ -28,6 +30,8 @@ enum semantic_error {
 	SEMANTIC_INVALID_COND_TYPE,
 	SEMANTIC_INVALID_BYREF_ARG,
 	SEMANTIC_CONST_ASSIGN_ERROR,
+	SEMANTIC_DIVISION_BY_ZERO,
+	SEMANTIC_CONST_OVERFLOW,
 	SEMANTIC_CODEGEN_ERROR
 };
 
@@ -71,6 +75,14 @@ typedef struct {
 		codegen_while_t while_;
 		codegen_repeat_t repeat;
 	};
+	/* expressions only: the value when it is known at compile time, and
+	 * the position of the CRCT pushing it; for the calls of functions,
+	 * at is the position of the room of the value */
+	int known;
+	int value;
+	size_t at;
+	/* the left operand of and/or: where the code after it starts */
+	size_t end;
 }sem_ref_t;
 
 struct semantic_state {
@@ -78,6 +90,8 @@ struct semantic_state {
 	char error_arg[SEMANTIC_MAX_ERROR_ARG];
 
 	struct symbol_table *symbols;
+	struct intern_pool *idents;
+	struct arena *arena;	/* lives as long as the compilation */
 	enum scope_types scope;
 
 	int byref_pending;
@@ -87,6 +101,7 @@ struct semantic_state {
 
 	struct symbol *proc;
 	struct symbol *main_proc;
+	size_t self_call;	/* where the last call of proc to itself ends */
 
 	struct codegen_state *codegen;
 
@@ -95,22 +110,20 @@ struct semantic_state {
 };
 
 void semantic_dump_error(struct semantic_state *ss, FILE *stream);
-struct semantic_state *init_semantic_state();
+struct semantic_state *init_semantic_state(struct codegen_state *codegen,
+		struct intern_pool *idents, struct arena *arena);
+void destroy_semantic_state(struct semantic_state *ss);
 void sem_warning(struct semantic_state *ss, enum semantic_warnings type,
 		const char *warn_arg);
 void semantic_set_error(struct semantic_state *ss,
 		enum semantic_error error, const char *error_arg);
-int sem_decl_const_int(struct semantic_state *ss, const char *name,
-		size_t size, int value);
-int sem_decl_const_char(struct semantic_state *ss, const char *name,
-		size_t size, char value);
-int sem_decl_const_real(struct semantic_state *ss, const char *name,
-		size_t size, float real);
+int sem_decl_const_int(struct semantic_state *ss, ident_t name, int value);
+int sem_decl_const_char(struct semantic_state *ss, ident_t name, char value);
+int sem_decl_const_real(struct semantic_state *ss, ident_t name, float real);
 int sem_decl_var_list(struct semantic_state *ss, struct string_list *names,
 		sem_ref_t *rval);
-int sem_find_type(struct semantic_state *ss, const char *name,
-		size_t size, sem_ref_t *rval);
-int sem_hold_var(struct semantic_state *ss, const char *name, size_t size,
+int sem_find_type(struct semantic_state *ss, ident_t name, sem_ref_t *rval);
+int sem_hold_var(struct semantic_state *ss, ident_t name,
 		sem_ref_t *hold);
 int sem_call_function(struct semantic_state *ss, sem_ref_t *var,
 		sem_ref_t *holdret);
@@ -136,15 +149,16 @@ int sem_relcmp_values(struct semantic_state *ss,
 		enum semantic_cmp_operators operator,
 		sem_ref_t *left, sem_ref_t *right,
 		sem_ref_t *rval);
+int sem_boolcmp_operand(struct semantic_state *ss, sem_ref_t *left);
 int sem_boolcmp_values(struct semantic_state *ss,
 		enum semantic_bool_operators operator,
 		sem_ref_t *left, sem_ref_t *right,
 		sem_ref_t *rval);
 int sem_decl_procedure(struct semantic_state *ss,
-		const char *name, size_t size,
+		ident_t name,
 		sem_ref_t *var);
 int sem_decl_function(struct semantic_state *ss,
-		const char *name, size_t size,
+		ident_t name,
 		sem_ref_t *var);
 int sem_function_type(struct semantic_state *ss,
 		sem_ref_t *var, sem_ref_t *rval);
@@ -159,8 +173,7 @@ int sem_finish_params(struct semantic_state *ss,
 		sem_ref_t *rval);
 int sem_finish_procedure(struct semantic_state *ss, 
 		sem_ref_t *rval);
-int sem_init_program(struct semantic_state *ss, const char *name,
-		size_t size);
+int sem_init_program(struct semantic_state *ss, ident_t name);
 int sem_finish_program(struct semantic_state *ss);
 int sem_begin_code_block(struct semantic_state *ss);
 int sem_begin_params(struct semantic_state *ss, sem_ref_t *rval);
@@ -185,8 +198,7 @@ int sem_repeat_eval(struct semantic_state *ss, sem_ref_t *rval,
 int sem_read_var(struct semantic_state *ss, sem_ref_t *var);
 int sem_write_value(struct semantic_state *ss, sem_ref_t *rval);
 
-int sem_decl_label(struct semantic_state *ss, const char *name,
-		size_t size);
+int sem_decl_label(struct semantic_state *ss, ident_t name);
 int sem_inst_label(struct semantic_state *ss, sem_ref_t *var);
 int sem_goto_label(struct semantic_state *ss, sem_ref_t *var);
 
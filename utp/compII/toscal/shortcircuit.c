@@ -0,0 +1,169 @@
+/** shortcircuit.c
+ *
+ * The and, or and not are kept while the expressions are generated, and
+ * when a condition ends with one of them its operands are generated again
+ * as jumps. The code of an expression is postfix, so the value of
+ * [start, end) is an and/or/not only when the one kept has its position
+ * at end - 1.
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "shortcircuit.h"
+#include "opcodes.h"
+
+#define ERROR	0
+#define OK	1
+
+struct short_circuit {
+	struct codegen_state *cs;
+	struct codegen_inst *saved;	/* the code moved out, from base */
+	size_t base;
+	size_t label;		/* where the condition jumps when false */
+	enum codegen_note note;	/* of the jumps to it */
+};
+
+/** Keeps the and, or or not about to be generated, right is where the code
+ * of its right operand starts */
+int codegen_keep_bool(struct codegen_state *cs, enum mepa_opcode op,
+		size_t right)
+{
+	struct codegen_bool *bools;
+	size_t allocated;
+
+	if (!cs->short_circuit || !cs->out)
+		return OK;
+
+	if (cs->nbools == cs->bools_allocated) {
+		allocated = cs->bools_allocated ? cs->bools_allocated * 2
+			: CODEGEN_INITIAL_BOOLS;
+		bools = (struct codegen_bool*) realloc(cs->bools,
+				allocated * sizeof(struct codegen_bool));
+		if (!bools) {
+			codegen_set_error(cs, CODEGEN_NO_MEMORY);
+			return ERROR;
+		}
+		cs->bools = bools;
+		cs->bools_allocated = allocated;
+	}
+	cs->bools[cs->nbools].op = op;
+	cs->bools[cs->nbools].right = right;
+	cs->bools[cs->nbools].at = cs->ninsts;
+	cs->nbools++;
+
+	return OK;
+}
+
+/* the and/or/not giving the value that ends at end, if any */
+static struct codegen_bool *sc_find(struct short_circuit *sc, size_t end)
+{
+	struct codegen_state *cs = sc->cs;
+	struct codegen_inst *inst;
+	size_t i;
+
+	if (end == 0)
+		return NULL;
+	inst = end - 1 >= sc->base ? &sc->saved[end - 1 - sc->base]
+		: &cs->code[end - 1];
+	for (i = 0; i < cs->nbools; i++)
+		if (cs->bools[i].at == end - 1 && cs->bools[i].op == inst->op)
+			return &cs->bools[i];
+	return NULL;
+}
+
+/* the end of the first operand that isn't an and/or/not, nothing before it
+ * changes */
+static size_t sc_first_value(struct short_circuit *sc, size_t end)
+{
+	struct codegen_bool *b;
+
+	while ((b = sc_find(sc, end)))
+		end = b->op == MEPA_NEGA ? b->at : b->right;
+	return end;
+}
+
+/* the code of the value [start, end), the part before base is in place */
+static int sc_copy(struct short_circuit *sc, size_t start, size_t end)
+{
+	struct codegen_inst *inst;
+	size_t i;
+
+	for (i = start > sc->base ? start : sc->base; i < end; i++) {
+		inst = &sc->saved[i - sc->base];
+		if (!codegen_emit(sc->cs, inst->op, inst->a, inst->b,
+					inst->label, inst->note))
+			return ERROR;
+	}
+	return OK;
+}
+
+/* Generates the value [start, end) jumping to label when it is true (if
+ * when) or false, and falling through otherwise. */
+static int sc_jump(struct short_circuit *sc, size_t start, size_t end,
+		int when, size_t label)
+{
+	struct codegen_state *cs = sc->cs;
+	struct codegen_bool *b = sc_find(sc, end);
+	enum codegen_note note;
+	size_t skip;
+
+	if (!b) {
+		note = label == sc->label ? sc->note : CODEGEN_NOTE_NONE;
+		return sc_copy(sc, start, end)
+			&& (!when || codegen_emit_op(cs, MEPA_NEGA))
+			&& codegen_emit(cs, MEPA_DSVF, 0, 0, label, note);
+	}
+	if (b->op == MEPA_NEGA)
+		return sc_jump(sc, start, b->at, !when, label);
+
+	/* a false operand of an and (or a true one of an or) decides it */
+	if ((b->op == MEPA_CONJ) == !when)
+		return sc_jump(sc, start, b->right, when, label)
+			&& sc_jump(sc, b->right, b->at, when, label);
+
+	/* otherwise the left one only skips the right one */
+	return codegen_new_label(cs, CODEGEN_LABEL_JUMP, &skip)
+		&& sc_jump(sc, start, b->right, !when, skip)
+		&& sc_jump(sc, b->right, b->at, when, label)
+		&& codegen_place_label(cs, skip, CODEGEN_NOTE_NONE);
+}
+
+/** The DSVF of the conditions, with the short circuit when it is on */
+int codegen_jump_false(struct codegen_state *cs, size_t label,
+		enum codegen_note note)
+{
+	struct short_circuit sc;
+	size_t i, count;
+	int ret;
+
+	sc.cs = cs;
+	sc.saved = NULL;
+	sc.base = cs->ninsts;
+	sc.label = label;
+	sc.note = note;
+	if (cs->nbools)
+		sc.base = sc_first_value(&sc, cs->ninsts);
+	count = cs->ninsts - sc.base;
+	for (i = sc.base; i < cs->ninsts; i++)
+		if (cs->code[i].op == MEPA_LABEL)
+			count = 0;
+	if (!count) {
+		cs->nbools = 0;
+		return codegen_emit(cs, MEPA_DSVF, 0, 0, label, note);
+	}
+
+	sc.saved = (struct codegen_inst*) malloc(count
+			* sizeof(struct codegen_inst));
+	if (!sc.saved) {
+		codegen_set_error(cs, CODEGEN_NO_MEMORY);
+		return ERROR;
+	}
+	memcpy(sc.saved, &cs->code[sc.base],
+			count * sizeof(struct codegen_inst));
+	cs->ninsts = sc.base;
+	ret = sc_jump(&sc, 0, sc.base + count, 0, label);
+	free(sc.saved);
+	cs->nbools = 0;
+
+	return ret;
+}
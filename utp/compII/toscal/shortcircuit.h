@@ -0,0 +1,16 @@
+/** The short circuit of the conditions, with -fshort-circuit: the values
+ * of and, or and not become jumps (see codegen_cond_eval()).
+ */
+#ifndef inc_shortcircuit_h
+#define inc_shortcircuit_h
+
+#include <stddef.h>
+
+#include "codegen.h"
+
+int codegen_keep_bool(struct codegen_state *cs, enum mepa_opcode op,
+		size_t right);
+int codegen_jump_false(struct codegen_state *cs, size_t label,
+		enum codegen_note note);
+
+#endif /* inc_shortcircuit_h */
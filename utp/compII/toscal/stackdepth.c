@@ -0,0 +1,338 @@
+/** stackdepth.c
+ *
+ * Each procedure is walked from its entry, following the jumps, with the
+ * words over the base of its frame before each instruction: the paths
+ * getting to an instruction must agree on them. A call leaves the words
+ * it found minus the params of the procedure called, which its RTPR
+ * takes out, and an ENRT sets them to the locals.
+ *
+ * The params are found first, looking for the RTPR after the entry: the
+ * code of each procedure is in one piece, the ones nested in it come
+ * before.
+ */
+#include <stdlib.h>
+
+#include "stackdepth.h"
+#include "opcodes.h"
+
+#define NONE		((size_t) -1)
+#define UNKNOWN		(-1)
+
+/* for the need, while the calls are followed */
+#define NEED_NEW	0
+#define NEED_WALKING	1
+#define NEED_DONE	2
+
+/* a call, with the words over the frame of the procedure making it */
+struct stack_call {
+	size_t callee;
+	long depth;
+};
+
+struct walk {
+	struct codegen_state *cs;
+	struct stack_depth *sd;
+	size_t *proc_at;	/* the procedure entering at each position */
+	size_t *seen;		/* the procedure (plus 1) walking there */
+	long *depth;		/* the words before each position */
+	size_t *work;
+	size_t nwork;
+	/* the ones of each procedure are together, from first_call[p] to
+	 * first_call[p + 1] */
+	struct stack_call *calls;
+	size_t ncalls;
+	size_t calls_allocated;
+	size_t *first_call;
+	unsigned char *state;
+};
+
+/* the position a jump goes to, NONE for the end of the program */
+static size_t jump_target(struct codegen_state *cs, struct codegen_inst *inst)
+{
+	size_t target = cs->labels[inst->label].target;
+
+	return target < cs->ninsts ? target : NONE;
+}
+
+/* the procedures are the main block and every place a CHPR goes to */
+static int find_procedures(struct walk *w)
+{
+	struct codegen_state *cs = w->cs;
+	struct stack_procedure *proc;
+	size_t i, target, n = 1;
+
+	for (i = 0; i < cs->ninsts; i++)
+		w->proc_at[i] = NONE;
+	w->proc_at[0] = 0;
+	for (i = 0; i < cs->ninsts; i++) {
+		if (cs->code[i].op != MEPA_CHPR)
+			continue;
+		target = jump_target(cs, &cs->code[i]);
+		if (target != NONE && w->proc_at[target] == NONE) {
+			w->proc_at[target] = 0;
+			n++;
+		}
+	}
+
+	w->sd->procs = (struct stack_procedure*) malloc(n
+			* sizeof(struct stack_procedure));
+	if (!w->sd->procs)
+		return 0;
+	for (i = 0; i < cs->ninsts; i++) {
+		if (w->proc_at[i] == NONE)
+			continue;
+		w->proc_at[i] = w->sd->nprocs;
+		proc = &w->sd->procs[w->sd->nprocs++];
+		proc->entry = i;
+		proc->frame = 0;
+		proc->depth = UNKNOWN;
+		proc->params = -1;
+		proc->need = -1;
+	}
+
+	return 1;
+}
+
+/* the locals are kept in the b of ENPR (INPP for the main block) */
+static void find_frame(struct walk *w, struct stack_procedure *proc)
+{
+	struct codegen_state *cs = w->cs;
+	size_t i;
+
+	if (proc->entry == 0) {
+		if (cs->code[0].op == MEPA_INPP)
+			proc->frame = cs->code[0].b;
+		return;
+	}
+	if (proc->entry + 1 < cs->ninsts
+			&& cs->code[proc->entry + 1].op == MEPA_ENPR)
+		proc->frame = cs->code[proc->entry + 1].b;
+
+	for (i = proc->entry + 1; i < cs->ninsts; i++) {
+		if (w->proc_at[i] != NONE)
+			break;
+		if (cs->code[i].op == MEPA_RTPR) {
+			proc->params = cs->code[i].b;
+			break;
+		}
+	}
+}
+
+static int add_call(struct walk *w, size_t callee, long depth)
+{
+	struct stack_call *calls;
+	size_t allocated;
+
+	if (w->ncalls == w->calls_allocated) {
+		allocated = w->calls_allocated ? w->calls_allocated * 2 : 16;
+		calls = (struct stack_call*) realloc(w->calls,
+				allocated * sizeof(struct stack_call));
+		if (!calls)
+			return 0;
+		w->calls = calls;
+		w->calls_allocated = allocated;
+	}
+	w->calls[w->ncalls].callee = callee;
+	w->calls[w->ncalls].depth = depth;
+	w->ncalls++;
+
+	return 1;
+}
+
+/* goes on at pos with depth words, 0 when another path got there with a
+ * different number */
+static int visit(struct walk *w, size_t p, size_t pos, long depth)
+{
+	if (pos == NONE || pos >= w->cs->ninsts)
+		return 1;
+	if (w->seen[pos] == p + 1)
+		return w->depth[pos] == depth;
+	w->seen[pos] = p + 1;
+	w->depth[pos] = depth;
+	w->work[w->nwork++] = pos;
+
+	return 1;
+}
+
+/* the depth of the procedure p and the calls it makes, 0 without memory */
+static int walk_procedure(struct walk *w, size_t p)
+{
+	struct codegen_state *cs = w->cs;
+	struct stack_procedure *proc = &w->sd->procs[p];
+	struct codegen_inst *inst;
+	size_t pos, target, callee;
+	long depth, after, most = 0;
+	int next, jump, params;
+
+	w->first_call[p] = w->ncalls;
+	w->nwork = 0;
+	visit(w, p, proc->entry, 0);
+	while (w->nwork) {
+		pos = w->work[--w->nwork];
+		inst = &cs->code[pos];
+		depth = w->depth[pos];
+		after = depth + mepa_opcodes[inst->op].stack;
+		next = 1;
+		jump = 0;
+
+		switch (inst->op) {
+		case MEPA_AMEM:
+			/* its operand is written over the top */
+			after = depth + inst->a;
+			if (depth + 1 > most)
+				most = depth + 1;
+			break;
+		case MEPA_DMEM:
+			after = depth - inst->a;
+			break;
+		case MEPA_ENRT:
+			after = inst->b;
+			break;
+		case MEPA_CHPR:
+			target = jump_target(cs, inst);
+			callee = target == NONE ? NONE : w->proc_at[target];
+			params = callee == NONE ? -1
+				: w->sd->procs[callee].params;
+			if (callee != NONE && !add_call(w, callee, depth))
+				return 0;
+			/* a procedure with no RTPR never comes back */
+			if (params < 0)
+				next = 0;
+			else
+				after = depth - params;
+			break;
+		case MEPA_PARA:
+		case MEPA_RTPR:
+		case MEPA_DSVR:
+			next = 0;
+			break;
+		case MEPA_DSVS:
+			next = 0;
+			jump = 1;
+			break;
+		case MEPA_DSVF:
+		case MEPA_DSIG: case MEPA_DSDG: case MEPA_DSMA:
+		case MEPA_DSAG: case MEPA_DSME: case MEPA_DSEG:
+			jump = 1;
+			break;
+		default:
+			break;
+		}
+		if (depth > most)
+			most = depth;
+		if (after > most)
+			most = after;
+
+		if ((next && !visit(w, p, pos + 1, after))
+				|| (jump && !visit(w, p,
+						jump_target(cs, inst), after))) {
+			proc->depth = UNKNOWN;
+			return 1;
+		}
+	}
+	proc->depth = most > proc->frame ? most - proc->frame : 0;
+
+	return 1;
+}
+
+/* the most p uses with the procedures it calls, -1 when it calls itself
+ * (or a depth isn't known) */
+static long find_need(struct walk *w, size_t p)
+{
+	struct stack_procedure *proc = &w->sd->procs[p];
+	struct stack_call *call;
+	long need, callee;
+
+	if (w->state[p] == NEED_DONE)
+		return proc->need;
+	if (w->state[p] == NEED_WALKING)
+		return -1;
+	w->state[p] = NEED_WALKING;
+
+	need = proc->depth == UNKNOWN ? -1 : proc->frame + proc->depth;
+	for (call = &w->calls[w->first_call[p]];
+			need >= 0 && call < &w->calls[w->first_call[p + 1]];
+			call++) {
+		callee = find_need(w, call->callee);
+		if (callee < 0)
+			need = -1;
+		else if (call->depth + CODEOBJ_ARGS_BP_OFFSET + callee > need)
+			need = call->depth + CODEOBJ_ARGS_BP_OFFSET + callee;
+	}
+
+	w->state[p] = NEED_DONE;
+	proc->need = need;
+
+	return need;
+}
+
+/** The use of the stack by the code generated, NULL without memory */
+struct stack_depth *create_stack_depth(struct codegen_state *cs)
+{
+	struct stack_depth *sd;
+	struct walk w;
+	size_t p, n = cs->ninsts;
+	int ok = 0;
+
+	sd = (struct stack_depth*) malloc(sizeof(struct stack_depth));
+	if (!sd)
+		return NULL;
+	sd->procs = NULL;
+	sd->nprocs = 0;
+	sd->words = 0;
+	if (!n)
+		return sd;
+
+	w.cs = cs;
+	w.sd = sd;
+	w.proc_at = (size_t*) malloc(n * sizeof(size_t));
+	w.seen = (size_t*) calloc(n, sizeof(size_t));
+	w.depth = (long*) malloc(n * sizeof(long));
+	w.work = (size_t*) malloc(n * sizeof(size_t));
+	w.calls = NULL;
+	w.ncalls = 0;
+	w.calls_allocated = 0;
+	w.first_call = NULL;
+	w.state = NULL;
+	if (!w.proc_at || !w.seen || !w.depth || !w.work
+			|| !find_procedures(&w))
+		goto done;
+
+	w.first_call = (size_t*) malloc((sd->nprocs + 1) * sizeof(size_t));
+	w.state = (unsigned char*) calloc(sd->nprocs, 1);
+	if (!w.first_call || !w.state)
+		goto done;
+	for (p = 0; p < sd->nprocs; p++)
+		find_frame(&w, &sd->procs[p]);
+	for (p = 0; p < sd->nprocs; p++)
+		if (!walk_procedure(&w, p))
+			goto done;
+	w.first_call[sd->nprocs] = w.ncalls;
+
+	if (find_need(&w, 0) > 0)
+		sd->words = sd->procs[0].need;
+	ok = 1;
+
+done:
+	free(w.proc_at);
+	free(w.seen);
+	free(w.depth);
+	free(w.work);
+	free(w.calls);
+	free(w.first_call);
+	free(w.state);
+	if (!ok) {
+		destroy_stack_depth(sd);
+		return NULL;
+	}
+
+	return sd;
+}
+
+void destroy_stack_depth(struct stack_depth *sd)
+{
+	if (!sd)
+		return;
+	free(sd->procs);
+	free(sd);
+}
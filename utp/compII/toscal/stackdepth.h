@@ -0,0 +1,39 @@
+/** The use of the stack by each procedure of the generated code, written
+ * as comments in the text with toscal -s and always in the bytecode (see
+ * bytecode.h), where mepa/mepa takes the room of the whole program from
+ * it.
+ *
+ * The words are counted from the base of the frame (the first local, or
+ * the bottom of the stack for the main block): frame is what the
+ * procedure allocates at its start and depth the most that its code
+ * pushes over it. The 3 words saved by CHPR belong to the procedure
+ * called, so the most the program uses adds, along each chain of calls,
+ * the depth at each call plus 3 plus what the procedure called uses.
+ */
+#ifndef inc_stackdepth_h
+#define inc_stackdepth_h
+
+#include <stddef.h>
+
+#include "codegen.h"
+
+struct stack_procedure {
+	size_t entry;	/* position in cs->code: the label of the
+			   procedure, or 0 for the main block */
+	int frame;
+	int depth;	/* -1 when the paths to an instruction don't agree */
+	int params;	/* taken out by RTPR, -1 for the main block or when
+			   it never returns */
+	long need;	/* with the procedures called, -1 when unbounded */
+};
+
+struct stack_depth {
+	struct stack_procedure *procs;	/* in the order of the code */
+	size_t nprocs;
+	size_t words;	/* the most the program uses, 0 when unbounded */
+};
+
+struct stack_depth *create_stack_depth(struct codegen_state *cs);
+void destroy_stack_depth(struct stack_depth *sd);
+
+#endif /* inc_stackdepth_h */
@@ -1,34 +1,34 @@
 #ifndef inc_slist_h
 #define inc_slist_h
 
+#include "intern.h"
+#include "arena.h"
+
+/* A list of interned names, in the order they were added */
 struct string_item {
-	char *value;
-	size_t size;
+	ident_t ident;
 	struct string_item *next;
 };
 
 struct string_list {
 	struct string_item *first;
 	struct string_item *last;
+	struct arena *arena;
 };
 
 /* just to not leak a implementation detail to the users of the
  * string_list_foreach macro */
 typedef struct string_item* string_list_iter_t;
 
-struct string_list *create_string_list();
-char *string_list_add(struct string_list *sl, const char *value,
-		size_t size);
-/* no need to remove items from the list, at least for now */
-void destroy_string_list(struct string_list *sl);
+/* the list and its items are released along with the arena */
+struct string_list *create_string_list(struct arena *arena);
+struct string_item *string_list_add(struct string_list *sl, ident_t ident);
 
-#define string_list_foreach(sl, iter, ptr, sizeval) \
+#define string_list_foreach(sl, iter, identval) \
 	  for (iter = sl->first, \
-			ptr = iter ? iter->value : 0, \
-			sizeval = iter ? iter->size : 0; \
+			identval = iter ? iter->ident : 0; \
 		iter; \
 		  iter = iter->next, \
-		       ptr = iter ? iter->value : 0, \
-		       sizeval = iter ? iter->size : 0)
+		       identval = iter ? iter->ident : 0)
 
 #endif
@@ -5,19 +5,22 @@
 #include "string_list.h"
 #include "symbols.h"
 #include "parameters.h"
-#include "hash.h"
 
-/* Crappy memory allocation scheme:
+/* Memory allocation scheme:
  *
- * - global symbols are destroyed along with the symbol table;
- * - local symbols (local variables only) are destroyed when the parser
- *   ends reading/checking the function/procedure;
- * - function parameters (SCOPE_PARAMS) are freed along with the symbol
- *   table (ie. in the same moment globals are freed) , BUT they can still
- *   be referenced by ->parameters of functions.
+ * - local symbols (variables, constants and labels) are taken from
+ *   st->locals and released all at once when the parser ends
+ *   reading/checking the function/procedure;
+ * - functions, procedures and their parameters (SCOPE_PARAMS) are taken
+ *   from the arena of the compilation, the parameters are still needed
+ *   to check the calls to their function after its scope is closed.
+ *
+ * Functions and procedures are never dropped: when their scope is closed
+ * they are moved to the scope that encloses it.
  */
 
-struct symbol_table *init_symbol_table()
+struct symbol_table *init_symbol_table(struct intern_pool *idents,
+		struct arena *arena)
 {
 	struct symbol_table *st;
 
@@ -25,58 +28,106 @@ struct symbol_table *init_symbol_table()
 	if (!st)
 		return NULL;
 
-	st->symbols = hash_init(SYMBOL_TABLE_HASH_SIZE);
-	if (!st->symbols) {
-		free(st);
-		return NULL;
-	}
+	st->idents = idents;
+	st->arena = arena;
+	st->bindings = NULL;
+	st->bindings_size = 0;
+
+	st->log_count = 0;
+	st->log_allocated = SYMBOL_TABLE_INITIAL_LOG;
+	st->log = (struct symbol**) malloc(st->log_allocated
+			* sizeof(struct symbol*));
+	if (!st->log)
+		goto error_log;
+
+	st->scopes_allocated = SYMBOL_TABLE_INITIAL_SCOPES;
+	st->scopes = (struct scope*) malloc(st->scopes_allocated
+			* sizeof(struct scope));
+	if (!st->scopes)
+		goto error_scopes;
+
+	st->locals = create_arena(ARENA_BLOCK_SIZE);
+	if (!st->locals)
+		goto error_locals;
+
+	st->scopes[0].begin = 0;
+	st->scopes[0].locals = arena_mark(st->locals);
 
 	return st;
-}
 
-void destroy_symbol(struct symbol *sym)
-{
-	parameters_iter_t iter;
-	struct symbol *psym;
-	
-	free(sym->name);
-	if (sym->parameters) {
-		for_each_parameter(sym->parameters, iter, psym)
-			destroy_symbol(psym);
-		destroy_parameters(sym->parameters);
-	}
-	free(sym);
+error_locals:
+	free(st->scopes);
+error_scopes:
+	free(st->log);
+error_log:
+	free(st);
+	return NULL;
 }
 
+/* the symbols in st->arena are freed along with it */
 void destroy_symbol_table(struct symbol_table *st)
 {
-	hash_iter_t iter;
-	struct symbol *sym;
-
-	for_each_hash_value(st->symbols, iter, sym)
-		destroy_symbol(sym);
-	hash_free(st->symbols);
+	destroy_arena(st->locals);
+	free(st->scopes);
+	free(st->log);
+	free(st->bindings);
 	free(st);
 }
 
-/** Gets the symbol structure from a given symbol name */
-struct symbol *symbol_table_get(struct symbol_table *st, const char *name,
-		size_t size)
+/** Gets the visible symbol with the given name */
+struct symbol *symbol_table_get(struct symbol_table *st, ident_t name)
 {
-	struct symbol *sym;
+	if (name >= st->bindings_size)
+		return NULL;
+	return st->bindings[name];
+}
+
+/* makes room for the binding of name, the pool may have grown since the
+ * last symbol was added */
+static int grow_bindings(struct symbol_table *st, ident_t name)
+{
+	struct symbol **bindings;
+	size_t size;
+
+	size = st->bindings_size ? st->bindings_size : SYMBOL_TABLE_INITIAL_LOG;
+	while (size <= name)
+		size *= 2;
+
+	bindings = (struct symbol**) realloc(st->bindings,
+			size * sizeof(struct symbol*));
+	if (!bindings)
+		return 0;
+	memset(bindings + st->bindings_size, 0,
+			(size - st->bindings_size) * sizeof(struct symbol*));
+	st->bindings = bindings;
+	st->bindings_size = size;
+
+	return 1;
+}
 
-	sym = (struct symbol*) hash_get(st->symbols, name, size, 0);
+static int log_symbol(struct symbol_table *st, struct symbol *sym)
+{
+	struct symbol **log;
+
+	if (st->log_count == st->log_allocated) {
+		log = (struct symbol**) realloc(st->log,
+				st->log_allocated * 2 * sizeof(struct symbol*));
+		if (!log)
+			return 0;
+		st->log = log;
+		st->log_allocated *= 2;
+	}
+	st->log[st->log_count++] = sym;
 
-	return sym;
+	return 1;
 }
 
 /** Adds a new symbol to the symbol table
  *
- * Note it doesn't check whether it already exists in the hash table, it
- * will overwrite one that already exists.
+ * Note it doesn't check whether it already exists in the table, it will
+ * shadow one that already exists until the current scope is closed.
  */
-struct symbol* add_symbol(struct symbol_table *st,
-		const char *name, size_t size,
+struct symbol* add_symbol(struct symbol_table *st, ident_t name,
 		enum symbol_types symtype, 
 		enum scope_types scope,
 		struct type *type,
@@ -84,16 +135,23 @@ struct symbol* add_symbol(struct symbol_table *st,
 		struct symbol *parent)
 {
 	struct symbol *sym;
+	struct arena *arena;
+
+	if (name >= st->bindings_size && !grow_bindings(st, name))
+		return NULL;
 
-	sym = (struct symbol*) malloc(sizeof(struct symbol));
+	if (symtype == SYMTYPE_FUNCTION || symtype == SYMTYPE_PROCEDURE
+			|| scope == SCOPE_PARAMS)
+		arena = st->arena;
+	else
+		arena = st->locals;
+	sym = (struct symbol*) arena_alloc(arena, sizeof(struct symbol));
 	if (!sym)
-		goto error;
+		return NULL;
 
-	sym->name = (char*) malloc(size + 1);
-	if (!sym->name)
-		goto error_name;
-	strncpy(sym->name, name, size + 1);
-	sym->size = size;
+	sym->ident = name;
+	sym->name = intern_name(st->idents, name);
+	sym->size = intern_size(st->idents, name);
 
 	sym->symtype = symtype;
 	sym->scope = scope;
@@ -110,53 +168,73 @@ struct symbol* add_symbol(struct symbol_table *st,
 	if (parent)
 		sym->lexscope = parent->lexscope;
 
-	if (!hash_put(st->symbols, name, size, sym, 0))
-		goto error_name;
+	if (!log_symbol(st, sym))
+		return NULL;
 
-	return sym;
+	sym->shadowed = st->bindings[name];
+	st->bindings[name] = sym;
 
-error_name:
-	free(sym->name);
-error:
-	free(sym);
-	return NULL;
+	return sym;
 }
 
-/* no need to drop individual symbols for now */
-void purge_locals(struct symbol_table *st, int lexscope)
+/** Starts the lexical level, the symbols added from now on belong to it */
+int open_scope(struct symbol_table *st, int lexscope)
 {
-	hash_iter_t iter;
-	struct symbol *sym;
+	struct scope *scopes;
+
+	if (lexscope >= st->scopes_allocated) {
+		scopes = (struct scope*) realloc(st->scopes,
+				st->scopes_allocated * 2 * sizeof(struct scope));
+		if (!scopes)
+			return 0;
+		st->scopes = scopes;
+		st->scopes_allocated *= 2;
+	}
+	st->scopes[lexscope].begin = st->log_count;
+	st->scopes[lexscope].locals = arena_mark(st->locals);
 
-	for_each_hash_value(st->symbols, iter, sym)
-		if (sym->scope == SCOPE_LOCAL && sym->lexscope == lexscope
-				&& sym->symtype != SYMTYPE_FUNCTION
-		  		&& sym->symtype != SYMTYPE_PROCEDURE) {
-			hash_pop(st->symbols, sym->name, sym->size, 0);
-			destroy_symbol(sym);
-		}
+	return 1;
 }
 
-/* Removes the references to the function parameters symbols, but doesn't
- * destroy them. */
-void deref_params(struct symbol_table *st, int lexscope)
+/** Ends the lexical level opened by the last open_scope()
+ *
+ * The local symbols are released, the parameters are removed from the
+ * table but they will still be used to check the calls to their function,
+ * and the functions and procedures are kept.
+ */
+void close_scope(struct symbol_table *st, int lexscope)
 {
-	hash_iter_t iter;
+	size_t begin = st->scopes[lexscope].begin;
+	size_t i, kept;
 	struct symbol *sym;
 
-	for_each_hash_value(st->symbols, iter, sym)
-		if (sym->scope == SCOPE_PARAMS && sym->lexscope == lexscope)
-			hash_pop(st->symbols, sym->name, sym->size, 0);
+	/* backwards, so that the bindings shadowed in this same scope are
+	 * restored in the right order */
+	for (i = st->log_count; i > begin; i--) {
+		sym = st->log[i - 1];
+		if (sym->symtype == SYMTYPE_FUNCTION
+				|| sym->symtype == SYMTYPE_PROCEDURE)
+			continue;
+		st->bindings[sym->ident] = sym->shadowed;
+		st->log[i - 1] = NULL;
+	}
+
+	for (i = kept = begin; i < st->log_count; i++)
+		if (st->log[i])
+			st->log[kept++] = st->log[i];
+	st->log_count = kept;
+
+	arena_release(st->locals, st->scopes[lexscope].locals);
 }
 
 void find_unreferenced_symbols(struct symbol_table *st, int lexscope, void *state,
 		const char *context, symbol_warnf_t warnf)
 {
 
-	hash_iter_t iter;
+	symbol_table_iter_t iter;
 	struct symbol *sym;
 
-	for_each_hash_value(st->symbols, iter, sym)
+	for_each_scope_symbol(st, lexscope, iter, sym)
 		if (sym->lexscope == lexscope
 				&& sym->symtype != SYMTYPE_FUNCTION
 				&& sym->symtype != SYMTYPE_PROCEDURE
@@ -2,11 +2,13 @@
 #define inc_symbols_h
 
 #include "string_list.h"
-#include "hash.h"
+#include "intern.h"
+#include "arena.h"
 #include "type.h"
 #include "codegen.h"
 
-#define SYMBOL_TABLE_HASH_SIZE	1024
+#define SYMBOL_TABLE_INITIAL_LOG	256
+#define SYMBOL_TABLE_INITIAL_SCOPES	16
 
 enum scope_types {
 	SCOPE_LOCAL,
@@ -23,7 +25,8 @@ enum symbol_table_errors {
 /* TODO consider moving all the object-related data to another structure
  * and refer it here just as an "object structure" */
 struct symbol {
-	char *name;
+	ident_t ident;
+	const char *name;	/* owned by the intern pool */
 	size_t size;
 	enum symbol_types symtype;
 	enum scope_types scope;
@@ -38,35 +41,66 @@ struct symbol {
 	size_t locals;
 
 	struct symbol *parent;
+	struct symbol *shadowed; /* previous binding of the same name */
+};
+
+/* The visible symbol of each name is kept in an array indexed by its
+ * ident_t, older bindings of the same name are chained through ->shadowed.
+ *
+ * Every symbol is also appended to a log in declaration order, and
+ * scopes[n] tells where the symbols of the lexical level n start in it, so
+ * closing a scope only touches the symbols declared on it.
+ *
+ * The symbols that go away with their scope are taken from the locals
+ * arena, which is released back to the mark of the scope when it is
+ * closed. Functions, procedures and parameters outlive their scopes and
+ * are taken from the arena of the whole compilation.
+ */
+struct scope {
+	size_t begin;			/* first symbol in the log */
+	struct arena_mark locals;
 };
 
 struct symbol_table {
-	struct hash_table *symbols;
+	struct intern_pool *idents;
+	struct arena *arena;
+	struct arena *locals;
+
+	struct symbol **bindings;
+	size_t bindings_size;
+
+	struct symbol **log;
+	size_t log_count;
+	size_t log_allocated;
+
+	struct scope *scopes;
+	size_t scopes_allocated;
 };
 
-struct symbol_table *init_symbol_table();
+struct symbol_table *init_symbol_table(struct intern_pool *idents,
+		struct arena *arena);
 void destroy_symbol_table(struct symbol_table *st);
-void destroy_symbol(struct symbol *sym);
-struct symbol* add_symbol(struct symbol_table *st,
-		const char *name, size_t size,
+struct symbol* add_symbol(struct symbol_table *st, ident_t name,
 		enum symbol_types symtype, 
 		enum scope_types scope,
 		struct type *type,
 		struct object value,
 		struct symbol *parent);
-struct symbol *symbol_table_get(struct symbol_table *st, const char *name,
-		size_t size);
-/* no need to drop individual symbols for now */
-void purge_locals(struct symbol_table *st, int lexscope);
-void deref_params(struct symbol_table *st, int lexscope);
+struct symbol *symbol_table_get(struct symbol_table *st, ident_t name);
+int open_scope(struct symbol_table *st, int lexscope);
+void close_scope(struct symbol_table *st, int lexscope);
 
 typedef void (*symbol_warnf_t)(void*, const char *, const char *);
 void find_unreferenced_symbols(struct symbol_table *st, int lexscope,
 		void *state, const char *context, symbol_warnf_t warnf);
 
-typedef hash_iter_t symbol_table_iter_t;
+typedef size_t symbol_table_iter_t;
 
-#define for_each_symbol(table, iter, sym) \
-	for_each_hash_value(table->symbols, iter, sym)
+/* goes over the symbols declared in the lexical level, in order */
+#define for_each_scope_symbol(table, lexscope, iter, sym) \
+	for (iter = (table)->scopes[lexscope].begin; \
+			iter < (table)->log_count \
+			&& ((sym = (table)->log[iter]), 1); \
+			iter++)
 
 #endif
@@ -0,0 +1,165 @@
+/** tailcalls.c
+ *
+ * A call of the procedure to itself with nothing but jumps between it and
+ * the end of the procedure stores the arguments over the parameters and
+ * jumps back to the start of the procedure, reusing the frame.
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "tailcalls.h"
+#include "opcodes.h"
+
+#define ERROR	0
+#define OK	1
+
+/** The call just generated is a call of the procedure being generated to
+ * itself, made by a statement that may be its last one; result tells the
+ * value of the function is stored next */
+int codegen_tail_call(struct codegen_state *cs, int result)
+{
+	struct codegen_tail_call *tails;
+	size_t allocated;
+
+	if (!cs->tail_calls || !cs->out || !cs->ninsts
+			|| cs->code[cs->ninsts - 1].op != MEPA_CHPR)
+		return OK;
+
+	if (cs->ntails == cs->tails_allocated) {
+		allocated = cs->tails_allocated ? cs->tails_allocated * 2
+			: CODEGEN_INITIAL_TAILS;
+		tails = (struct codegen_tail_call*) realloc(cs->tails,
+				allocated * sizeof(struct codegen_tail_call));
+		if (!tails) {
+			codegen_set_error(cs, CODEGEN_NO_MEMORY);
+			return ERROR;
+		}
+		cs->tails = tails;
+		cs->tails_allocated = allocated;
+	}
+	cs->tails[cs->ntails].at = cs->ninsts - 1;
+	cs->tails[cs->ntails].result = result;
+	cs->ntails++;
+
+	return OK;
+}
+
+/* the code from pos reaches end with no other instruction than DSVS */
+static int codegen_reaches_end(struct codegen_state *cs, size_t pos,
+		size_t end)
+{
+	size_t steps = 0;
+	size_t target;
+
+	while (pos < end) {
+		if (cs->code[pos].op == MEPA_DSVS) {
+			target = cs->labels[cs->code[pos].label].target;
+			/* a loop made of jumps never gets there */
+			if (target == CODEGEN_NO_TARGET || ++steps > end)
+				return 0;
+			pos = target;
+		}
+		else if (mepa_opcodes[cs->code[pos].op].operands
+				== MEPA_OPND_PSEUDO)
+			pos++;
+		else
+			return 0;
+	}
+
+	return 1;
+}
+
+/* the code of the tail call, instead of the CHPR (and the ARMZ of the
+ * result) at tail */
+static int codegen_tail_jump(struct codegen_state *cs, int k,
+		size_t params_offset, size_t locals_offset, int result,
+		size_t start)
+{
+	size_t i;
+
+	/* the last argument is the top of the stack */
+	for (i = 0; i < params_offset; i++)
+		if (!codegen_emit(cs, MEPA_ARMZ, k,
+					-(int) (CODEOBJ_ARGS_BP_OFFSET + 1 + i),
+					0, CODEGEN_NOTE_PARAM_VAR))
+			return ERROR;
+	/* the room for the result goes away and the locals are allocated
+	 * again */
+	if (result && !codegen_emit(cs, MEPA_DMEM, result, 0, 0,
+				CODEGEN_NOTE_FUNC_CALL))
+		return ERROR;
+	if (locals_offset && !codegen_emit(cs, MEPA_DMEM, locals_offset, 0, 0,
+				CODEGEN_NOTE_DEALLOC_LOCALS))
+		return ERROR;
+
+	return codegen_emit(cs, MEPA_DSVS, 0, 0, start, CODEGEN_NOTE_NONE);
+}
+
+/** The code after ENPR is moved out and generated again with the tail calls
+ * replaced, like in codegen_jump_false(), at the end of the procedure */
+int codegen_tail_calls(struct codegen_state *cs, int k,
+		size_t params_offset, size_t locals_offset)
+{
+	struct codegen_tail_call *tail;
+	struct codegen_inst *saved, *inst;
+	size_t proc, entry, count, start, i;
+	int found = 0, ret = OK;
+
+	proc = cs->labels[cs->code[cs->tails[0].at].label].target;
+	if (proc == CODEGEN_NO_TARGET || proc + 1 >= cs->ninsts
+			|| cs->code[proc + 1].op != MEPA_ENPR)
+		return OK;
+	entry = proc + 2;
+	while (entry < cs->ninsts && cs->code[entry].op == MEPA_PARAM_NOTE)
+		entry++;
+	if (entry < cs->written)
+		return OK;
+
+	/* the addresses in the frame can't be passed to the next call */
+	for (i = entry; i < cs->ninsts; i++)
+		if (cs->code[i].op == MEPA_CREN && cs->code[i].a == k)
+			return OK;
+
+	for (tail = cs->tails; tail < cs->tails + cs->ntails; tail++)
+		if (codegen_reaches_end(cs, tail->at + 1 + tail->result,
+					cs->ninsts))
+			found = 1;
+		else
+			tail->at = CODEGEN_NO_TARGET;
+	if (!found)
+		return OK;
+
+	count = cs->ninsts - entry;
+	saved = (struct codegen_inst*) malloc(count
+			* sizeof(struct codegen_inst));
+	if (!saved) {
+		codegen_set_error(cs, CODEGEN_NO_MEMORY);
+		return ERROR;
+	}
+	memcpy(saved, &cs->code[entry], count * sizeof(struct codegen_inst));
+	cs->ninsts = entry;
+
+	ret = codegen_new_label(cs, CODEGEN_LABEL_JUMP, &start)
+		&& codegen_place_label(cs, start, CODEGEN_NOTE_NONE);
+	tail = cs->tails;
+	for (i = 0; ret && i < count; i++) {
+		inst = &saved[i];
+		while (tail < cs->tails + cs->ntails
+				&& (tail->at == CODEGEN_NO_TARGET
+					|| tail->at < entry + i))
+			tail++;
+		if (tail < cs->tails + cs->ntails && tail->at == entry + i) {
+			ret = codegen_tail_jump(cs, k, params_offset,
+					locals_offset, tail->result, start);
+			i += tail->result;
+		}
+		else if (inst->op == MEPA_LABEL)
+			ret = codegen_place_label(cs, inst->label, inst->note);
+		else
+			ret = codegen_emit(cs, inst->op, inst->a, inst->b,
+					inst->label, inst->note);
+	}
+	free(saved);
+
+	return ret;
+}
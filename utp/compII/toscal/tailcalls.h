@@ -0,0 +1,15 @@
+/** The tail calls, with -ftail-calls: the calls of a procedure to itself
+ * that end it become jumps to its start (see codegen_procedure_epilog()).
+ */
+#ifndef inc_tailcalls_h
+#define inc_tailcalls_h
+
+#include <stddef.h>
+
+#include "codegen.h"
+
+int codegen_tail_call(struct codegen_state *cs, int result);
+int codegen_tail_calls(struct codegen_state *cs, int k,
+		size_t params_offset, size_t locals_offset);
+
+#endif /* inc_tailcalls_h */
@@ -1,8 +1,41 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
 
 #include "input.h"
 #include "tokenize.h"
+#include "scan.h"
+
+/* each engine runs over the file again and again for at least this time */
+#define BENCH_MIN_CLOCKS	(CLOCKS_PER_SEC / 2)
+
+typedef struct token *(*fetch_token_t)(struct input_state*, struct token*);
+
+static void bench_engine(struct input_state *is, const char *name,
+		fetch_token_t fetch)
+{
+	struct token tok;
+	unsigned long tokens = 0;
+	unsigned long rounds = 0;
+	clock_t start, elapsed;
+	double secs;
+
+	tok.idents = NULL;
+	start = clock();
+	do {
+		input_rewind(is);
+		while (fetch(is, &tok))
+			tokens++;
+		rounds++;
+		elapsed = clock() - start;
+	} while (elapsed < BENCH_MIN_CLOCKS);
+
+	secs = (double) elapsed / CLOCKS_PER_SEC;
+	printf("%s engine: %lu tokens in %lu rounds, %.3fs, %.0f tokens/sec, "
+			"%.1f MB/s\n", name, tokens, rounds, secs,
+			tokens / secs, is->size * rounds / secs / 1e6);
+}
 
 int main(int argc, char *argv[])
 {
@@ -11,9 +44,27 @@ int main(int argc, char *argv[])
 	struct token tok;
 	struct input_state *is;
 	int err = 0;
+	int bench = 0;
+	const char *impl;
+	size_t j;
 
 	for (i = 1; i < argc; i++) {
 
+		if (strcmp(argv[i], "-b") == 0) {
+			bench = 1;
+			continue;
+		}
+		if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+			/* forces one of the implementations of scan.c */
+			init_scan();
+			if (!scan_select(argv[++i])) {
+				fprintf(stderr, "%s: not supported\n", argv[i]);
+				err = 3;
+				goto failed_open;
+			}
+			continue;
+		}
+
 		input = fopen(argv[i], "r");
 		if (!input) {
 			perror(argv[i]);
@@ -28,6 +79,18 @@ int main(int argc, char *argv[])
 			goto failed_input_stream;
 		}
 
+		if (bench) {
+			printf("%s:\n", argv[i]);
+			bench_engine(is, "switch", fetch_next_token_switch);
+			for (j = 0; (impl = scan_available(j)); j++) {
+				scan_select(impl);
+				printf("(%s) ", impl);
+				bench_engine(is, "table", fetch_next_token);
+			}
+			goto next;
+		}
+
+		tok.idents = NULL;
 		while (fetch_next_token(is, &tok))
 			dump_token(&tok, stdout);
 
@@ -37,6 +100,7 @@ int main(int argc, char *argv[])
 			err = 2;
 		}
 
+next:
 		close_input_state(is);
 failed_input_stream:
 		fclose(input);
@@ -0,0 +1,13 @@
+(* an expression passed to a var parameter is a semantic error with -A,
+   the parser reads it as any other argument *)
+program ByrefExpression;
+var x: integer;
+procedure inc(var n: integer);
+begin
+	n := n + 1
+end;
+begin
+	x := 1;
+	inc(x + 1);
+	write(x)
+end.
@@ -0,0 +1,6 @@
+(* with -A the whole program is read before the semantic checks, so the
+   syntax error is the one reported *)
+program SyntaxAfterSemantic;
+begin
+	reference_an_undeclared_procedure;
+end
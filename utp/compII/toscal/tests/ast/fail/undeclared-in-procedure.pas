@@ -0,0 +1,12 @@
+(* the message has the position where the parser was when it read the
+   name, not the end of the program *)
+program UndeclaredInProcedure;
+var x: integer;
+procedure p(a: integer);
+begin
+	x := a + y
+end;
+begin
+	p(1);
+	write(x)
+end.
@@ -0,0 +1,14 @@
+program test_const_fold;
+const k = 3;
+      c = 'a';
+var a, b : integer;
+begin
+	a := k * 4 + 1;
+	b := (a + k) * (k - 1);
+	a := -7 div 2 + (-7 mod 2) * 10;
+	b := c + 1;
+	a := (k > 2) and (k < 10);
+	b := not (k = 3) or 5;
+	a := -(k * 2);
+	write(a, b, k * k - a)
+end.
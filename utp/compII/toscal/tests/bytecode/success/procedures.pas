@@ -0,0 +1,26 @@
+program procedures;
+var
+	n: integer;
+
+function fact(x: integer): integer;
+begin
+	if x <= 1 then
+		fact := 1
+	else
+		fact := x * fact(x - 1)
+end;
+
+procedure count(var i: integer; until_: integer);
+label 1;
+begin
+	1: write(i);
+	i := i + 1;
+	if i < until_ then
+		goto 1
+end;
+
+begin
+	n := 1;
+	count(n, 4);
+	write(fact(5) mod 7)
+end.
@@ -0,0 +1,32 @@
+program inl;
+var x, y : integer;
+
+function sq(n : integer) : integer;
+begin
+	sq := n * n
+end;
+
+procedure swap(var a, b : integer);
+var t : integer;
+begin
+	t := a;
+	a := b;
+	b := t
+end;
+
+function max(a, b : integer) : integer;
+begin
+	if a > b then
+		max := a
+	else
+		max := b
+end;
+
+begin
+	x := 3;
+	y := 4;
+	swap(x, y);
+	write(x, y);
+	write(sq(x) + sq(max(x, y + 1)));
+	write(max(sq(2), sq(3)))
+end.
@@ -0,0 +1,24 @@
+program lbl;
+label 10;
+var i, s : integer;
+
+function twice(n : integer) : integer;
+begin
+	twice := n + n
+end;
+
+procedure add(var acc : integer; n : integer);
+begin
+	acc := acc + twice(n)
+end;
+
+begin
+	i := 0;
+	s := 0;
+10:
+	add(s, i);
+	i := i + 1;
+	if i < 5 then
+		goto 10;
+	write(s)
+end.
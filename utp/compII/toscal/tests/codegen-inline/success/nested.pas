@@ -0,0 +1,47 @@
+program nested;
+var x : integer;
+
+procedure outer(n : integer);
+var t : integer;
+
+	function inner(m : integer) : integer;
+	begin
+		inner := m * t
+	end;
+
+	procedure show(v : integer);
+	begin
+		write(v + inner(v))
+	end;
+
+begin
+	t := n;
+	show(inner(2));
+	write(t)
+end;
+
+procedure halve(var n : integer);
+begin
+	while n > 9 do
+		n := n div 2
+end;
+
+function count(n : integer) : integer;
+var c : integer;
+begin
+	c := 0;
+	while n > 0 do
+	begin
+		c := c + 1;
+		n := n div 2
+	end;
+	count := c
+end;
+
+begin
+	x := 3;
+	outer(x);
+	x := 1000;
+	halve(x);
+	write(x, count(1000))
+end.
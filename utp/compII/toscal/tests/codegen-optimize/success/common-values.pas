@@ -0,0 +1,29 @@
+program commonvalues;
+var a, b, c, i, s : integer;
+
+procedure twice(var r : integer; f : integer);
+begin
+	r := (r + f) * (r + f);
+	write(r + f);
+	r := r - 1;
+	write(r + f, r + f)
+end;
+
+begin
+	a := 3;
+	b := 4;
+	c := 5;
+	s := (a * b + c) * (a * b + c) - a * b;
+	write(s, a * b);
+	a := a + 1;
+	write(a * b);
+	twice(s, c);
+	write(a * b);
+	i := 0;
+	while i < 3 do
+	begin
+		s := s + (i + c) * (i + c);
+		i := i + 1
+	end;
+	write(s)
+end.
@@ -0,0 +1,19 @@
+program comparejump;
+var i, j: integer;
+begin
+	i := 0;
+	j := 10;
+	while i < j do
+	begin
+		if i = 3 then
+			write(i);
+		if not (i >= 5) then
+			write(j);
+		i := i + 1
+	end;
+	repeat
+		j := j - 1
+	until j <= i;
+	if i <> j then
+		write(i)
+end.
@@ -0,0 +1,42 @@
+program deadcode;
+label 10;
+const debug = 0;
+var x : integer;
+
+procedure unused(n : integer);
+	procedure inner;
+	begin
+		write(n)
+	end;
+begin
+	inner
+end;
+
+procedure helper(n : integer);
+begin
+	write(n * 2)
+end;
+
+procedure onlyfromunused;
+begin
+	helper(1)
+end;
+
+procedure show(n : integer);
+begin
+	if debug = 1 then
+		write(0 - n)
+	else
+		helper(n)
+end;
+
+begin
+	x := 3;
+	show(x);
+	while debug > 0 do
+		x := x + 1;
+	goto 10;
+	write(x);
+	x := 0;
+10:	write(x)
+end.
@@ -0,0 +1,9 @@
+program test_fold_const;
+var a, b : integer;
+    e : real;
+begin
+	a := 1;
+	b := -(-a) * 3 + a * 4 div 2;
+	e := 2.5 + 1.5 * 2.0;
+	write(a, b, e)
+end.
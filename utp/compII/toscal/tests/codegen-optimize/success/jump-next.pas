@@ -0,0 +1,9 @@
+program test_jump_next;
+var x : integer;
+begin
+	x := 1;
+	if x > 1 then
+		write(x)
+	else
+		write(0)
+end.
@@ -0,0 +1,11 @@
+program test_labels;
+label 100;
+var x : integer;
+begin
+	x := 0;
+100:
+	x := x + 1;
+	if x < 3 then
+		goto 100;
+	write(x)
+end.
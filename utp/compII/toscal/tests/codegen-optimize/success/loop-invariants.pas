@@ -0,0 +1,34 @@
+program loopinvariants;
+var i, n, k, s : integer;
+
+procedure scale(var r : integer; f : integer);
+var j, t : integer;
+begin
+	j := 0;
+	t := 0;
+	while j < f * 2 do
+	begin
+		t := t + (f + 3) * f;
+		j := j + 1
+	end;
+	repeat
+		r := r + f div 2;
+		j := j - 1
+	until j < f - 1;
+	write(t)
+end;
+
+begin
+	n := 5;
+	k := 3;
+	i := 0;
+	s := 0;
+	while i < n + k do
+	begin
+		s := s + n * k + i * (n - k) + n * k;
+		i := i + 1
+	end;
+	write(s);
+	scale(s, k);
+	write(s)
+end.
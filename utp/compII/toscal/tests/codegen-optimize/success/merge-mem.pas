@@ -0,0 +1,17 @@
+program test_merge_mem;
+var a, b, c : integer;
+
+function f(x : integer) : integer;
+var y, z : integer;
+begin
+	y := x;
+	z := y + 1;
+	f := z
+end;
+
+begin
+	a := f(1);
+	b := a;
+	c := b + a;
+	write(c)
+end.
@@ -0,0 +1,35 @@
+program tailcalls;
+var r : integer;
+
+procedure count(n, acc : integer);
+var x : integer;
+begin
+	x := n * 2;
+	if n = 0 then
+		write(acc)
+	else
+		count(n - 1, acc + x)
+end;
+
+function fact(n, acc : integer) : integer;
+begin
+	if n <= 1 then
+		fact := acc
+	else
+		fact := fact(n - 1, acc * n)
+end;
+
+function sum(n : integer) : integer;
+begin
+	if n = 0 then
+		sum := 0
+	else
+		sum := n + sum(n - 1)
+end;
+
+begin
+	count(10, 0);
+	r := fact(7, 1);
+	write(r);
+	write(sum(10))
+end.
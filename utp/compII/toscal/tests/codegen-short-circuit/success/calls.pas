@@ -0,0 +1,20 @@
+program calls;
+var i, n : integer;
+
+function f(x : integer) : integer;
+begin
+	write(x);
+	f := x
+end;
+
+begin
+	i := 0;
+	n := 3;
+	if (i > n) and (f(1) > 0) then
+		write(100);
+	if (i < n) or (f(2) > 0) then
+		write(200)
+	else
+		write(201);
+	write(i and 5, 0 or n)
+end.
@@ -0,0 +1,11 @@
+program loops;
+var i, n : integer;
+begin
+	i := 0;
+	n := 10;
+	while (i < n) and not (i = 5) do
+		i := i + 1;
+	repeat
+		i := i - 1
+	until (i = 0) or (i < n) and (i mod 2 = 0)
+end.
@@ -0,0 +1,9 @@
+program nested;
+var a, b, c : integer;
+begin
+	read(a, b, c);
+	if ((a > 0) or (b > 0)) and not ((c = 0) and (a = b)) then
+		write(1);
+	if not (a > 0) or not (b > 0) then
+		write(2)
+end.
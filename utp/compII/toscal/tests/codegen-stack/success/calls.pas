@@ -0,0 +1,26 @@
+program stk;
+var a, b : integer;
+
+function sum3(x, y, z : integer) : integer;
+begin
+	sum3 := x + y + z
+end;
+
+procedure outer(n : integer; var r : integer);
+var t : integer;
+
+	function inner(m : integer) : integer;
+	begin
+		inner := sum3(m, m * 2, n)
+	end;
+
+begin
+	t := inner(n + 1);
+	r := sum3(t, inner(t), 1)
+end;
+
+begin
+	a := 2;
+	outer(a, b);
+	write(b)
+end.
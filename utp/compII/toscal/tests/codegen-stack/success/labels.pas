@@ -0,0 +1,25 @@
+program lbl;
+label 10;
+var i : integer;
+
+procedure check(k : integer);
+	procedure leave;
+	begin
+		goto 10
+	end;
+begin
+	if k * k > 20 then
+		leave;
+	write(k)
+end;
+
+begin
+	i := 0;
+	while i < 10 do
+	begin
+		check(i);
+		i := i + 1
+	end;
+10:
+	write(i + 100)
+end.
@@ -0,0 +1,15 @@
+program rec;
+var n : integer;
+
+function fib(k : integer) : integer;
+begin
+	if k < 2 then
+		fib := k
+	else
+		fib := fib(k - 1) + fib(k - 2)
+end;
+
+begin
+	read(n);
+	write(fib(n) * 2 + 1)
+end.
@@ -0,0 +1,7 @@
+program test_division_by_zero;
+const zero = 0;
+var a : integer;
+begin
+	a := 10;
+	a := a div (zero * 2)
+end.
@@ -0,0 +1,6 @@
+program test_const_overflow;
+const big = 2147483647;
+var a : integer;
+begin
+	a := big + 1
+end.
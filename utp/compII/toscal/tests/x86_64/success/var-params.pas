@@ -0,0 +1,15 @@
+program var_params;
+var a, b : integer;
+
+procedure divide(x, y : integer; var q, r : integer);
+begin
+	q := x div y;
+	r := x - q * y
+end;
+
+begin
+	read(a);
+	divide(a, 7, a, b);
+	if (a < 0) or not (b = 0) then
+		write(a, b)
+end.
@@ -16,10 +16,13 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
 #include <ctype.h> /* VStudio-related */
 
 #include "input.h"
 #include "tokenize.h"
+#include "keywords_hash.h"
+#include "scan.h"
 
 int push_lexeme_ch(struct token *tok, int ch)
 {
@@ -31,6 +34,21 @@ int push_lexeme_ch(struct token *tok, int ch)
 	return 1;
 }
 
+/* pushes as many chars of [from, to) as there is room for, returns how
+ * many */
+static inline size_t push_lexeme_run(struct token *tok, const char *from,
+		const char *to)
+{
+	size_t n = to - from;
+
+	if (n > MAX_TOK_PENDING - 1 - tok->pending)
+		n = MAX_TOK_PENDING - 1 - tok->pending;
+	memcpy(tok->repr + tok->pending, from, n);
+	tok->pending += n;
+
+	return n;
+}
+
 void finish_lexeme(struct token *tok)
 {
 	tok->repr[tok->pending] = '\0';
@@ -42,21 +60,485 @@ void token_error(struct token *tok, struct input_state *is, char *message)
 	tok->error = message ? message : "error parsing token";
 }
 
-int set_token_keyword(const char *name, struct token *tok)
+int set_token_keyword(const char *name, size_t len, struct token *tok)
 {
-	size_t i;
-
-	/* FIXME use a hash tamble to compare the keywords */
-	for (i = 0; i < NR_KEYWORDS; i++)
-		if (strcmp(name, keywords[i].keyword) == 0) {
-			tok->type = keywords[i].type;
-			tok->name = keywords[i].name;
-			return 1;
-		}
-	return 0;
+	unsigned int slot;
+
+	/* keywords_hash.h has a perfect hash of the keywords, so there is
+	 * only one candidate to be compared */
+	if (len < KEYWORD_MIN_LEN || len > KEYWORD_MAX_LEN)
+		return 0;
+	slot = keyword_slots[KEYWORD_HASH(name[0], name[1], name[len - 1],
+			len)];
+	if (!slot)
+		return 0;
+	slot--;
+	/* strncmp stops at the end of shorter keywords */
+	if (strncmp(name, keywords[slot].keyword, len) != 0
+			|| keywords[slot].keyword[len] != '\0')
+		return 0;
+
+	tok->type = keywords[slot].type;
+	tok->name = keywords[slot].name;
+	return 1;
 }
 
+/*
+ * The table-driven tokenizer.
+ *
+ * Every char of the source is first mapped to a class by char_class[],
+ * then lex_transitions[state][class] says which is the next state and
+ * what should be done with the char. It walks the input exactly as the
+ * old switch-based state machine (fetch_next_token_switch()) did,
+ * including the chars that are read and stepped back, so that the
+ * positions reported in the error messages do not change.
+ */
+
+enum lex_class {
+	C_OTHER = 0,	/* anything that can't start a token */
+	C_EOF,		/* '\0', returned by input_next() on EOF */
+	C_SPACE,
+	C_LETTER,	/* letters and the underline */
+	C_DIGIT,
+	C_PLUS,
+	C_MINUS,
+	C_EQUAL,
+	C_LESS,
+	C_GREATER,
+	C_SEMICOLON,
+	C_DOT,
+	C_COLON,
+	C_COMMA,
+	C_LPAREN,
+	C_RPAREN,
+	C_LBRACKET,
+	C_RBRACKET,
+	C_LBRACE,
+	C_RBRACE,
+	C_ASTERISK,
+	C_QUOTE,
+	C_BACKSLASH,
+	C__COUNT
+};
+
+static const unsigned char char_class[256] = {
+	['\0'] = C_EOF,
+	[' '] = C_SPACE, ['\t'] = C_SPACE, ['\n'] = C_SPACE,
+	['\v'] = C_SPACE, ['\f'] = C_SPACE, ['\r'] = C_SPACE,
+	['a' ... 'z'] = C_LETTER, ['A' ... 'Z'] = C_LETTER,
+	['_'] = C_LETTER,
+	['0' ... '9'] = C_DIGIT,
+	['+'] = C_PLUS, ['-'] = C_MINUS, ['='] = C_EQUAL,
+	['<'] = C_LESS, ['>'] = C_GREATER, [';'] = C_SEMICOLON,
+	['.'] = C_DOT, [':'] = C_COLON, [','] = C_COMMA,
+	['('] = C_LPAREN, [')'] = C_RPAREN,
+	['['] = C_LBRACKET, [']'] = C_RBRACKET,
+	['{'] = C_LBRACE, ['}'] = C_RBRACE,
+	['*'] = C_ASTERISK, ['\''] = C_QUOTE, ['\\'] = C_BACKSLASH
+};
+
+/* the numbers in the comments are the states of the old machine */
+enum lex_state {
+	S_START = 0,	/* 0 */
+	S_IDENT,	/* 1 */
+	S_INTEGER,	/* 2 */
+	S_REAL_DOT,	/* 3 */
+	S_REAL_FRAC,	/* 4 */
+	S_EQUAL,	/* 5 */
+	S_LESS,		/* 6 */
+	S_GREATER,	/* 8 */
+	S_COLON,	/* 12 */
+	S_LPAREN,	/* 15 */
+	S_COMMENT,	/* 151 */
+	S_COMMENT_END,	/* 152 */
+	S_STRING,	/* 24 */
+	S_STRING_ESC,	/* 25 */
+	S_SINGLE,	/* 10, 11, 14, 16, 19-23, 250 and 251 */
+	S__COUNT
+};
+
+/* What to do with the char just read. For the A_ACCEPT* actions the
+ * "next" member of the transition is an index of lex_accepts[] instead of
+ * a state */
+enum lex_action {
+	A_NONE = 0,	/* just go to the next state */
+	A_BACK,		/* step back, the next state will read it again */
+	A_PUSH,		/* keep the char in the lexeme */
+	A_PUSH_IDENT,	/* a char of an identifier, the rest of it comes too */
+	A_PUSH_INT,	/* a digit of the integer part (and the next ones) */
+	A_PUSH_FRAC,	/* a digit of the fractional part (and the next ones) */
+	A_SKIP_SPACE,	/* skips the whole run of blanks */
+	A_SKIP_COMMENT,	/* skips the comment until the next '*' */
+	A_PUSH_ESC,	/* an unknown escape, keep the backslash too */
+	A_SINGLE,	/* remember the single-char token for S_SINGLE */
+	A_ACCEPT,	/* the token is complete */
+	A_ACCEPT_BACK,	/* the token ended in the previous char */
+	A_IDENT,
+	A_INTEGER,
+	A_REAL,
+	A_STRING,
+	A_ERROR
+};
+
+struct lex_transition {
+	unsigned char next;
+	unsigned char action;
+};
+
+struct lex_accept {
+	enum token_t type;
+	char *name;
+	int ch;
+	char *repr;	/* for the two-char tokens */
+};
+
+#define ACCEPT_CH(tokname, c) { tokname, #tokname, c, NULL }
+#define ACCEPT_REPR(tokname, r) { tokname, #tokname, 0, r }
+
+enum lex_accept_index {
+	ACC_PLUS = 0, ACC_MINUS, ACC_EQUAL, ACC_LESSTHAN, ACC_LESSEQTHAN,
+	ACC_DIFFERENT, ACC_GREATERTHAN, ACC_GREATEREQTHAN, ACC_SEMICOLON,
+	ACC_DOT, ACC_COLON, ACC_ASSIGNMENT, ACC_COMMA, ACC_LPARENTHESIS,
+	ACC_RPARENTHESIS, ACC_OPENINGBRACKET, ACC_CLOSINGBRACKET,
+	ACC_LBRACE, ACC_RBRACE, ACC_ASTERISK
+};
+
+static const struct lex_accept lex_accepts[] = {
+	[ACC_PLUS] = ACCEPT_CH(TOK_PLUS, '+'),
+	[ACC_MINUS] = ACCEPT_CH(TOK_MINUS, '-'),
+	[ACC_EQUAL] = ACCEPT_CH(TOK_EQUAL, '='),
+	[ACC_LESSTHAN] = ACCEPT_CH(TOK_LESSTHAN, '<'),
+	[ACC_LESSEQTHAN] = ACCEPT_REPR(TOK_LESSEQTHAN, "<="),
+	[ACC_DIFFERENT] = ACCEPT_REPR(TOK_DIFFERENT, "<>"),
+	[ACC_GREATERTHAN] = ACCEPT_CH(TOK_GREATERTHAN, '>'),
+	[ACC_GREATEREQTHAN] = ACCEPT_REPR(TOK_GREATEREQTHAN, ">="),
+	[ACC_SEMICOLON] = ACCEPT_CH(TOK_SEMICOLON, ';'),
+	[ACC_DOT] = ACCEPT_CH(TOK_DOT, '.'),
+	[ACC_COLON] = ACCEPT_CH(TOK_COLON, ':'),
+	[ACC_ASSIGNMENT] = ACCEPT_REPR(TOK_ASSIGNMENT, ":="),
+	[ACC_COMMA] = ACCEPT_CH(TOK_COMMA, ','),
+	[ACC_LPARENTHESIS] = ACCEPT_CH(TOK_LPARENTHESIS, '('),
+	[ACC_RPARENTHESIS] = ACCEPT_CH(TOK_RPARENTHESIS, ')'),
+	[ACC_OPENINGBRACKET] = ACCEPT_CH(TOK_OPENINGBRACKET, '['),
+	[ACC_CLOSINGBRACKET] = ACCEPT_CH(TOK_CLOSINGBRACKET, ']'),
+	[ACC_LBRACE] = ACCEPT_CH(TOK_LBRACE, '{'),
+	[ACC_RBRACE] = ACCEPT_CH(TOK_RBRACE, '}'),
+	[ACC_ASTERISK] = ACCEPT_CH(TOK_ASTERISK, '*')
+};
+
+#define GO(state)		{ state, A_NONE }
+#define BACK(state)		{ state, A_BACK }
+#define DO(state, action)	{ state, action }
+#define SINGLE(acc)		{ acc, A_SINGLE }
+#define ACCEPT(acc)		{ acc, A_ACCEPT }
+#define ACCEPT_BACK(acc)	{ acc, A_ACCEPT_BACK }
+#define ALL_CLASSES		[0 ... C__COUNT - 1]
+
+/* The catch-all entries come first and are partially overridden by the
+ * specific ones */
+static const struct lex_transition lex_transitions[S__COUNT][C__COUNT] = {
+	[S_START] = {
+		ALL_CLASSES = DO(S_START, A_ERROR),
+		[C_EOF] = GO(S_START),
+		[C_SPACE] = DO(S_START, A_SKIP_SPACE),
+		[C_LETTER] = BACK(S_IDENT),
+		[C_DIGIT] = BACK(S_INTEGER),
+		[C_PLUS] = SINGLE(ACC_PLUS),
+		[C_MINUS] = SINGLE(ACC_MINUS),
+		[C_EQUAL] = BACK(S_EQUAL),
+		[C_LESS] = GO(S_LESS),
+		[C_GREATER] = GO(S_GREATER),
+		[C_SEMICOLON] = SINGLE(ACC_SEMICOLON),
+		[C_DOT] = SINGLE(ACC_DOT),
+		[C_COLON] = GO(S_COLON),
+		[C_COMMA] = SINGLE(ACC_COMMA),
+		[C_LPAREN] = GO(S_LPAREN),
+		[C_RPAREN] = SINGLE(ACC_RPARENTHESIS),
+		[C_LBRACKET] = SINGLE(ACC_OPENINGBRACKET),
+		[C_RBRACKET] = SINGLE(ACC_CLOSINGBRACKET),
+		[C_LBRACE] = SINGLE(ACC_LBRACE),
+		[C_RBRACE] = SINGLE(ACC_RBRACE),
+		[C_ASTERISK] = SINGLE(ACC_ASTERISK),
+		[C_QUOTE] = GO(S_STRING)
+	},
+	[S_IDENT] = {
+		ALL_CLASSES = DO(0, A_IDENT),
+		[C_LETTER] = DO(S_IDENT, A_PUSH_IDENT),
+		[C_DIGIT] = DO(S_IDENT, A_PUSH_IDENT)
+	},
+	[S_INTEGER] = {
+		ALL_CLASSES = DO(0, A_INTEGER),
+		[C_DIGIT] = DO(S_INTEGER, A_PUSH_INT),
+		[C_DOT] = DO(S_REAL_DOT, A_PUSH)
+	},
+	[S_REAL_DOT] = {
+		/* weird: most of the programming languages allow using
+		 * just "1." to real numbers, ".1" as well. */
+		ALL_CLASSES = DO(0, A_ERROR),
+		[C_DIGIT] = BACK(S_REAL_FRAC)
+	},
+	[S_REAL_FRAC] = {
+		ALL_CLASSES = DO(0, A_REAL),
+		[C_DIGIT] = DO(S_REAL_FRAC, A_PUSH_FRAC)
+	},
+	[S_EQUAL] = {
+		ALL_CLASSES = ACCEPT(ACC_EQUAL)
+	},
+	[S_LESS] = {
+		ALL_CLASSES = ACCEPT_BACK(ACC_LESSTHAN),
+		[C_EQUAL] = ACCEPT(ACC_LESSEQTHAN),
+		[C_GREATER] = ACCEPT(ACC_DIFFERENT)
+	},
+	[S_GREATER] = {
+		ALL_CLASSES = ACCEPT_BACK(ACC_GREATERTHAN),
+		[C_EQUAL] = ACCEPT(ACC_GREATEREQTHAN)
+	},
+	[S_COLON] = {
+		ALL_CLASSES = ACCEPT_BACK(ACC_COLON),
+		[C_EQUAL] = ACCEPT(ACC_ASSIGNMENT)
+	},
+	[S_LPAREN] = {
+		ALL_CLASSES = ACCEPT_BACK(ACC_LPARENTHESIS),
+		[C_ASTERISK] = GO(S_COMMENT)
+	},
+	[S_COMMENT] = {
+		ALL_CLASSES = DO(S_COMMENT, A_SKIP_COMMENT),
+		[C_EOF] = GO(S_COMMENT),
+		[C_ASTERISK] = GO(S_COMMENT_END)
+	},
+	[S_COMMENT_END] = {
+		ALL_CLASSES = DO(S_COMMENT, A_SKIP_COMMENT),
+		[C_EOF] = GO(S_COMMENT),
+		[C_ASTERISK] = GO(S_COMMENT),
+		/* closed the comment, we don't generate tokens here */
+		[C_RPAREN] = GO(S_START)
+	},
+	[S_STRING] = {
+		ALL_CLASSES = DO(S_STRING, A_PUSH),
+		[C_BACKSLASH] = GO(S_STRING_ESC),
+		[C_QUOTE] = DO(0, A_STRING)
+	},
+	[S_STRING_ESC] = {
+		/* handle escaped characters \\ and \', anything else is
+		 * pushed as if nothing happened */
+		ALL_CLASSES = DO(S_STRING, A_PUSH_ESC),
+		[C_QUOTE] = DO(S_STRING, A_PUSH),
+		[C_BACKSLASH] = DO(S_STRING, A_PUSH)
+	},
+	[S_SINGLE] = {
+		/* the token was set by A_SINGLE, the char read here is
+		 * just the lookahead */
+		ALL_CLASSES = ACCEPT_BACK(0)
+	}
+};
+
+/* the fast path of strtod(): when both the digits and the power of ten
+ * are exact doubles a single division is correctly rounded */
+#define REAL_EXACT_DIGITS	15
+static const double real_pow10[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15
+};
+
 struct token *fetch_next_token(struct input_state *is, struct token *tok)
+{
+	int ch, digit;
+	int state = S_START;
+	const char *run, *end;
+	size_t n;
+	const struct lex_transition *t;
+	const struct lex_accept *acc = NULL;
+	long integer = 0;	/* accumulated as strtol() would */
+	double mantissa = 0.0;
+	int digits = 0;
+	int frac_digits = 0;
+
+	tok->pending = 0;
+
+	while (1) {
+		ch = input_next(is);
+		t = &lex_transitions[state][char_class[ch]];
+
+		switch (t->action) {
+		case A_NONE:
+			state = t->next;
+			break;
+
+		case A_BACK:
+			input_step_back(is);
+			state = t->next;
+			break;
+
+		case A_PUSH:
+			if (!push_lexeme_ch(tok, ch))
+				goto error_lexeme_size;
+			state = t->next;
+			break;
+
+		/* The runs below start at the char just read. Only the
+		 * chars that fit in the lexeme are consumed by them, so
+		 * when it is too long the next push fails just as it
+		 * would reading them one by one. */
+		case A_PUSH_IDENT:
+			run = is->cur - 1;
+			n = push_lexeme_run(tok, run, scan.ident(is->cur,
+						is->end));
+			if (!n)
+				goto error_lexeme_size;
+			input_skip_line(is, run + n);
+			break;
+
+		case A_PUSH_INT:
+			/* as before, the digits that don't fit in the
+			 * lexeme are silently ignored */
+			run = is->cur - 1;
+			end = scan.digits(is->cur, is->end);
+			n = push_lexeme_run(tok, run, end);
+			for (; n; n--, run++) {
+				digit = *run - '0';
+				if (integer > (LONG_MAX - digit) / 10)
+					integer = LONG_MAX;
+				else
+					integer = integer * 10 + digit;
+				mantissa = mantissa * 10 + digit;
+				digits++;
+			}
+			input_skip_line(is, end);
+			break;
+
+		case A_PUSH_FRAC:
+			run = is->cur - 1;
+			n = push_lexeme_run(tok, run, scan.digits(is->cur,
+						is->end));
+			if (!n)
+				goto error_lexeme_size;
+			input_skip_line(is, run + n);
+			for (; n; n--, run++) {
+				mantissa = mantissa * 10 + (*run - '0');
+				digits++;
+				frac_digits++;
+			}
+			break;
+
+		case A_SKIP_SPACE:
+			input_skip(is, scan.space(is->cur, is->end));
+			state = t->next;
+			break;
+
+		case A_SKIP_COMMENT:
+			input_skip(is, scan.comment(is->cur, is->end));
+			state = t->next;
+			break;
+
+		case A_PUSH_ESC:
+			if (!push_lexeme_ch(tok, '\\'))
+				goto error_lexeme_size;
+			if (!push_lexeme_ch(tok, ch))
+				goto error_lexeme_size;
+			state = t->next;
+			break;
+
+		case A_SINGLE:
+			acc = &lex_accepts[t->next];
+			state = S_SINGLE;
+			break;
+
+		case A_ACCEPT_BACK:
+			input_step_back(is);
+			if (state != S_SINGLE)
+				acc = &lex_accepts[t->next];
+			tok->type = acc->type;
+			tok->name = acc->name;
+			tok->ch = acc->ch;
+			goto done;
+
+		case A_ACCEPT:
+			acc = &lex_accepts[t->next];
+			tok->type = acc->type;
+			tok->name = acc->name;
+			if (acc->repr)
+				strcpy(tok->repr, acc->repr);
+			else
+				tok->ch = acc->ch;
+			goto done;
+
+		case A_IDENT:
+			input_step_back(is);
+			finish_lexeme(tok);
+			if (set_token_keyword(tok->repr, tok->pending, tok))
+				goto done;
+			TOK_SET(tok, TOK_IDENTIFIER);
+			if (tok->idents) {
+				tok->ident = intern_string(tok->idents,
+						tok->repr, tok->pending);
+				if (!tok->ident) {
+					token_error(tok, is, "out of memory");
+					goto error;
+				}
+			}
+			goto done;
+
+		case A_INTEGER:
+			input_step_back(is);
+			TOK_SET(tok, TOK_INTEGER);
+			finish_lexeme(tok);
+			tok->token.integer = (int) integer;
+			goto done;
+
+		case A_REAL:
+			input_step_back(is);
+			TOK_SET(tok, TOK_REAL);
+			finish_lexeme(tok);
+			if (digits <= REAL_EXACT_DIGITS)
+				tok->token.real = mantissa
+					/ real_pow10[frac_digits];
+			else
+				tok->token.real = atof(tok->repr);
+			goto done;
+
+		case A_STRING:
+			finish_lexeme(tok);
+			if (tok->pending == 1)
+				/* single-byte strings should be seen as
+				 * 'char' (crappy!) */
+				TOK_SET(tok, TOK_CHAR);
+			else
+				TOK_SET(tok, TOK_STRING);
+			goto done;
+
+		case A_ERROR:
+			token_error(tok, is, NULL);
+			goto error;
+		}
+
+		/* EOF is seen as another character, so the states that
+		 * can end a token already handled it */
+		if (ch == -INPUT_EOF) {
+			if (state != S_START) {
+				token_error(tok, is, "unexpected end of file");
+				goto error;
+			}
+			goto eof;
+		}
+	}
+
+done:
+	return tok;
+
+error_lexeme_size:
+	token_error(tok, is, "too long lexeme");
+	return NULL;
+eof:
+	TOK_SET(tok, TOK_EOF);
+error:
+	return NULL;
+}
+
+/* The original switch-based state machine. It is not used by the
+ * compiler anymore, but it is kept as a reference for the tables above
+ * and for comparing both engines in "tokenize -b". */
+struct token *fetch_next_token_switch(struct input_state *is,
+		struct token *tok)
 {
 	int ch;
 	int state = 0;
@@ -148,7 +630,7 @@ struct token *fetch_next_token(struct input_state *is, struct token *tok)
 			if (!(isalpha(ch) || isdigit(ch) || ch == '_')) {
 				input_step_back(is);
 				finish_lexeme(tok);
-				if (!set_token_keyword(tok->repr, tok))
+				if (!set_token_keyword(tok->repr, tok->pending, tok))
 					TOK_SET(tok, TOK_IDENTIFIER);
 				goto done;
 			}
@@ -4,6 +4,7 @@
 #include <stdio.h>
 
 #include "input.h"
+#include "intern.h"
 
 #define TOK_SET(k, tokname) do { \
 	k->type = tokname; \
@@ -120,9 +121,16 @@ struct token {
 		float real;
 	} token;
 	char *error;
+
+	/* when set, the identifiers are interned here and ident has their
+	 * ids */
+	struct intern_pool *idents;
+	ident_t ident;
 };
 
 struct token *fetch_next_token(struct input_state *is, struct token *tok);
+struct token *fetch_next_token_switch(struct input_state *is,
+		struct token *tok);
 void dump_token(struct token *tok, FILE *output);
 void tokenizer_dump_error(struct token *tok, struct input_state *is, FILE *output);
 
@@ -1,41 +1,65 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <limits.h>
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#endif
 
 #include "input.h"
 #include "tokenize.h"
 #include "parser.h"
 #include "semantic.h"
 #include "codegen.h"
+#include "intern.h"
+#include "arena.h"
+#include "peephole.h"
 
 int main(int argc, char *argv[])
 {
 	int i;
-	struct input_state *input;
-	struct semantic_state *semantic;
-	struct parser_state *parser;
-	struct codegen_state *codegen;
+	int err = 1;
+	unsigned int passes = 0, pass;
+	const char *target;
+	char *end;
+	long size;
+	size_t removed;
+	struct input_state *input = NULL;
+	struct semantic_state *semantic = NULL;
+	struct parser_state *parser = NULL;
+	struct codegen_state *codegen = NULL;
+	struct intern_pool *idents = NULL;
+	struct arena *arena = NULL;
 	FILE *source = NULL;
 
-	input = init_input_state(stdin);
-	if (!input) {
-		perror("allocating the input state");
-		goto failed;
-	}
-
 	codegen = init_codegen_state(stdout);
 	if (!codegen) {
 		perror("allocating codegen state");
 		goto failed;
 	}
 
-	semantic = init_semantic_state(codegen);
+	idents = init_intern_pool();
+	if (!idents) {
+		perror("allocating the identifiers pool");
+		goto failed;
+	}
+
+	/* everything that lives until the end of the compilation */
+	arena = create_arena(ARENA_BLOCK_SIZE);
+	if (!arena) {
+		perror("allocating the compilation arena");
+		goto failed;
+	}
+
+	semantic = init_semantic_state(codegen, idents, arena);
 	if (!semantic) {
 		perror("allocating semantic state");
 		goto failed;
 	}
 	semantic->warning_stream = stderr;
 
-	parser = init_parser_state(input, semantic);
+	parser = init_parser_state(NULL, semantic);
 	if (!parser) {
 		perror("while allocationg parser state");
 		goto failed;
@@ -53,6 +77,17 @@ int main(int argc, char *argv[])
 			case 'S':
 				parser->semantic_check = 0;
 				break;
+			case 'A':
+				/* read the whole program before the semantic
+				 * checks and the code */
+				if (parser->ast)
+					break;
+				parser->ast = create_ast();
+				if (!parser->ast) {
+					perror("allocating the syntax tree");
+					goto failed;
+				}
+				break;
 			case 'z':
 				semantic->debug_stream = stdout;
 				break;
@@ -62,6 +97,114 @@ int main(int argc, char *argv[])
 			case 'C':
 				codegen->out = NULL;
 				break;
+			case 'b':
+				codegen->format = CODEGEN_FORMAT_BYTECODE;
+				break;
+			case 's':
+				codegen->stack_notes = 1;
+				break;
+			case 'm':
+				/* -m <target> or -m<target> */
+				target = argv[i][2] ? argv[i] + 2 : argv[++i];
+				if (target && strcmp(target, "x86_64") == 0)
+					codegen->format = CODEGEN_FORMAT_X86_64;
+				else if (target && strcmp(target, "c") == 0)
+					codegen->format = CODEGEN_FORMAT_C;
+				else if (target && strcmp(target, "mepa") == 0)
+					codegen->format = CODEGEN_FORMAT_TEXT;
+				else {
+					fprintf(stderr, "unknown target %s\n",
+							target ? target : "");
+					goto failed;
+				}
+				break;
+			case 'O':
+				passes = PEEPHOLE_ALL;
+				codegen->tail_calls = 1;
+				codegen->loop_invariants = 1;
+				codegen->cse = 1;
+				break;
+			case 'f':
+				/* not a peephole pass, it changes which calls
+				 * are made */
+				if (strcmp(argv[i] + 2, "short-circuit") == 0) {
+					codegen->short_circuit = 1;
+					break;
+				}
+				if (strcmp(argv[i] + 2, "no-short-circuit") == 0) {
+					codegen->short_circuit = 0;
+					break;
+				}
+				/* done by codegen.c at the end of each
+				 * procedure, also turned on by -O */
+				if (strcmp(argv[i] + 2, "tail-calls") == 0) {
+					codegen->tail_calls = 1;
+					break;
+				}
+				if (strcmp(argv[i] + 2, "no-tail-calls") == 0) {
+					codegen->tail_calls = 0;
+					break;
+				}
+				/* done by codegen.c at the end of each loop,
+				 * also turned on by -O */
+				if (strcmp(argv[i] + 2, "loop-invariants") == 0) {
+					codegen->loop_invariants = 1;
+					break;
+				}
+				if (strcmp(argv[i] + 2,
+						"no-loop-invariants") == 0) {
+					codegen->loop_invariants = 0;
+					break;
+				}
+				/* done by codegen.c at the end of each
+				 * procedure, also turned on by -O */
+				if (strcmp(argv[i] + 2, "cse") == 0) {
+					codegen->cse = 1;
+					break;
+				}
+				if (strcmp(argv[i] + 2, "no-cse") == 0) {
+					codegen->cse = 0;
+					break;
+				}
+				/* -finline or -finline=<size>, done by
+				 * codegen.c at each call */
+				if (strcmp(argv[i] + 2, "inline") == 0) {
+					codegen->inline_size =
+						CODEGEN_INLINE_SIZE;
+					break;
+				}
+				if (strncmp(argv[i] + 2, "inline=", 7) == 0) {
+					size = strtol(argv[i] + 9, &end, 10);
+					if (end == argv[i] + 9 || *end
+							|| size < 0
+							|| size > INT_MAX) {
+						fprintf(stderr, "invalid inline "
+								"size %s\n",
+								argv[i] + 9);
+						goto failed;
+					}
+					codegen->inline_size = size;
+					break;
+				}
+				if (strcmp(argv[i] + 2, "no-inline") == 0) {
+					codegen->inline_size = 0;
+					break;
+				}
+				/* -f<pass> and -fno-<pass> */
+				if (strncmp(argv[i] + 2, "no-", 3) == 0) {
+					pass = peephole_find_pass(argv[i] + 5);
+					passes &= ~pass;
+				}
+				else {
+					pass = peephole_find_pass(argv[i] + 2);
+					passes |= pass;
+				}
+				if (!pass) {
+					fprintf(stderr, "unknown optimization %s\n",
+							argv[i]);
+					goto failed;
+				}
+				break;
 			default:
 				fprintf(stderr, "invalid option %s\n", argv[i]);
 				goto failed;
@@ -73,21 +216,64 @@ int main(int argc, char *argv[])
 				perror(argv[i]);
 				goto failed;
 			}
-			input->stream = source;
 		}
 	}
 
-	if (input->stream == stdin)
+#ifdef _WIN32
+	if (codegen->format == CODEGEN_FORMAT_BYTECODE)
+		_setmode(_fileno(stdout), _O_BINARY);
+#endif
+
+	if (!source) {
 		fputs("reading from stdin\n", stderr);
+		source = stdin;
+	}
+
+	/* the whole source is loaded (or mapped) at once */
+	input = init_input_state(source);
+	if (!input) {
+		perror("reading the source");
+		goto failed;
+	}
+	parser->input = input;
 
 	if (!parser_check(parser)) {
 		parser_dump_error(parser, stderr);
+		/* the code generated up to the error is still written,
+		 * when it can be */
+		if (codegen->format == CODEGEN_FORMAT_TEXT)
+			codegen_write(codegen);
 		goto failed;
 	}
 
-	/* FIXME memory is not being freed */
+	if (passes) {
+		removed = peephole_optimize(codegen, passes);
+		fprintf(stderr, "peephole: %lu instructions removed\n",
+				(unsigned long) removed);
+	}
+
+	if (!codegen_write(codegen)) {
+		codegen_dump_error(codegen, stderr);
+		goto failed;
+	}
+
+	err = 0;
 
-	return 0;
 failed:
-	return 1;
+	if (input)
+		close_input_state(input);
+	if (source && source != stdin)
+		fclose(source);
+	if (parser)
+		destroy_parser_state(parser);
+	if (semantic)
+		destroy_semantic_state(semantic);
+	if (arena)
+		destroy_arena(arena);
+	if (idents)
+		destroy_intern_pool(idents);
+	if (codegen)
+		destroy_codegen_state(codegen);
+
+	return err;
 }
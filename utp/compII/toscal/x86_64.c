@@ -0,0 +1,373 @@
+/** x86_64.c
+ *
+ * Each MEPA instruction becomes a few x86-64 ones, with the MEPA stack
+ * living in the machine stack:
+ *
+ * - %rsp is SP. The MEPA memory grows upwards and the machine stack
+ *   downwards, so the word at address a is at base - 8 * (a + 1), where
+ *   base (in %r13) is %rsp when mepa_main() starts.
+ * - The display has the machine addresses of the frames, so CRVL k,n is
+ *   a load from D[k] - 8 * n. The addresses taken by CREN are machine
+ *   addresses too, as only CRVI and ARMI use them.
+ * - %rbp is BP, saved by CHPR and restored by RTPR.
+ * - CHPR p,k pushes BP and k and then calls p, so the return address is
+ *   the last of the three words between the parameters and the frame
+ *   (mepa.py has it first, but only RTPR looks at them). RTPR k,n is then
+ *   a "ret" taking the parameters and those words out of the stack.
+ *
+ * The words are 64 bit wide, like in mepa/vm.c. The memory never written
+ * isn't filled with 999999 as in the VMs, only wrong programs read it.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "x86_64.h"
+#include "opcodes.h"
+
+#define ERROR	0
+#define OK	1
+
+/* the largest "ret $n" */
+#define MAX_RET_POP	65535
+
+/* setCC and jCC after "cmp b, a", aligned with the MEPA_CM* and MEPA_DS*
+ * opcodes */
+static const char *compare_suffixes[] = {
+	"e",	/* CMIG */
+	"ne",	/* CMDG */
+	"g",	/* CMMA */
+	"ge",	/* CMAG */
+	"l",	/* CMME */
+	"le"	/* CMEG */
+};
+
+static const char prolog[] =
+	"\t.text\n"
+	"\t.globl mepa_main\n"
+	"\t.type mepa_main, @function\n"
+	"mepa_main:\n"
+	"\tpush %rbx\n"
+	"\tpush %rbp\n"
+	"\tpush %r13\n"
+	"\tmov %rsp, %r13\n";
+
+/* PARA and the end of the code get here */
+static const char epilog[] =
+	".Lmepa_end:\n"
+	"\tmov %r13, %rsp\n"
+	"\tpop %r13\n"
+	"\tpop %rbp\n"
+	"\tpop %rbx\n"
+	"\tret\n"
+	"\t.size mepa_main, .-mepa_main\n";
+
+/* rax = a, rcx = b => rax = a div b, rdx = a mod b, rounding down like
+ * mepa.py */
+static const char divmod[] =
+	".Lmepa_divmod:\n"
+	"\ttest %rcx, %rcx\n"
+	"\tjz .Lmepa_division_by_zero\n"
+	"\tcmp $-1, %rcx\n"
+	"\tje 2f\n"
+	"\tcqo\n"
+	"\tidiv %rcx\n"
+	"\ttest %rdx, %rdx\n"
+	"\tjz 1f\n"
+	"\tmov %rdx, %r8\n"
+	"\txor %rcx, %r8\n"
+	"\tjns 1f\n"
+	"\tdec %rax\n"
+	"\tadd %rcx, %rdx\n"
+	"1:\tret\n"
+	/* idiv traps on LONG_MIN / -1 */
+	"2:\tneg %rax\n"
+	"\txor %edx, %edx\n"
+	"\tret\n"
+	".Lmepa_division_by_zero:\n"
+	"\tand $-16, %rsp\n"
+	"\tlea .Lmepa_division_message(%rip), %rdi\n"
+	"\tcall mepa_fail\n";
+
+struct asm_writer {
+	FILE *out;
+	struct codegen_state *cs;
+	int uses_divmod;
+};
+
+static void label_name(struct asm_writer *w, size_t label, char *buf)
+{
+	if (w->cs->labels[label].target == CODEGEN_NO_TARGET) {
+		snprintf(buf, CODEGEN_LABEL_SIZE, ".Lmepa_end");
+		return;
+	}
+	buf[0] = '.';
+	buf[1] = 'L';
+	codegen_label_name(w->cs, label, buf + 2, CODEGEN_LABEL_SIZE - 2);
+}
+
+/* reg = D[k] */
+static void load_display(struct asm_writer *w, int k, const char *reg)
+{
+	fprintf(w->out, "\tmov mepa_display+%ld(%%rip), %s\n", 8L * k, reg);
+}
+
+/* D[k] = reg */
+static void store_display(struct asm_writer *w, const char *reg, int k)
+{
+	fprintf(w->out, "\tmov %s, mepa_display+%ld(%%rip)\n", reg, 8L * k);
+}
+
+/* calls a function of the runtime, which needs %rsp aligned */
+static void call_runtime(struct asm_writer *w, const char *name)
+{
+	fprintf(w->out, "\tmov %%rsp, %%rbx\n"
+			"\tand $-16, %%rsp\n"
+			"\tcall %s\n"
+			"\tmov %%rbx, %%rsp\n", name);
+}
+
+/* the MEPA instruction, as a comment */
+static void comment(struct asm_writer *w, struct codegen_inst *inst)
+{
+	char text[64];
+
+	codegen_inst_text(w->cs, inst, text, sizeof(text));
+	fprintf(w->out, "\t# %s\n", text);
+}
+
+static void write_inst(struct asm_writer *w, struct codegen_inst *inst)
+{
+	FILE *out = w->out;
+	char label[CODEGEN_LABEL_SIZE];
+	long pop;
+
+	if (inst->op == MEPA_LABEL) {
+		label_name(w, inst->label, label);
+		fprintf(out, "%s:\n", label);
+		return;
+	}
+	if (mepa_opcodes[inst->op].operands == MEPA_OPND_PSEUDO)
+		return;
+
+	comment(w, inst);
+	switch (inst->op) {
+	case MEPA_INPP:
+		fputs("\tlea -8(%r13), %rbp\n", out);
+		store_display(w, "%rbp", 0);
+		break;
+	case MEPA_PARA:
+		fputs("\tjmp .Lmepa_end\n", out);
+		break;
+	case MEPA_AMEM:
+		fprintf(out, "\tlea %ld(%%rsp), %%rsp\n", -8L * inst->a);
+		break;
+	case MEPA_DMEM:
+		fprintf(out, "\tlea %ld(%%rsp), %%rsp\n", 8L * inst->a);
+		break;
+	case MEPA_CRCT:
+		fprintf(out, "\tpushq $%d\n", inst->a);
+		break;
+	case MEPA_CRVL:
+		load_display(w, inst->a, "%rax");
+		fprintf(out, "\tpushq %ld(%%rax)\n", -8L * inst->b);
+		break;
+	case MEPA_ARMZ:
+		load_display(w, inst->a, "%rax");
+		fprintf(out, "\tpopq %ld(%%rax)\n", -8L * inst->b);
+		break;
+	case MEPA_ARMC:
+		load_display(w, inst->a, "%rax");
+		fprintf(out, "\tmov (%%rsp), %%rcx\n"
+				"\tmov %%rcx, %ld(%%rax)\n", -8L * inst->b);
+		break;
+	case MEPA_CRVI:
+		load_display(w, inst->a, "%rax");
+		fprintf(out, "\tmov %ld(%%rax), %%rax\n"
+				"\tpushq (%%rax)\n", -8L * inst->b);
+		break;
+	case MEPA_ARMI:
+		load_display(w, inst->a, "%rax");
+		fprintf(out, "\tmov %ld(%%rax), %%rax\n"
+				"\tpopq (%%rax)\n", -8L * inst->b);
+		break;
+	case MEPA_CREN:
+		load_display(w, inst->a, "%rax");
+		fprintf(out, "\tlea %ld(%%rax), %%rax\n"
+				"\tpush %%rax\n", -8L * inst->b);
+		break;
+	case MEPA_SOMA:
+		fputs("\tpop %rax\n\tadd %rax, (%rsp)\n", out);
+		break;
+	case MEPA_SUBT:
+		fputs("\tpop %rax\n\tsub %rax, (%rsp)\n", out);
+		break;
+	case MEPA_MULT:
+		fputs("\tpop %rax\n\timul (%rsp), %rax\n"
+				"\tmov %rax, (%rsp)\n", out);
+		break;
+	case MEPA_DIVI:
+	case MEPA_MODU:
+		fprintf(out, "\tpop %%rcx\n\tmov (%%rsp), %%rax\n"
+				"\tcall .Lmepa_divmod\n\tmov %s, (%%rsp)\n",
+				inst->op == MEPA_DIVI ? "%rax" : "%rdx");
+		w->uses_divmod = 1;
+		break;
+	case MEPA_INVR:
+		fputs("\tnegq (%rsp)\n", out);
+		break;
+	/* the python "and" and "or", which give one of the operands */
+	case MEPA_CONJ:
+		fputs("\tpop %rax\n\tmov (%rsp), %rcx\n\ttest %rax, %rax\n"
+				"\tcmovz %rax, %rcx\n\tmov %rcx, (%rsp)\n", out);
+		break;
+	case MEPA_DISJ:
+		fputs("\tpop %rax\n\tmov (%rsp), %rcx\n\ttest %rax, %rax\n"
+				"\tcmovnz %rax, %rcx\n\tmov %rcx, (%rsp)\n", out);
+		break;
+	case MEPA_NEGA:
+		fputs("\txor %eax, %eax\n\tcmpq $0, (%rsp)\n\tsete %al\n"
+				"\tmov %rax, (%rsp)\n", out);
+		break;
+	case MEPA_CMIG:
+	case MEPA_CMDG:
+	case MEPA_CMMA:
+	case MEPA_CMAG:
+	case MEPA_CMME:
+	case MEPA_CMEG:
+		fprintf(out, "\tpop %%rax\n\txor %%ecx, %%ecx\n"
+				"\tcmp %%rax, (%%rsp)\n\tset%s %%cl\n"
+				"\tmov %%rcx, (%%rsp)\n",
+				compare_suffixes[inst->op - MEPA_CMIG]);
+		break;
+	case MEPA_DSVS:
+		label_name(w, inst->label, label);
+		fprintf(out, "\tjmp %s\n", label);
+		break;
+	case MEPA_DSVF:
+		label_name(w, inst->label, label);
+		fprintf(out, "\tpop %%rax\n\ttest %%rax, %%rax\n\tjz %s\n",
+				label);
+		break;
+	case MEPA_DSIG:
+	case MEPA_DSDG:
+	case MEPA_DSMA:
+	case MEPA_DSAG:
+	case MEPA_DSME:
+	case MEPA_DSEG:
+		label_name(w, inst->label, label);
+		fprintf(out, "\tpop %%rax\n\tpop %%rcx\n\tcmp %%rax, %%rcx\n"
+				"\tj%s %s\n",
+				compare_suffixes[inst->op - MEPA_DSIG], label);
+		break;
+	case MEPA_DSVR:
+		/* BP of the level of the label, SP is set by its ENRT */
+		label_name(w, inst->label, label);
+		load_display(w, inst->a, "%rbp");
+		fprintf(out, "\tjmp %s\n", label);
+		break;
+	case MEPA_CHPR:
+		label_name(w, inst->label, label);
+		fprintf(out, "\tpush %%rbp\n\tpushq $%d\n\tcall %s\n",
+				inst->a, label);
+		break;
+	case MEPA_ENPR:
+		fputs("\tlea -8(%rsp), %rbp\n", out);
+		store_display(w, "%rbp", inst->a);
+		break;
+	case MEPA_RTPR:
+		/* D[k of the caller] = BP of the caller */
+		fputs("\tmov 8(%rsp), %rcx\n\tmov 16(%rsp), %rbp\n"
+				"\tlea mepa_display(%rip), %rax\n"
+				"\tmov %rbp, (%rax,%rcx,8)\n", out);
+		pop = 16 + 8L * inst->b;
+		if (pop <= MAX_RET_POP)
+			fprintf(out, "\tret $%ld\n", pop);
+		else
+			fprintf(out, "\tpop %%rax\n\tlea %ld(%%rsp), %%rsp\n"
+					"\tjmp *%%rax\n", pop);
+		break;
+	case MEPA_ENRT:
+		load_display(w, inst->a, "%rax");
+		fprintf(out, "\tlea %ld(%%rax), %%rsp\n", 8 - 8L * inst->b);
+		break;
+	case MEPA_LEIT:
+		call_runtime(w, "mepa_read");
+		fputs("\tpush %rax\n", out);
+		break;
+	case MEPA_IMPR:
+		fputs("\tpop %rdi\n", out);
+		call_runtime(w, "mepa_write");
+		break;
+	case MEPA_NADA:
+		break;
+	case MEPA_ASSERT:
+		fputs("\tpop %rdi\n\tpop %rsi\n", out);
+		call_runtime(w, "mepa_assert");
+		break;
+	default:
+		break;
+	}
+}
+
+/* the display needs the largest k in the code */
+static long count_levels(struct codegen_state *cs)
+{
+	struct codegen_inst *inst;
+	long levels = 1, k;
+	size_t i;
+
+	for (i = 0; i < cs->ninsts; i++) {
+		inst = &cs->code[i];
+		switch (inst->op) {
+		case MEPA_CRVL: case MEPA_ARMZ: case MEPA_ARMC:
+		case MEPA_CRVI: case MEPA_ARMI: case MEPA_CREN:
+		case MEPA_ENPR: case MEPA_RTPR: case MEPA_ENRT:
+		case MEPA_CHPR:
+			k = inst->a;
+			break;
+		case MEPA_DSVR:
+			k = inst->a > inst->b ? inst->a : inst->b;
+			break;
+		default:
+			continue;
+		}
+		if (k >= levels)
+			levels = k + 1;
+	}
+
+	return levels;
+}
+
+/** Writes the whole program as x86-64 assembly */
+int x86_64_write(struct codegen_state *cs)
+{
+	struct asm_writer w;
+	size_t i;
+
+	w.out = cs->out;
+	w.cs = cs;
+	w.uses_divmod = 0;
+
+	fputs(prolog, w.out);
+	for (i = 0; i < cs->ninsts; i++)
+		write_inst(&w, &cs->code[i]);
+	fputs(epilog, w.out);
+
+	if (w.uses_divmod)
+		fprintf(w.out, "%s\t.section .rodata\n"
+				".Lmepa_division_message:\n"
+				"\t.string \"division by zero\"\n", divmod);
+
+	fprintf(w.out, "\t.local mepa_display\n"
+			"\t.comm mepa_display, %ld, 8\n"
+			"\t.section .note.GNU-stack,\"\",@progbits\n",
+			8 * count_levels(cs));
+
+	if (fflush(w.out) == EOF || ferror(w.out)) {
+		codegen_set_error(cs, CODEGEN_WRITE_ERROR);
+		return ERROR;
+	}
+	cs->written = cs->ninsts;
+
+	return OK;
+}
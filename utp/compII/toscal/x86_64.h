@@ -0,0 +1,14 @@
+/** The x86-64 backend writes the code generated by codegen.c as GNU
+ * assembly (AT&T syntax) for the System V ABI.
+ *
+ * The program becomes the function mepa_main(), called by the runtime in
+ * runtime/runtime.c, which also has the input and output.
+ */
+#ifndef inc_x86_64_h
+#define inc_x86_64_h
+
+#include "codegen.h"
+
+int x86_64_write(struct codegen_state *cs);
+
+#endif /* inc_x86_64_h */
@@ -8,10 +8,7 @@
  *
  * Problems:
  *
- * - If the number of classes gets too high, there will be a huge memory
- *   waste in the hash tables of each attribute class;
- *
- * - Conversely, if the number of attributes is too high, it will be too
+ * - If the number of attributes is too high, it will be too
  *   slow to add new entries in the refmap (hm, actually this is not a big
  *   issue, as we are limited by IO).
  *
@@ -29,8 +26,9 @@
 #include "hash.h"
 
 #define LINE_BUFFER_SIZE	(1024*1024)
-#define HASH_SIZE_ATTRIBUTES	1024
-#define HASH_SIZE_CLASSES	64
+/* initial sizes only, the hash tables grow as needed */
+#define HASH_SIZE_ATTRIBUTES	16
+#define HASH_SIZE_CLASSES	8
 
 
 /* classes don't need to have their names stored, just their "uniqueness" 
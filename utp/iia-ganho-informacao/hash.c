@@ -1,131 +1,352 @@
 #include <stdlib.h>
 #include <string.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #include "hash.h"
 
-void *hash_get(struct hash_table *table, unsigned char *key, size_t
-		key_len, unsigned int force_hash)
+/* the control byte of a used slot: the 7 bits of the hash that aren't
+ * (usually) used to pick the group */
+#define HASH_TAG(hash)	((unsigned char) ((hash) >> 25))
+
+/* bitmask of the control bytes of the group equal to byte */
+static inline unsigned int group_match(const unsigned char *ctrl,
+		unsigned char byte)
 {
-	unsigned int hash;
-	size_t pos;
-	struct hash_entry *found;
-	void *data = NULL;
+#ifdef __SSE2__
+	return _mm_movemask_epi8(_mm_cmpeq_epi8(
+				_mm_loadu_si128((const __m128i*) ctrl),
+				_mm_set1_epi8(byte)));
+#else
+	unsigned int mask = 0;
+	int i;
 
-	hash = force_hash ? force_hash : get_hash(key, key_len);
-	pos = hash % table->size;
-	found = table->entries[pos];
-	if (found) {
-		if (found->next) {
-			while (found) {
-				/* HACK HACK HACK!!!  in order to differentiate the
-				   pingeons that we have found in the same
-				   pigeonhole, we compare their full hashes + their
-				   length. This is just an exercise of how to not
-				   keep the keys in memory. */
-				if (found->hash == hash
-					&& found->key_len == key_len) {
-					data = found->data;
-					break;
-				}
-				found = found->next;
+	for (i = 0; i < HASH_GROUP; i++)
+		if (ctrl[i] == byte)
+			mask |= 1u << i;
+	return mask;
+#endif
+}
+
+/* bitmask of the slots of the group that are empty or deleted, both
+ * have the high bit set, unlike the tags */
+static inline unsigned int group_match_free(const unsigned char *ctrl)
+{
+#ifdef __SSE2__
+	return _mm_movemask_epi8(_mm_loadu_si128((const __m128i*) ctrl));
+#else
+	unsigned int mask = 0;
+	int i;
+
+	for (i = 0; i < HASH_GROUP; i++)
+		if (ctrl[i] & 0x80)
+			mask |= 1u << i;
+	return mask;
+#endif
+}
+
+/* the groups are probed in triangular steps (1, 2, 3...), which visits
+ * all of them as their number is a power of 2 */
+static struct hash_entry *find_entry(const unsigned char *ctrl,
+		struct hash_entry *entries, size_t size, const char *key,
+		size_t key_len, unsigned int hash, size_t *slot)
+{
+	size_t mask = size / HASH_GROUP - 1;
+	size_t group = hash & mask;
+	size_t step = 0;
+	size_t base, i;
+	unsigned int match;
+	struct hash_entry *entry;
+
+	for (;;) {
+		base = group * HASH_GROUP;
+		for (match = group_match(ctrl + base, HASH_TAG(hash)); match;
+				match &= match - 1) {
+			i = base + __builtin_ctz(match);
+			entry = &entries[i];
+			if (entry->hash == hash && entry->key_len == key_len
+					&& memcmp(entry->key, key, key_len) == 0) {
+				*slot = i;
+				return entry;
 			}
 		}
-		else
-			data = found->data;
+		/* the key would have been put in this empty slot */
+		if (group_match(ctrl + base, HASH_EMPTY))
+			return NULL;
+		group = (group + ++step) & mask;
+	}
+}
+
+static size_t find_free_slot(const unsigned char *ctrl, size_t size,
+		unsigned int hash)
+{
+	size_t mask = size / HASH_GROUP - 1;
+	size_t group = hash & mask;
+	size_t step = 0;
+	unsigned int match;
+
+	for (;;) {
+		match = group_match_free(ctrl + group * HASH_GROUP);
+		if (match)
+			return group * HASH_GROUP + __builtin_ctz(match);
+		group = (group + ++step) & mask;
+	}
+}
+
+/* looks in the current array, and then in the one being drained */
+static struct hash_entry *lookup(struct hash_table *table, const char *key,
+		size_t key_len, unsigned int hash, int *old, size_t *slot)
+{
+	struct hash_entry *entry;
+
+	*old = 0;
+	entry = find_entry(table->ctrl, table->entries, table->size, key,
+			key_len, hash, slot);
+	if (!entry && table->old_ctrl) {
+		*old = 1;
+		entry = find_entry(table->old_ctrl, table->old_entries,
+				table->old_size, key, key_len, hash, slot);
+	}
+
+	return entry;
+}
+
+/* puts an entry known not to be there yet */
+static struct hash_entry *insert_entry(struct hash_table *table,
+		struct hash_entry *from)
+{
+	size_t slot;
+
+	slot = find_free_slot(table->ctrl, table->size, from->hash);
+	if (table->ctrl[slot] == HASH_EMPTY)
+		table->used++;
+	table->ctrl[slot] = HASH_TAG(from->hash);
+	table->entries[slot] = *from;
+
+	return &table->entries[slot];
+}
+
+/* moves some of the entries of the old array to the current one */
+static void migrate(struct hash_table *table, size_t slots)
+{
+	size_t end;
+
+	if (!table->old_ctrl)
+		return;
+
+	end = table->old_pos + slots;
+	if (end > table->old_size)
+		end = table->old_size;
+	for (; table->old_pos < end; table->old_pos++)
+		if (!(table->old_ctrl[table->old_pos] & 0x80)) {
+			insert_entry(table, &table->old_entries[table->old_pos]);
+			table->old_ctrl[table->old_pos] = HASH_DELETED;
+		}
+
+	if (table->old_pos == table->old_size) {
+		free(table->old_ctrl);
+		free(table->old_entries);
+		table->old_ctrl = NULL;
+		table->old_entries = NULL;
+		table->old_size = 0;
+	}
+}
+
+static void finish_resize(struct hash_table *table)
+{
+	if (table->old_ctrl)
+		migrate(table, table->old_size);
+}
+
+static int alloc_arrays(size_t size, unsigned char **ctrl,
+		struct hash_entry **entries)
+{
+	*ctrl = (unsigned char*) malloc(size);
+	if (!*ctrl)
+		return 0;
+	*entries = (struct hash_entry*) malloc(size
+			* sizeof(struct hash_entry));
+	if (!*entries) {
+		free(*ctrl);
+		return 0;
 	}
+	memset(*ctrl, HASH_EMPTY, size);
 
-	return data;
+	return 1;
 }
 
-void *hash_put(struct hash_table *table, unsigned char *key, size_t
-		key_len, void *data, unsigned int force_hash)
+/* Starts moving the entries to a new array: twice as large when most of
+ * the used slots are alive, of the same size when they are mostly
+ * deleted ones. */
+static int start_resize(struct hash_table *table)
+{
+	size_t size;
+	unsigned char *ctrl;
+	struct hash_entry *entries;
+
+	finish_resize(table);
+
+	size = table->size;
+	if (table->count >= size / 16 * 7)
+		size *= 2;
+	if (!alloc_arrays(size, &ctrl, &entries))
+		return 0;
+
+	table->old_ctrl = table->ctrl;
+	table->old_entries = table->entries;
+	table->old_size = table->size;
+	table->old_pos = 0;
+
+	table->ctrl = ctrl;
+	table->entries = entries;
+	table->size = size;
+	table->used = 0;
+
+	return 1;
+}
+
+/* copies the key to the last chunk, or to a new one when it is full */
+static const char *store_key(struct hash_table *table, const char *key,
+		size_t key_len)
+{
+	struct hash_key_chunk *chunk = table->keys;
+	size_t chunk_size;
+	char *copy;
+
+	if (!chunk || chunk->size - chunk->used < key_len + 1) {
+		chunk_size = chunk ? chunk->size * 2 : HASH_KEY_CHUNK_MIN;
+		if (chunk_size > HASH_KEY_CHUNK_MAX)
+			chunk_size = HASH_KEY_CHUNK_MAX;
+		if (chunk_size < key_len + 1)
+			chunk_size = key_len + 1;
+		chunk = (struct hash_key_chunk*) malloc(
+				sizeof(struct hash_key_chunk) + chunk_size);
+		if (!chunk)
+			return NULL;
+		chunk->size = chunk_size;
+		chunk->used = 0;
+		chunk->next = table->keys;
+		table->keys = chunk;
+	}
+
+	copy = chunk->data + chunk->used;
+	memcpy(copy, key, key_len);
+	copy[key_len] = '\0';
+	chunk->used += key_len + 1;
+
+	return copy;
+}
+
+void *hash_get(struct hash_table *table, const char *key,
+		size_t key_len, unsigned int force_hash)
 {
 	unsigned int hash;
-	size_t pos;
-	struct hash_entry *found, *new;
+	struct hash_entry *found;
+	size_t slot;
+	int old;
 
 	hash = force_hash ? force_hash : get_hash(key, key_len);
-	pos = hash % table->size;
-	found = table->entries[pos];
-	if (found && found->hash == hash && found->key_len == key_len)
+	found = lookup(table, key, key_len, hash, &old, &slot);
+
+	return found ? found->data : NULL;
+}
+
+/** Puts or updates the data of a key
+ *
+ * Returns the entry, which is only valid until the next change in the
+ * table (but its ->key isn't), or NULL when there is no memory left.
+ */
+struct hash_entry *hash_put(struct hash_table *table, const char *key,
+		size_t key_len, void *data, unsigned int force_hash)
+{
+	unsigned int hash;
+	struct hash_entry *found, new;
+	size_t slot;
+	int old;
+
+	hash = force_hash ? force_hash : get_hash(key, key_len);
+	migrate(table, HASH_MIGRATE_GROUPS * HASH_GROUP);
+
+	found = lookup(table, key, key_len, hash, &old, &slot);
+	if (found) {
 		/* just update the key */
 		found->data = data;
-	else {
-		new = (struct hash_entry*) malloc(sizeof(struct hash_entry));
-		if (!new)
-			return NULL;
-#ifdef DEBUG
-		new->key = (char*) malloc(sizeof(char) * key_len + 1);
-		strncpy(new->key, key, key_len + 1);
-		new->key[key_len] = '\0';
-#endif
-		new->key_len = key_len;
-		new->next = NULL;
-		new->hash = hash;
-		new->data = data;
-		table->entries[pos] = new;
-
-		if (found) {
-			while (found->next)
-				found = found->next;
-			found->next = new;
-		}
-		else
-			table->entries[pos] = new;
-		table->count++;
+		return found;
 	}
 
-	return new; /* just to say it didn't fail */
+	/* keep at least 1/8 of the slots empty, so that the probing
+	 * always stops */
+	if (table->used + 1 > table->size / 8 * 7
+			&& !start_resize(table))
+		return NULL;
+
+	new.key = store_key(table, key, key_len);
+	if (!new.key)
+		return NULL;
+	new.key_len = key_len;
+	new.hash = hash;
+	new.data = data;
+	table->count++;
+
+	return insert_entry(table, &new);
+}
+
+void *hash_pop(struct hash_table *table, const char *key,
+		size_t key_len, unsigned int force_hash)
+{
+	unsigned int hash;
+	struct hash_entry *found;
+	unsigned char *ctrl;
+	size_t slot, base;
+	int old;
+
+	hash = force_hash ? force_hash : get_hash(key, key_len);
+	migrate(table, HASH_MIGRATE_GROUPS * HASH_GROUP);
+
+	found = lookup(table, key, key_len, hash, &old, &slot);
+	if (!found)
+		return NULL;
+
+	/* no probe went past a group that still has an empty slot, so the
+	 * slot can be made empty again instead of a tombstone */
+	ctrl = old ? table->old_ctrl : table->ctrl;
+	base = slot - slot % HASH_GROUP;
+	if (group_match(ctrl + base, HASH_EMPTY)) {
+		ctrl[slot] = HASH_EMPTY;
+		if (!old)
+			table->used--;
+	}
+	else
+		ctrl[slot] = HASH_DELETED;
+	table->count--;
+
+	return found->data;
 }
 
 /* FIXME make these iterator functions inline */
 hash_iter_t hash_iter_first(struct hash_table *table, void **dataptr)
 {
-	struct hash_entry *found;
 	hash_iter_t state;
-	size_t first;
 
-	for (first = 0;
-	     first < table->size && !table->entries[first];
-	     first++)
-		;
-	if (first >= table->size) {
-		/* nothing found, end of iteration */
-		state.i = table->size;
-		state.current = NULL;
-	}
-	else {
-		found = table->entries[first];
-		*dataptr = found->data;
-		state.i = first;
-		state.current = found;
-	}
-	return state;
+	/* only the current array is walked */
+	finish_resize(table);
+
+	state.i = (size_t) -1;
+	return hash_iter_next(table, state, dataptr);
 }
 
 hash_iter_t hash_iter_next(struct hash_table *table, hash_iter_t last,
 		void **dataptr)
 {
-	struct hash_entry *found;
-
-	found = last.current->next;
-	if (!found) {
-		/* we have reached the end of the linked list, move to the
-		 * next hash entry */
-		for (last.i++;
-		     last.i < table->size && !table->entries[last.i] ;
-		     last.i++)
-			;
-		if (last.i < table->size)
-			found = table->entries[last.i];
-		/* else let last.i pass and make hash_iter_done finish the
-		 * iteration */
-	}
-
-	if (found) {
-		*dataptr = found->data;
-		last.current = found;
-	}
+	for (last.i++; last.i < table->size && (table->ctrl[last.i] & 0x80);
+			last.i++)
+		;
+	if (last.i < table->size)
+		*dataptr = table->entries[last.i].data;
+	/* else let last.i pass and make hash_iter_done finish the
+	 * iteration */
 
 	return last;
 }
@@ -135,55 +356,57 @@ int hash_iter_done(struct hash_table *table, hash_iter_t state)
 	return state.i < table->size;
 }
 
-void hash_free_entry(struct hash_entry *entry)
+void hash_free(struct hash_table *table)
 {
-	struct hash_entry *next;
+	struct hash_key_chunk *chunk, *next;
 
-	while (entry) {
-		next = entry->next;
-		free(entry);
-		entry = next;
+	for (chunk = table->keys; chunk; chunk = next) {
+		next = chunk->next;
+		free(chunk);
 	}
-}
-
-void hash_free(struct hash_table *table)
-{
-	size_t i;
-	/* free the entries */
-	for (i = 0; i < table->size; i++)
-		if (table->entries[i])
-			hash_free_entry(table->entries[i]);
+	free(table->old_ctrl);
+	free(table->old_entries);
+	free(table->ctrl);
 	free(table->entries);
 	free(table);
 }
 
+/* size is the number of entries expected, it grows as needed */
 struct hash_table *hash_init(size_t size)
 {
-	size_t i, toalloc;
 	struct hash_table *table;
+	size_t slots;
 
 	table = (struct hash_table*) malloc(sizeof(struct hash_table));
 	if (!table)
 		return NULL;
-	toalloc = sizeof(struct hash_entry*) * size;
-	table->entries = (struct hash_entry**) malloc(toalloc);
-	if (!table->entries) {
+
+	for (slots = HASH_GROUP; slots / 8 * 7 < size; slots *= 2)
+		;
+	if (!alloc_arrays(slots, &table->ctrl, &table->entries)) {
 		free(table);
 		return NULL;
 	}
-	table->size = size;
+	table->size = slots;
 	table->count = 0;
-	memset((void*)table->entries, 0, toalloc);
+	table->used = 0;
+
+	table->old_ctrl = NULL;
+	table->old_entries = NULL;
+	table->old_size = 0;
+	table->old_pos = 0;
+
+	table->keys = NULL;
 
 	return table;
 }
 
 /* from http://www.burtleburtle.net/bob/hash/doobs.html */
-unsigned int get_hash(unsigned char *key, size_t key_len)
+unsigned int get_hash(const char *key, size_t key_len)
 {
     unsigned int hash = 0;
     size_t i;
- 
+
     for (i = 0; i < key_len; i++){
         hash += key[i];
         hash += (hash << 10);
@@ -194,4 +417,3 @@ unsigned int get_hash(unsigned char *key, size_t key_len)
     hash += (hash << 15);
     return hash;
 }
-